@@ -0,0 +1,237 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <clock.h>
+
+#define CPUID_TSC_DEADLINE      (1U << 24)  // Leaf 1 ECX
+#define CPUID_HYPERVISOR        (1U << 31)  // Leaf 1 ECX
+#define CPUID_ARAT              (1U << 2)   // Leaf 6 EAX
+#define CPUID_INVARIANT_TSC     (1U << 8)   // Leaf 0x80000007 EDX
+#define CPUID_HV_BASE           0x40000000
+#define CPUID_HV_TIMING         0x40000010  // TSC and LAPIC bus rates in kHz (VMware's leaf)
+#define CPUID_HV_LAST           0x400000FF
+
+// FADT fields; the 64-bit timer block wins when present and non-zero
+#define FADT_PM_TMR_BLK         76
+#define FADT_PM_TMR_LEN         91
+#define FADT_FLAGS              112
+#define FADT_X_PM_TMR_BLK       208
+#define FADT_TMR_VAL_EXT        (1U << 8)
+#define FADT_HW_REDUCED_ACPI    (1U << 20)
+#define GAS_SIZE                12
+#define GAS_SYSTEM_MEMORY       0
+#define GAS_SYSTEM_IO           1
+#define IO_PORT_LAST            0xFFFF
+
+#define CRYSTAL_TOLERANCE_PPM   50          // Typical of a quartz crystal; CPUID 0x15 does not say
+
+#define PM_TIMER_HZ             3579545
+#define PM_TIMER_TOLERANCE_PPM  CRYSTAL_TOLERANCE_PPM   // Divided from a 14.318 MHz crystal
+#define PM_MIN_TICKS            (PM_TIMER_HZ / 1000)    // 1 ms
+#define PM_MAX_TICKS            (PM_TIMER_HZ / 100)     // 10 ms
+#define PM_TARGET_PPM           100
+#define PM_EDGE_READS           100000      // A counter that stops is not a timer
+
+#define STALL_US                1000
+#define STALL_ERROR_PPM         1000        // Stall() only promises a minimum; a guess at how much more
+
+typedef struct {
+    UINTN   Address;
+    BOOLEAN Io;
+    UINT32  Mask;       // 24- or 32-bit counter
+} PM_TIMER;
+
+// Parts per million that ErrorHz is of Frequency, rounded up
+STATIC UINT32 ClockErrorPpm(UINT64 ErrorHz, UINT64 Frequency) {
+    return (UINT32)((ErrorHz * 1000000 + Frequency - 1) / Frequency);
+}
+
+STATIC UINT32 ClockFlags(VOID) {
+    UINT32 MaxLeaf, Eax, Ecx, Edx;
+    UINT32 Flags = 0;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    AsmCpuid(1, NULL, NULL, &Ecx, NULL);
+    if (Ecx & CPUID_TSC_DEADLINE) Flags |= PXS_CLOCK_TSC_DEADLINE;
+    if (MaxLeaf >= 6) {
+        AsmCpuid(6, &Eax, NULL, NULL, NULL);
+        if (Eax & CPUID_ARAT) Flags |= PXS_CLOCK_APIC_ARAT;
+    }
+    AsmCpuid(0x80000000, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf >= 0x80000007) {
+        AsmCpuid(0x80000007, NULL, NULL, NULL, &Edx);
+        if (Edx & CPUID_INVARIANT_TSC) Flags |= PXS_CLOCK_INVARIANT_TSC;
+    }
+    return Flags;
+}
+
+// Hypervisors known to put the timing leaf at CPUID_HV_TIMING: VMware, and KVM
+// when QEMU runs it with vmware-cpuid-freq. Others use that leaf for something
+// else, or not at all.
+STATIC CONST CHAR8 *CONST mTimingLeafVendors[] = { "VMwareVMware", "KVMKVMKVM\0\0\0" };
+
+// Under a hypervisor the measured rates are whatever the host scheduled; the
+// timing leaf gives the ones it programmed
+STATIC BOOLEAN ClockFromHypervisor(PXS_CLOCKS *Clocks) {
+    UINT32 Ecx, MaxLeaf, TscKhz, BusKhz;
+    UINT32 Vendor[3];
+    BOOLEAN Known = FALSE;
+
+    AsmCpuid(1, NULL, NULL, &Ecx, NULL);
+    if (!(Ecx & CPUID_HYPERVISOR)) return FALSE;
+    AsmCpuid(CPUID_HV_BASE, &MaxLeaf, &Vendor[0], &Vendor[1], &Vendor[2]);
+    for (UINTN i = 0; i < ARRAY_SIZE(mTimingLeafVendors); i++) {
+        if (CompareMem(Vendor, mTimingLeafVendors[i], sizeof(Vendor)) == 0) Known = TRUE;
+    }
+    if (!Known) return FALSE;
+    if (MaxLeaf < CPUID_HV_TIMING || MaxLeaf > CPUID_HV_LAST) return FALSE;
+    AsmCpuid(CPUID_HV_TIMING, &TscKhz, &BusKhz, NULL, NULL);
+    if (TscKhz == 0) return FALSE;
+
+    Clocks->TscFrequency = (UINT64)TscKhz * 1000;
+    Clocks->TscErrorPpm = ClockErrorPpm(500, Clocks->TscFrequency);    // Rounded to a kHz
+    Clocks->TscSource = PXS_CLOCK_SOURCE_HYPERVISOR;
+    Clocks->ApicTimerFrequency = (UINT64)BusKhz * 1000;
+    return TRUE;
+}
+
+STATIC BOOLEAN ClockFromCpuid(PXS_CLOCKS *Clocks) {
+    UINT32 MaxLeaf, Denominator, Numerator, CrystalHz, BaseMhz;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf < 0x15) return FALSE;
+    AsmCpuid(0x15, &Denominator, &Numerator, &CrystalHz, NULL);
+    if (Denominator == 0 || Numerator == 0) return FALSE;
+
+    if (CrystalHz != 0) {
+        Clocks->CrystalFrequency = CrystalHz;
+        Clocks->TscFrequency = (UINT64)CrystalHz * Numerator / Denominator;
+        Clocks->TscErrorPpm = CRYSTAL_TOLERANCE_PPM;
+        Clocks->TscSource = PXS_CLOCK_SOURCE_CPUID;
+    } else {
+        // Parts that leave the crystal out run the TSC at the base frequency
+        if (MaxLeaf < 0x16) return FALSE;
+        AsmCpuid(0x16, &BaseMhz, NULL, NULL, NULL);
+        BaseMhz &= 0xFFFF;
+        if (BaseMhz == 0) return FALSE;
+        Clocks->TscFrequency = (UINT64)BaseMhz * 1000000;
+        Clocks->CrystalFrequency = Clocks->TscFrequency * Denominator / Numerator;
+        Clocks->TscErrorPpm = ClockErrorPpm(500000, Clocks->TscFrequency) + CRYSTAL_TOLERANCE_PPM;  // Rounded to a MHz
+        Clocks->TscSource = PXS_CLOCK_SOURCE_CPUID_BASE;
+    }
+
+    // The LAPIC timer runs off the core crystal on the parts that report one
+    Clocks->ApicTimerFrequency = Clocks->CrystalFrequency;
+    return TRUE;
+}
+
+STATIC UINT32 PmTimerRead(CONST PM_TIMER *Timer) {
+    UINT32 Value;
+
+    if (Timer->Io) {
+        __asm__ __volatile__("inl %w1, %0" : "=a"(Value) : "Nd"((UINT16)Timer->Address));
+    } else {
+        Value = *(volatile UINT32 *)Timer->Address;
+    }
+    return Value & Timer->Mask;
+}
+
+STATIC BOOLEAN PmTimerFind(CONST UINT8 *Fadt, PM_TIMER *Timer) {
+    UINT32 Length, Flags, Port;
+    UINT64 Address;
+
+    SetMem(Timer, sizeof(*Timer), 0);
+    if (!Fadt) return FALSE;
+    CopyMem(&Length, Fadt + 4, sizeof(Length));
+    if (Length < FADT_FLAGS + sizeof(Flags)) return FALSE;
+    CopyMem(&Flags, Fadt + FADT_FLAGS, sizeof(Flags));
+    if (Flags & FADT_HW_REDUCED_ACPI) return FALSE;
+    Timer->Mask = (Flags & FADT_TMR_VAL_EXT) ? MAX_UINT32 : 0xFFFFFF;
+
+    if (Length >= FADT_X_PM_TMR_BLK + GAS_SIZE) {
+        UINT8 Space = Fadt[FADT_X_PM_TMR_BLK];
+        CopyMem(&Address, Fadt + FADT_X_PM_TMR_BLK + 4, sizeof(Address));
+        if (Address != 0 && (Space == GAS_SYSTEM_IO || Space == GAS_SYSTEM_MEMORY)) {
+            Timer->Address = (UINTN)Address;
+            Timer->Io = Space == GAS_SYSTEM_IO;
+            return !Timer->Io || Address <= IO_PORT_LAST;
+        }
+    }
+
+    CopyMem(&Port, Fadt + FADT_PM_TMR_BLK, sizeof(Port));
+    if (Port == 0 || Port > IO_PORT_LAST || Fadt[FADT_PM_TMR_LEN] < 4) return FALSE;
+    Timer->Address = Port;
+    Timer->Io = TRUE;
+    return TRUE;
+}
+
+// Wait for the counter to tick. The tick fell between the start of the last
+// read that saw the old value and the end of the first that saw the new one,
+// which the TSC brackets as [*Low, *High].
+STATIC BOOLEAN PmTimerEdge(CONST PM_TIMER *Timer, UINT32 *Value, UINT64 *Low, UINT64 *High) {
+    UINT64 Start = __builtin_ia32_rdtsc();
+    UINT32 From = PmTimerRead(Timer);
+
+    for (UINTN i = 0; i < PM_EDGE_READS; i++) {
+        UINT64 ReadStart = __builtin_ia32_rdtsc();
+        *Value = PmTimerRead(Timer);
+        UINT64 ReadEnd = __builtin_ia32_rdtsc();
+        if (*Value != From) {
+            *Low = Start;
+            *High = ReadEnd;
+            return TRUE;
+        }
+        Start = ReadStart;
+    }
+    return FALSE;
+}
+
+// Count TSC cycles between two ticks of the PM timer. Each edge is taken at
+// the middle of its bracket, so the count is off by at most half of both
+// brackets; the window grows until that is under PM_TARGET_PPM or it reaches
+// PM_MAX_TICKS.
+STATIC BOOLEAN CalibratePmTimer(CONST PM_TIMER *Timer, PXS_CLOCKS *Clocks) {
+    UINT32 First, Last;
+    UINT64 Low0, High0, Low1, High1;
+
+    if (!PmTimerEdge(Timer, &First, &Low0, &High0)) return FALSE;
+    for (;;) {
+        if (!PmTimerEdge(Timer, &Last, &Low1, &High1)) return FALSE;
+        UINT32 Ticks = (Last - First) & Timer->Mask;
+        if (Ticks < PM_MIN_TICKS) continue;
+
+        UINT64 Cycles = (Low1 + (High1 - Low1) / 2) - (Low0 + (High0 - Low0) / 2);
+        UINT64 Slack = ((High0 - Low0) + (High1 - Low1)) / 2 + 1;
+        if (Cycles == 0) return FALSE;
+        if (Slack * 1000000 > Cycles * PM_TARGET_PPM && Ticks < PM_MAX_TICKS) continue;
+
+        Clocks->TscFrequency = Cycles * PM_TIMER_HZ / Ticks;
+        Clocks->TscErrorPpm = ClockErrorPpm(Slack, Cycles) + PM_TIMER_TOLERANCE_PPM;
+        Clocks->TscSource = PXS_CLOCK_SOURCE_PM_TIMER;
+        return TRUE;
+    }
+}
+
+STATIC VOID CalibrateStall(PXS_CLOCKS *Clocks) {
+    UINT64 Start = __builtin_ia32_rdtsc();
+    gBS->Stall(STALL_US);
+    UINT64 Cycles = __builtin_ia32_rdtsc() - Start;
+
+    Clocks->TscFrequency = Cycles * (1000000 / STALL_US);
+    Clocks->TscErrorPpm = STALL_ERROR_PPM;
+    Clocks->TscSource = Cycles ? PXS_CLOCK_SOURCE_STALL : PXS_CLOCK_SOURCE_NONE;
+}
+
+VOID ClockCalibrate(IN CONST VOID *Fadt OPTIONAL, OUT PXS_CLOCKS *Clocks) {
+    PM_TIMER Timer;
+
+    SetMem(Clocks, sizeof(*Clocks), 0);
+    Clocks->Version = PXS_CLOCKS_VERSION;
+    Clocks->Flags = ClockFlags();
+
+    if (ClockFromHypervisor(Clocks) || ClockFromCpuid(Clocks)) return;
+    if (PmTimerFind((CONST UINT8 *)Fadt, &Timer) && CalibratePmTimer(&Timer, Clocks)) return;
+    CalibrateStall(Clocks);
+}
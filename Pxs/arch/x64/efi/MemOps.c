@@ -0,0 +1,222 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <compiler.h>
+#include <memops.h>
+
+// Below this BaseMemoryLib is as good as anything and has no setup cost
+#define MEMOPS_BULK_MIN        SIZE_2KB
+#define MEMOPS_DEFAULT_LLC     SIZE_8MB
+#define MEMOPS_STREAM_ALIGN    64
+
+#define CPUID1_ECX_OSXSAVE     (1U << 27)
+#define CPUID1_ECX_AVX         (1U << 28)
+#define CPUID7_EBX_ERMS        (1U << 9)
+#define XCR0_SSE_AVX           0x6
+
+STATIC BOOLEAN mErms = FALSE;
+STATIC BOOLEAN mAvx = FALSE;
+STATIC UINTN   mStreamThreshold = MAX_UINTN;
+
+// Direction flag is clear on entry to any UEFI function
+STATIC VOID RepMovsb(VOID *Dest, CONST VOID *Src, UINTN Length) {
+    __asm__ __volatile__("rep movsb" : "+D"(Dest), "+S"(Src), "+c"(Length) : : "memory");
+}
+
+STATIC VOID RepStosb(VOID *Dest, UINT8 Value, UINTN Length) {
+    __asm__ __volatile__("rep stosb" : "+D"(Dest), "+c"(Length) : "a"(Value) : "memory");
+}
+
+STATIC VOID SmallCopy(VOID *Dest, CONST VOID *Src, UINTN Length) {
+    if (mErms) RepMovsb(Dest, Src, Length);
+    else CopyMem(Dest, Src, Length);
+}
+
+STATIC VOID SmallSet(VOID *Dest, UINT8 Value, UINTN Length) {
+    if (mErms) RepStosb(Dest, Value, Length);
+    else SetMem(Dest, Length, Value);
+}
+
+// The streaming loops below move Blocks * 64 bytes to a 64-byte aligned Dest
+// with non-temporal stores. Each block is loaded before it is stored, so Dest
+// may trail Src in an overlap. They carry their own target so the rest of the
+// image can be built without SSE code generation.
+
+__target("avx")
+STATIC VOID StreamCopyAvx(UINT8 *Dest, CONST UINT8 *Src, UINTN Blocks) {
+    __asm__ __volatile__(
+        "1:\n\t"
+        "vmovdqu  0(%1), %%ymm0\n\t"
+        "vmovdqu 32(%1), %%ymm1\n\t"
+        "vmovntdq %%ymm0,  0(%0)\n\t"
+        "vmovntdq %%ymm1, 32(%0)\n\t"
+        "add $64, %0\n\t"
+        "add $64, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper\n\t"
+        "sfence"
+        : "+r"(Dest), "+r"(Src), "+r"(Blocks)
+        :
+        : "xmm0", "xmm1", "memory", "cc"
+    );
+}
+
+__target("sse2")
+STATIC VOID StreamCopySse2(UINT8 *Dest, CONST UINT8 *Src, UINTN Blocks) {
+    __asm__ __volatile__(
+        "1:\n\t"
+        "movdqu  0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movntdq %%xmm0,  0(%0)\n\t"
+        "movntdq %%xmm1, 16(%0)\n\t"
+        "movntdq %%xmm2, 32(%0)\n\t"
+        "movntdq %%xmm3, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "add $64, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(Dest), "+r"(Src), "+r"(Blocks)
+        :
+        : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc"
+    );
+}
+
+// Pattern holds 32 copies of the fill byte
+__target("avx")
+STATIC VOID StreamSetAvx(UINT8 *Dest, CONST UINT8 *Pattern, UINTN Blocks) {
+    __asm__ __volatile__(
+        "vmovdqu (%2), %%ymm0\n\t"
+        "1:\n\t"
+        "vmovntdq %%ymm0,  0(%0)\n\t"
+        "vmovntdq %%ymm0, 32(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper\n\t"
+        "sfence"
+        : "+r"(Dest), "+r"(Blocks)
+        : "r"(Pattern)
+        : "xmm0", "memory", "cc"
+    );
+}
+
+__target("sse2")
+STATIC VOID StreamSetSse2(UINT8 *Dest, CONST UINT8 *Pattern, UINTN Blocks) {
+    __asm__ __volatile__(
+        "movdqu (%2), %%xmm0\n\t"
+        "1:\n\t"
+        "movntdq %%xmm0,  0(%0)\n\t"
+        "movntdq %%xmm0, 16(%0)\n\t"
+        "movntdq %%xmm0, 32(%0)\n\t"
+        "movntdq %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(Dest), "+r"(Blocks)
+        : "r"(Pattern)
+        : "xmm0", "memory", "cc"
+    );
+}
+
+// Largest data or unified cache: CPUID leaf 4 on Intel, 0x80000006 on AMD
+STATIC UINTN LastLevelCacheSize(UINT32 MaxLeaf) {
+    UINTN Largest = 0;
+    UINT32 Eax, Ebx, Ecx, Edx;
+
+    if (MaxLeaf >= 4) {
+        for (UINT32 Index = 0; Index < 16; Index++) {
+            AsmCpuidEx(4, Index, &Eax, &Ebx, &Ecx, NULL);
+            UINT32 Type = Eax & 0x1F;
+            if (Type == 0) break;
+            if (Type == 2) continue;  // Instruction cache
+            UINTN Size = (UINTN)(((Ebx >> 22) & 0x3FF) + 1) * (((Ebx >> 12) & 0x3FF) + 1) *
+                         ((Ebx & 0xFFF) + 1) * ((UINTN)Ecx + 1);
+            Largest = MAX(Largest, Size);
+        }
+    }
+    if (Largest == 0) {
+        AsmCpuid(0x80000000, &Eax, NULL, NULL, NULL);
+        if (Eax >= 0x80000006) {
+            AsmCpuid(0x80000006, NULL, NULL, &Ecx, &Edx);
+            Largest = MAX((UINTN)(Ecx >> 16) * SIZE_1KB, (UINTN)(Edx >> 18) * SIZE_512KB);
+        }
+    }
+    return Largest;
+}
+
+VOID MemOpsInit(OUT CONST CHAR16 **Name) {
+    UINT32 MaxLeaf, Ecx1 = 0, Ebx7 = 0;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    AsmCpuid(1, NULL, NULL, &Ecx1, NULL);
+    if (MaxLeaf >= 7) {
+        AsmCpuidEx(7, 0, NULL, &Ebx7, NULL, NULL);
+    }
+    mErms = (Ebx7 & CPUID7_EBX_ERMS) != 0;
+
+    // SSE2 is architectural on x64. YMM stores also need the firmware to have
+    // enabled AVX state in XCR0, which the loader does not change.
+    mAvx = (Ecx1 & CPUID1_ECX_AVX) && (Ecx1 & CPUID1_ECX_OSXSAVE) &&
+           (AsmXGetBv(0) & XCR0_SSE_AVX) == XCR0_SSE_AVX;
+
+    UINTN Llc = LastLevelCacheSize(MaxLeaf);
+    mStreamThreshold = Llc ? MAX(Llc, MEMOPS_BULK_MIN) : MEMOPS_DEFAULT_LLC;
+
+    if (mErms) *Name = mAvx ? L"erms, avx streaming" : L"erms, sse2 streaming";
+    else *Name = mAvx ? L"avx streaming" : L"sse2 streaming";
+}
+
+UINTN MemOpsStreamingThreshold(VOID) {
+    return mStreamThreshold;
+}
+
+VOID *BulkCopyMem(OUT VOID *Destination, IN CONST VOID *Source, IN UINTN Length) {
+    UINT8 *Dest = (UINT8 *)Destination;
+    CONST UINT8 *Src = (CONST UINT8 *)Source;
+
+    if (Length < MEMOPS_BULK_MIN || (Dest > Src && Dest < Src + Length)) {
+        return CopyMem(Destination, Source, Length);
+    }
+    if (Length < mStreamThreshold) {
+        SmallCopy(Dest, Src, Length);
+        return Destination;
+    }
+
+    UINTN Head = (UINTN)(-(UINTN)Dest) & (MEMOPS_STREAM_ALIGN - 1);
+    UINTN Blocks = (Length - Head) / MEMOPS_STREAM_ALIGN;
+    UINTN Body = Blocks * MEMOPS_STREAM_ALIGN;
+    if (Head > 0) SmallCopy(Dest, Src, Head);
+    if (mAvx) StreamCopyAvx(Dest + Head, Src + Head, Blocks);
+    else StreamCopySse2(Dest + Head, Src + Head, Blocks);
+    if (Head + Body < Length) SmallCopy(Dest + Head + Body, Src + Head + Body, Length - Head - Body);
+    return Destination;
+}
+
+VOID *BulkSetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value) {
+    UINT8 *Dest = (UINT8 *)Buffer;
+
+    if (Length < MEMOPS_BULK_MIN) {
+        return SetMem(Buffer, Length, Value);
+    }
+    if (Length < mStreamThreshold) {
+        SmallSet(Dest, Value, Length);
+        return Buffer;
+    }
+
+    UINTN Head = (UINTN)(-(UINTN)Dest) & (MEMOPS_STREAM_ALIGN - 1);
+    UINTN Blocks = (Length - Head) / MEMOPS_STREAM_ALIGN;
+    UINTN Body = Blocks * MEMOPS_STREAM_ALIGN;
+    UINT8 Pattern[32];
+    SetMem(Pattern, sizeof(Pattern), Value);
+    if (Head > 0) SmallSet(Dest, Value, Head);
+    if (mAvx) StreamSetAvx(Dest + Head, Pattern, Blocks);
+    else StreamSetSse2(Dest + Head, Pattern, Blocks);
+    if (Head + Body < Length) SmallSet(Dest + Head + Body, Value, Length - Head - Body);
+    return Buffer;
+}
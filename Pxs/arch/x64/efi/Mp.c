@@ -0,0 +1,75 @@
+#include <Uefi.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <mp.h>
+
+typedef struct {
+    PXS_WORK_POOL *Pool;
+    PXS_WORK_FUNC Func;
+    VOID          *Context;
+    UINTN         Items;
+    UINTN         Next;     // Next unclaimed item, advanced atomically
+} PXS_WORK_BATCH;
+
+VOID WorkPoolInit(OUT PXS_WORK_POOL *Pool) {
+    EFI_MP_SERVICES_PROTOCOL *Mp;
+    UINTN Total, Enabled;
+
+    SetMem(Pool, sizeof(*Pool), 0);
+    Pool->Workers = 1;
+    Pool->Enabled = 1;
+
+    if (EFI_ERROR(gBS->LocateProtocol(&gEfiMpServiceProtocolGuid, NULL, (VOID **)&Mp))) return;
+    if (EFI_ERROR(Mp->GetNumberOfProcessors(Mp, &Total, &Enabled)) || Enabled < 2) return;
+
+    Pool->Mp = Mp;
+    Pool->Workers = Total;
+    Pool->Enabled = Enabled;
+}
+
+STATIC VOID WorkPoolDrain(IN PXS_WORK_BATCH *Batch) {
+    UINTN Worker = 0;
+    if (Batch->Pool->Mp) {
+        Batch->Pool->Mp->WhoAmI(Batch->Pool->Mp, &Worker);
+    }
+    for (;;) {
+        UINTN Item = __atomic_fetch_add(&Batch->Next, 1, __ATOMIC_RELAXED);
+        if (Item >= Batch->Items) return;
+        Batch->Func(Batch->Context, Item, Worker);
+    }
+}
+
+STATIC VOID EFIAPI WorkPoolAp(IN VOID *Argument) {
+    WorkPoolDrain((PXS_WORK_BATCH *)Argument);
+}
+
+VOID WorkPoolRun(IN PXS_WORK_POOL *Pool, IN PXS_WORK_FUNC Func, IN VOID *Context, IN UINTN Items) {
+    PXS_WORK_BATCH Batch = { Pool, Func, Context, Items, 0 };
+    EFI_EVENT Done = NULL;
+    EFI_STATUS Status = EFI_NOT_STARTED;
+
+    if (Pool->Mp && Items > 1) {
+        // Non-blocking start so the BSP can take items too; StartupAllAPs
+        // returns only after every AP finished when no event is given
+        if (!EFI_ERROR(gBS->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &Done))) {
+            Status = Pool->Mp->StartupAllAPs(Pool->Mp, WorkPoolAp, FALSE, Done, 0, &Batch, NULL);
+            if (EFI_ERROR(Status)) {
+                gBS->CloseEvent(Done);
+                Done = NULL;
+            }
+        }
+        if (EFI_ERROR(Status)) {
+            Pool->Mp->StartupAllAPs(Pool->Mp, WorkPoolAp, FALSE, NULL, 0, &Batch, NULL);
+        }
+    }
+
+    // Whatever the APs left (everything without them)
+    WorkPoolDrain(&Batch);
+
+    if (Done) {
+        UINTN Index;
+        gBS->WaitForEvent(1, &Done, &Index);
+        gBS->CloseEvent(Done);
+    }
+}
@@ -0,0 +1,181 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <paging.h>
+
+#define MSR_EFER        0xC0000080
+#define MSR_PAT         0x277
+#define EFER_NXE        (1ULL << 11)
+#define CR4_PGE         (1ULL << 7)
+#define CR4_LA57        (1ULL << 12)
+#define PAT_TYPE_WC     0x01
+
+#define TABLE_BATCH_PAGES 16
+
+// Tables come from small page batches to keep the firmware memory map short
+STATIC EFI_STATUS AllocateTable(PXS_PAGE_TABLES *Tables, UINT64 **Table) {
+    if (Tables->PoolPages == 0) {
+        EFI_PHYSICAL_ADDRESS Address = 0;
+        EFI_STATUS Status = Tables->Allocate ? Tables->Allocate(TABLE_BATCH_PAGES, &Address)
+                                             : gBS->AllocatePages(AllocateAnyPages, EfiLoaderData, TABLE_BATCH_PAGES, &Address);
+        if (EFI_ERROR(Status)) return Status;
+        Tables->Pool = Address;
+        Tables->PoolPages = TABLE_BATCH_PAGES;
+    }
+
+    *Table = (UINT64 *)Tables->Pool;
+    Tables->Pool += EFI_PAGE_SIZE;
+    Tables->PoolPages--;
+    Tables->TablePages++;
+    SetMem(*Table, EFI_PAGE_SIZE, 0);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS PagingInit(OUT PXS_PAGE_TABLES *Tables, IN PXS_PAGING_ALLOCATE Allocate OPTIONAL) {
+    UINT32 MaxLeaf, Edx;
+    UINT64 *Root;
+
+    SetMem(Tables, sizeof(*Tables), 0);
+    Tables->Allocate = Allocate;
+
+    AsmCpuid(1, NULL, NULL, NULL, &Edx);
+    Tables->PatSupported = (Edx & (1U << 16)) != 0;
+    AsmCpuid(0x80000000, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf >= 0x80000001) {
+        AsmCpuid(0x80000001, NULL, NULL, NULL, &Edx);
+        Tables->NxSupported = (Edx & (1U << 20)) != 0;
+        Tables->Huge1G = (Edx & (1U << 26)) != 0;
+    }
+
+    // LA57 can only change with paging off, so follow whatever the firmware chose
+    Tables->Levels = (AsmReadCr4() & CR4_LA57) ? 5 : 4;
+
+    EFI_STATUS Status = AllocateTable(Tables, &Root);
+    if (EFI_ERROR(Status)) return Status;
+    Tables->Root = (UINT64)Root;
+    return EFI_SUCCESS;
+}
+
+STATIC UINT64 LeafFlags(CONST PXS_PAGE_TABLES *Tables, UINT32 Attributes) {
+    UINT64 Flags = PXS_PTE_PRESENT;
+    if (Attributes & PXS_MAP_WRITE) Flags |= PXS_PTE_WRITE;
+    if (Attributes & PXS_MAP_GLOBAL) Flags |= PXS_PTE_GLOBAL;
+    if (!(Attributes & PXS_MAP_EXEC) && Tables->NxSupported) Flags |= PXS_PTE_NX;
+    if (Attributes & PXS_MAP_WC) {
+        // Entry 5 (PAT + PWT) where PAT exists, else plain uncached
+        Flags |= Tables->PatSupported ? PXS_PTE_PWT : (PXS_PTE_PCD | PXS_PTE_PWT);
+    }
+    if (Attributes & PXS_MAP_UC) Flags |= PXS_PTE_PCD | PXS_PTE_PWT;
+    return Flags;
+}
+
+// Replace a large page at Level with a table of the next smaller pages
+STATIC EFI_STATUS SplitLarge(PXS_PAGE_TABLES *Tables, UINT64 *Entry, UINT32 Level) {
+    UINT64 *Table;
+    EFI_STATUS Status = AllocateTable(Tables, &Table);
+    if (EFI_ERROR(Status)) return Status;
+
+    UINT64 Base = *Entry & PXS_PTE_ADDRESS & ~(PXS_PTE_PAT_LARGE);
+    UINT64 Flags = *Entry & ~PXS_PTE_ADDRESS;
+    UINT64 Step = 1ULL << (12 + 9 * (Level - 2));
+
+    if (Level == 2) {
+        // 4K entries keep PAT in bit 7, where large pages keep PS
+        Flags &= ~PXS_PTE_LARGE;
+        if (*Entry & PXS_PTE_PAT_LARGE) Flags |= PXS_PTE_PAT_4K;
+    } else if (*Entry & PXS_PTE_PAT_LARGE) {
+        Flags |= PXS_PTE_PAT_LARGE;
+    }
+
+    for (UINTN i = 0; i < 512; i++) {
+        Table[i] = (Base + i * Step) | Flags;
+    }
+    *Entry = (UINT64)Table | PXS_PTE_PRESENT | PXS_PTE_WRITE;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS PagingMap(
+    IN OUT PXS_PAGE_TABLES *Tables,
+    IN UINT64 Virt,
+    IN UINT64 Phys,
+    IN UINT64 Size,
+    IN UINT32 Attributes
+) {
+    EFI_STATUS Status;
+    UINT64 Flags = LeafFlags(Tables, Attributes);
+    BOOLEAN Pat = (Attributes & PXS_MAP_WC) && Tables->PatSupported;
+
+    if (Pat) Tables->UsesWc = TRUE;
+
+    Size = (Size + (Virt & EFI_PAGE_MASK) + EFI_PAGE_MASK) & ~(UINT64)EFI_PAGE_MASK;
+    Virt &= ~(UINT64)EFI_PAGE_MASK;
+    Phys &= ~(UINT64)EFI_PAGE_MASK;
+
+    while (Size > 0) {
+        // Pick the largest page both addresses are aligned for
+        UINT32 Target = 1;
+        if (!(Attributes & PXS_MAP_NO_LARGE)) {
+            if (Tables->Huge1G && Size >= PXS_SIZE_1G && ((Virt | Phys) & (PXS_SIZE_1G - 1)) == 0) {
+                Target = 3;
+            } else if (Size >= PXS_SIZE_2M && ((Virt | Phys) & (PXS_SIZE_2M - 1)) == 0) {
+                Target = 2;
+            }
+        }
+
+        UINT64 *Table = (UINT64 *)Tables->Root;
+        for (UINT32 Level = Tables->Levels; Level > Target; Level--) {
+            UINT64 *Entry = &Table[(Virt >> (12 + 9 * (Level - 1))) & 511];
+            if (!(*Entry & PXS_PTE_PRESENT)) {
+                UINT64 *Next;
+                Status = AllocateTable(Tables, &Next);
+                if (EFI_ERROR(Status)) return Status;
+                *Entry = (UINT64)Next | PXS_PTE_PRESENT | PXS_PTE_WRITE;
+            } else if (Level <= 3 && (*Entry & PXS_PTE_LARGE)) {
+                Status = SplitLarge(Tables, Entry, Level);
+                if (EFI_ERROR(Status)) return Status;
+            }
+            Table = (UINT64 *)(*Entry & PXS_PTE_ADDRESS);
+        }
+
+        UINT64 PageSize = 1ULL << (12 + 9 * (Target - 1));
+        UINT64 Leaf = Phys | Flags;
+        if (Target > 1) Leaf |= PXS_PTE_LARGE | (Pat ? PXS_PTE_PAT_LARGE : 0);
+        else if (Pat) Leaf |= PXS_PTE_PAT_4K;
+        Table[(Virt >> (12 + 9 * (Target - 1))) & 511] = Leaf;
+
+        Virt += PageSize;
+        Phys += PageSize;
+        Size -= PageSize;
+    }
+    return EFI_SUCCESS;
+}
+
+UINT64 PagingPat(IN CONST PXS_PAGE_TABLES *Tables, IN UINT64 Pat) {
+    if (Tables->UsesWc) {
+        Pat &= ~(0xFFULL << (8 * PXS_PAT_WC_INDEX));
+        Pat |= (UINT64)PAT_TYPE_WC << (8 * PXS_PAT_WC_INDEX);
+    }
+    return Pat;
+}
+
+VOID PagingActivate(IN CONST PXS_PAGE_TABLES *Tables) {
+    if (Tables->NxSupported) {
+        AsmWriteMsr64(MSR_EFER, AsmReadMsr64(MSR_EFER) | EFER_NXE);
+    }
+    if (Tables->UsesWc) {
+        // Nothing cached may be left under the old type of entry 5
+        UINT64 Pat = PagingPat(Tables, AsmReadMsr64(MSR_PAT));
+        AsmWbinvd();
+        AsmWriteMsr64(MSR_PAT, Pat);
+    }
+    AsmWriteCr3(Tables->Root);
+
+    // CR3 keeps global TLB entries, which may still hold the firmware's types
+    UINTN Cr4 = AsmReadCr4();
+    if (Cr4 & CR4_PGE) {
+        AsmWriteCr4(Cr4 & ~CR4_PGE);
+        AsmWriteCr4(Cr4);
+    }
+}
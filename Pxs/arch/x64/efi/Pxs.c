@@ -4,6 +4,11 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/PrintLib.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
 #include <Protocol/GraphicsOutput.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/LoadedImage.h>
@@ -12,17 +17,59 @@
 #include <Guid/Acpi.h>
 #include <Guid/SmBios.h>
 
+#include <acpi.h>
+#include <clock.h>
 #include <compiler.h>
 #include <elf.h>
+#include <decompress.h>
+#include <hex.h>
+#include <cpio.h>
+#include <memmap.h>
+#include <memops.h>
+#include <mp.h>
+#include <numa.h>
+#include <paging.h>
+#include <partition.h>
+#include <sha256.h>
+#include <smbios.h>
+#include <smp.h>
 #include <include/protocol.h>
 
 #define PXS_LOADER_VERSION "0.1.0"
 #define DEFAULT_KERNEL_PATH L"voidframex.krnl"
 #define DEFAULT_CONFIG_PATH L"pxs.cfg"
+#define PXS_MAX_MODULES 16
+#define PXS_MAX_ENTRIES 16
+#define PXS_MENU_TITLE_SIZE 64
+#define KASLR_ALIGN SIZE_2MB
+#define KASLR_DEFAULT_MIN SIZE_2MB
+#define KASLR_VIRT_MIN 0xFFFFFFFF80000000ULL   // Run window of relocatable kernels with PAGING=1
+#define KASLR_VIRT_MAX 0xFFFFFFFFC0000000ULL
 
 // Kernel Entry Point Type
 typedef VOID (__sysv_abi *KERNEL_ENTRY)(PXS_BOOT_INFO *BootInfo);
 
+typedef struct {
+    CHAR16 Path[256];
+    CHAR8  Name[PXS_MODULE_NAME_SIZE];
+    UINT64 Alignment;
+} PXS_MODULE_CONFIG;
+
+// An [entry] section of the config file
+typedef struct {
+    CHAR16 Title[PXS_MENU_TITLE_SIZE];
+    UINTN  Start;   // Offsets of the section body in PXS_CONFIG.Text
+    UINTN  End;
+} PXS_MENU_ENTRY;
+
+// A loaded PT_LOAD segment, after the KASLR slide
+typedef struct {
+    UINT64 VirtualAddress;
+    UINT64 PhysicalAddress;
+    UINT64 MemorySize;
+    UINT32 Flags;           ///< PF_R / PF_W / PF_X
+} PXS_KERNEL_SEGMENT;
+
 typedef struct {
     CHAR16 KernelPath[256];
     CHAR16 InitrdPath[256];
@@ -30,8 +77,124 @@ typedef struct {
     UINTN  Timeout;
     UINT64 KvBase;
     BOOLEAN KaslrEnabled;
+    UINT64 KaslrMin;                                 // The kernel is placed in [KaslrMin, KaslrMax)
+    UINT64 KaslrMax;
+    BOOLEAN PagingEnabled;
+    UINT32 ResolutionWidth;                          // RESOLUTION=, 0 to keep the firmware mode
+    UINT32 ResolutionHeight;
+    UINT32 MaxResWidth;                              // MAXRES=, 0 for no limit
+    UINT32 MaxResHeight;
+    PXS_MODULE_CONFIG Modules[PXS_MAX_MODULES];
+    UINTN  ModuleCount;
+    BOOLEAN VerifyKernel;                            // KERNEL_SHA256= given
+    BOOLEAN VerifyInitrd;                            // INITRD_SHA256= given
+    UINT8  KernelSha256[PXS_SHA256_DIGEST_SIZE];
+    UINT8  InitrdSha256[PXS_SHA256_DIGEST_SIZE];
+    PXS_MENU_ENTRY Entries[PXS_MAX_ENTRIES];
+    UINTN  EntryCount;                               // 0: no sections, boot the global keys
+    UINTN  DefaultEntry;
+    BOOLEAN MenuHidden;                              // MENU=hidden
+    UINT8  LogLevel;                                 // LOG=, console level (PXS_LOG_*)
+    BOOLEAN SmpPark;                                 // SMP=, park APs on mailboxes for the kernel
+    CHAR8  *Text;                                    // Config file until an entry is applied
+    UINTN  TextSize;
 } PXS_CONFIG;
 
+// --------------------------------------------------------------------------
+// LOG
+// --------------------------------------------------------------------------
+
+// Every message goes into a ring of PXS_LOG_RECORDs that the kernel receives
+// through PXS_BOOT_INFO.Log. Only those at or below the LOG= level are also
+// written to ConOut, where each line can cost milliseconds of firmware text
+// rendering or serial redirection. The level is not known until the config
+// is read, so until LogSetLevel() only errors are shown; it then shows the
+// held-back records that pass. An error also shows every held-back record up
+// to PXS_LOG_INFO first, so a quiet boot that fails still explains itself.
+
+#define LOG_LINE_SIZE 256
+
+PXS_LOG *gLog = NULL;
+UINT8 gLogLevel = 0;            // Console level, 0 until LogSetLevel()
+BOOLEAN gLogConsole = TRUE;     // Cleared once boot services are gone
+
+VOID LogInit() {
+    EFI_STATUS Status;
+
+    Status = gBS->AllocatePool(EfiLoaderData, sizeof(PXS_LOG) + PXS_LOG_CAPACITY * sizeof(PXS_LOG_RECORD), (VOID **)&gLog);
+    if (EFI_ERROR(Status)) {
+        gLog = NULL; // Messages then go straight to the console
+        return;
+    }
+    gLog->Version = PXS_LOG_VERSION;
+    gLog->Capacity = PXS_LOG_CAPACITY;
+    gLog->Written = 0;
+    gLog->Records = (PXS_LOG_RECORD *)(gLog + 1);
+}
+
+VOID LogShow(IN OUT PXS_LOG_RECORD *Record) {
+    Print(L"%a\n", Record->Text);
+    Record->Flags |= PXS_LOG_FLAG_CONSOLE;
+}
+
+// Show the records still in the ring at or below Level that are not shown yet
+VOID LogReplay(IN UINT8 Level) {
+    if (!gLog || !gLogConsole) return;
+
+    UINT64 First = (gLog->Written > gLog->Capacity) ? gLog->Written - gLog->Capacity : 0;
+    for (UINT64 i = First; i < gLog->Written; i++) {
+        PXS_LOG_RECORD *Record = &gLog->Records[i % gLog->Capacity];
+        if (Record->Level <= Level && !(Record->Flags & PXS_LOG_FLAG_CONSOLE)) LogShow(Record);
+    }
+}
+
+VOID LogSetLevel(IN UINT8 Level) {
+    gLogLevel = Level;
+    LogReplay(Level);
+}
+
+// Record one line (surrounding newlines dropped) and show it if the level allows
+VOID LogWrite(IN UINT8 Level, IN CONST CHAR8 *Line) {
+    while (*Line == '\n' || *Line == '\r') Line++;
+    UINTN Length = AsciiStrLen(Line);
+    while (Length > 0 && (Line[Length - 1] == '\n' || Line[Length - 1] == '\r')) Length--;
+
+    if (!gLog) {
+        // Nothing can be held back without the ring
+        if (gLogConsole && (gLogLevel == 0 || Level <= gLogLevel)) Print(L"%a\n", Line);
+        return;
+    }
+    if (Level == PXS_LOG_ERROR) LogReplay(MAX(gLogLevel, PXS_LOG_INFO));
+
+    PXS_LOG_RECORD *Record = &gLog->Records[gLog->Written++ % gLog->Capacity];
+    Record->Tsc = __builtin_ia32_rdtsc();
+    Record->Level = Level;
+    Record->Flags = 0;
+    if (Length >= PXS_LOG_TEXT_SIZE) {
+        Length = PXS_LOG_TEXT_SIZE - 1;
+        Record->Flags |= PXS_LOG_FLAG_TRUNCATED;
+    }
+    Record->Length = (UINT16)Length;
+    CopyMem(Record->Text, Line, Length);
+    Record->Text[Length] = '\0';
+
+    if (gLogConsole && (gLogLevel ? Level <= gLogLevel : Level == PXS_LOG_ERROR)) {
+        // The console gets the whole line, even when the record is cut short
+        Print(L"%a\n", Line);
+        Record->Flags |= PXS_LOG_FLAG_CONSOLE;
+    }
+}
+
+VOID LogPrint(IN UINT8 Level, IN CONST CHAR16 *Format, ...) {
+    CHAR8 Line[LOG_LINE_SIZE];
+    VA_LIST Args;
+
+    VA_START(Args, Format);
+    AsciiVSPrintUnicodeFormat(Line, sizeof(Line), Format, Args);
+    VA_END(Args);
+    LogWrite(Level, Line);
+}
+
 // --------------------------------------------------------------------------
 // HELPER FUNCTIONS
 // --------------------------------------------------------------------------
@@ -45,9 +208,9 @@ VOID WaitForInput() {
 }
 
 VOID FatalError(IN CHAR16 *Message, IN EFI_STATUS Status) {
-    Print(L"\nCRITICAL ERROR: %s\n", Message);
+    LogPrint(PXS_LOG_ERROR, L"CRITICAL ERROR: %s", Message);
     if (EFI_ERROR(Status)) {
-        Print(L"Status Code: %r\n", Status);
+        LogPrint(PXS_LOG_ERROR, L"Status Code: %r", Status);
     }
     Print(L"\nPress any key to reboot...\n");
     WaitForInput();
@@ -86,6 +249,593 @@ VOID* GetSystemConfigurationTable(EFI_GUID *Guid) {
     return NULL;
 }
 
+// Snapshot of the memory map in pool, for reading before ExitBootServices
+EFI_STATUS GetMemoryMapCopy(OUT EFI_MEMORY_DESCRIPTOR **Map, OUT UINTN *MapSize, OUT UINTN *DescriptorSize) {
+    UINTN MapKey;
+    UINT32 DescriptorVersion;
+    EFI_STATUS Status;
+
+    *Map = NULL;
+    *MapSize = 0;
+    Status = gBS->GetMemoryMap(MapSize, NULL, &MapKey, DescriptorSize, &DescriptorVersion);
+    while (Status == EFI_BUFFER_TOO_SMALL) {
+        if (*Map) gBS->FreePool(*Map);
+        *MapSize += 2 * *DescriptorSize;
+        Status = gBS->AllocatePool(EfiLoaderData, *MapSize, (VOID **)Map);
+        if (EFI_ERROR(Status)) {
+            *Map = NULL;
+            return Status;
+        }
+        Status = gBS->GetMemoryMap(MapSize, *Map, &MapKey, DescriptorSize, &DescriptorVersion);
+    }
+    if (EFI_ERROR(Status) && *Map) {
+        gBS->FreePool(*Map);
+        *Map = NULL;
+    }
+    return Status;
+}
+
+// End of RAM (not MMIO) in the firmware memory map, at least 4 GiB, 1 GiB aligned
+UINT64 GetPhysicalTop() {
+    EFI_MEMORY_DESCRIPTOR *Map;
+    UINTN MapSize;
+    UINTN DescriptorSize;
+    UINT64 Top = SIZE_4GB;
+
+    if (!EFI_ERROR(GetMemoryMapCopy(&Map, &MapSize, &DescriptorSize))) {
+        for (UINTN Offset = 0; Offset < MapSize; Offset += DescriptorSize) {
+            EFI_MEMORY_DESCRIPTOR *Desc = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)Map + Offset);
+            if (Desc->Type == EfiMemoryMappedIO || Desc->Type == EfiMemoryMappedIOPortSpace) continue;
+            UINT64 End = Desc->PhysicalStart + EFI_PAGES_TO_SIZE(Desc->NumberOfPages);
+            if (End > Top) Top = End;
+        }
+        gBS->FreePool(Map);
+    }
+    return ALIGN_VALUE(Top, PXS_SIZE_1G);
+}
+
+// --------------------------------------------------------------------------
+// NUMA PLACEMENT
+// --------------------------------------------------------------------------
+
+// Firmware hands out pages from the top of memory down, which on a multi-socket
+// machine is usually the last node's, so the kernel, initrd, modules, page
+// tables and handoff arena can all end up remote from the boot CPU. When the
+// SRAT puts it in one of several nodes, they go in that node's free memory
+// instead, still highest first, and anywhere only when it has no room.
+
+PXS_NUMA *gNuma = NULL;
+
+// Initial APIC ID of the boot CPU as the SRAT lists it: the x2APIC ID where
+// CPUID leaf 0xB reports one
+UINT32 GetBspApicId(VOID) {
+    UINT32 MaxLeaf, Ebx, Edx;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf >= 0xB) {
+        AsmCpuidEx(0xB, 0, NULL, &Ebx, NULL, &Edx);
+        if (Ebx != 0) return Edx;
+    }
+    AsmCpuid(1, NULL, &Ebx, NULL, NULL);
+    return Ebx >> 24;
+}
+
+// The node to place things in, NULL when there is no choice to make
+CONST PXS_NUMA_NODE *GetLocalNode(VOID) {
+    if (!gNuma || gNuma->NodeCount < 2 || gNuma->BspNode == PXS_NUMA_NO_NODE) return NULL;
+    return &gNuma->Nodes[gNuma->BspNode];
+}
+
+// First table with Signature that passes its checksum
+VOID *FindAcpiTable(IN CONST PXS_FIRMWARE_TABLES *Tables, IN UINT32 Signature) {
+    for (UINT32 i = 0; i < Tables->AcpiCount; i++) {
+        CONST PXS_ACPI_TABLE *Table = &Tables->Acpi[i];
+        if (Table->Signature == Signature && !(Table->Flags & PXS_ACPI_TABLE_BAD_CHECKSUM)) {
+            return (VOID *)(UINTN)Table->Address;
+        }
+    }
+    return NULL;
+}
+
+// Node table of the SRAT, with SLIT distances when there is one. NULL without
+// a usable SRAT.
+PXS_NUMA* BuildNumaTable(IN CONST PXS_FIRMWARE_TABLES *Tables) {
+    PXS_NUMA Bounds;
+    PXS_NUMA *Numa;
+    UINT8 *Distances;
+
+    if (!Tables) return NULL;
+    VOID *Srat = FindAcpiTable(Tables, PXS_ACPI_SIGNATURE('S', 'R', 'A', 'T'));
+    VOID *Slit = FindAcpiTable(Tables, PXS_ACPI_SIGNATURE('S', 'L', 'I', 'T'));
+    SetMem(&Bounds, sizeof(Bounds), 0);
+    if (EFI_ERROR(NumaBuildTable(Srat, 0, &Bounds)) || Bounds.NodeCount == 0) return NULL;
+
+    UINTN TableSize = sizeof(PXS_NUMA) + Bounds.NodeCount * sizeof(PXS_NUMA_NODE) + Bounds.RangeCount * sizeof(PXS_NUMA_RANGE);
+    if (EFI_ERROR(gBS->AllocatePool(EfiLoaderData, TableSize, (VOID **)&Numa))) return NULL;
+    SetMem(Numa, sizeof(PXS_NUMA), 0);
+    Numa->NodeCount = Bounds.NodeCount;
+    Numa->RangeCount = Bounds.RangeCount;
+    Numa->Nodes = (PXS_NUMA_NODE *)(Numa + 1);
+    Numa->Ranges = (PXS_NUMA_RANGE *)(Numa->Nodes + Bounds.NodeCount);
+    if (EFI_ERROR(NumaBuildTable(Srat, GetBspApicId(), Numa))) {
+        gBS->FreePool(Numa);
+        return NULL;
+    }
+
+    // Sized by the node count, known only now
+    if (Slit && !EFI_ERROR(gBS->AllocatePool(EfiLoaderData, Numa->NodeCount * Numa->NodeCount, (VOID **)&Distances))) {
+        Numa->Distances = Distances;
+        if (EFI_ERROR(NumaReadDistances(Slit, Numa))) {
+            gBS->FreePool(Distances);
+            Numa->Distances = NULL;
+        }
+    }
+
+    if (Numa->BspNode == PXS_NUMA_NO_NODE) {
+        LogPrint(PXS_LOG_VERBOSE, L"NUMA: %d nodes, boot CPU not in the SRAT", Numa->NodeCount);
+    } else {
+        LogPrint(PXS_LOG_VERBOSE, L"NUMA: %d nodes, %d ranges, boot CPU in domain %d%s", Numa->NodeCount,
+                 Numa->RangeCount, Numa->Nodes[Numa->BspNode].Domain, Numa->Distances ? L"" : L", no SLIT");
+    }
+    return Numa;
+}
+
+typedef struct {
+    CONST PXS_NUMA_NODE *Node;
+    UINT64 Size;
+    UINT64 Alignment;
+    EFI_PHYSICAL_ADDRESS Address;   ///< Highest fit so far, 0 for none
+} LOCAL_SEARCH;
+
+// Look for the highest fit in the part of the free run [Start, End) that is
+// in the node
+VOID LocalAddRun(IN OUT LOCAL_SEARCH *Search, IN UINT64 Start, IN UINT64 End) {
+    for (UINT32 i = 0; i < Search->Node->RangeCount; i++) {
+        CONST PXS_NUMA_RANGE *Range = &gNuma->Ranges[Search->Node->FirstRange + i];
+        UINT64 Low = MAX(Start, Range->Base);
+        UINT64 High = MIN(End, Range->Base + Range->Length);
+        if (High <= Low || High - Low < Search->Size) continue;
+
+        UINT64 Candidate = (High - Search->Size) & ~(Search->Alignment - 1);
+        if (Candidate >= Low && Candidate > Search->Address) Search->Address = Candidate;
+    }
+}
+
+// Pages of MemoryType aligned to Alignment (a power of two, at least 4K) in
+// the boot CPU's node. EFI_NOT_FOUND when there is no node to prefer or no
+// room in it.
+EFI_STATUS AllocateLocalPages(
+    IN UINTN Pages,
+    IN UINT64 Alignment,
+    IN EFI_MEMORY_TYPE MemoryType,
+    OUT EFI_PHYSICAL_ADDRESS *Address
+) {
+    EFI_MEMORY_DESCRIPTOR *Map;
+    UINTN MapSize;
+    UINTN DescriptorSize;
+    LOCAL_SEARCH Search;
+    UINT64 RunStart = 0;
+    UINT64 RunEnd = 0;
+
+    Search.Node = GetLocalNode();
+    if (!Search.Node) return EFI_NOT_FOUND;
+    if (EFI_ERROR(GetMemoryMapCopy(&Map, &MapSize, &DescriptorSize))) return EFI_NOT_FOUND;
+    Search.Size = EFI_PAGES_TO_SIZE(Pages);
+    Search.Alignment = Alignment;
+    Search.Address = 0;
+
+    // Touching free descriptors form one run, as for KASLR
+    for (UINTN Offset = 0; Offset < MapSize; Offset += DescriptorSize) {
+        CONST EFI_MEMORY_DESCRIPTOR *Desc = (CONST EFI_MEMORY_DESCRIPTOR *)((CONST UINT8 *)Map + Offset);
+        if (Desc->Type != EfiConventionalMemory) continue;
+
+        UINT64 Start = Desc->PhysicalStart;
+        UINT64 End = Start + EFI_PAGES_TO_SIZE(Desc->NumberOfPages);
+        if (Start == RunEnd && RunEnd != RunStart) {
+            RunEnd = End;
+            continue;
+        }
+        LocalAddRun(&Search, RunStart, RunEnd);
+        RunStart = Start;
+        RunEnd = End;
+    }
+    LocalAddRun(&Search, RunStart, RunEnd);
+    gBS->FreePool(Map);
+
+    if (Search.Address == 0) return EFI_NOT_FOUND;
+    *Address = Search.Address;
+    return gBS->AllocatePages(AllocateAddress, MemoryType, Pages, Address);
+}
+
+// --------------------------------------------------------------------------
+// BOOT TIMING
+// --------------------------------------------------------------------------
+
+PXS_BOOT_TIMING *gTiming = NULL;
+PXS_TIMING_ENTRY *gActiveStage = NULL;
+
+VOID TimingInit(UINT64 EntryTsc) {
+    EFI_STATUS Status;
+
+    Status = gBS->AllocatePool(EfiLoaderData, sizeof(PXS_BOOT_TIMING), (VOID **)&gTiming);
+    if (EFI_ERROR(Status)) {
+        gTiming = NULL; // Timing is best effort
+        return;
+    }
+    SetMem(gTiming, sizeof(PXS_BOOT_TIMING), 0);
+    gTiming->Version = PXS_TIMING_VERSION;
+    gTiming->TscLoaderEntry = EntryTsc;
+}
+
+VOID TimingBegin(UINT32 Stage) {
+    gActiveStage = NULL;
+    if (!gTiming || gTiming->EntryCount >= PXS_TIMING_MAX_ENTRIES) {
+        return;
+    }
+    gActiveStage = &gTiming->Entries[gTiming->EntryCount++];
+    gActiveStage->Stage = Stage;
+    gActiveStage->TscStart = __builtin_ia32_rdtsc();
+}
+
+VOID TimingEnd() {
+    if (gActiveStage) {
+        gActiveStage->TscEnd = __builtin_ia32_rdtsc();
+        gActiveStage = NULL;
+    }
+}
+
+// Attribute a completed file Read() to the active stage
+VOID TimingAccountRead(UINT64 Bytes) {
+    if (gActiveStage) {
+        gActiveStage->ReadCalls++;
+        gActiveStage->BytesRead += Bytes;
+    }
+}
+
+CONST CHAR16 *ClockSourceName(UINT32 Source) {
+    switch (Source) {
+        case PXS_CLOCK_SOURCE_HYPERVISOR:  return L"hypervisor";
+        case PXS_CLOCK_SOURCE_CPUID:       return L"cpuid";
+        case PXS_CLOCK_SOURCE_CPUID_BASE:  return L"cpuid-base";
+        case PXS_CLOCK_SOURCE_PM_TIMER:    return L"pm-timer";
+        case PXS_CLOCK_SOURCE_STALL:       return L"stall";
+        default:                           return L"none";
+    }
+}
+
+// TSC and timer rates, from CPUID or measured against the FADT's PM timer.
+// NULL if the allocation failed.
+PXS_CLOCKS* BuildClocks(IN CONST PXS_FIRMWARE_TABLES *Tables OPTIONAL) {
+    PXS_CLOCKS *Clocks;
+
+    if (EFI_ERROR(gBS->AllocatePool(EfiLoaderData, sizeof(PXS_CLOCKS), (VOID **)&Clocks))) return NULL;
+    ClockCalibrate(Tables ? FindAcpiTable(Tables, PXS_ACPI_SIGNATURE('F', 'A', 'C', 'P')) : NULL, Clocks);
+
+    LogPrint(PXS_LOG_VERBOSE, L"TSC: %ld Hz +/- %d ppm (%s)%s%s", Clocks->TscFrequency, Clocks->TscErrorPpm,
+             ClockSourceName(Clocks->TscSource), (Clocks->Flags & PXS_CLOCK_INVARIANT_TSC) ? L", invariant" : L"",
+             (Clocks->Flags & PXS_CLOCK_TSC_DEADLINE) ? L", deadline" : L"");
+    return Clocks;
+}
+
+// Record the TSC rate and compute per-stage throughput
+VOID TimingFinalize(IN UINT64 TscFrequency) {
+    if (!gTiming) return;
+
+    gTiming->TscFrequency = TscFrequency;
+    UINT64 TscPerMicrosecond = gTiming->TscFrequency / 1000000;
+    if (TscPerMicrosecond == 0) return;
+
+    for (UINT32 i = 0; i < gTiming->EntryCount; i++) {
+        PXS_TIMING_ENTRY *Entry = &gTiming->Entries[i];
+        UINT64 Microseconds = (Entry->TscEnd - Entry->TscStart) / TscPerMicrosecond;
+        if (Entry->BytesRead != 0 && Entry->TscEnd > Entry->TscStart && Microseconds != 0) {
+            Entry->BytesPerSecond = (Entry->BytesRead * 1000000) / Microseconds;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// PARTITION FILES
+// --------------------------------------------------------------------------
+
+// KERNEL=, INITRD= and MODULE= may name part:<GUID>[:offset] instead of a path
+// on the boot volume: an image stored raw on a GPT partition, or in an extent
+// behind a PXS_EXTENT_HEADER there. It is read with EFI_BLOCK_IO_PROTOCOL in
+// large block-aligned transfers, which skips the firmware's FAT driver and its
+// cluster-at-a-time reads. The image is wrapped in a read-only
+// EFI_FILE_PROTOCOL, so streams, hashing and decompression take it like a file.
+
+#define PART_BOUNCE_SIZE    SIZE_1MB    // Unaligned ends, and buffers the device cannot DMA to
+#define PART_MAX_TRANSFER   SIZE_8MB    // Per ReadBlocks(); some controllers split larger ones badly
+
+typedef struct {
+    EFI_FILE_PROTOCOL     Protocol;     // First, so the two pointers convert
+    EFI_BLOCK_IO_PROTOCOL *BlockIo;
+    UINT32                MediaId;
+    UINT32                BlockSize;
+    UINTN                 IoAlign;      // Buffer alignment ReadBlocks() needs, 1 for any
+    UINT64                Start;        // Partition byte offset of the image
+    UINT64                Size;
+    UINT64                Position;
+    UINT8                 *Bounce;      // PART_BOUNCE_SIZE bytes at IoAlign
+    EFI_PHYSICAL_ADDRESS  BouncePages;
+    UINTN                 BouncePageCount;
+} PXS_PART_FILE;
+
+// Read Size bytes at partition byte Offset. Whole blocks go straight into
+// Buffer when the device can take it; partial blocks through the bounce buffer.
+EFI_STATUS PartReadBytes(IN PXS_PART_FILE *File, IN UINT64 Offset, OUT VOID *Buffer, IN UINTN Size) {
+    EFI_BLOCK_IO_PROTOCOL *BlockIo = File->BlockIo;
+    UINT8 *Dest = (UINT8 *)Buffer;
+    EFI_STATUS Status;
+
+    while (Size > 0) {
+        EFI_LBA Lba = Offset / File->BlockSize;
+        UINTN Skip = (UINTN)(Offset % File->BlockSize);
+        UINTN Length;
+
+        if (Skip == 0 && Size >= File->BlockSize && ((UINTN)Dest & (File->IoAlign - 1)) == 0) {
+            Length = MIN(Size, PART_MAX_TRANSFER);
+            Length -= Length % File->BlockSize;
+            Status = BlockIo->ReadBlocks(BlockIo, File->MediaId, Lba, Length, Dest);
+            if (EFI_ERROR(Status)) return Status;
+        } else {
+            UINTN Blocks = MIN((Skip + Size + File->BlockSize - 1) / File->BlockSize, PART_BOUNCE_SIZE / File->BlockSize);
+            Length = MIN(Size, Blocks * File->BlockSize - Skip);
+            Status = BlockIo->ReadBlocks(BlockIo, File->MediaId, Lba, Blocks * File->BlockSize, File->Bounce);
+            if (EFI_ERROR(Status)) return Status;
+            CopyMem(Dest, File->Bounce + Skip, Length);
+        }
+        Dest += Length;
+        Offset += Length;
+        Size -= Length;
+    }
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI PartFileClose(IN EFI_FILE_PROTOCOL *This) {
+    PXS_PART_FILE *File = (PXS_PART_FILE *)This;
+    if (File->BouncePageCount) gBS->FreePages(File->BouncePages, File->BouncePageCount);
+    FreePool(File);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI PartFileRead(IN EFI_FILE_PROTOCOL *This, IN OUT UINTN *BufferSize, OUT VOID *Buffer) {
+    PXS_PART_FILE *File = (PXS_PART_FILE *)This;
+    EFI_STATUS Status;
+
+    UINT64 Remaining = (File->Position < File->Size) ? File->Size - File->Position : 0;
+    if (*BufferSize > Remaining) *BufferSize = (UINTN)Remaining;
+    Status = PartReadBytes(File, File->Start + File->Position, Buffer, *BufferSize);
+    if (EFI_ERROR(Status)) {
+        *BufferSize = 0;
+        return Status;
+    }
+    File->Position += *BufferSize;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI PartFileGetPosition(IN EFI_FILE_PROTOCOL *This, OUT UINT64 *Position) {
+    *Position = ((PXS_PART_FILE *)This)->Position;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI PartFileSetPosition(IN EFI_FILE_PROTOCOL *This, IN UINT64 Position) {
+    PXS_PART_FILE *File = (PXS_PART_FILE *)This;
+    File->Position = (Position == MAX_UINT64) ? File->Size : Position;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI PartFileGetInfo(
+    IN EFI_FILE_PROTOCOL *This,
+    IN EFI_GUID *InformationType,
+    IN OUT UINTN *BufferSize,
+    OUT VOID *Buffer
+) {
+    PXS_PART_FILE *File = (PXS_PART_FILE *)This;
+    EFI_FILE_INFO *Info = Buffer;
+
+    if (!CompareGuid(InformationType, &gEfiFileInfoGuid)) return EFI_UNSUPPORTED;
+    if (*BufferSize < sizeof(EFI_FILE_INFO)) {
+        *BufferSize = sizeof(EFI_FILE_INFO);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    SetMem(Info, sizeof(EFI_FILE_INFO), 0);
+    Info->Size = sizeof(EFI_FILE_INFO);
+    Info->FileSize = File->Size;
+    Info->PhysicalSize = File->Size;
+    *BufferSize = sizeof(EFI_FILE_INFO);
+    return EFI_SUCCESS;
+}
+
+// The image is a read-only file with no directory around it and no queue
+
+EFI_STATUS EFIAPI PartFileOpen(
+    IN EFI_FILE_PROTOCOL *This,
+    OUT EFI_FILE_PROTOCOL **NewHandle,
+    IN CHAR16 *FileName,
+    IN UINT64 OpenMode,
+    IN UINT64 Attributes
+) {
+    return EFI_UNSUPPORTED;
+}
+
+// Delete() closes the handle even when it cannot delete
+EFI_STATUS EFIAPI PartFileDelete(IN EFI_FILE_PROTOCOL *This) {
+    PartFileClose(This);
+    return EFI_WARN_DELETE_FAILURE;
+}
+
+EFI_STATUS EFIAPI PartFileWrite(IN EFI_FILE_PROTOCOL *This, IN OUT UINTN *BufferSize, IN VOID *Buffer) {
+    return EFI_WRITE_PROTECTED;
+}
+
+EFI_STATUS EFIAPI PartFileSetInfo(
+    IN EFI_FILE_PROTOCOL *This,
+    IN EFI_GUID *InformationType,
+    IN UINTN BufferSize,
+    IN VOID *Buffer
+) {
+    return EFI_WRITE_PROTECTED;
+}
+
+EFI_STATUS EFIAPI PartFileFlush(IN EFI_FILE_PROTOCOL *This) {
+    return EFI_WRITE_PROTECTED;
+}
+
+EFI_STATUS EFIAPI PartFileOpenEx(
+    IN EFI_FILE_PROTOCOL *This,
+    OUT EFI_FILE_PROTOCOL **NewHandle,
+    IN CHAR16 *FileName,
+    IN UINT64 OpenMode,
+    IN UINT64 Attributes,
+    IN OUT EFI_FILE_IO_TOKEN *Token
+) {
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS EFIAPI PartFileReadEx(IN EFI_FILE_PROTOCOL *This, IN OUT EFI_FILE_IO_TOKEN *Token) {
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS EFIAPI PartFileWriteEx(IN EFI_FILE_PROTOCOL *This, IN OUT EFI_FILE_IO_TOKEN *Token) {
+    return EFI_WRITE_PROTECTED;
+}
+
+EFI_STATUS EFIAPI PartFileFlushEx(IN EFI_FILE_PROTOCOL *This, IN OUT EFI_FILE_IO_TOKEN *Token) {
+    return EFI_WRITE_PROTECTED;
+}
+
+// Block I/O of the GPT partition whose unique GUID is Guid: the handle whose
+// device path ends in that hard drive node, so not the whole disk
+EFI_BLOCK_IO_PROTOCOL* PartFind(IN CONST EFI_GUID *Guid) {
+    EFI_HANDLE *Handles;
+    UINTN Count;
+    EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
+
+    if (EFI_ERROR(gBS->LocateHandleBuffer(ByProtocol, &gEfiBlockIoProtocolGuid, NULL, &Count, &Handles))) return NULL;
+    for (UINTN i = 0; i < Count && !BlockIo; i++) {
+        EFI_DEVICE_PATH_PROTOCOL *Node, *Last = NULL;
+        if (EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiDevicePathProtocolGuid, (VOID **)&Node))) continue;
+        for (; !IsDevicePathEnd(Node); Node = NextDevicePathNode(Node)) Last = Node;
+        if (!Last || DevicePathType(Last) != MEDIA_DEVICE_PATH || DevicePathSubType(Last) != MEDIA_HARDDRIVE_DP) continue;
+
+        HARDDRIVE_DEVICE_PATH *HardDrive = (HARDDRIVE_DEVICE_PATH *)Last;
+        if (HardDrive->SignatureType == SIGNATURE_TYPE_GUID && CompareMem(HardDrive->Signature, Guid, sizeof(EFI_GUID)) == 0) {
+            if (EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo))) BlockIo = NULL;
+        }
+    }
+    FreePool(Handles);
+    return BlockIo;
+}
+
+// Open a part: source. The image is the extent its header describes, or
+// everything from the offset to the end of the partition.
+EFI_STATUS PartOpen(IN CONST CHAR16 *Source, OUT EFI_FILE_HANDLE *Handle) {
+    EFI_STATUS Status;
+    EFI_GUID Guid;
+    UINT64 Offset, DataOffset, DataSize;
+    PXS_EXTENT_HEADER Header;
+
+    if (!PartitionParseSource(Source, &Guid, &Offset)) return EFI_INVALID_PARAMETER;
+    EFI_BLOCK_IO_PROTOCOL *BlockIo = PartFind(&Guid);
+    if (!BlockIo) return EFI_NOT_FOUND;
+    EFI_BLOCK_IO_MEDIA *Media = BlockIo->Media;
+    if (!Media->MediaPresent) return EFI_NO_MEDIA;
+    if (Media->BlockSize == 0 || Media->BlockSize > PART_BOUNCE_SIZE) return EFI_UNSUPPORTED;
+    UINT64 PartitionSize = (Media->LastBlock + 1) * Media->BlockSize;
+    if (Offset >= PartitionSize) return EFI_END_OF_FILE;
+
+    PXS_PART_FILE *File = AllocateZeroPool(sizeof(PXS_PART_FILE));
+    if (!File) return EFI_OUT_OF_RESOURCES;
+    File->Protocol.Revision = EFI_FILE_PROTOCOL_REVISION;
+    File->Protocol.Open = PartFileOpen;
+    File->Protocol.Close = PartFileClose;
+    File->Protocol.Delete = PartFileDelete;
+    File->Protocol.Read = PartFileRead;
+    File->Protocol.Write = PartFileWrite;
+    File->Protocol.GetPosition = PartFileGetPosition;
+    File->Protocol.SetPosition = PartFileSetPosition;
+    File->Protocol.GetInfo = PartFileGetInfo;
+    File->Protocol.SetInfo = PartFileSetInfo;
+    File->Protocol.Flush = PartFileFlush;
+    // Revision 1, so callers read synchronously, but no member is left NULL
+    File->Protocol.OpenEx = PartFileOpenEx;
+    File->Protocol.ReadEx = PartFileReadEx;
+    File->Protocol.WriteEx = PartFileWriteEx;
+    File->Protocol.FlushEx = PartFileFlushEx;
+    File->BlockIo = BlockIo;
+    File->MediaId = Media->MediaId;
+    File->BlockSize = Media->BlockSize;
+    File->IoAlign = MAX(Media->IoAlign, 1);
+
+    // Pages are aligned enough for all but the odd device that wants more
+    UINTN Extra = (File->IoAlign > EFI_PAGE_SIZE) ? File->IoAlign : 0;
+    Status = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData, EFI_SIZE_TO_PAGES(PART_BOUNCE_SIZE + Extra), &File->BouncePages);
+    if (EFI_ERROR(Status)) {
+        FreePool(File);
+        return Status;
+    }
+    File->BouncePageCount = EFI_SIZE_TO_PAGES(PART_BOUNCE_SIZE + Extra);
+    File->Bounce = (UINT8 *)(UINTN)ALIGN_VALUE(File->BouncePages, File->IoAlign);
+
+    Status = EFI_NOT_FOUND;
+    if (PartitionSize - Offset >= sizeof(Header)) {
+        Status = PartReadBytes(File, Offset, &Header, sizeof(Header));
+        if (!EFI_ERROR(Status)) Status = PartitionParseExtent(&Header, PartitionSize - Offset, &DataOffset, &DataSize);
+    }
+    if (Status == EFI_NOT_FOUND) {
+        File->Start = Offset;
+        File->Size = PartitionSize - Offset;
+    } else if (!EFI_ERROR(Status)) {
+        File->Start = Offset + DataOffset;
+        File->Size = DataSize;
+    } else {
+        PartFileClose(&File->Protocol);
+        return Status;
+    }
+
+    LogPrint(PXS_LOG_VERBOSE, L"Partition image: %ld bytes at byte %ld, %s, %d-byte blocks", File->Size, File->Start,
+             (Status == EFI_NOT_FOUND) ? L"raw" : L"extent", File->BlockSize);
+    *Handle = &File->Protocol;
+    return EFI_SUCCESS;
+}
+
+// Open an image source: a part: source, or a path on the boot volume
+EFI_STATUS OpenImageFile(IN EFI_FILE_HANDLE RootDir, IN CHAR16 *FileName, OUT EFI_FILE_HANDLE *File) {
+    if (PartitionIsSource(FileName)) return PartOpen(FileName, File);
+    return RootDir->Open(RootDir, File, FileName, EFI_FILE_MODE_READ, 0);
+}
+
+// --------------------------------------------------------------------------
+// FILES
+// --------------------------------------------------------------------------
+
+// Read exactly Size bytes starting at Offset
+EFI_STATUS ReadFileAt(
+    IN EFI_FILE_HANDLE FileHandle,
+    IN UINT64 Offset,
+    OUT VOID *Buffer,
+    IN UINT64 Size
+) {
+    EFI_STATUS Status;
+    UINT8 *Dest = (UINT8 *)Buffer;
+
+    Status = FileHandle->SetPosition(FileHandle, Offset);
+    if (EFI_ERROR(Status)) return Status;
+
+    while (Size > 0) {
+        UINTN ReadSize = Size;
+        Status = FileHandle->Read(FileHandle, &ReadSize, Dest);
+        if (EFI_ERROR(Status)) return Status;
+        TimingAccountRead(ReadSize);
+        if (ReadSize == 0) return EFI_END_OF_FILE;
+        Dest += ReadSize;
+        Size -= ReadSize;
+    }
+    return EFI_SUCCESS;
+}
+
 EFI_STATUS LoadFile(
     IN EFI_FILE_HANDLE RootDir,
     IN CHAR16 *FileName,
@@ -112,358 +862,2648 @@ EFI_STATUS LoadFile(
         return EFI_OUT_OF_RESOURCES;
     }
 
-    UINTN ReadSize = FileSize;
-    Status = FileHandle->Read(FileHandle, &ReadSize, FileBuffer);
-    FileHandle->Close(FileHandle);
+    Status = ReadFileAt(FileHandle, 0, FileBuffer, FileSize);
+    FileHandle->Close(FileHandle);
+
+    if (EFI_ERROR(Status)) {
+        FreePool(FileBuffer);
+        return Status;
+    }
+
+    *Buffer = FileBuffer;
+    *Size = FileSize;
+    return EFI_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// FILE READER
+// --------------------------------------------------------------------------
+
+// Large reads are split into READ_CHUNK requests with up to READ_DEPTH in
+// flight through EFI_FILE_PROTOCOL.ReadEx, so the file system driver can keep
+// the device queue busy (it drives DiskIo2/BlockIo2 underneath). Sequential
+// readers also get read-ahead: the next chunks arrive while the caller decodes
+// the current one. Without ReadEx every request completes synchronously.
+
+#define READ_CHUNK  SIZE_1MB
+#define READ_DEPTH  4
+
+typedef struct {
+    EFI_FILE_IO_TOKEN Token;
+    UINT64            Offset;
+    UINTN             Size;
+    BOOLEAN           Busy;     // Issued and not yet consumed
+    BOOLEAN           Pending;  // Issued asynchronously and not yet waited for
+    BOOLEAN           Checked;  // Completed, accounted and hashed by ReaderCheck
+} PXS_READ_SLOT;
+
+typedef struct {
+    EFI_FILE_HANDLE File;
+    UINT64          FileSize;
+    BOOLEAN         Async;
+    UINT8           *Ahead;        // READ_DEPTH read-ahead chunks, allocated on first use
+    UINT64          AheadOffset;   // File offset of the next byte handed out
+    UINT64          AheadIssued;   // End of the last read-ahead request
+    UINTN           AheadUsed;     // Bytes already handed out from the head slot
+    UINTN           Head;          // Oldest busy slot
+    UINTN           Count;         // Busy slots
+    PXS_READ_SLOT   Slots[READ_DEPTH];
+    PXS_SHA256      *Hash;         // Digest of the file in offset order, if requested
+    UINT64          Hashed;        // Bytes of the file already folded into Hash
+} PXS_READER;
+
+PXS_SHA256_BLOCKS gSha256Blocks = NULL;  // Chosen in UefiMain; NULL hashes with the generic code
+
+VOID ReaderOpen(IN EFI_FILE_HANDLE File, IN UINT64 FileSize, OUT PXS_READER *Reader) {
+    SetMem(Reader, sizeof(*Reader), 0);
+    Reader->File = File;
+    Reader->FileSize = FileSize;
+
+    if (File->Revision < EFI_FILE_PROTOCOL_REVISION2 || File->ReadEx == NULL) return;
+    for (UINTN i = 0; i < READ_DEPTH; i++) {
+        if (EFI_ERROR(gBS->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &Reader->Slots[i].Token.Event))) {
+            while (i-- > 0) {
+                gBS->CloseEvent(Reader->Slots[i].Token.Event);
+                Reader->Slots[i].Token.Event = NULL;
+            }
+            return;
+        }
+    }
+    Reader->Async = TRUE;
+}
+
+// Start reading Size bytes at Offset into Buffer, asynchronously when possible.
+// Errors are reported when the slot completes.
+VOID ReaderSubmit(IN OUT PXS_READER *Reader, IN PXS_READ_SLOT *Slot, IN UINT64 Offset, OUT VOID *Buffer, IN UINTN Size) {
+    EFI_STATUS Status;
+
+    Slot->Offset = Offset;
+    Slot->Size = Size;
+    Slot->Token.Buffer = Buffer;
+    Slot->Token.BufferSize = Size;
+    Slot->Token.Status = EFI_SUCCESS;
+    Slot->Busy = TRUE;
+    Slot->Pending = FALSE;
+    Slot->Checked = FALSE;
+    Reader->Count++;
+
+    Status = Reader->File->SetPosition(Reader->File, Offset);
+    if (EFI_ERROR(Status)) {
+        Slot->Token.Status = Status;
+        return;
+    }
+
+    if (Reader->Async) {
+        Status = Reader->File->ReadEx(Reader->File, &Slot->Token);
+        if (!EFI_ERROR(Status)) {
+            Slot->Pending = TRUE;
+            return;
+        }
+        if (Status != EFI_UNSUPPORTED) {
+            Slot->Token.Status = Status;
+            return;
+        }
+        // Driver claims revision 2 but cannot queue: read synchronously from now on
+        Reader->Async = FALSE;
+    }
+
+    Slot->Token.Status = Reader->File->Read(Reader->File, &Slot->Token.BufferSize, Buffer);
+}
+
+// Fold bytes that just arrived from the file into the digest. Hashing follows
+// the reads instead of making its own pass: bytes the loader never asks for
+// (headers, padding) are read here only when a later read skips over them,
+// and overlapping reads are hashed once.
+EFI_STATUS ReaderHash(IN OUT PXS_READER *Reader, IN UINT64 Offset, IN CONST VOID *Data, IN UINTN Size) {
+    EFI_STATUS Status;
+
+    if (!Reader->Hash || Offset + Size <= Reader->Hashed) return EFI_SUCCESS;
+
+    if (Offset > Reader->Hashed) {
+        UINTN GapSize = (UINTN)MIN(Offset - Reader->Hashed, READ_CHUNK);
+        UINT8 *Gap = AllocatePool(GapSize);
+        if (!Gap) return EFI_OUT_OF_RESOURCES;
+        while (Reader->Hashed < Offset) {
+            UINTN Chunk = (UINTN)MIN(Offset - Reader->Hashed, GapSize);
+            Status = ReadFileAt(Reader->File, Reader->Hashed, Gap, Chunk);
+            if (EFI_ERROR(Status)) {
+                FreePool(Gap);
+                return Status;
+            }
+            Sha256Update(Reader->Hash, Gap, Chunk);
+            Reader->Hashed += Chunk;
+        }
+        FreePool(Gap);
+    }
+
+    UINTN Skip = (UINTN)(Reader->Hashed - Offset);
+    Sha256Update(Reader->Hash, (CONST UINT8 *)Data + Skip, Size - Skip);
+    Reader->Hashed = Offset + Size;
+    return EFI_SUCCESS;
+}
+
+// Wait for a slot, finish a short read synchronously and hash it, once: a
+// slot ReaderReadNext has started handing out is checked already
+EFI_STATUS ReaderCheck(IN OUT PXS_READER *Reader, IN OUT PXS_READ_SLOT *Slot) {
+    EFI_STATUS Status;
+    UINTN Index;
+
+    if (Slot->Checked) return EFI_SUCCESS;
+    if (Slot->Pending) {
+        gBS->WaitForEvent(1, &Slot->Token.Event, &Index);
+        Slot->Pending = FALSE;
+    }
+    Slot->Checked = TRUE;
+
+    Status = Slot->Token.Status;
+    if (EFI_ERROR(Status)) return Status;
+    TimingAccountRead(Slot->Token.BufferSize);
+    if (Slot->Token.BufferSize < Slot->Size) {
+        UINTN Done = Slot->Token.BufferSize;
+        if (Done == 0) return EFI_END_OF_FILE;
+        Status = ReadFileAt(Reader->File, Slot->Offset + Done, (UINT8 *)Slot->Token.Buffer + Done, Slot->Size - Done);
+        if (EFI_ERROR(Status)) return Status;
+    }
+    return ReaderHash(Reader, Slot->Offset, Slot->Token.Buffer, Slot->Size);
+}
+
+// Check the head slot and release it
+EFI_STATUS ReaderComplete(IN OUT PXS_READER *Reader) {
+    PXS_READ_SLOT *Slot = &Reader->Slots[Reader->Head];
+    EFI_STATUS Status = ReaderCheck(Reader, Slot);
+
+    Slot->Busy = FALSE;
+    Reader->Head = (Reader->Head + 1) % READ_DEPTH;
+    Reader->Count--;
+    return Status;
+}
+
+// Complete everything in flight, keeping the first error
+EFI_STATUS ReaderDrain(IN OUT PXS_READER *Reader) {
+    EFI_STATUS Status = EFI_SUCCESS;
+    while (Reader->Count > 0) {
+        EFI_STATUS SlotStatus = ReaderComplete(Reader);
+        if (!EFI_ERROR(Status)) Status = SlotStatus;
+    }
+    Reader->AheadUsed = 0;
+    return Status;
+}
+
+VOID ReaderClose(IN OUT PXS_READER *Reader) {
+    ReaderDrain(Reader);
+    for (UINTN i = 0; i < READ_DEPTH; i++) {
+        if (Reader->Slots[i].Token.Event) gBS->CloseEvent(Reader->Slots[i].Token.Event);
+    }
+    if (Reader->Ahead) FreePool(Reader->Ahead);
+    SetMem(Reader, sizeof(*Reader), 0);
+}
+
+// Read Size bytes at Offset straight into Buffer, READ_DEPTH chunks at a time
+EFI_STATUS ReaderReadAt(IN OUT PXS_READER *Reader, IN UINT64 Offset, OUT VOID *Buffer, IN UINT64 Size) {
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT8 *Dest = (UINT8 *)Buffer;
+    UINT64 Issued = 0;
+
+    // Any read-ahead is for a different position
+    ReaderDrain(Reader);
+    Reader->AheadOffset = Reader->AheadIssued = 0;
+
+    while (Issued < Size || Reader->Count > 0) {
+        while (Issued < Size && Reader->Count < READ_DEPTH) {
+            UINTN Chunk = (UINTN)MIN(Size - Issued, READ_CHUNK);
+            PXS_READ_SLOT *Slot = &Reader->Slots[(Reader->Head + Reader->Count) % READ_DEPTH];
+            ReaderSubmit(Reader, Slot, Offset + Issued, Dest + Issued, Chunk);
+            Issued += Chunk;
+        }
+        Status = ReaderComplete(Reader);
+        if (EFI_ERROR(Status)) {
+            ReaderDrain(Reader);
+            break;
+        }
+    }
+    return Status;
+}
+
+// Copy the next Size bytes of a front-to-back scan that starts at Offset. Later
+// chunks are read ahead, so the caller's processing overlaps with the device.
+EFI_STATUS ReaderReadNext(IN OUT PXS_READER *Reader, IN UINT64 Offset, OUT VOID *Buffer, IN UINTN Size) {
+    EFI_STATUS Status;
+    UINT8 *Dest = (UINT8 *)Buffer;
+
+    if (!Reader->Ahead) {
+        Reader->Ahead = AllocatePool(READ_DEPTH * READ_CHUNK);
+        if (!Reader->Ahead) return EFI_OUT_OF_RESOURCES;
+    }
+    if (Offset != Reader->AheadOffset) {
+        ReaderDrain(Reader);
+        Reader->AheadOffset = Reader->AheadIssued = Offset;
+    }
+
+    while (Size > 0) {
+        // Keep every slot busy with the chunks that follow
+        while (Reader->Count < READ_DEPTH && Reader->AheadIssued < Reader->FileSize) {
+            UINTN Index = (Reader->Head + Reader->Count) % READ_DEPTH;
+            UINTN Chunk = (UINTN)MIN(Reader->FileSize - Reader->AheadIssued, READ_CHUNK);
+            ReaderSubmit(Reader, &Reader->Slots[Index], Reader->AheadIssued, Reader->Ahead + Index * READ_CHUNK, Chunk);
+            Reader->AheadIssued += Chunk;
+        }
+        if (Reader->Count == 0) return EFI_END_OF_FILE;
+
+        PXS_READ_SLOT *Slot = &Reader->Slots[Reader->Head];
+        Status = ReaderCheck(Reader, Slot);
+        if (EFI_ERROR(Status)) {
+            ReaderDrain(Reader);
+            return Status;
+        }
+
+        UINTN Chunk = MIN(Slot->Size - Reader->AheadUsed, Size);
+        CopyMem(Dest, (UINT8 *)Slot->Token.Buffer + Reader->AheadUsed, Chunk);
+        Dest += Chunk;
+        Size -= Chunk;
+        Reader->AheadOffset += Chunk;
+        Reader->AheadUsed += Chunk;
+        if (Reader->AheadUsed == Slot->Size) {
+            Slot->Busy = FALSE;
+            Reader->Head = (Reader->Head + 1) % READ_DEPTH;
+            Reader->Count--;
+            Reader->AheadUsed = 0;
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+// Hash everything read from now on into Ctx
+VOID ReaderStartHash(IN OUT PXS_READER *Reader, OUT PXS_SHA256 *Ctx) {
+    Sha256Init(Ctx, gSha256Blocks);
+    Reader->Hash = Ctx;
+    Reader->Hashed = 0;
+}
+
+// Read whatever part of the file the loader skipped and produce the digest
+EFI_STATUS ReaderFinishHash(IN OUT PXS_READER *Reader, OUT UINT8 *Digest) {
+    EFI_STATUS Status = ReaderDrain(Reader);
+    if (EFI_ERROR(Status)) return Status;
+
+    if (Reader->Hashed < Reader->FileSize) {
+        UINTN ScratchSize = (UINTN)MIN(Reader->FileSize - Reader->Hashed, READ_DEPTH * READ_CHUNK);
+        UINT8 *Scratch = AllocatePool(ScratchSize);
+        if (!Scratch) return EFI_OUT_OF_RESOURCES;
+        while (Reader->Hashed < Reader->FileSize) {
+            UINTN Chunk = (UINTN)MIN(Reader->FileSize - Reader->Hashed, ScratchSize);
+            Status = ReaderReadAt(Reader, Reader->Hashed, Scratch, Chunk);
+            if (EFI_ERROR(Status)) break;
+        }
+        FreePool(Scratch);
+        if (EFI_ERROR(Status)) return Status;
+    }
+
+    Sha256Final(Reader->Hash, Digest);
+    Reader->Hash = NULL;
+    return EFI_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// COMPRESSED STREAMS
+// --------------------------------------------------------------------------
+
+// Images may be stored raw or as LZ4 / zstd (detected by magic). Compressed
+// images are read forward in bounded chunks and decoded block by block, so the
+// only full-size buffer is the final destination.
+
+#define STREAM_INPUT_CHUNK  SIZE_1MB
+
+typedef struct {
+    UINT64     OutOffset;  // From the start of the batch
+    UINT64     Produced;
+    EFI_STATUS Status;
+} PXS_DECODE_RESULT;
+
+// Units planned ahead of the serial decoder (see PARALLEL DECODE)
+typedef struct {
+    CONST UINT8         *In;
+    UINT8               *Out;
+    PXS_DECOMPRESS_UNIT *Units;
+    PXS_DECODE_RESULT   *Results;
+    PXS_DECOMPRESSOR    *Decoders;      // One per processor number
+    UINTN               DecoderCount;   // Initialised so far
+    UINTN               Count;
+    UINT64              Output;         // Decoded size of the planned units
+    UINTN               InUsed;         // Compressed bytes they span from InStart
+    PXS_DECOMPRESSOR    Walk;           // Framing state after them
+} PXS_DECODE_BATCH;
+
+typedef struct {
+    EFI_FILE_HANDLE  File;
+    PXS_READER       Reader;
+    UINT64           FileSize;
+    UINT64           FileOffset;   // Next compressed byte to fetch
+    UINT32           Format;       // PXS_COMPRESSION_*
+    PXS_DECOMPRESSOR Dec;
+    UINT8            *In;          // Compressed bytes [InStart, InEnd)
+    UINTN            InCap;
+    UINTN            InStart;
+    UINTN            InEnd;
+    UINT8            *Window;      // Decoded bytes; Window[0] is at stream offset WindowBase
+    UINTN            WindowCap;
+    UINTN            WindowLen;
+    UINT64           WindowBase;
+    PXS_DECODE_BATCH *Batch;       // Allocated when units are first planned
+    BOOLEAN          Serial;       // Stopped splitting; decode in order only
+    UINTN            Parallel;     // Units decoded across CPUs
+} PXS_STREAM;
+
+CONST CHAR16 *CompressionName(UINT32 Format) {
+    switch (Format) {
+        case PXS_COMPRESSION_LZ4:        return L"lz4";
+        case PXS_COMPRESSION_LZ4_LEGACY: return L"lz4-legacy";
+        case PXS_COMPRESSION_ZSTD:       return L"zstd";
+        default:                         return L"none";
+    }
+}
+
+VOID StreamClose(IN PXS_STREAM *Stream) {
+    if (Stream->Format != PXS_COMPRESSION_NONE) {
+        DecompressFree(&Stream->Dec);
+    }
+    if (Stream->In) FreePool(Stream->In);
+    if (Stream->Window) FreePool(Stream->Window);
+    if (Stream->Batch) {
+        while (Stream->Batch->DecoderCount > 0) {
+            DecompressFree(&Stream->Batch->Decoders[--Stream->Batch->DecoderCount]);
+        }
+        FreePool(Stream->Batch);
+    }
+    ReaderClose(&Stream->Reader);
+    Stream->File->Close(Stream->File);
+    SetMem(Stream, sizeof(*Stream), 0);
+}
+
+EFI_STATUS StreamOpen(
+    IN EFI_FILE_HANDLE RootDir,
+    IN CHAR16 *FileName,
+    OUT PXS_STREAM *Stream
+) {
+    EFI_STATUS Status;
+    UINT8 Magic[4];
+
+    SetMem(Stream, sizeof(*Stream), 0);
+    Status = OpenImageFile(RootDir, FileName, &Stream->File);
+    if (EFI_ERROR(Status)) return Status;
+
+    Status = GetFileSize(Stream->File, &Stream->FileSize);
+    if (!EFI_ERROR(Status) && Stream->FileSize >= sizeof(Magic)) {
+        Status = ReadFileAt(Stream->File, 0, Magic, sizeof(Magic));
+        if (!EFI_ERROR(Status)) {
+            Stream->Format = DecompressDetect(Magic, sizeof(Magic));
+        }
+    }
+    if (!EFI_ERROR(Status) && Stream->Format != PXS_COMPRESSION_NONE) {
+        Status = DecompressInit(&Stream->Dec, Stream->Format);
+        if (!EFI_ERROR(Status)) {
+            Stream->InCap = STREAM_INPUT_CHUNK;
+            Stream->In = AllocatePool(Stream->InCap);
+            if (!Stream->In) {
+                DecompressFree(&Stream->Dec);
+                Status = EFI_OUT_OF_RESOURCES;
+            }
+        }
+    }
+    if (EFI_ERROR(Status)) {
+        Stream->File->Close(Stream->File);
+        return Status;
+    }
+    ReaderOpen(Stream->File, Stream->FileSize, &Stream->Reader);
+    return EFI_SUCCESS;
+}
+
+// Restart decoding from the beginning of the file
+EFI_STATUS StreamRewind(IN OUT PXS_STREAM *Stream) {
+    DecompressFree(&Stream->Dec);
+    Stream->FileOffset = 0;
+    Stream->InStart = Stream->InEnd = 0;
+    Stream->WindowBase = 0;
+    Stream->WindowLen = 0;
+    return DecompressInit(&Stream->Dec, Stream->Format);
+}
+
+// Compact the input buffer and top it up with at least Needed bytes if the file has them
+EFI_STATUS StreamFill(IN OUT PXS_STREAM *Stream, IN UINTN Needed) {
+    EFI_STATUS Status;
+    UINTN Pending = Stream->InEnd - Stream->InStart;
+
+    if (Stream->InStart > 0) {
+        CopyMem(Stream->In, Stream->In + Stream->InStart, Pending);
+        Stream->InStart = 0;
+        Stream->InEnd = Pending;
+    }
+
+    if (Needed > Stream->InCap) {
+        UINTN NewCap = ALIGN_VALUE(Needed, STREAM_INPUT_CHUNK);
+        UINT8 *NewIn = AllocatePool(NewCap);
+        if (!NewIn) return EFI_OUT_OF_RESOURCES;
+        CopyMem(NewIn, Stream->In, Pending);
+        FreePool(Stream->In);
+        Stream->In = NewIn;
+        Stream->InCap = NewCap;
+    }
+
+    UINT64 Left = Stream->FileSize - Stream->FileOffset;
+    UINTN Size = Stream->InCap - Stream->InEnd;
+    if (Left < Size) Size = (UINTN)Left;
+    if (Size == 0) return EFI_SUCCESS;
+
+    Status = ReaderReadNext(&Stream->Reader, Stream->FileOffset, Stream->In + Stream->InEnd, Size);
+    if (EFI_ERROR(Status)) return Status;
+    Stream->FileOffset += Size;
+    Stream->InEnd += Size;
+    return EFI_SUCCESS;
+}
+
+// Output room the next decode step may need at Out[OutPos]
+UINTN StreamRoom(IN CONST PXS_STREAM *Stream) {
+    CONST PXS_DECOMPRESSOR *Dec = &Stream->Dec;
+
+    if (Dec->Phase != PXS_DECOMPRESS_PHASE_BLOCK) return 0;
+    if (Dec->FrameContentSize != PXS_DECOMPRESS_UNKNOWN_SIZE &&
+        Dec->FrameContentSize - Dec->FrameOutput < Dec->MaxBlockSize) {
+        return (UINTN)(Dec->FrameContentSize - Dec->FrameOutput);
+    }
+    return Dec->MaxBlockSize;
+}
+
+// Decode one unit into Out[OutPos..OutCap). EFI_END_OF_FILE at a clean end of stream.
+EFI_STATUS StreamDecode(
+    IN OUT PXS_STREAM *Stream,
+    IN OUT UINT8 *Out,
+    IN UINTN OutPos,
+    IN UINTN OutCap,
+    OUT UINTN *Produced
+) {
+    EFI_STATUS Status;
+    UINTN Used;
+    UINTN Needed;
+
+    for (;;) {
+        if (Stream->InStart == Stream->InEnd && Stream->FileOffset == Stream->FileSize) {
+            return DecompressAtBoundary(&Stream->Dec) ? EFI_END_OF_FILE : EFI_VOLUME_CORRUPTED;
+        }
+
+        Status = DecompressStep(&Stream->Dec,
+            Stream->In + Stream->InStart, Stream->InEnd - Stream->InStart, &Used,
+            Out, OutPos, OutCap, Produced, &Needed);
+
+        if (Status == EFI_BUFFER_TOO_SMALL) {
+            // Unit straddles the buffered input; a truncated file cannot satisfy it
+            if (Stream->FileOffset == Stream->FileSize) return EFI_VOLUME_CORRUPTED;
+            Status = StreamFill(Stream, Needed);
+            if (EFI_ERROR(Status)) return Status;
+            continue;
+        }
+        if (EFI_ERROR(Status)) return Status;
+
+        Stream->InStart += Used;
+        return EFI_SUCCESS;
+    }
+}
+
+// Make room for the next unit in the sliding window, keeping the history it may reference
+EFI_STATUS StreamReserve(IN OUT PXS_STREAM *Stream) {
+    UINTN Room = StreamRoom(Stream);
+    UINTN History = Stream->Dec.WindowSize;
+
+    if (Stream->WindowCap - Stream->WindowLen >= Room) return EFI_SUCCESS;
+
+    UINTN Keep = MIN(Stream->WindowLen, History);
+    UINT8 *Source = Stream->Window + Stream->WindowLen - Keep;
+
+    if (Stream->WindowCap < History + Room) {
+        UINTN NewCap = ALIGN_VALUE(History + Room, STREAM_INPUT_CHUNK);
+        UINT8 *NewWindow = AllocatePool(NewCap);
+        if (!NewWindow) return EFI_OUT_OF_RESOURCES;
+        if (Keep > 0) CopyMem(NewWindow, Source, Keep);
+        if (Stream->Window) FreePool(Stream->Window);
+        Stream->Window = NewWindow;
+        Stream->WindowCap = NewCap;
+    } else {
+        CopyMem(Stream->Window, Source, Keep);
+    }
+
+    Stream->WindowBase += Stream->WindowLen - Keep;
+    Stream->WindowLen = Keep;
+    return EFI_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// PARALLEL DECODE
+// --------------------------------------------------------------------------
+
+// With application processors available, the units of a compressed image that
+// decode on their own (zstd frames and LZ4 frames that declare their size,
+// legacy and independent LZ4 blocks) are found from their headers as the input
+// is read. When a read covers several of them they are decoded by every CPU,
+// each straight to its place in the destination. Images that are one frame,
+// dependent LZ4 blocks and units cut by the end of a read go through the serial
+// decoder as before, so they keep overlapping decode with read-ahead.
+
+#define DECODE_BATCH_INPUT  SIZE_64MB   // Compressed bytes read ahead to find units
+#define DECODE_BATCH_UNITS  256
+
+PXS_WORK_POOL gWorkPool;
+
+// Runs on APs
+VOID DecodeUnitWork(IN VOID *Context, IN UINTN Item, IN UINTN Worker) {
+    PXS_DECODE_BATCH *Batch = (PXS_DECODE_BATCH *)Context;
+    PXS_DECODE_RESULT *Result = &Batch->Results[Item];
+
+    Result->Status = DecompressUnit(&Batch->Decoders[Worker], Batch->In, &Batch->Units[Item],
+                                    Batch->Out + Result->OutOffset, &Result->Produced);
+}
+
+// Plan the units that follow the decoder's position and decode to at most Room
+// bytes in all, reading ahead as far as their headers ask. *Count is 0 when
+// fewer than two are found; the serial decoder then carries on.
+EFI_STATUS StreamPlanUnits(IN OUT PXS_STREAM *Stream, IN UINT64 Room, OUT UINTN *Count) {
+    EFI_STATUS Status;
+    PXS_DECODE_BATCH *Batch = Stream->Batch;
+
+    *Count = 0;
+    if (Stream->Serial || gWorkPool.Enabled < 2 || Stream->Format == PXS_COMPRESSION_NONE) {
+        return EFI_SUCCESS;
+    }
+    if (!Batch) {
+        Batch = AllocateZeroPool(sizeof(*Batch) + DECODE_BATCH_UNITS * (sizeof(PXS_DECOMPRESS_UNIT) +
+                                 sizeof(PXS_DECODE_RESULT)) + gWorkPool.Workers * sizeof(PXS_DECOMPRESSOR));
+        if (!Batch) {
+            Stream->Serial = TRUE;
+            return EFI_SUCCESS;
+        }
+        Batch->Units = (PXS_DECOMPRESS_UNIT *)(Batch + 1);
+        Batch->Results = (PXS_DECODE_RESULT *)(Batch->Units + DECODE_BATCH_UNITS);
+        Batch->Decoders = (PXS_DECOMPRESSOR *)(Batch->Results + DECODE_BATCH_UNITS);
+        Stream->Batch = Batch;
+    }
+
+    Batch->Count = 0;
+    Batch->Output = 0;
+    Batch->InUsed = 0;
+    Batch->Walk = Stream->Dec;
+    while (Batch->Count < DECODE_BATCH_UNITS) {
+        PXS_DECOMPRESSOR Walk = Batch->Walk;
+        PXS_DECOMPRESS_UNIT *Unit = &Batch->Units[Batch->Count];
+        UINTN Pending = Stream->InEnd - Stream->InStart;
+        UINT64 Remaining = Pending + (Stream->FileSize - Stream->FileOffset);
+        UINTN Used;
+        UINTN Needed;
+
+        Status = DecompressNextUnit(&Walk, Stream->In + Stream->InStart + Batch->InUsed, Pending - Batch->InUsed,
+                                    Remaining - Batch->InUsed, &Used, Unit, &Needed);
+        if (Status == EFI_BUFFER_TOO_SMALL) {
+            // Read no further for a unit that will not fit, or for a first unit
+            // that may run to the end of the stream (a single frame): serial
+            // decoding overlaps that with the read-ahead
+            Needed += Batch->InUsed;
+            if (Unit->OutSize > Room - Batch->Output) break;
+            if (Batch->Count == 0 && Needed >= Remaining) break;
+            if (Needed > DECODE_BATCH_INPUT) break;
+            Status = StreamFill(Stream, Needed);
+            if (EFI_ERROR(Status)) return Status;
+            continue;
+        }
+        // Corruption is left for the serial decoder to report in stream order
+        if (EFI_ERROR(Status) || Unit->OutSize > Room - Batch->Output) break;
+
+        Unit->InOffset += Batch->InUsed;
+        Batch->InUsed += Used;
+        Batch->Output += Unit->OutSize;
+        Batch->Walk = Walk;
+        Batch->Count++;
+
+        // Nothing can be placed after a unit whose size is only bounded
+        if (Unit->Bounded) break;
+    }
+
+    if (Batch->Count < 2) Batch->Count = 0;
+    *Count = Batch->Count;
+    return EFI_SUCCESS;
+}
+
+// Decode the planned units into Out on every CPU and move the stream past them.
+// Units are placed by their planned sizes, so if one taken to be a full block
+// comes out short the ones after it are misplaced: *Produced is then 0, the
+// stream stays where it was and decodes serially from there on.
+EFI_STATUS StreamRunUnits(IN OUT PXS_STREAM *Stream, OUT UINT8 *Out, OUT UINT64 *Produced) {
+    PXS_DECODE_BATCH *Batch = Stream->Batch;
+    UINT64 Length = 0;
+    UINTN i;
+
+    *Produced = 0;
+    for (; Batch->DecoderCount < gWorkPool.Workers; Batch->DecoderCount++) {
+        if (EFI_ERROR(DecompressInit(&Batch->Decoders[Batch->DecoderCount], Stream->Format))) {
+            Stream->Serial = TRUE;
+            return EFI_SUCCESS;
+        }
+    }
+
+    for (i = 0; i < Batch->Count; i++) {
+        Batch->Results[i].OutOffset = Length;
+        Length += Batch->Units[i].OutSize;
+    }
+    Batch->In = Stream->In + Stream->InStart;
+    Batch->Out = Out;
+    WorkPoolRun(&gWorkPool, DecodeUnitWork, Batch, Batch->Count);
+
+    Length = 0;
+    for (i = 0; i < Batch->Count; i++) {
+        PXS_DECODE_RESULT *Result = &Batch->Results[i];
+        PXS_DECOMPRESS_UNIT *Unit = &Batch->Units[i];
+        if (EFI_ERROR(Result->Status)) return Result->Status;
+        if (Result->Produced != Unit->OutSize && !(Unit->Bounded && i + 1 == Batch->Count)) {
+            LogPrint(PXS_LOG_VERBOSE, L"Short %s block at %ld, decoding serially",
+                     CompressionName(Stream->Format), Stream->FileOffset - (Stream->InEnd - Stream->InStart) + Unit->InOffset);
+            Stream->Serial = TRUE;
+            return EFI_SUCCESS;
+        }
+        Length += Result->Produced;
+    }
+
+    Stream->InStart += Batch->InUsed;
+    Stream->Dec = Batch->Walk;
+    Stream->Parallel += Batch->Count;
+    Batch->Count = 0;
+    *Produced = Length;
+    return EFI_SUCCESS;
+}
+
+// Read Size decoded bytes at Offset. Compressed streams are forward-only: reads
+// are cheapest in increasing offset order, and going backwards restarts decoding.
+EFI_STATUS StreamReadAt(
+    IN OUT PXS_STREAM *Stream,
+    IN UINT64 Offset,
+    OUT VOID *Buffer,
+    IN UINT64 Size
+) {
+    EFI_STATUS Status;
+    UINT8 *Dest = (UINT8 *)Buffer;
+
+    if (Stream->Format == PXS_COMPRESSION_NONE) {
+        return ReaderReadAt(&Stream->Reader, Offset, Buffer, Size);
+    }
+
+    while (Size > 0) {
+        if (Offset < Stream->WindowBase) {
+            Status = StreamRewind(Stream);
+            if (EFI_ERROR(Status)) return Status;
+        }
+
+        UINT64 End = Stream->WindowBase + Stream->WindowLen;
+        if (Offset < End) {
+            UINTN Chunk = (UINTN)MIN(End - Offset, Size);
+            CopyMem(Dest, Stream->Window + (Offset - Stream->WindowBase), Chunk);
+            Dest += Chunk;
+            Offset += Chunk;
+            Size -= Chunk;
+            continue;
+        }
+
+        // Whole units inside the read are decoded straight into it
+        if (Offset == End) {
+            UINTN Count;
+            UINT64 Decoded;
+            Status = StreamPlanUnits(Stream, Size, &Count);
+            if (EFI_ERROR(Status)) return Status;
+            if (Count > 0) {
+                Status = StreamRunUnits(Stream, Dest, &Decoded);
+                if (EFI_ERROR(Status)) return Status;
+                if (Decoded > 0) {
+                    Dest += Decoded;
+                    Offset += Decoded;
+                    Size -= Decoded;
+                    Stream->WindowBase = Offset;
+                    Stream->WindowLen = 0;
+                    continue;
+                }
+            }
+        }
+
+        UINTN Produced;
+        Status = StreamReserve(Stream);
+        if (EFI_ERROR(Status)) return Status;
+        Status = StreamDecode(Stream, Stream->Window, Stream->WindowLen, Stream->WindowCap, &Produced);
+        if (EFI_ERROR(Status)) return Status;
+        Stream->WindowLen += Produced;
+    }
+    return EFI_SUCCESS;
+}
+
+// AllocatePages of MemoryType whose start is aligned to Alignment (a power of
+// two, at least 4K), in the boot CPU's node if it has room
+EFI_STATUS AllocateAlignedPages(
+    IN UINTN Pages,
+    IN UINT64 Alignment,
+    IN EFI_MEMORY_TYPE MemoryType,
+    OUT EFI_PHYSICAL_ADDRESS *Address
+) {
+    EFI_STATUS Status;
+    EFI_PHYSICAL_ADDRESS Base = 0;
+    UINTN Slack = EFI_SIZE_TO_PAGES(Alignment) - 1;
+
+    if (!EFI_ERROR(AllocateLocalPages(Pages, Alignment, MemoryType, Address))) return EFI_SUCCESS;
+
+    Status = gBS->AllocatePages(AllocateAnyPages, MemoryType, Pages + Slack, &Base);
+    if (EFI_ERROR(Status)) return Status;
+
+    // Return the misaligned head and the unused tail of the over-allocation
+    EFI_PHYSICAL_ADDRESS Aligned = ALIGN_VALUE(Base, Alignment);
+    UINTN Head = EFI_SIZE_TO_PAGES(Aligned - Base);
+    if (Head > 0) {
+        gBS->FreePages(Base, Head);
+    }
+    if (Slack > Head) {
+        gBS->FreePages(Aligned + EFI_PAGES_TO_SIZE(Pages), Slack - Head);
+    }
+
+    *Address = Aligned;
+    return EFI_SUCCESS;
+}
+
+// Read or decode the whole stream into freshly allocated pages of MemoryType
+// aligned to Alignment. The allocation is kept to a whole number of Alignment units with
+// the slack zeroed, so the buffer can be mapped with pages of that size.
+// Compressed data is decoded in place, using the destination as the history window.
+EFI_STATUS StreamLoadPages(
+    IN OUT PXS_STREAM *Stream,
+    IN UINT64 Alignment,
+    IN EFI_MEMORY_TYPE MemoryType,
+    OUT VOID **Buffer,
+    OUT UINT64 *Size
+) {
+    EFI_STATUS Status;
+    EFI_PHYSICAL_ADDRESS Address = 0;
+    UINTN Pages = 0;
+    UINT64 Length = 0;
+
+    if (Stream->Format == PXS_COMPRESSION_NONE) {
+        Pages = EFI_SIZE_TO_PAGES(ALIGN_VALUE(MAX(Stream->FileSize, 1), Alignment));
+        Status = AllocateAlignedPages(Pages, Alignment, MemoryType, &Address);
+        if (EFI_ERROR(Status)) return Status;
+        Status = ReaderReadAt(&Stream->Reader, 0, (VOID *)Address, Stream->FileSize);
+        if (EFI_ERROR(Status)) {
+            gBS->FreePages(Address, Pages);
+            return Status;
+        }
+        Length = Stream->FileSize;
+    } else {
+        for (;;) {
+            UINT64 Room = StreamRoom(Stream);
+            UINT64 Capacity = EFI_PAGES_TO_SIZE(Pages);
+            UINTN Count;
+
+            // Units found ahead are decoded on every CPU, as far as the read-ahead budget goes
+            Status = StreamPlanUnits(Stream, MAX_UINT64, &Count);
+            if (EFI_ERROR(Status)) break;
+            if (Count > 0) Room = Stream->Batch->Output;
+
+            if (Capacity - Length < Room) {
+                // Size the buffer from the frame header, else extrapolate the ratio so far
+                UINT64 Consumed = Stream->FileOffset - (Stream->InEnd - Stream->InStart);
+                UINT64 Estimate;
+                if (Length == 0 && Stream->Dec.FrameContentSize != PXS_DECOMPRESS_UNKNOWN_SIZE) {
+                    Estimate = Stream->Dec.FrameContentSize;
+                } else if (Length == 0 || Consumed == 0) {
+                    Estimate = Stream->FileSize * 4;
+                } else {
+                    Estimate = Length * Stream->FileSize / Consumed;
+                    Estimate += Estimate / 8;
+                }
+                Estimate = MAX(Estimate, Length + Room);
+                Estimate = MAX(Estimate, Capacity + Capacity / 4);
+
+                EFI_PHYSICAL_ADDRESS NewAddress = 0;
+                UINTN NewPages = EFI_SIZE_TO_PAGES(ALIGN_VALUE(Estimate, Alignment));
+                Status = AllocateAlignedPages(NewPages, Alignment, MemoryType, &NewAddress);
+                if (EFI_ERROR(Status)) break;
+                if (Pages > 0) {
+                    BulkCopyMem((VOID *)NewAddress, (VOID *)Address, Length);
+                    gBS->FreePages(Address, Pages);
+                }
+                Address = NewAddress;
+                Pages = NewPages;
+                Capacity = EFI_PAGES_TO_SIZE(Pages);
+            }
+
+            if (Count > 0) {
+                UINT64 Decoded;
+                Status = StreamRunUnits(Stream, (UINT8 *)Address + Length, &Decoded);
+                if (EFI_ERROR(Status)) break;
+                if (Decoded > 0) {
+                    Length += Decoded;
+                    continue;
+                }
+            }
+
+            UINTN Produced;
+            Status = StreamDecode(Stream, (UINT8 *)Address, (UINTN)Length, (UINTN)Capacity, &Produced);
+            if (Status == EFI_END_OF_FILE) {
+                Status = EFI_SUCCESS;
+                break;
+            }
+            if (EFI_ERROR(Status)) break;
+            Length += Produced;
+        }
+
+        if (EFI_ERROR(Status) || Length == 0) {
+            if (Pages > 0) gBS->FreePages(Address, Pages);
+            return EFI_ERROR(Status) ? Status : EFI_LOAD_ERROR;
+        }
+
+        // Hand back the over-allocated tail
+        UINTN Used = EFI_SIZE_TO_PAGES(ALIGN_VALUE(Length, Alignment));
+        if (Used < Pages) {
+            gBS->FreePages(Address + EFI_PAGES_TO_SIZE(Used), Pages - Used);
+            Pages = Used;
+        }
+        LogPrint(PXS_LOG_VERBOSE, L"Decompressed %s: %ld -> %ld bytes (%d units on %d CPUs)", CompressionName(Stream->Format),
+                 Stream->FileSize, Length, Stream->Parallel, Stream->Parallel ? gWorkPool.Enabled : 1);
+    }
+
+    BulkSetMem((UINT8 *)Address + Length, EFI_PAGES_TO_SIZE(Pages) - Length, 0);
+    *Buffer = (VOID *)Address;
+    *Size = Length;
+    return EFI_SUCCESS;
+}
+
+// Load a whole (possibly compressed) file into pages. With Digest, the SHA-256
+// of the file as stored is computed from the same reads.
+EFI_STATUS LoadImageFile(
+    IN EFI_FILE_HANDLE RootDir,
+    IN CHAR16 *FileName,
+    IN UINT64 Alignment,
+    IN EFI_MEMORY_TYPE MemoryType,
+    OUT VOID **Buffer,
+    OUT UINT64 *Size,
+    OUT UINT8 *Digest OPTIONAL
+) {
+    EFI_STATUS Status;
+    PXS_STREAM Stream;
+    PXS_SHA256 Hash;
+
+    Status = StreamOpen(RootDir, FileName, &Stream);
+    if (EFI_ERROR(Status)) return Status;
+    if (Digest) ReaderStartHash(&Stream.Reader, &Hash);
+
+    Status = StreamLoadPages(&Stream, Alignment, MemoryType, Buffer, Size);
+    if (!EFI_ERROR(Status) && Digest) {
+        Status = ReaderFinishHash(&Stream.Reader, Digest);
+        if (EFI_ERROR(Status)) {
+            gBS->FreePages((EFI_PHYSICAL_ADDRESS)*Buffer, EFI_SIZE_TO_PAGES(ALIGN_VALUE(MAX(*Size, 1), Alignment)));
+        }
+    }
+    StreamClose(&Stream);
+    return Status;
+}
+
+// Weak seed from the TSC and the wall clock, for firmware without RNG or RDRAND
+UINT64 MixTimeEntropy(IN UINT64 Tsc, IN CONST EFI_TIME *Time) {
+    UINT64 Seed = Tsc;
+
+    Seed ^= ((UINT64)Time->Nanosecond << 32);
+    Seed ^= ((UINT64)Time->Year << 16) | ((UINT64)Time->Month << 8) | Time->Day;
+    Seed ^= ((UINT64)Time->Hour << 24) | ((UINT64)Time->Minute << 16) | ((UINT64)Time->Second << 8);
+
+    // Simple mixing step (XOR-shift style)
+    Seed ^= (Seed << 13);
+    Seed ^= (Seed >> 7);
+    Seed ^= (Seed << 17);
+
+    return Seed;
+}
+
+UINT64 GetBestEntropy() {
+    EFI_STATUS Status;
+    UINT64 Seed = 0;
+
+    // 1. Try UEFI RNG Protocol
+    EFI_RNG_PROTOCOL *Rng;
+    Status = gBS->LocateProtocol(&gEfiRngProtocolGuid, NULL, (VOID **)&Rng);
+    if (!EFI_ERROR(Status)) {
+        Status = Rng->GetRNG(Rng, NULL, sizeof(Seed), (UINT8*)&Seed);
+        if (!EFI_ERROR(Status) && Seed != 0) {
+            return Seed;
+        }
+    }
+
+    // 2. Try RDRAND (Hardware Instruction)
+    UINT32 Ecx;
+    // CPUID Leaf 1, ECX[30] = RDRAND
+    AsmCpuid(1, NULL, NULL, &Ecx, NULL);
+
+    if (Ecx & (1 << 30)) {
+        UINT8 Success = 0;
+        // Retry loop for RDRAND underflow
+        for (int i = 0; i < 10; i++) {
+            __asm__ __volatile__ (
+                "rdrand %0; setc %1"
+                : "=r" (Seed), "=qm" (Success)
+            );
+            if (Success && Seed != 0) return Seed;
+        }
+    }
+
+    // 3. Fallback: Mix Time and TSC
+    EFI_TIME Time;
+    gST->RuntimeServices->GetTime(&Time, NULL);
+    return MixTimeEntropy(__builtin_ia32_rdtsc(), &Time);
+}
+
+// MODULE=path[,name][,align=4K|2M|...]
+VOID ParseModuleLine(
+    IN CONST CHAR8 *Value,
+    IN UINTN ValLen,
+    IN OUT PXS_CONFIG *Config
+) {
+    if (Config->ModuleCount >= PXS_MAX_MODULES) {
+        LogPrint(PXS_LOG_WARNING, L"Warning: More than %d modules, ignoring the rest", PXS_MAX_MODULES);
+        return;
+    }
+
+    PXS_MODULE_CONFIG *Module = &Config->Modules[Config->ModuleCount];
+    SetMem(Module, sizeof(*Module), 0);
+    Module->Alignment = EFI_PAGE_SIZE;
+
+    UINTN Pos = 0;
+    for (UINTN Field = 0; Pos <= ValLen; Field++, Pos++) {
+        CONST CHAR8 *Text = &Value[Pos];
+        UINTN Len = 0;
+        while (Pos < ValLen && Value[Pos] != ',') {
+            Pos++;
+            Len++;
+        }
+
+        if (Field == 0) {
+            for (UINTN i = 0; i < Len && i < 255; i++) {
+                Module->Path[i] = (CHAR16)Text[i];
+            }
+            Module->Path[Len < 255 ? Len : 255] = L'\0';
+        } else if (Len > 6 && AsciiStrnCmp(Text, "align=", 6) == 0) {
+            UINT64 Align = 0;
+            UINTN i = 6;
+            while (i < Len && Text[i] >= '0' && Text[i] <= '9') {
+                Align = Align * 10 + (Text[i++] - '0');
+            }
+            if (i < Len) {
+                CHAR8 Unit = Text[i] | 0x20; // Lowercase
+                if (Unit == 'k') Align <<= 10;
+                else if (Unit == 'm') Align <<= 20;
+                else if (Unit == 'g') Align <<= 30;
+            }
+            if (Align < EFI_PAGE_SIZE || Align > SIZE_1GB || (Align & (Align - 1)) != 0) {
+                LogPrint(PXS_LOG_WARNING, L"Warning: Bad module alignment, using 4K");
+                Align = EFI_PAGE_SIZE;
+            }
+            Module->Alignment = Align;
+        } else {
+            for (UINTN i = 0; i < Len && i < PXS_MODULE_NAME_SIZE - 1; i++) {
+                Module->Name[i] = Text[i];
+            }
+        }
+    }
+
+    if (Module->Path[0] == L'\0') return;
+
+    // Name defaults to the path
+    if (Module->Name[0] == '\0') {
+        for (UINTN i = 0; i < PXS_MODULE_NAME_SIZE - 1 && Module->Path[i] != L'\0'; i++) {
+            Module->Name[i] = (CHAR8)Module->Path[i];
+        }
+    }
+    Config->ModuleCount++;
+}
+
+// 64 hex digits, as printed by sha256sum
+BOOLEAN ParseSha256(IN CONST CHAR8 *Text, IN UINTN Length, OUT UINT8 *Digest) {
+    while (Length > 0 && (Text[Length - 1] == ' ' || Text[Length - 1] == '\t')) Length--;
+    if (Length != 2 * PXS_SHA256_DIGEST_SIZE) return FALSE;
+
+    for (UINTN i = 0; i < Length; i++) {
+        INTN Nibble = HexDigit(Text[i]);
+        if (Nibble < 0) return FALSE;
+        Digest[i / 2] = (i & 1) ? (UINT8)(Digest[i / 2] | Nibble) : (UINT8)(Nibble << 4);
+    }
+    return TRUE;
+}
+
+// Hex number with an optional 0x prefix, up to the first non-hex character
+UINT64 ParseHex(IN CONST CHAR8 *Text, IN UINTN Length) {
+    UINT64 Value = 0;
+
+    if (Length >= 2 && Text[0] == '0' && (Text[1] == 'x' || Text[1] == 'X')) {
+        Text += 2;
+        Length -= 2;
+    }
+    for (UINTN i = 0; i < Length; i++) {
+        INTN Digit = HexDigit(Text[i]);
+        if (Digit < 0) break;
+        Value = (Value << 4) | (UINT64)Digit;
+    }
+    return Value;
+}
+
+// WIDTHxHEIGHT in decimal, e.g. 1920x1080
+BOOLEAN ParseResolution(IN CONST CHAR8 *Text, IN UINTN Length, OUT UINT32 *Width, OUT UINT32 *Height) {
+    UINT32 Value[2] = { 0, 0 };
+    UINTN Part = 0;
+    UINTN Digits = 0;
+
+    for (UINTN i = 0; i < Length; i++) {
+        CHAR8 c = Text[i];
+        if (c >= '0' && c <= '9' && Value[Part] < 100000) {
+            Value[Part] = Value[Part] * 10 + (c - '0');
+            Digits++;
+        } else if ((c == 'x' || c == 'X') && Part == 0 && Digits > 0) {
+            Part = 1;
+            Digits = 0;
+        } else {
+            return FALSE;
+        }
+    }
+    if (Part != 1 || Digits == 0 || Value[0] == 0 || Value[1] == 0) return FALSE;
+    *Width = Value[0];
+    *Height = Value[1];
+    return TRUE;
+}
+
+// One KEY=VALUE line without leading whitespace. Unknown keys are ignored.
+VOID ParseConfigLine(
+    IN CONST CHAR8 *Line,
+    IN UINTN Length,
+    IN OUT PXS_CONFIG *Config
+) {
+    // Check for KERNEL=
+    if (AsciiStrnCmp(Line, "KERNEL=", 7) == 0) {
+        UINTN ValStart = 7;
+        UINTN ValLen = Length - ValStart;
+        // Convert to CHAR16
+        for (UINTN i=0; i < ValLen && i < 255; i++) {
+            Config->KernelPath[i] = (CHAR16)Line[ValStart + i];
+        }
+        Config->KernelPath[ValLen < 255 ? ValLen : 255] = L'\0';
+    }
+    // Check for INITRD=
+    else if (AsciiStrnCmp(Line, "INITRD=", 7) == 0) {
+        UINTN ValStart = 7;
+        UINTN ValLen = Length - ValStart;
+        for (UINTN i=0; i < ValLen && i < 255; i++) {
+            Config->InitrdPath[i] = (CHAR16)Line[ValStart + i];
+        }
+        Config->InitrdPath[ValLen < 255 ? ValLen : 255] = L'\0';
+    }
+    // Check for MODULE=
+    else if (AsciiStrnCmp(Line, "MODULE=", 7) == 0) {
+        ParseModuleLine(Line + 7, Length - 7, Config);
+    }
+    // Check for CMDLINE=
+    else if (AsciiStrnCmp(Line, "CMDLINE=", 8) == 0) {
+        UINTN ValStart = 8;
+        UINTN ValLen = Length - ValStart;
+        for (UINTN i=0; i < ValLen && i < 511; i++) {
+            Config->CmdLine[i] = Line[ValStart + i];
+        }
+        UINTN MaxLen = (ValLen < 511) ? ValLen : 511;
+        Config->CmdLine[MaxLen] = '\0';
+    }
+    // Check for TIMEOUT=
+    else if (AsciiStrnCmp(Line, "TIMEOUT=", 8) == 0) {
+        UINTN ValStart = 8;
+        UINTN ValLen = Length - ValStart;
+        UINTN TimeoutVal = 0;
+        for (UINTN i = 0; i < ValLen; i++) {
+            CHAR8 c = Line[ValStart + i];
+            if (c >= '0' && c <= '9') {
+                TimeoutVal = TimeoutVal * 10 + (c - '0');
+            } else {
+                break; // Stop at non-digit
+            }
+        }
+        Config->Timeout = TimeoutVal;
+    }
+    // Check for KVBASE=
+    else if (AsciiStrnCmp(Line, "KVBASE=", 7) == 0) {
+        Config->KvBase = ParseHex(Line + 7, Length - 7);
+    }
+    // Check for KASLR_MIN= / KASLR_MAX= (hex physical addresses)
+    else if (AsciiStrnCmp(Line, "KASLR_MIN=", 10) == 0) {
+        Config->KaslrMin = ParseHex(Line + 10, Length - 10);
+    }
+    else if (AsciiStrnCmp(Line, "KASLR_MAX=", 10) == 0) {
+        Config->KaslrMax = ParseHex(Line + 10, Length - 10);
+    }
+    // Check for RESOLUTION= / MAXRES= (WIDTHxHEIGHT)
+    else if (AsciiStrnCmp(Line, "RESOLUTION=", 11) == 0) {
+        if (!ParseResolution(Line + 11, Length - 11, &Config->ResolutionWidth, &Config->ResolutionHeight)) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Ignoring malformed RESOLUTION=");
+        }
+    }
+    else if (AsciiStrnCmp(Line, "MAXRES=", 7) == 0) {
+        if (!ParseResolution(Line + 7, Length - 7, &Config->MaxResWidth, &Config->MaxResHeight)) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Ignoring malformed MAXRES=");
+        }
+    }
+    // Check for KASLR=
+    else if (AsciiStrnCmp(Line, "KASLR=", 6) == 0) {
+        UINTN ValStart = 6;
+        // Check for 0 or FALSE
+        if (Line[ValStart] == '0') {
+            Config->KaslrEnabled = FALSE;
+        } else if (AsciiStrnCmp(&Line[ValStart], "FALSE", 5) == 0) {
+            Config->KaslrEnabled = FALSE;
+        }
+    }
+    // Check for KERNEL_SHA256= / INITRD_SHA256=
+    else if (AsciiStrnCmp(Line, "KERNEL_SHA256=", 14) == 0) {
+        // A malformed digest still demands verification, which then fails
+        Config->VerifyKernel = TRUE;
+        if (!ParseSha256(Line + 14, Length - 14, Config->KernelSha256)) {
+            SetMem(Config->KernelSha256, sizeof(Config->KernelSha256), 0);
+            LogPrint(PXS_LOG_WARNING, L"Warning: KERNEL_SHA256 is not 64 hex digits");
+        }
+    }
+    else if (AsciiStrnCmp(Line, "INITRD_SHA256=", 14) == 0) {
+        Config->VerifyInitrd = TRUE;
+        if (!ParseSha256(Line + 14, Length - 14, Config->InitrdSha256)) {
+            SetMem(Config->InitrdSha256, sizeof(Config->InitrdSha256), 0);
+            LogPrint(PXS_LOG_WARNING, L"Warning: INITRD_SHA256 is not 64 hex digits");
+        }
+    }
+    // Check for PAGING=
+    else if (AsciiStrnCmp(Line, "PAGING=", 7) == 0) {
+        UINTN ValStart = 7;
+        if (Line[ValStart] == '1') {
+            Config->PagingEnabled = TRUE;
+        } else if (AsciiStrnCmp(&Line[ValStart], "TRUE", 4) == 0) {
+            Config->PagingEnabled = TRUE;
+        }
+    }
+    // Check for SMP=
+    else if (AsciiStrnCmp(Line, "SMP=", 4) == 0) {
+        UINTN ValStart = 4;
+        if (Line[ValStart] == '0') {
+            Config->SmpPark = FALSE;
+        } else if (AsciiStrnCmp(&Line[ValStart], "FALSE", 5) == 0) {
+            Config->SmpPark = FALSE;
+        }
+    }
+}
+
+// Next non-blank line of Text[*Pos, End), without leading whitespace
+BOOLEAN NextConfigLine(
+    IN CONST CHAR8 *Text,
+    IN UINTN End,
+    IN OUT UINTN *Pos,
+    OUT CONST CHAR8 **Line,
+    OUT UINTN *Length
+) {
+    UINTN Start = *Pos;
+
+    while (Start < End) {
+        UINTN LineEnd = Start;
+        while (LineEnd < End && Text[LineEnd] != '\n' && Text[LineEnd] != '\r') {
+            LineEnd++;
+        }
+        while (Start < LineEnd && (Text[Start] == ' ' || Text[Start] == '\t')) {
+            Start++;
+        }
+        UINTN First = Start;
+
+        // Skip newline chars
+        Start = LineEnd;
+        while (Start < End && (Text[Start] == '\n' || Text[Start] == '\r')) {
+            Start++;
+        }
+        if (First < LineEnd) {
+            *Line = Text + First;
+            *Length = LineEnd - First;
+            *Pos = Start;
+            return TRUE;
+        }
+    }
+    *Pos = End;
+    return FALSE;
+}
+
+// Copy an ASCII config value into a CHAR16 buffer of Capacity characters
+VOID ConfigValueToUnicode(IN CONST CHAR8 *Value, IN UINTN Length, OUT CHAR16 *Dest, IN UINTN Capacity) {
+    UINTN i;
+    while (Length > 0 && (Value[Length - 1] == ' ' || Value[Length - 1] == '\t')) Length--;
+    for (i = 0; i < Length && i < Capacity - 1; i++) {
+        Dest[i] = (CHAR16)Value[i];
+    }
+    Dest[i] = L'\0';
+}
+
+// DEFAULT= names an entry by title or by 1-based position
+UINTN FindConfigEntry(IN PXS_CONFIG *Config, IN CONST CHAR8 *Value, IN UINTN Length) {
+    while (Length > 0 && (Value[Length - 1] == ' ' || Value[Length - 1] == '\t')) Length--;
+
+    for (UINTN i = 0; i < Config->EntryCount; i++) {
+        CONST CHAR16 *Title = Config->Entries[i].Title;
+        UINTN j = 0;
+        while (j < Length && Title[j] != L'\0' && Title[j] == (CHAR16)Value[j]) j++;
+        if (j == Length && Title[j] == L'\0') return i;
+    }
+
+    UINTN Number = 0;
+    for (UINTN i = 0; i < Length; i++) {
+        if (Value[i] < '0' || Value[i] > '9') {
+            Number = 0;
+            break;
+        }
+        Number = Number * 10 + (Value[i] - '0');
+    }
+    if (Number >= 1 && Number <= Config->EntryCount) return Number - 1;
+
+    LogPrint(PXS_LOG_WARNING, L"Warning: DEFAULT entry not found, using the first");
+    return 0;
+}
+
+// Config parser
+// Format: KEY=VALUE
+// KERNEL=path
+// INITRD=path
+// MODULE=path[,name][,align=2M] (repeatable)
+//   Any of the three may be part:<GUID>[:offset], read from a GPT partition
+// CMDLINE=string
+// PAGING=1 (enter the kernel on loader-built page tables)
+// SMP=0 (leave APs to the kernel instead of parking them on mailboxes)
+// KASLR=0, KASLR_MIN=hex / KASLR_MAX=hex (physical range for the kernel)
+// RESOLUTION=WxH (that graphics mode), MAXRES=WxH (the largest mode within)
+// KERNEL_SHA256=hex / INITRD_SHA256=hex (refuse to boot on a mismatch)
+// TIMEOUT=seconds (0 boots the default entry without waiting)
+// DEFAULT=title or number, MENU=hidden (show the menu only on a keypress)
+// LOG=quiet|normal|verbose (console output: errors only, progress, details)
+//
+// Keys before the first section apply to every entry. Each [entry] section
+// (TITLE=name plus any of the keys above) is only indexed here; the one picked
+// by BootMenu() is parsed by ApplyConfigEntry(), so unused entries cost nothing.
+VOID ConfigDefaults(OUT PXS_CONFIG *Config) {
+    StrCpyS(Config->KernelPath, 256, DEFAULT_KERNEL_PATH);
+    Config->InitrdPath[0] = L'\0';
+    Config->CmdLine[0] = '\0';
+    Config->Timeout = 3;
+    Config->KvBase = 0;
+    Config->KaslrEnabled = TRUE;
+    Config->KaslrMin = KASLR_DEFAULT_MIN;
+    Config->KaslrMax = MAX_UINT64;
+    Config->PagingEnabled = FALSE;
+    Config->ResolutionWidth = 0;
+    Config->ResolutionHeight = 0;
+    Config->MaxResWidth = 0;
+    Config->MaxResHeight = 0;
+    Config->ModuleCount = 0;
+    Config->VerifyKernel = FALSE;
+    Config->VerifyInitrd = FALSE;
+    Config->EntryCount = 0;
+    Config->DefaultEntry = 0;
+    Config->MenuHidden = FALSE;
+    Config->LogLevel = PXS_LOG_INFO;
+    Config->SmpPark = TRUE;
+    Config->Text = NULL;
+    Config->TextSize = 0;
+}
+
+VOID ParseLogLevel(IN CONST CHAR8 *Value, IN UINTN Length, IN OUT PXS_CONFIG *Config) {
+    if (Length == 5 && CompareMem(Value, "quiet", 5) == 0) {
+        Config->LogLevel = PXS_LOG_ERROR;
+    } else if (Length == 6 && CompareMem(Value, "normal", 6) == 0) {
+        Config->LogLevel = PXS_LOG_INFO;
+    } else if (Length == 7 && CompareMem(Value, "verbose", 7) == 0) {
+        Config->LogLevel = PXS_LOG_VERBOSE;
+    } else {
+        LogPrint(PXS_LOG_WARNING, L"Warning: Unknown LOG= level, using normal");
+    }
+}
+
+// Index the config in Text (pool, owned by Config from here on) over the defaults
+VOID ParseConfig(IN CHAR8 *Text, IN UINTN Size, IN OUT PXS_CONFIG *Config) {
+    CONST CHAR8 *Line;
+    UINTN Length;
+    UINTN Pos = 0;
+    CONST CHAR8 *Default = NULL;
+    UINTN DefaultLength = 0;
+    PXS_MENU_ENTRY *Entry = NULL;
+    BOOLEAN InSection = FALSE;
+
+    Config->Text = Text;
+    Config->TextSize = Size;
+
+    while (NextConfigLine(Config->Text, Config->TextSize, &Pos, &Line, &Length)) {
+        if (Line[0] == '[') {
+            InSection = TRUE;
+            Entry = NULL;
+            if (Length >= 7 && CompareMem(Line, "[entry]", 7) == 0) {
+                if (Config->EntryCount < PXS_MAX_ENTRIES) {
+                    Entry = &Config->Entries[Config->EntryCount++];
+                    Entry->Title[0] = L'\0';
+                    Entry->Start = Entry->End = Pos;
+                } else {
+                    LogPrint(PXS_LOG_WARNING, L"Warning: More than %d entries, ignoring the rest", PXS_MAX_ENTRIES);
+                }
+            } else {
+                LogPrint(PXS_LOG_WARNING, L"Warning: Unknown config section ignored");
+            }
+            continue;
+        }
+
+        if (Entry) {
+            // Untitled entries are listed by kernel path
+            Entry->End = Pos;
+            if (Length > 6 && CompareMem(Line, "TITLE=", 6) == 0) {
+                ConfigValueToUnicode(Line + 6, Length - 6, Entry->Title, PXS_MENU_TITLE_SIZE);
+            } else if (Length > 7 && CompareMem(Line, "KERNEL=", 7) == 0 && Entry->Title[0] == L'\0') {
+                ConfigValueToUnicode(Line + 7, Length - 7, Entry->Title, PXS_MENU_TITLE_SIZE);
+            }
+        } else if (!InSection) {
+            if (Length > 8 && CompareMem(Line, "DEFAULT=", 8) == 0) {
+                Default = Line + 8;
+                DefaultLength = Length - 8;
+            } else if (Length >= 5 && CompareMem(Line, "MENU=", 5) == 0) {
+                Config->MenuHidden = (Length >= 11 && CompareMem(Line + 5, "hidden", 6) == 0);
+            } else if (Length > 4 && CompareMem(Line, "LOG=", 4) == 0) {
+                ParseLogLevel(Line + 4, Length - 4, Config);
+            } else {
+                ParseConfigLine(Line, Length, Config);
+            }
+        }
+    }
+
+    for (UINTN i = 0; i < Config->EntryCount; i++) {
+        if (Config->Entries[i].Title[0] == L'\0') {
+            StrCpyS(Config->Entries[i].Title, PXS_MENU_TITLE_SIZE, L"(untitled)");
+        }
+    }
+    if (Default && Config->EntryCount > 0) {
+        Config->DefaultEntry = FindConfigEntry(Config, Default, DefaultLength);
+    }
+}
+
+VOID LoadConfig(
+    IN EFI_FILE_HANDLE RootDir,
+    IN CHAR16 *ConfigName,
+    OUT PXS_CONFIG *Config
+) {
+    EFI_STATUS Status;
+    VOID *Buffer;
+    UINT64 Size;
+
+    ConfigDefaults(Config);
+    Status = LoadFile(RootDir, ConfigName, &Buffer, &Size);
+    if (EFI_ERROR(Status)) {
+        LogPrint(PXS_LOG_INFO, L"Config '%s' not found. Using defaults.", ConfigName);
+        return;
+    }
+    ParseConfig((CHAR8 *)Buffer, (UINTN)Size, Config);
+}
+
+// Parse the chosen [entry] over the global keys, then wipe the config text
+VOID ApplyConfigEntry(IN OUT PXS_CONFIG *Config, IN UINTN Index) {
+    CONST CHAR8 *Line;
+    UINTN Length;
+
+    if (Index < Config->EntryCount) {
+        PXS_MENU_ENTRY *Entry = &Config->Entries[Index];
+        UINTN Pos = Entry->Start;
+        while (NextConfigLine(Config->Text, Entry->End, &Pos, &Line, &Length)) {
+            ParseConfigLine(Line, Length, Config);
+        }
+        LogPrint(PXS_LOG_INFO, L"Entry: %s", Entry->Title);
+    }
+
+    if (Config->Text) {
+        BulkSetMem(Config->Text, Config->TextSize, 0); // Secure wipe
+        FreePool(Config->Text);
+        Config->Text = NULL;
+        Config->TextSize = 0;
+    }
+    LogPrint(PXS_LOG_INFO, L"Config Loaded: Kernel=%s, KASLR=%s", Config->KernelPath, Config->KaslrEnabled ? L"ON" : L"OFF");
+    if (Config->CmdLine[0] != '\0') {
+        LogPrint(PXS_LOG_INFO, L"CmdLine: %a", Config->CmdLine);
+    }
+}
+
+
+// --------------------------------------------------------------------------
+// BOOT MENU
+// --------------------------------------------------------------------------
+
+// The countdown waits on a periodic timer and the key event together, so a
+// keypress ends it at once. With TIMEOUT=0 no event is created and nothing is
+// drawn: a key already waiting (held through firmware start) opens the menu,
+// otherwise the default entry boots straight away.
+
+#define MENU_TICK 10000000  // 1 s in 100 ns timer units
+
+CONST CHAR16 *MenuTitle(IN PXS_CONFIG *Config, IN UINTN Index) {
+    return (Config->EntryCount > 0) ? Config->Entries[Index].Title : Config->KernelPath;
+}
+
+// Redraw the list at row Top, with the countdown while Remaining != 0
+VOID MenuDraw(IN PXS_CONFIG *Config, IN UINTN Top, IN UINTN Selected, IN UINTN Remaining) {
+    UINTN Count = MAX(Config->EntryCount, 1);
+
+    for (UINTN i = 0; i < Count; i++) {
+        gST->ConOut->SetCursorPosition(gST->ConOut, 0, Top + i);
+        Print(L"%c %d. %s", (i == Selected) ? L'>' : L' ', i + 1, MenuTitle(Config, i));
+    }
+    gST->ConOut->SetCursorPosition(gST->ConOut, 0, Top + Count);
+    if (Remaining > 0) {
+        Print(L"Booting in %d s, press a key to choose    ", Remaining);
+    } else {
+        Print(L"Up/Down or 1-9 to choose, Enter to boot   ");
+    }
+}
+
+// Make room below the cursor (the console may scroll) and draw the list there
+UINTN MenuOpen(IN PXS_CONFIG *Config, IN UINTN Selected, IN UINTN Remaining) {
+    UINTN Lines = MAX(Config->EntryCount, 1) + 1;
+    for (UINTN i = 0; i < Lines; i++) {
+        Print(L"\n");
+    }
+    UINTN Top = gST->ConOut->Mode->CursorRow - Lines;
+    MenuDraw(Config, Top, Selected, Remaining);
+    return Top;
+}
+
+// Pick the entry to boot
+UINTN BootMenu(IN PXS_CONFIG *Config) {
+    EFI_SIMPLE_TEXT_INPUT_PROTOCOL *ConIn = gST->ConIn;
+    UINTN Count = MAX(Config->EntryCount, 1);
+    UINTN Selected = Config->DefaultEntry;
+    UINTN Remaining = Config->Timeout;
+    BOOLEAN Shown = FALSE;
+    UINTN Top = 0;
+    UINTN Index;
+    EFI_INPUT_KEY Key;
+    EFI_EVENT Timer;
+
+    if (Remaining == 0) {
+        // CheckEvent leaves the key queued for the menu below
+        if (Config->EntryCount < 2 || gBS->CheckEvent(ConIn->WaitForKey) != EFI_SUCCESS) return Selected;
+    } else {
+        if (EFI_ERROR(gBS->CreateEvent(EVT_TIMER, 0, NULL, NULL, &Timer))) {
+            gBS->Stall(Remaining * 1000000);
+            return Selected;
+        }
+        gBS->SetTimer(Timer, TimerPeriodic, MENU_TICK);
+        if (!Config->MenuHidden) {
+            Top = MenuOpen(Config, Selected, Remaining);
+            Shown = TRUE;
+        }
+
+        EFI_EVENT Events[2] = { ConIn->WaitForKey, Timer };
+        while (Remaining > 0) {
+            if (EFI_ERROR(gBS->WaitForEvent(2, Events, &Index)) || Index == 0) break;
+            Remaining--;
+            if (Shown) MenuDraw(Config, Top, Selected, Remaining);
+        }
+        gBS->CloseEvent(Timer);
+
+        // Timed out, or a key with nothing to choose from
+        if (Remaining == 0 || Config->EntryCount < 2) {
+            if (Shown) Print(L"\n");
+            return Selected;
+        }
+    }
+
+    if (Shown) MenuDraw(Config, Top, Selected, 0);
+    else Top = MenuOpen(Config, Selected, 0);
+
+    for (;;) {
+        if (EFI_ERROR(ConIn->ReadKeyStroke(ConIn, &Key))) {
+            gBS->WaitForEvent(1, &ConIn->WaitForKey, &Index);
+            continue;
+        }
+        if (Key.ScanCode == SCAN_UP) {
+            Selected = (Selected + Count - 1) % Count;
+        } else if (Key.ScanCode == SCAN_DOWN) {
+            Selected = (Selected + 1) % Count;
+        } else if (Key.UnicodeChar == CHAR_CARRIAGE_RETURN) {
+            break;
+        } else if (Key.UnicodeChar >= L'1' && Key.UnicodeChar < L'1' + MIN(Count, 9)) {
+            Selected = Key.UnicodeChar - L'1';
+            MenuDraw(Config, Top, Selected, 0);
+            break;
+        }
+        MenuDraw(Config, Top, Selected, 0);
+    }
+    Print(L"\n");
+    return Selected;
+}
+
+// --------------------------------------------------------------------------
+// ELF LOADER
+// --------------------------------------------------------------------------
+
+// KASLR places the image at a slot drawn uniformly from every address that
+// keeps it inside one run of free memory within [KaslrMin, KaslrMax). Slots are
+// KASLR_ALIGN apart and keep the linked address's offset within KASLR_ALIGN, so
+// the slide preserves large page alignment. One pass over the memory map counts
+// them, a second finds the chosen one, and a single AllocatePages() takes it.
+// Only slots in the boot CPU's node count, unless it has none.
+
+typedef struct {
+    UINT64 Min;                     ///< The image must lie in [Min, Max)
+    UINT64 Max;
+    UINT64 Phase;                   ///< Slot addresses modulo KASLR_ALIGN
+    UINT64 Size;
+    UINT64 Pick;                    ///< Slot to return, MAX_UINT64 to only count
+    UINT64 Count;                   ///< Slots seen so far
+    EFI_PHYSICAL_ADDRESS Address;   ///< Slot number Pick, once seen
+    CONST PXS_NUMA_NODE *Node;      ///< Runs are clipped to its ranges, unless NULL
+} KASLR_SEARCH;
+
+// Account for the slots in the free run [Start, End)
+VOID KaslrAddRun(IN OUT KASLR_SEARCH *Search, IN UINT64 Start, IN UINT64 End) {
+    Start = MAX(Start, Search->Min);
+    End = MIN(End, Search->Max);
+    if (End <= Start || End - Start < Search->Size) return;
+
+    UINT64 First = ((Start + KASLR_ALIGN - 1 - Search->Phase) & ~(UINT64)(KASLR_ALIGN - 1)) + Search->Phase;
+    UINT64 Last = End - Search->Size;
+    if (First > Last) return;
+
+    UINT64 Slots = (Last - First) / KASLR_ALIGN + 1;
+    if (Search->Pick >= Search->Count && Search->Pick - Search->Count < Slots) {
+        Search->Address = First + (Search->Pick - Search->Count) * KASLR_ALIGN;
+    }
+    Search->Count += Slots;
+}
+
+// The part of the free run [Start, End) in the search node, or all of it
+VOID KaslrAddNodeRun(IN OUT KASLR_SEARCH *Search, IN UINT64 Start, IN UINT64 End) {
+    if (!Search->Node) {
+        KaslrAddRun(Search, Start, End);
+        return;
+    }
+    for (UINT32 i = 0; i < Search->Node->RangeCount; i++) {
+        CONST PXS_NUMA_RANGE *Range = &gNuma->Ranges[Search->Node->FirstRange + i];
+        KaslrAddRun(Search, MAX(Start, Range->Base), MIN(End, Range->Base + Range->Length));
+    }
+}
+
+// Free descriptors that touch are merged into one run, as firmware splits
+// conventional memory at arbitrary points
+VOID KaslrSearch(
+    IN CONST EFI_MEMORY_DESCRIPTOR *Map,
+    IN UINTN MapSize,
+    IN UINTN DescriptorSize,
+    IN OUT KASLR_SEARCH *Search
+) {
+    UINT64 RunStart = 0;
+    UINT64 RunEnd = 0;
+
+    Search->Count = 0;
+    for (UINTN Offset = 0; Offset < MapSize; Offset += DescriptorSize) {
+        CONST EFI_MEMORY_DESCRIPTOR *Desc = (CONST EFI_MEMORY_DESCRIPTOR *)((CONST UINT8 *)Map + Offset);
+        if (Desc->Type != EfiConventionalMemory) continue;
+
+        UINT64 Start = Desc->PhysicalStart;
+        UINT64 End = Start + EFI_PAGES_TO_SIZE(Desc->NumberOfPages);
+        if (Start == RunEnd && RunEnd != RunStart) {
+            RunEnd = End;
+            continue;
+        }
+        KaslrAddNodeRun(Search, RunStart, RunEnd);
+        RunStart = Start;
+        RunEnd = End;
+    }
+    KaslrAddNodeRun(Search, RunStart, RunEnd);
+}
+
+// Uniform random number below Count (nonzero). Seeds from the incomplete top
+// block are redrawn so Seed % Count is not biased.
+UINT64 KaslrUniform(IN UINT64 Count) {
+    UINT64 Seed = GetBestEntropy();
+    UINT64 Excess = (MAX_UINT64 % Count + 1) % Count;
+    while (Seed > MAX_UINT64 - Excess) {
+        Seed = Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return Seed % Count;
+}
+
+// Choose a slot for an image linked at BaseOffset: a random one, or the
+// lowest when KASLR is disabled
+EFI_STATUS KaslrChooseSlot(
+    IN PXS_CONFIG *Config,
+    IN UINT64 BaseOffset,
+    IN UINT64 TotalSize,
+    OUT EFI_PHYSICAL_ADDRESS *LoadBase
+) {
+    EFI_MEMORY_DESCRIPTOR *Map;
+    UINTN MapSize;
+    UINTN DescriptorSize;
+    KASLR_SEARCH Search;
+    EFI_STATUS Status;
+
+    Status = GetMemoryMapCopy(&Map, &MapSize, &DescriptorSize);
+    if (EFI_ERROR(Status)) return Status;
+
+    Search.Min = Config->KaslrMin;
+    Search.Max = Config->KaslrMax;
+    Search.Phase = BaseOffset & (KASLR_ALIGN - 1);
+    Search.Size = TotalSize;
+    Search.Pick = MAX_UINT64;
+    Search.Node = GetLocalNode();
+    KaslrSearch(Map, MapSize, DescriptorSize, &Search);
+    if (Search.Count == 0 && Search.Node) {
+        LogPrint(PXS_LOG_VERBOSE, L"KASLR: No slot in the boot CPU's node, using any");
+        Search.Node = NULL;
+        KaslrSearch(Map, MapSize, DescriptorSize, &Search);
+    }
+    if (Search.Count == 0) {
+        gBS->FreePool(Map);
+        return EFI_NOT_FOUND;
+    }
+
+    UINT64 Slots = Search.Count;
+    Search.Pick = Config->KaslrEnabled ? KaslrUniform(Slots) : 0;
+    KaslrSearch(Map, MapSize, DescriptorSize, &Search);
+    gBS->FreePool(Map);
+
+    *LoadBase = Search.Address;
+    if (Config->KaslrEnabled) {
+        LogPrint(PXS_LOG_VERBOSE, L"KASLR: %ld slots, chose 0x%lx", Slots, *LoadBase);
+    }
+    return EFI_SUCCESS;
+}
+
+// Run address of a relocatable kernel loaded at PhysicalBase. Without loader
+// page tables it runs identity mapped. With them it gets a KASLR_ALIGN slot in
+// [KASLR_VIRT_MIN, KASLR_VIRT_MAX), random unless KASLR is disabled, at the
+// same offset within KASLR_ALIGN as PhysicalBase so large pages still fit.
+EFI_STATUS KaslrChooseVirtualBase(
+    IN PXS_CONFIG *Config,
+    IN UINT64 PhysicalBase,
+    IN UINT64 Size,
+    OUT UINT64 *VirtualBase
+) {
+    if (!Config->PagingEnabled) {
+        *VirtualBase = PhysicalBase;
+        return EFI_SUCCESS;
+    }
+
+    UINT64 Phase = PhysicalBase & (KASLR_ALIGN - 1);
+    UINT64 Window = KASLR_VIRT_MAX - KASLR_VIRT_MIN;
+    if (Size > Window - Phase) return EFI_BAD_BUFFER_SIZE;
+
+    UINT64 Slots = (Window - Phase - Size) / KASLR_ALIGN + 1;
+    UINT64 Pick = Config->KaslrEnabled ? KaslrUniform(Slots) : 0;
+    *VirtualBase = KASLR_VIRT_MIN + Pick * KASLR_ALIGN + Phase;
+    if (Config->KaslrEnabled) {
+        LogPrint(PXS_LOG_VERBOSE, L"KASLR: %ld virtual slots, chose 0x%lx", Slots, *VirtualBase);
+    }
+    return EFI_SUCCESS;
+}
+
+// Allocate the kernel's TotalSize bytes at a KASLR slot, else (when disabled,
+// or if no slot is free) at BaseOffset as linked. A Relocatable kernel is not
+// tied to its link address, so with KASLR disabled it takes the lowest slot.
+EFI_STATUS AllocateKernelPages(
+    IN PXS_CONFIG *Config,
+    IN UINT64 BaseOffset,
+    IN UINT64 TotalSize,
+    IN BOOLEAN Relocatable,
+    OUT EFI_PHYSICAL_ADDRESS *LoadBase
+) {
+    EFI_STATUS Status;
+    UINTN TotalPages = EFI_SIZE_TO_PAGES(TotalSize);
+
+    if (!Config->KaslrEnabled) {
+        LogPrint(PXS_LOG_INFO, L"KASLR: Disabled by config.");
+    }
+    if (Config->KaslrEnabled || Relocatable) {
+        Status = KaslrChooseSlot(Config, BaseOffset, TotalSize, LoadBase);
+        if (!EFI_ERROR(Status)) {
+            Status = gBS->AllocatePages(AllocateAddress, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_KERNEL, TotalPages, LoadBase);
+            if (!EFI_ERROR(Status)) return EFI_SUCCESS;
+        }
+        LogPrint(PXS_LOG_INFO, L"KASLR: No slot for 0x%lx bytes (%r), loading at the linked address", TotalSize, Status);
+    }
+
+    *LoadBase = BaseOffset;
+    return gBS->AllocatePages(AllocateAddress, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_KERNEL, TotalPages, LoadBase);
+}
+
+// Segments are streamed from the file straight into their final pages; only
+// the headers are buffered and only the bytes not backed by the file are zeroed.
+// Compressed kernels are decoded on the fly, so segments are read in file order.
+// The slid segment layout is returned in *Segments (pool, virtual address order).
+// With Digest, the SHA-256 of the kernel file is computed from the same reads.
+// An ET_EXEC kernel slides only physically when the loader maps it, and runs
+// at its linked addresses, unless those fall in the identity map; on the
+// firmware's identity map it runs where it was loaded. An ET_DYN one gets its own virtual base (KaslrChooseVirtualBase) and its RELA and RELR
+// relocations applied in place once loaded.
+EFI_STATUS LoadElfKernel(
+    IN EFI_FILE_HANDLE RootDir,
+    IN PXS_CONFIG *Config,
+    OUT EFI_PHYSICAL_ADDRESS *EntryPoint,
+    OUT UINT64 *KernelBase,
+    OUT UINT64 *KernelSize,
+    OUT UINT64 *KernelSlide,
+    OUT PXS_KERNEL_SEGMENT **Segments,
+    OUT UINTN *SegmentCount,
+    OUT UINT8 *Digest OPTIONAL
+) {
+    EFI_STATUS Status;
+    PXS_STREAM Stream;
+    PXS_SHA256 Hash;
+    UINT64 ImageSize;
+    Elf64_Ehdr Ehdr;
+    Elf64_Phdr *Phdr;
+    UINTN *Order;
+    UINTN *FileOrder;
+    UINTN LoadCount = 0;
+    UINTN DynamicIndex = MAX_UINTN;
+    UINTN i;
+    LogPrint(PXS_LOG_INFO, L"Loading Kernel: %s", Config->KernelPath);
+
+    Status = StreamOpen(RootDir, Config->KernelPath, &Stream);
+    if (EFI_ERROR(Status)) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Could not open kernel file '%s'. %r", Config->KernelPath, Status);
+        return Status;
+    }
+    if (Digest) ReaderStartHash(&Stream.Reader, &Hash);
+
+    *KernelSize = Stream.FileSize;
+
+    // Decoded size of a compressed image is only known once it has been read
+    ImageSize = Stream.FileSize;
+    if (Stream.Format != PXS_COMPRESSION_NONE) {
+        LogPrint(PXS_LOG_VERBOSE, L"Kernel is %s compressed", CompressionName(Stream.Format));
+        ImageSize = MAX_UINT64;
+    }
+
+    // Check ELF Header
+    if (ImageSize < sizeof(Ehdr)) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Kernel file too small");
+        StreamClose(&Stream);
+        return EFI_LOAD_ERROR;
+    }
+    Status = StreamReadAt(&Stream, 0, &Ehdr, sizeof(Ehdr));
+    if (EFI_ERROR(Status)) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Could not read ELF header. %r", Status);
+        StreamClose(&Stream);
+        return Status;
+    }
+
+    if (Ehdr.e_ident[EI_MAG0] != ELFMAG0 ||
+        Ehdr.e_ident[EI_MAG1] != ELFMAG1 ||
+        Ehdr.e_ident[EI_MAG2] != ELFMAG2 ||
+        Ehdr.e_ident[EI_MAG3] != ELFMAG3) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Invalid ELF Magic");
+        StreamClose(&Stream);
+        return EFI_LOAD_ERROR;
+    }
+
+    if (Ehdr.e_ident[EI_CLASS] != ELFCLASS64) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Not 64-bit ELF");
+        StreamClose(&Stream);
+        return EFI_LOAD_ERROR;
+    }
+
+    if (Ehdr.e_type != ET_EXEC && Ehdr.e_type != ET_DYN) {
+        LogPrint(PXS_LOG_ERROR, L"Error: ELF type %d is not executable", Ehdr.e_type);
+        StreamClose(&Stream);
+        return EFI_LOAD_ERROR;
+    }
+    BOOLEAN Relocatable = (Ehdr.e_type == ET_DYN);
+
+    UINT64 PhdrTableSize = (UINT64)Ehdr.e_phnum * sizeof(Elf64_Phdr);
+    if (Ehdr.e_phnum == 0 || Ehdr.e_phentsize != sizeof(Elf64_Phdr) ||
+        Ehdr.e_phoff > ImageSize || PhdrTableSize > ImageSize - Ehdr.e_phoff) {
+        LogPrint(PXS_LOG_ERROR, L"Error: Invalid program header table");
+        StreamClose(&Stream);
+        return EFI_LOAD_ERROR;
+    }
+
+    // Read only the program headers
+    Phdr = AllocatePool(PhdrTableSize);
+    Order = AllocatePool(2 * Ehdr.e_phnum * sizeof(UINTN));
+    if (!Phdr || !Order) {
+        if (Phdr) FreePool(Phdr);
+        if (Order) FreePool(Order);
+        StreamClose(&Stream);
+        return EFI_OUT_OF_RESOURCES;
+    }
+    FileOrder = Order + Ehdr.e_phnum;
+    Status = StreamReadAt(&Stream, Ehdr.e_phoff, Phdr, PhdrTableSize);
+    if (EFI_ERROR(Status)) {
+        goto Done;
+    }
+
+    // Calculate Total Kernel Size (Phys Min to Phys Max)
+    UINT64 MinPhys = 0xFFFFFFFFFFFFFFFF;
+    UINT64 MaxPhys = 0;
+    UINT64 MinVirt = 0xFFFFFFFFFFFFFFFF;
+    UINT64 LinkDelta = 0;                  // p_paddr - p_vaddr, one value for ET_DYN
+
+    for (i = 0; i < Ehdr.e_phnum; i++) {
+        if (Phdr[i].p_type == PT_DYNAMIC) DynamicIndex = i;
+        if (Phdr[i].p_type != PT_LOAD) continue;
+
+        if (Phdr[i].p_filesz > Phdr[i].p_memsz ||
+            Phdr[i].p_offset > ImageSize || Phdr[i].p_filesz > ImageSize - Phdr[i].p_offset) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Segment %d is malformed", i);
+            Status = EFI_LOAD_ERROR;
+            goto Done;
+        }
+        if (Phdr[i].p_paddr < MinPhys) MinPhys = Phdr[i].p_paddr;
+        UINT64 End = Phdr[i].p_paddr + Phdr[i].p_memsz;
+        if (End > MaxPhys) MaxPhys = End;
+        if (Phdr[i].p_vaddr < MinVirt) MinVirt = Phdr[i].p_vaddr;
+
+        // Relocations address the image by link address, so it must load as one block
+        if (LoadCount == 0) LinkDelta = Phdr[i].p_paddr - Phdr[i].p_vaddr;
+        if (Relocatable && Phdr[i].p_paddr - Phdr[i].p_vaddr != LinkDelta) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Segment %d of a relocatable kernel is not at its link offset", i);
+            Status = EFI_LOAD_ERROR;
+            goto Done;
+        }
+
+        // Keep PT_LOAD indices sorted by physical address and by file offset
+        UINTN j = LoadCount;
+        while (j > 0 && Phdr[Order[j - 1]].p_paddr > Phdr[i].p_paddr) {
+            Order[j] = Order[j - 1];
+            j--;
+        }
+        Order[j] = i;
+
+        j = LoadCount++;
+        while (j > 0 && Phdr[FileOrder[j - 1]].p_offset > Phdr[i].p_offset) {
+            FileOrder[j] = FileOrder[j - 1];
+            j--;
+        }
+        FileOrder[j] = i;
+    }
+
+    if (LoadCount == 0) {
+        LogPrint(PXS_LOG_ERROR, L"Error: No loadable segments");
+        Status = EFI_LOAD_ERROR;
+        goto Done;
+    }
+
+    // Align MinPhys down and MaxPhys up to Page Boundaries
+    UINT64 BaseOffset = MinPhys & ~(0xFFF);
+    UINT64 TotalSize = ((MaxPhys - BaseOffset) + 0xFFF) & ~0xFFF;
+    UINTN TotalPages = EFI_SIZE_TO_PAGES(TotalSize);
+    LogPrint(PXS_LOG_VERBOSE, L"Image Size: 0x%lx bytes (%d Pages)", TotalSize, TotalPages);
+
+    // An ET_EXEC kernel linked inside the identity-mapped range cannot run at
+    // its link address from other pages without displacing the identity map
+    // there, so with loader paging it loads exactly where it was linked
+    EFI_PHYSICAL_ADDRESS LoadBase = BaseOffset;
+    if (!Relocatable && Config->PagingEnabled && MinVirt < GetPhysicalTop()) {
+        if (Config->KaslrEnabled) {
+            LogPrint(PXS_LOG_INFO, L"KASLR: Kernel is linked at 0x%lx in the identity map, not sliding it", MinVirt);
+        }
+        Status = gBS->AllocatePages(AllocateAddress, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_KERNEL, TotalPages, &LoadBase);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Linked address 0x%lx of the kernel is not free. %r", BaseOffset, Status);
+        }
+    } else {
+        Status = AllocateKernelPages(Config, BaseOffset, TotalSize, Relocatable, &LoadBase);
+    }
+    if (EFI_ERROR(Status)) {
+        goto Done;
+    }
+    UINT64 Slide = LoadBase - BaseOffset;
+
+    // Zero gaps and BSS tails in address order, then fill segments in file order
+    UINT8 *Cursor = (UINT8 *)LoadBase;
+    UINT8 *Limit = (UINT8 *)(LoadBase + TotalSize);
+    for (UINTN n = 0; n < LoadCount; n++) {
+        Elf64_Phdr *Seg = &Phdr[Order[n]];
+        UINT8 *Dest = (UINT8 *)(Seg->p_paddr + Slide);
+
+        if (Dest + Seg->p_memsz > Limit) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Segment %d exceeds allocated memory", Order[n]);
+            Status = EFI_LOAD_ERROR;
+            break;
+        }
+        if (Dest > Cursor) {
+            BulkSetMem(Cursor, Dest - Cursor, 0);
+        }
+        BulkSetMem(Dest + Seg->p_filesz, Seg->p_memsz - Seg->p_filesz, 0);
+
+        if (Dest + Seg->p_memsz > Cursor) {
+            Cursor = Dest + Seg->p_memsz;
+        }
+    }
+    if (!EFI_ERROR(Status)) {
+        BulkSetMem(Cursor, Limit - Cursor, 0);
+
+        for (UINTN n = 0; n < LoadCount; n++) {
+            Elf64_Phdr *Seg = &Phdr[FileOrder[n]];
+            Status = StreamReadAt(&Stream, Seg->p_offset, (VOID *)(Seg->p_paddr + Slide), Seg->p_filesz);
+            if (EFI_ERROR(Status)) {
+                LogPrint(PXS_LOG_ERROR, L"Error: Could not read segment %d. %r", FileOrder[n], Status);
+                break;
+            }
+        }
+    }
+    if (!EFI_ERROR(Status) && Digest) {
+        Status = ReaderFinishHash(&Stream.Reader, Digest);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Could not hash kernel file. %r", Status);
+        }
+    }
+
+    // LinkBase is the link address of the byte at LoadBase. Loader page tables
+    // map an ET_EXEC kernel at its link addresses whatever the physical slide.
+    UINT64 LinkBase = BaseOffset - LinkDelta;
+    UINT64 VirtualSlide = Config->PagingEnabled ? 0 : Slide;
+    if (!EFI_ERROR(Status) && Relocatable) {
+        UINT64 VirtualBase;
+        Status = KaslrChooseVirtualBase(Config, LoadBase, TotalSize, &VirtualBase);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_ERROR, L"Error: No virtual slot for 0x%lx bytes. %r", TotalSize, Status);
+        } else {
+            VirtualSlide = VirtualBase - LinkBase;
+        }
+    }
+    if (!EFI_ERROR(Status) && Relocatable && DynamicIndex != MAX_UINTN) {
+        UINTN Relocations;
+        Status = ElfRelocate((VOID *)LoadBase, TotalSize, LinkBase, Phdr[DynamicIndex].p_vaddr,
+                             Phdr[DynamicIndex].p_filesz, VirtualSlide, &Relocations);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Could not relocate kernel. %r", Status);
+        } else {
+            LogPrint(PXS_LOG_VERBOSE, L"Relocated %d words to run at 0x%lx", Relocations, LinkBase + VirtualSlide);
+        }
+    }
+    if (EFI_ERROR(Status)) {
+        gBS->FreePages(LoadBase, TotalPages);
+        goto Done;
+    }
+
+    PXS_KERNEL_SEGMENT *Layout = AllocatePool(LoadCount * sizeof(PXS_KERNEL_SEGMENT));
+    if (!Layout) {
+        gBS->FreePages(LoadBase, TotalPages);
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+    }
+    for (UINTN n = 0; n < LoadCount; n++) {
+        Elf64_Phdr *Seg = &Phdr[Order[n]];
+        UINTN j = n;
+        while (j > 0 && Layout[j - 1].VirtualAddress > Seg->p_vaddr + VirtualSlide) {
+            Layout[j] = Layout[j - 1];
+            j--;
+        }
+        Layout[j].VirtualAddress = Seg->p_vaddr + VirtualSlide;
+        Layout[j].PhysicalAddress = Seg->p_paddr + Slide;
+        Layout[j].MemorySize = Seg->p_memsz;
+        Layout[j].Flags = Seg->p_flags;
+    }
+
+    *EntryPoint = Ehdr.e_entry + VirtualSlide;
+    *KernelBase = LoadBase;
+    *KernelSlide = Relocatable ? LinkBase + VirtualSlide : Config->KvBase + VirtualSlide;
+    *Segments = Layout;
+    *SegmentCount = LoadCount;
+
+Done:
+    FreePool(Order);
+    FreePool(Phdr);
+    StreamClose(&Stream);
+    return Status;
+}
+
+// --------------------------------------------------------------------------
+// INITRD INDEX
+// --------------------------------------------------------------------------
+
+// Walk a newc initrd once and publish its sorted path index, so the kernel and
+// early userspace can binary search instead of rescanning the archive.
+PXS_INITRD_INDEX* BuildInitrdIndex(IN VOID *Initrd, IN UINT64 Size) {
+    EFI_STATUS Status;
+    PXS_INITRD_INDEX *Index;
+    UINT32 Count;
+
+    Status = CpioBuildIndex(Initrd, Size, NULL, 0, &Count);
+    if (EFI_ERROR(Status)) {
+        if (Status != EFI_UNSUPPORTED) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Initrd archive is malformed, no index. %r", Status);
+        }
+        return NULL;
+    }
+
+    UINTN IndexSize = sizeof(PXS_INITRD_INDEX) + (UINTN)Count * sizeof(PXS_INITRD_FILE);
+    Status = gBS->AllocatePool(EfiLoaderData, IndexSize, (VOID **)&Index);
+    if (EFI_ERROR(Status)) return NULL;
+
+    Index->Version = PXS_INITRD_INDEX_VERSION;
+    Index->Entries = (PXS_INITRD_FILE *)(Index + 1);
+    Status = CpioBuildIndex(Initrd, Size, Index->Entries, Count, &Index->EntryCount);
+    if (EFI_ERROR(Status)) {
+        gBS->FreePool(Index);
+        return NULL;
+    }
+
+    LogPrint(PXS_LOG_VERBOSE, L"Initrd Index: %d entries", Index->EntryCount);
+    return Index;
+}
+
+// --------------------------------------------------------------------------
+// MODULES
+// --------------------------------------------------------------------------
+
+// Place each MODULE= file in its own aligned pages so the kernel can map it in
+// place. A module that fails to load is reported and left out of the table.
+PXS_MODULE_TABLE* LoadModules(IN EFI_FILE_HANDLE RootDir, IN PXS_CONFIG *Config) {
+    EFI_STATUS Status;
+    PXS_MODULE_TABLE *Table;
+
+    UINTN TableSize = sizeof(PXS_MODULE_TABLE) + Config->ModuleCount * sizeof(PXS_MODULE);
+    Status = gBS->AllocatePool(EfiLoaderData, TableSize, (VOID **)&Table);
+    if (EFI_ERROR(Status)) return NULL;
+    SetMem(Table, TableSize, 0);
+    Table->Version = PXS_MODULE_TABLE_VERSION;
+    Table->Modules = (PXS_MODULE *)(Table + 1);
+
+    for (UINTN i = 0; i < Config->ModuleCount; i++) {
+        PXS_MODULE_CONFIG *Module = &Config->Modules[i];
+        PXS_MODULE *Entry = &Table->Modules[Table->ModuleCount];
+        VOID *Buffer;
+        UINT64 Size;
+
+        LogPrint(PXS_LOG_INFO, L"Loading Module: %s", Module->Path);
+        Status = LoadImageFile(RootDir, Module->Path, Module->Alignment, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_MODULE,
+                               &Buffer, &Size, NULL);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Failed to load module '%s'. %r", Module->Path, Status);
+            continue;
+        }
+
+        Entry->Address = (UINT64)Buffer;
+        Entry->Size = Size;
+        Entry->Alignment = Module->Alignment;
+        CopyMem(Entry->Name, Module->Name, PXS_MODULE_NAME_SIZE);
+        Table->ModuleCount++;
+        LogPrint(PXS_LOG_VERBOSE, L"Module '%a' @ 0x%lx (Size: %ld bytes, Align: 0x%lx)", Entry->Name, Entry->Address, Entry->Size, Entry->Alignment);
+    }
+    return Table;
+}
+
+// --------------------------------------------------------------------------
+// GRAPHICS
+// --------------------------------------------------------------------------
+
+#define FB_CACHE_ATTRIBUTES (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB | EFI_MEMORY_UCE)
+
+// RESOLUTION= picks that exact mode. Otherwise, or if no mode matches, the
+// largest mode within MAXRES= (or within RESOLUTION=) is used. Modes without a
+// linear framebuffer are skipped, and the firmware mode is kept when nothing
+// fits, so a bad value never costs the console.
+VOID GraphicsSelectMode(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, IN PXS_CONFIG *Config) {
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
+    UINTN InfoSize;
+    EFI_STATUS Status;
+
+    if (Config->ResolutionWidth == 0 && Config->MaxResWidth == 0) return;
+
+    UINT32 LimitWidth = Config->MaxResWidth ? Config->MaxResWidth : Config->ResolutionWidth;
+    UINT32 LimitHeight = Config->MaxResWidth ? Config->MaxResHeight : Config->ResolutionHeight;
+    UINT32 Best = Gop->Mode->Mode;
+    UINT64 BestArea = 0;
+    BOOLEAN Exact = FALSE;
+
+    // Some firmware only answers QueryMode once a mode has been set
+    Status = Gop->QueryMode(Gop, Gop->Mode->Mode, &InfoSize, &Info);
+    if (Status == EFI_NOT_STARTED) {
+        Gop->SetMode(Gop, Gop->Mode->Mode);
+    } else if (!EFI_ERROR(Status)) {
+        FreePool(Info);
+    }
+
+    for (UINT32 Mode = 0; Mode < Gop->Mode->MaxMode && !Exact; Mode++) {
+        Status = Gop->QueryMode(Gop, Mode, &InfoSize, &Info);
+        if (EFI_ERROR(Status)) continue;
+
+        UINT32 Width = Info->HorizontalResolution;
+        UINT32 Height = Info->VerticalResolution;
+        BOOLEAN Linear = Info->PixelFormat != PixelBltOnly;
+        FreePool(Info);
+        if (!Linear) continue;
+
+        if (Width == Config->ResolutionWidth && Height == Config->ResolutionHeight) {
+            Best = Mode;
+            Exact = TRUE;
+        } else if (Width <= LimitWidth && Height <= LimitHeight && (UINT64)Width * Height > BestArea) {
+            Best = Mode;
+            BestArea = (UINT64)Width * Height;
+        }
+    }
+
+    if (!Exact && BestArea == 0) {
+        LogPrint(PXS_LOG_WARNING, L"Warning: No graphics mode within %dx%d, keeping the current one", LimitWidth, LimitHeight);
+        return;
+    }
+    if (Best == Gop->Mode->Mode) return;
+
+    Status = Gop->SetMode(Gop, Best);
+    if (EFI_ERROR(Status)) {
+        LogPrint(PXS_LOG_WARNING, L"Warning: Could not set graphics mode %d. %r", Best, Status);
+    }
+}
+
+// Position and width of the lowest run of set bits in Mask
+VOID GraphicsMaskField(IN UINT32 Mask, OUT UINT8 *Position, OUT UINT8 *Size) {
+    *Position = 0;
+    *Size = 0;
+    if (Mask == 0) return;
+    while (!(Mask & 1)) {
+        Mask >>= 1;
+        (*Position)++;
+    }
+    while (Mask & 1) {
+        Mask >>= 1;
+        (*Size)++;
+    }
+}
 
-    if (EFI_ERROR(Status)) {
-        FreePool(FileBuffer);
-        return Status;
+// Framebuffer description of the current mode, all zero for a Blt-only mode
+VOID GraphicsFramebufferInfo(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *Gop, OUT PXS_FRAMEBUFFER_INFO *Fb) {
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info = Gop->Mode->Info;
+    EFI_PIXEL_BITMASK Masks;
+
+    SetMem(Fb, sizeof(*Fb), 0);
+    switch (Info->PixelFormat) {
+        case PixelRedGreenBlueReserved8BitPerColor:
+            Masks.RedMask = 0x000000FF;
+            Masks.GreenMask = 0x0000FF00;
+            Masks.BlueMask = 0x00FF0000;
+            Masks.ReservedMask = 0xFF000000;
+            break;
+        case PixelBlueGreenRedReserved8BitPerColor:
+            Masks.RedMask = 0x00FF0000;
+            Masks.GreenMask = 0x0000FF00;
+            Masks.BlueMask = 0x000000FF;
+            Masks.ReservedMask = 0xFF000000;
+            break;
+        case PixelBitMask:
+            Masks = Info->PixelInformation;
+            break;
+        default:
+            LogPrint(PXS_LOG_WARNING, L"Warning: Graphics mode has no linear framebuffer");
+            return;
     }
 
-    *Buffer = FileBuffer;
-    *Size = FileSize;
-    return EFI_SUCCESS;
+    Fb->BaseAddress = Gop->Mode->FrameBufferBase;
+    Fb->Size = Gop->Mode->FrameBufferSize;
+    Fb->Width = Info->HorizontalResolution;
+    Fb->Height = Info->VerticalResolution;
+    Fb->PixelsPerScanLine = Info->PixelsPerScanLine;
+    GraphicsMaskField(Masks.RedMask, &Fb->RedFieldPosition, &Fb->RedMaskSize);
+    GraphicsMaskField(Masks.GreenMask, &Fb->GreenFieldPosition, &Fb->GreenMaskSize);
+    GraphicsMaskField(Masks.BlueMask, &Fb->BlueFieldPosition, &Fb->BlueMaskSize);
+    GraphicsMaskField(Masks.ReservedMask, &Fb->ReservedFieldPosition, &Fb->ReservedMaskSize);
 }
 
-UINT64 GetBestEntropy() {
+UINT8 GraphicsCacheType(IN UINT64 Attributes) {
+    if (Attributes & EFI_MEMORY_WC) return PXS_FRAMEBUFFER_CACHE_WC;
+    if (Attributes & EFI_MEMORY_WB) return PXS_FRAMEBUFFER_CACHE_WB;
+    if (Attributes & EFI_MEMORY_WT) return PXS_FRAMEBUFFER_CACHE_WT;
+    if (Attributes & (EFI_MEMORY_UC | EFI_MEMORY_UCE)) return PXS_FRAMEBUFFER_CACHE_UC;
+    return PXS_FRAMEBUFFER_CACHE_UNKNOWN;
+}
+
+// Firmware usually leaves the framebuffer uncached. Ask it, through the GCD,
+// to make the range write-combining; on x86 that is an MTRR change it applies
+// to every CPU, and it also speeds up the loader's own console. Returns the
+// cache type the range has afterwards, as far as the GCD knows.
+UINT8 GraphicsWriteCombine(IN UINT64 Base, IN UINT64 Size) {
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR Desc;
     EFI_STATUS Status;
-    UINT64 Seed = 0;
 
-    // 1. Try UEFI RNG Protocol
-    EFI_RNG_PROTOCOL *Rng;
-    Status = gBS->LocateProtocol(&gEfiRngProtocolGuid, NULL, (VOID **)&Rng);
-    if (!EFI_ERROR(Status)) {
-        Status = Rng->GetRNG(Rng, NULL, sizeof(Seed), (UINT8*)&Seed);
-        if (!EFI_ERROR(Status) && Seed != 0) {
-            return Seed;
-        }
+    if (gDS == NULL || Size == 0) return PXS_FRAMEBUFFER_CACHE_UNKNOWN;
+    Status = gDS->GetMemorySpaceDescriptor(Base, &Desc);
+    if (EFI_ERROR(Status)) return PXS_FRAMEBUFFER_CACHE_UNKNOWN;
+    if ((Desc.Attributes & FB_CACHE_ATTRIBUTES) == EFI_MEMORY_WC) return PXS_FRAMEBUFFER_CACHE_WC;
+
+    if (Desc.Capabilities & EFI_MEMORY_WC) {
+        UINT64 Attributes = (Desc.Attributes & ~(UINT64)FB_CACHE_ATTRIBUTES) | EFI_MEMORY_WC;
+        Status = gDS->SetMemorySpaceAttributes(Base & ~(UINT64)EFI_PAGE_MASK,
+                                               ALIGN_VALUE(Size + (Base & EFI_PAGE_MASK), EFI_PAGE_SIZE), Attributes);
+        if (!EFI_ERROR(Status)) return PXS_FRAMEBUFFER_CACHE_WC;
+        LogPrint(PXS_LOG_WARNING, L"Warning: Could not make the framebuffer write-combining. %r", Status);
     }
+    return GraphicsCacheType(Desc.Attributes);
+}
 
-    // 2. Try RDRAND (Hardware Instruction)
-    UINT32 Eax, Ecx, Edx;
-    // CPUID Leaf 1, ECX[30] = RDRAND
-    // Preserve RBX as it is callee-saved and used by PIC
-    __asm__ __volatile__ (
-        "pushq %%rbx\n\t"
-        "cpuid\n\t"
-        "popq %%rbx"
-        : "=a" (Eax), "=c" (Ecx), "=d" (Edx)
-        : "a" (1)
-        : "cc"
-    );
+// --------------------------------------------------------------------------
+// FIRMWARE TABLES
+// --------------------------------------------------------------------------
 
-    if (Ecx & (1 << 30)) {
-        UINT8 Success = 0;
-        // Retry loop for RDRAND underflow
-        for (int i = 0; i < 10; i++) {
-            __asm__ __volatile__ (
-                "rdrand %0; setc %1"
-                : "=r" (Seed), "=qm" (Success)
-            );
-            if (Success && Seed != 0) return Seed;
-        }
+// Index the ACPI tables and SMBIOS structures once, so the kernel does not
+// have to walk them. The SMBIOS 3 entry point is preferred, as it can reach
+// tables above 4 GiB. NULL when neither can be indexed.
+PXS_FIRMWARE_TABLES* BuildFirmwareTables(IN VOID *Rsdp, IN VOID *Smbios3, IN VOID *Smbios) {
+    EFI_STATUS Status;
+    PXS_FIRMWARE_TABLES *Tables;
+    PXS_SMBIOS_TABLE SmbiosTable;
+    UINT32 AcpiCount = 0, SmbiosCount = 0;
+
+    if (EFI_ERROR(AcpiBuildIndex(Rsdp, NULL, 0, &AcpiCount))) AcpiCount = 0;
+    BOOLEAN HasSmbios = SmbiosParseEntryPoint(Smbios3, &SmbiosTable) || SmbiosParseEntryPoint(Smbios, &SmbiosTable);
+    if (HasSmbios) SmbiosBuildIndex(&SmbiosTable, NULL, 0, &SmbiosCount);
+    if (AcpiCount == 0 && SmbiosCount == 0) return NULL;
+
+    UINTN AcpiBytes = (UINTN)AcpiCount * sizeof(PXS_ACPI_TABLE);
+    UINTN TablesSize = sizeof(PXS_FIRMWARE_TABLES) + AcpiBytes + (UINTN)SmbiosCount * sizeof(PXS_SMBIOS_STRUCTURE);
+    Status = gBS->AllocatePool(EfiLoaderData, TablesSize, (VOID **)&Tables);
+    if (EFI_ERROR(Status)) return NULL;
+    SetMem(Tables, sizeof(PXS_FIRMWARE_TABLES), 0);
+    Tables->Version = PXS_FIRMWARE_TABLES_VERSION;
+    Tables->Acpi = (PXS_ACPI_TABLE *)(Tables + 1);
+    Tables->Smbios = (PXS_SMBIOS_STRUCTURE *)((UINT8 *)Tables->Acpi + AcpiBytes);
+
+    if (AcpiCount > 0 && EFI_ERROR(AcpiBuildIndex(Rsdp, Tables->Acpi, AcpiCount, &Tables->AcpiCount))) {
+        Tables->AcpiCount = 0;
+    }
+    if (SmbiosCount > 0 && !EFI_ERROR(SmbiosBuildIndex(&SmbiosTable, Tables->Smbios, SmbiosCount, &Tables->SmbiosCount))) {
+        Tables->SmbiosMajor = SmbiosTable.Major;
+        Tables->SmbiosMinor = SmbiosTable.Minor;
+        Tables->SmbiosEntryPoint = SmbiosTable.EntryPoint;
     }
 
-    // 3. Fallback: Mix Time and TSC
-    EFI_TIME Time;
-    gST->RuntimeServices->GetTime(&Time, NULL);
+    UINT32 BadChecksums = 0;
+    for (UINT32 i = 0; i < Tables->AcpiCount; i++) {
+        if (Tables->Acpi[i].Flags & PXS_ACPI_TABLE_BAD_CHECKSUM) BadChecksums++;
+    }
+    if (BadChecksums > 0) {
+        LogPrint(PXS_LOG_WARNING, L"Warning: %d ACPI tables fail their checksum", BadChecksums);
+    }
+    LogPrint(PXS_LOG_VERBOSE, L"Firmware tables: %d ACPI, %d SMBIOS %d.%d structures",
+             Tables->AcpiCount, Tables->SmbiosCount, Tables->SmbiosMajor, Tables->SmbiosMinor);
+    return Tables;
+}
 
-    Seed = __builtin_ia32_rdtsc();
-    Seed ^= ((UINT64)Time.Nanosecond << 32);
-    Seed ^= ((UINT64)Time.Year << 16) | ((UINT64)Time.Month << 8) | Time.Day;
-    Seed ^= ((UINT64)Time.Hour << 24) | ((UINT64)Time.Minute << 16) | ((UINT64)Time.Second << 8);
+// --------------------------------------------------------------------------
+// PAGING
+// --------------------------------------------------------------------------
 
-    // Simple mixing step (XOR-shift style)
-    Seed ^= (Seed << 13);
-    Seed ^= (Seed >> 7);
-    Seed ^= (Seed << 17);
+#define PXS_DIRECT_MAP_BASE_4 0xFFFF800000000000ULL
+#define PXS_DIRECT_MAP_BASE_5 0xFF00000000000000ULL
 
-    return Seed;
+UINT32 SegmentAttributes(UINT32 Flags) {
+    UINT32 Attributes = 0;
+    if (Flags & PF_W) Attributes |= PXS_MAP_WRITE;
+    if (Flags & PF_X) Attributes |= PXS_MAP_EXEC;
+    return Attributes;
 }
 
-// Simple config parser
-// Format: KEY=VALUE
-// KERNEL=path
-// INITRD=path
-// CMDLINE=string
-VOID LoadConfig(
-    IN EFI_FILE_HANDLE RootDir,
-    IN CHAR16 *ConfigName,
-    OUT PXS_CONFIG *Config
+// Page table batches, in the boot CPU's node if it has room
+EFI_STATUS AllocateTablePages(IN UINTN Pages, OUT EFI_PHYSICAL_ADDRESS *Address) {
+    return AllocateAlignedPages(Pages, EFI_PAGE_SIZE, EfiLoaderData, Address);
+}
+
+// RAM as the firmware describes it: anything but MMIO, except reserved and
+// unusable ranges that are not write-back capable
+BOOLEAN IsWriteBackMemory(IN CONST EFI_MEMORY_DESCRIPTOR *Desc) {
+    switch (Desc->Type) {
+        case EfiMemoryMappedIO:
+        case EfiMemoryMappedIOPortSpace:
+            return FALSE;
+        case EfiReservedMemoryType:
+        case EfiUnusableMemory:
+            return (Desc->Attribute & EFI_MEMORY_WB) != 0;
+        default:
+            return TRUE;
+    }
+}
+
+// Write-back RAM in both the identity and the direct map, never executable
+EFI_STATUS MapWriteBack(IN OUT PXS_PAGE_TABLES *Tables, IN UINT64 DirectBase, IN UINT64 Base, IN UINT64 Size) {
+    EFI_STATUS Status = PagingMap(Tables, Base, Base, Size, PXS_MAP_WRITE);
+    if (EFI_ERROR(Status)) return Status;
+    return PagingMap(Tables, DirectBase + Base, Base, Size, PXS_MAP_WRITE | PXS_MAP_GLOBAL);
+}
+
+// Identity map physical memory up to Top (the loader keeps running on it until
+// the jump) and add a higher-half direct map of the same range: RAM write-back,
+// the rest uncached, all of it no-execute except the loader's own image. Then
+// map every kernel segment at its linked address with permissions from p_flags.
+EFI_STATUS BuildPageTables(
+    IN PXS_KERNEL_SEGMENT *Segments,
+    IN UINTN SegmentCount,
+    IN CONST EFI_LOADED_IMAGE_PROTOCOL *LoadedImage,
+    IN OUT PXS_BOOT_INFO *BootInfo,
+    OUT PXS_PAGE_TABLES *Tables
 ) {
     EFI_STATUS Status;
-    VOID *Buffer;
-    UINT64 Size;
-    CHAR8 *AsciiBuffer;
+    UINT64 Top = GetPhysicalTop();
+
+    // A segment inside the identity range must be identity mapped itself, or
+    // it would replace mappings the loader and firmware still run on
+    for (UINTN i = 0; i < SegmentCount; i++) {
+        PXS_KERNEL_SEGMENT *Seg = &Segments[i];
+        if (Seg->MemorySize > 0 && Seg->VirtualAddress < Top && Seg->VirtualAddress != Seg->PhysicalAddress) {
+            LogPrint(PXS_LOG_ERROR, L"Error: Kernel segment at 0x%lx overlaps the identity map", Seg->VirtualAddress);
+            return EFI_UNSUPPORTED;
+        }
+    }
 
-    // Set defaults
-    StrCpyS(Config->KernelPath, 256, DEFAULT_KERNEL_PATH);
-    Config->InitrdPath[0] = L'\0';
-    Config->CmdLine[0] = '\0';
-    Config->Timeout = 3;
-    Config->KvBase = 0;
-    Config->KaslrEnabled = TRUE;
+    Status = PagingInit(Tables, AllocateTablePages);
+    if (EFI_ERROR(Status)) return Status;
 
-    Status = LoadFile(RootDir, ConfigName, &Buffer, &Size);
-    if (EFI_ERROR(Status)) {
-        Print(L"Config '%s' not found. Using defaults.\n", ConfigName);
-        return;
-    }
+    UINT64 DirectBase = (Tables->Levels == 5) ? PXS_DIRECT_MAP_BASE_5 : PXS_DIRECT_MAP_BASE_4;
+
+    Status = PagingMap(Tables, 0, 0, Top, PXS_MAP_WRITE | PXS_MAP_UC);
+    if (EFI_ERROR(Status)) return Status;
+    Status = PagingMap(Tables, DirectBase, 0, Top, PXS_MAP_WRITE | PXS_MAP_UC | PXS_MAP_GLOBAL);
+    if (EFI_ERROR(Status)) return Status;
 
-    AsciiBuffer = (CHAR8*)Buffer;
-    UINTN Start = 0;
-    UINTN End = 0;
+    // RAM over the uncached base, touching descriptors as one run
+    EFI_MEMORY_DESCRIPTOR *Map;
+    UINTN MapSize;
+    UINTN DescriptorSize;
+    UINT64 RunStart = 0;
+    UINT64 RunEnd = 0;
 
-    while (End < Size) {
-        // Find end of line
-        while (End < Size && AsciiBuffer[End] != '\n' && AsciiBuffer[End] != '\r') {
-            End++;
+    Status = GetMemoryMapCopy(&Map, &MapSize, &DescriptorSize);
+    if (EFI_ERROR(Status)) return Status;
+    for (UINTN Offset = 0; Offset < MapSize && !EFI_ERROR(Status); Offset += DescriptorSize) {
+        CONST EFI_MEMORY_DESCRIPTOR *Desc = (CONST EFI_MEMORY_DESCRIPTOR *)((CONST UINT8 *)Map + Offset);
+        if (!IsWriteBackMemory(Desc) || Desc->PhysicalStart >= Top) continue;
+        UINT64 End = MIN(Desc->PhysicalStart + EFI_PAGES_TO_SIZE(Desc->NumberOfPages), Top);
+        if (Desc->PhysicalStart != RunEnd) {
+            if (RunEnd > RunStart) Status = MapWriteBack(Tables, DirectBase, RunStart, RunEnd - RunStart);
+            RunStart = Desc->PhysicalStart;
         }
+        RunEnd = End;
+    }
+    gBS->FreePool(Map);
+    if (!EFI_ERROR(Status) && RunEnd > RunStart) {
+        Status = MapWriteBack(Tables, DirectBase, RunStart, RunEnd - RunStart);
+    }
+    if (EFI_ERROR(Status)) return Status;
 
-        // Process line [Start, End)
-        if (End > Start) {
-            // Skip leading whitespace
-            while (Start < End && (AsciiBuffer[Start] == ' ' || AsciiBuffer[Start] == '\t')) {
-                Start++;
-            }
+    // The loader runs from the identity map up to the kernel entry call
+    UINT64 ImageBase = (UINT64)(UINTN)LoadedImage->ImageBase;
+    Status = PagingMap(Tables, ImageBase, ImageBase, LoadedImage->ImageSize, PXS_MAP_WRITE | PXS_MAP_EXEC);
+    if (EFI_ERROR(Status)) return Status;
 
-            // Check for KERNEL=
-            if (AsciiStrnCmp(&AsciiBuffer[Start], "KERNEL=", 7) == 0) {
-                UINTN ValStart = Start + 7;
-                UINTN ValLen = End - ValStart;
-                // Convert to CHAR16
-                for (UINTN i=0; i < ValLen && i < 255; i++) {
-                    Config->KernelPath[i] = (CHAR16)AsciiBuffer[ValStart + i];
-                }
-                Config->KernelPath[ValLen < 255 ? ValLen : 255] = L'\0';
-            }
-            // Check for INITRD=
-            else if (AsciiStrnCmp(&AsciiBuffer[Start], "INITRD=", 7) == 0) {
-                UINTN ValStart = Start + 7;
-                UINTN ValLen = End - ValStart;
-                for (UINTN i=0; i < ValLen && i < 255; i++) {
-                    Config->InitrdPath[i] = (CHAR16)AsciiBuffer[ValStart + i];
-                }
-                Config->InitrdPath[ValLen < 255 ? ValLen : 255] = L'\0';
-            }
-            // Check for CMDLINE=
-            else if (AsciiStrnCmp(&AsciiBuffer[Start], "CMDLINE=", 8) == 0) {
-                UINTN ValStart = Start + 8;
-                UINTN ValLen = End - ValStart;
-                for (UINTN i=0; i < ValLen && i < 511; i++) {
-                    Config->CmdLine[i] = AsciiBuffer[ValStart + i];
-                }
-                UINTN MaxLen = (ValLen < 511) ? ValLen : 511;
-                Config->CmdLine[MaxLen] = '\0';
-            }
-            // Check for TIMEOUT=
-            else if (AsciiStrnCmp(&AsciiBuffer[Start], "TIMEOUT=", 8) == 0) {
-                UINTN ValStart = Start + 8;
-                UINTN ValLen = End - ValStart;
-                UINTN TimeoutVal = 0;
-                for (UINTN i = 0; i < ValLen; i++) {
-                    CHAR8 c = AsciiBuffer[ValStart + i];
-                    if (c >= '0' && c <= '9') {
-                        TimeoutVal = TimeoutVal * 10 + (c - '0');
-                    } else {
-                        break; // Stop at non-digit
-                    }
-                }
-                Config->Timeout = TimeoutVal;
-            }
-            // Check for KVBASE=
-            else if (AsciiStrnCmp(&AsciiBuffer[Start], "KVBASE=", 7) == 0) {
-                UINTN ValStart = Start + 7;
-                UINTN ValLen = End - ValStart;
-                UINT64 BaseVal = 0;
-                // Skip potential 0x prefix
-                if (ValLen >= 2 && AsciiBuffer[ValStart] == '0' && (AsciiBuffer[ValStart+1] == 'x' || AsciiBuffer[ValStart+1] == 'X')) {
-                    ValStart += 2;
-                    ValLen -= 2;
-                }
-                for (UINTN i = 0; i < ValLen; i++) {
-                    CHAR8 c = AsciiBuffer[ValStart + i];
-                    if (c >= '0' && c <= '9') {
-                        BaseVal = (BaseVal << 4) | (c - '0');
-                    } else if (c >= 'a' && c <= 'f') {
-                        BaseVal = (BaseVal << 4) | (c - 'a' + 10);
-                    } else if (c >= 'A' && c <= 'F') {
-                        BaseVal = (BaseVal << 4) | (c - 'A' + 10);
-                    } else {
-                        break;
-                    }
-                }
-                Config->KvBase = BaseVal;
-            }
-            // Check for KASLR=
-            else if (AsciiStrnCmp(&AsciiBuffer[Start], "KASLR=", 6) == 0) {
-                UINTN ValStart = Start + 6;
-                // Check for 0 or FALSE
-                if (AsciiBuffer[ValStart] == '0') {
-                    Config->KaslrEnabled = FALSE;
-                } else if (AsciiStrnCmp(&AsciiBuffer[ValStart], "FALSE", 5) == 0) {
-                    Config->KaslrEnabled = FALSE;
-                }
-            }
-        }
+    // The framebuffer gets its own write-combining mappings, also where it
+    // falls below Top (the usual MMIO hole below 4 GiB)
+    UINT64 FbBase = BootInfo->Framebuffer.BaseAddress;
+    UINT64 FbSize = BootInfo->Framebuffer.Size;
+    if (FbSize > 0) {
+        Status = PagingMap(Tables, FbBase, FbBase, FbSize, PXS_MAP_WRITE | PXS_MAP_WC);
+        if (EFI_ERROR(Status)) return Status;
+        Status = PagingMap(Tables, DirectBase + FbBase, FbBase, FbSize, PXS_MAP_WRITE | PXS_MAP_WC | PXS_MAP_GLOBAL);
+        if (EFI_ERROR(Status)) return Status;
+        if (Tables->PatSupported) BootInfo->Framebuffer.CacheType = PXS_FRAMEBUFFER_CACHE_WC;
+    }
 
-        // Skip newline chars
-        while (End < Size && (AsciiBuffer[End] == '\n' || AsciiBuffer[End] == '\r')) {
-            End++;
+    // Kernel last so it overrides the RAM mappings. Segments are in virtual
+    // order; a page shared by two segments gets the union of their permissions.
+    UINT64 PrevEnd = 0;
+    UINT32 PrevAttributes = 0;
+    for (UINTN i = 0; i < SegmentCount; i++) {
+        PXS_KERNEL_SEGMENT *Seg = &Segments[i];
+        if (Seg->MemorySize == 0) continue;
+        UINT32 Attributes = SegmentAttributes(Seg->Flags);
+
+        Status = PagingMap(Tables, Seg->VirtualAddress, Seg->PhysicalAddress, Seg->MemorySize, Attributes | PXS_MAP_GLOBAL);
+        if (EFI_ERROR(Status)) return Status;
+
+        UINT64 FirstPage = Seg->VirtualAddress & ~(UINT64)EFI_PAGE_MASK;
+        if (i > 0 && PrevEnd > FirstPage) {
+            Status = PagingMap(Tables, FirstPage, Seg->PhysicalAddress & ~(UINT64)EFI_PAGE_MASK, EFI_PAGE_SIZE,
+                               Attributes | PrevAttributes | PXS_MAP_GLOBAL | PXS_MAP_NO_LARGE);
+            if (EFI_ERROR(Status)) return Status;
         }
-        Start = End;
+        PrevEnd = Seg->VirtualAddress + Seg->MemorySize;
+        PrevAttributes = Attributes;
     }
-    SetMem(Buffer, Size, 0); // Secure wipe
-    FreePool(Buffer);
-    Print(L"Config Loaded: Kernel=%s, KASLR=%s\n", Config->KernelPath, Config->KaslrEnabled ? L"ON" : L"OFF");
-    if (Config->CmdLine[0] != '\0') {
-        Print(L"CmdLine: %a\n", Config->CmdLine);
-    }
-}
 
+    BootInfo->PageTableRoot = Tables->Root;
+    BootInfo->DirectMapBase = DirectBase;
+    BootInfo->DirectMapSize = Top;
+    BootInfo->PagingLevels = Tables->Levels;
+    LogPrint(PXS_LOG_VERBOSE, L"Paging: %d-level, direct map 0x%lx (0x%lx bytes), %d table pages",
+             Tables->Levels, DirectBase, Top, Tables->TablePages);
+    return EFI_SUCCESS;
+}
 
 // --------------------------------------------------------------------------
-// ELF LOADER
+// HANDOFF ARENA
 // --------------------------------------------------------------------------
 
-EFI_STATUS LoadElfKernel(
-    IN EFI_FILE_HANDLE RootDir,
-    IN PXS_CONFIG *Config,
-    OUT EFI_PHYSICAL_ADDRESS *EntryPoint,
-    OUT UINT64 *KernelBase,
-    OUT UINT64 *KernelSize,
-    OUT UINT64 *KernelSlide
-) {
-    EFI_STATUS Status;
-    UINT64 FileSize;
-    VOID *FileBuffer;
-    Elf64_Ehdr *Ehdr;
-    Elf64_Phdr *Phdr;
-    UINTN i;
-    Print(L"Loading Kernel: %s\n", Config->KernelPath);
+// Boot info and everything it points to (command line, timing, initrd index,
+// module table and both memory maps) are handed over in one page-aligned block
+// of type PXS_EFI_MEMORY_HANDOFF, boot info first, in the boot CPU's node when
+// there is one. They are built in pool while
+// loading and packed once the memory map size is known, so the kernel can
+// reclaim the whole block in one step after reading it.
 
-    Status = LoadFile(RootDir, Config->KernelPath, &FileBuffer, &FileSize);
-    if (EFI_ERROR(Status)) {
-        Print(L"Error: Could not open kernel file '%s'. %r\n", Config->KernelPath, Status);
-        return Status;
-    }
+#define HANDOFF_ALIGN 16
 
-    *KernelSize = FileSize;
+VOID *HandoffAlloc(IN OUT UINT8 **Cursor, IN UINTN Size) {
+    VOID *Block = *Cursor;
+    *Cursor += ALIGN_VALUE(Size, HANDOFF_ALIGN);
+    return Block;
+}
 
-    // Check ELF Header
-    Ehdr = (Elf64_Ehdr *)FileBuffer;
-    if (Ehdr->e_ident[EI_MAG0] != ELFMAG0 ||
-        Ehdr->e_ident[EI_MAG1] != ELFMAG1 ||
-        Ehdr->e_ident[EI_MAG2] != ELFMAG2 ||
-        Ehdr->e_ident[EI_MAG3] != ELFMAG3) {
-        Print(L"Error: Invalid ELF Magic\n");
-        FreePool(FileBuffer);
-        return EFI_LOAD_ERROR;
-    }
+UINTN HandoffSize(IN CONST PXS_BOOT_INFO *Source, IN UINTN MapCapacity, IN UINTN NormalizedCapacity) {
+    UINTN Size = ALIGN_VALUE(sizeof(PXS_BOOT_INFO), HANDOFF_ALIGN);
 
-    if (Ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
-        Print(L"Error: Not 64-bit ELF\n");
-        FreePool(FileBuffer);
-        return EFI_LOAD_ERROR;
+    if (Source->CommandLine) {
+        Size += ALIGN_VALUE(AsciiStrSize(Source->CommandLine), HANDOFF_ALIGN);
     }
-
-    // Calculate Total Kernel Size (Phys Min to Phys Max)
-    Phdr = (Elf64_Phdr *)((UINT8 *)FileBuffer + Ehdr->e_phoff);
-    UINT64 MinPhys = 0xFFFFFFFFFFFFFFFF;
-    UINT64 MaxPhys = 0;
-
-    for (i = 0; i < Ehdr->e_phnum; i++) {
-        if (Phdr[i].p_type == PT_LOAD) {
-            if (Phdr[i].p_paddr < MinPhys) MinPhys = Phdr[i].p_paddr;
-            UINT64 End = Phdr[i].p_paddr + Phdr[i].p_memsz;
-            if (End > MaxPhys) MaxPhys = End;
-        }
+    if (Source->Timing) {
+        Size += ALIGN_VALUE(sizeof(PXS_BOOT_TIMING), HANDOFF_ALIGN);
+    }
+    if (Source->InitrdIndex) {
+        Size += ALIGN_VALUE(sizeof(PXS_INITRD_INDEX) + Source->InitrdIndex->EntryCount * sizeof(PXS_INITRD_FILE), HANDOFF_ALIGN);
+    }
+    if (Source->ModuleTable) {
+        Size += ALIGN_VALUE(sizeof(PXS_MODULE_TABLE) + Source->ModuleTable->ModuleCount * sizeof(PXS_MODULE), HANDOFF_ALIGN);
+    }
+    if (Source->Log) {
+        Size += ALIGN_VALUE(sizeof(PXS_LOG) + Source->Log->Capacity * sizeof(PXS_LOG_RECORD), HANDOFF_ALIGN);
+    }
+    if (Source->CpuTable) {
+        Size += ALIGN_VALUE(sizeof(PXS_CPU_TABLE) + Source->CpuTable->CpuCount * sizeof(PXS_CPU), HANDOFF_ALIGN);
+    }
+    if (Source->FirmwareTables) {
+        Size += ALIGN_VALUE(sizeof(PXS_FIRMWARE_TABLES) + Source->FirmwareTables->AcpiCount * sizeof(PXS_ACPI_TABLE) +
+                            Source->FirmwareTables->SmbiosCount * sizeof(PXS_SMBIOS_STRUCTURE), HANDOFF_ALIGN);
+    }
+    if (Source->Numa) {
+        UINTN Nodes = Source->Numa->NodeCount;
+        Size += ALIGN_VALUE(sizeof(PXS_NUMA) + Nodes * sizeof(PXS_NUMA_NODE) + Source->Numa->RangeCount * sizeof(PXS_NUMA_RANGE) +
+                            (Source->Numa->Distances ? Nodes * Nodes : 0), HANDOFF_ALIGN);
     }
+    if (Source->Clocks) {
+        Size += ALIGN_VALUE(sizeof(PXS_CLOCKS), HANDOFF_ALIGN);
+    }
+    Size += ALIGN_VALUE(MapCapacity, HANDOFF_ALIGN);
+    Size += sizeof(PXS_MEMORY_MAP) + NormalizedCapacity * sizeof(PXS_MEMORY_RANGE);
+    return Size;
+}
 
-    // Align MinPhys down and MaxPhys up to Page Boundaries
-    UINT64 BaseOffset = MinPhys & ~(0xFFF);
-    UINT64 TotalSize = ((MaxPhys - MinPhys) + 0xFFF) & ~0xFFF;
-    UINTN TotalPages = EFI_SIZE_TO_PAGES(TotalSize);
-    Print(L"Image Size: 0x%lx bytes (%d Pages)\n", TotalSize, TotalPages);
+// Copy Source and what it points to into a new arena, with room for a firmware
+// map of MapCapacity bytes and a normalized map of NormalizedCapacity entries.
+// Source is left intact for HandoffRelease().
+EFI_STATUS HandoffPack(
+    IN CONST PXS_BOOT_INFO *Source,
+    IN UINTN MapCapacity,
+    IN UINTN NormalizedCapacity,
+    OUT PXS_BOOT_INFO **Packed
+) {
+    EFI_STATUS Status;
+    EFI_PHYSICAL_ADDRESS Base;
+    UINTN Pages = EFI_SIZE_TO_PAGES(HandoffSize(Source, MapCapacity, NormalizedCapacity));
+
+    Status = AllocateAlignedPages(Pages, EFI_PAGE_SIZE, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_HANDOFF, &Base);
+    if (EFI_ERROR(Status)) return Status;
+    BulkSetMem((VOID *)Base, EFI_PAGES_TO_SIZE(Pages), 0);
 
-    // KASLR Logic
-    EFI_PHYSICAL_ADDRESS LoadBase = 0;
-    UINT64 Slide = 0;
-    BOOLEAN KaslrSuccess = FALSE;
-    UINT64 RandomSeed = 0;
+    UINT8 *Cursor = (UINT8 *)Base;
+    PXS_BOOT_INFO *Info = HandoffAlloc(&Cursor, sizeof(PXS_BOOT_INFO));
+    CopyMem(Info, Source, sizeof(PXS_BOOT_INFO));
+    Info->HandoffBase = Base;
+    Info->HandoffSize = EFI_PAGES_TO_SIZE(Pages);
 
-    if (Config->KaslrEnabled) {
-        RandomSeed = GetBestEntropy();
-
-        if (RandomSeed != 0) {
-            // Try 64 times to find a slot
-            for (int attempt = 0; attempt < 64; attempt++) {
-                // Simple LCG for next attempt if needed
-                RandomSeed = RandomSeed * 6364136223846793005ULL + 1;
-                // Constrain to 2MB - 1GB range
-                if (TotalSize >= 0x40000000) {
-                    // Kernel too large for KASLR range
-                    Config->KaslrEnabled = FALSE;
-                    Print(L"KASLR: Kernel too large, disabled\n");
-                } else {
-                    UINT64 MaxOffset = 0x40000000 - TotalSize;
-                    UINT64 Candidate = 0x200000 + (RandomSeed % MaxOffset);
-                    Candidate &= ~(0x1FFFFF); // Align to 2MB
-
-                    Status = gBS->AllocatePages(AllocateAddress, EfiLoaderData, TotalPages, &Candidate);
-                    if (!EFI_ERROR(Status)) {
-                        LoadBase = Candidate;
-                        Slide = LoadBase - BaseOffset;
-                        KaslrSuccess = TRUE;
-                        break;
-                    }
-                }
-            }
+    if (Source->CommandLine) {
+        UINTN Length = AsciiStrSize(Source->CommandLine);
+        Info->CommandLine = CopyMem(HandoffAlloc(&Cursor, Length), Source->CommandLine, Length);
+    }
+    if (Source->Timing) {
+        Info->Timing = CopyMem(HandoffAlloc(&Cursor, sizeof(PXS_BOOT_TIMING)), Source->Timing, sizeof(PXS_BOOT_TIMING));
+    }
+    if (Source->InitrdIndex) {
+        UINTN Bytes = Source->InitrdIndex->EntryCount * sizeof(PXS_INITRD_FILE);
+        PXS_INITRD_INDEX *Index = HandoffAlloc(&Cursor, sizeof(PXS_INITRD_INDEX) + Bytes);
+        *Index = *Source->InitrdIndex;
+        Index->Entries = CopyMem(Index + 1, Source->InitrdIndex->Entries, Bytes);
+        Info->InitrdIndex = Index;
+    }
+    if (Source->ModuleTable) {
+        UINTN Bytes = Source->ModuleTable->ModuleCount * sizeof(PXS_MODULE);
+        PXS_MODULE_TABLE *Table = HandoffAlloc(&Cursor, sizeof(PXS_MODULE_TABLE) + Bytes);
+        *Table = *Source->ModuleTable;
+        Table->Modules = CopyMem(Table + 1, Source->ModuleTable->Modules, Bytes);
+        Info->ModuleTable = Table;
+    }
+    if (Source->Log) {
+        UINTN Bytes = Source->Log->Capacity * sizeof(PXS_LOG_RECORD);
+        PXS_LOG *Log = HandoffAlloc(&Cursor, sizeof(PXS_LOG) + Bytes);
+        *Log = *Source->Log;
+        Log->Records = CopyMem(Log + 1, Source->Log->Records, Bytes);
+        Info->Log = Log;
+    }
+    if (Source->CpuTable) {
+        UINTN Bytes = Source->CpuTable->CpuCount * sizeof(PXS_CPU);
+        PXS_CPU_TABLE *Cpus = HandoffAlloc(&Cursor, sizeof(PXS_CPU_TABLE) + Bytes);
+        *Cpus = *Source->CpuTable;
+        Cpus->Cpus = CopyMem(Cpus + 1, Source->CpuTable->Cpus, Bytes);
+        Info->CpuTable = Cpus;
+    }
+    if (Source->FirmwareTables) {
+        UINTN AcpiBytes = Source->FirmwareTables->AcpiCount * sizeof(PXS_ACPI_TABLE);
+        UINTN SmbiosBytes = Source->FirmwareTables->SmbiosCount * sizeof(PXS_SMBIOS_STRUCTURE);
+        PXS_FIRMWARE_TABLES *Tables = HandoffAlloc(&Cursor, sizeof(PXS_FIRMWARE_TABLES) + AcpiBytes + SmbiosBytes);
+        *Tables = *Source->FirmwareTables;
+        Tables->Acpi = CopyMem(Tables + 1, Source->FirmwareTables->Acpi, AcpiBytes);
+        Tables->Smbios = CopyMem((UINT8 *)Tables->Acpi + AcpiBytes, Source->FirmwareTables->Smbios, SmbiosBytes);
+        Info->FirmwareTables = Tables;
+    }
+    if (Source->Numa) {
+        UINTN NodeBytes = Source->Numa->NodeCount * sizeof(PXS_NUMA_NODE);
+        UINTN RangeBytes = Source->Numa->RangeCount * sizeof(PXS_NUMA_RANGE);
+        UINTN DistanceBytes = Source->Numa->Distances ? Source->Numa->NodeCount * Source->Numa->NodeCount : 0;
+        PXS_NUMA *Numa = HandoffAlloc(&Cursor, sizeof(PXS_NUMA) + NodeBytes + RangeBytes + DistanceBytes);
+        *Numa = *Source->Numa;
+        Numa->Nodes = CopyMem(Numa + 1, Source->Numa->Nodes, NodeBytes);
+        Numa->Ranges = CopyMem((UINT8 *)Numa->Nodes + NodeBytes, Source->Numa->Ranges, RangeBytes);
+        if (DistanceBytes > 0) {
+            Numa->Distances = CopyMem((UINT8 *)Numa->Ranges + RangeBytes, Source->Numa->Distances, DistanceBytes);
         }
-    } else {
-        Print(L"KASLR: Disabled by config.\n");
+        Info->Numa = Numa;
+    }
+    if (Source->Clocks) {
+        Info->Clocks = CopyMem(HandoffAlloc(&Cursor, sizeof(PXS_CLOCKS)), Source->Clocks, sizeof(PXS_CLOCKS));
     }
 
-    if (!KaslrSuccess) {
-        if (Config->KaslrEnabled) {
-            Print(L"KASLR failed. Fallback to fixed address.\n");
-        }
-        LoadBase = BaseOffset;
-        Status = gBS->AllocatePages(AllocateAddress, EfiLoaderData, TotalPages, &LoadBase);
-        if (EFI_ERROR(Status)) {
-             FreePool(FileBuffer);
-             return Status;
-        }
-    }
-    // Zero the entire allocated block
-    SetMem((VOID *)LoadBase, TotalSize, 0);
-
-    // Load Segments
-    for (i = 0; i < Ehdr->e_phnum; i++) {
-        if (Phdr[i].p_type == PT_LOAD) {
-            UINT64 PhysAddr = Phdr[i].p_paddr + Slide;
-            UINT64 OffsetInAlloc = PhysAddr - LoadBase;
-            if (OffsetInAlloc + Phdr[i].p_memsz > TotalSize) {
-                Print(L"Error: Segment %d exceeds allocated memory\n", i);
-                FreePool(FileBuffer);
-                return EFI_LOAD_ERROR;
-            }
-            CopyMem((VOID *)(LoadBase + OffsetInAlloc), (UINT8 *)FileBuffer + Phdr[i].p_offset, Phdr[i].p_filesz);
+    // Filled in around ExitBootServices
+    Info->MemoryMap = HandoffAlloc(&Cursor, MapCapacity);
+    Info->NormalizedMemoryMap = HandoffAlloc(&Cursor, sizeof(PXS_MEMORY_MAP) + NormalizedCapacity * sizeof(PXS_MEMORY_RANGE));
+    Info->NormalizedMemoryMap->Version = PXS_MEMORY_MAP_VERSION;
+    Info->NormalizedMemoryMap->Entries = (PXS_MEMORY_RANGE *)(Info->NormalizedMemoryMap + 1);
+
+    // Stage timing carries on in the packed copy
+    if (Source->Timing && Source->Timing == gTiming) {
+        if (gActiveStage) {
+            gActiveStage = &Info->Timing->Entries[gActiveStage - gTiming->Entries];
         }
+        gTiming = Info->Timing;
     }
-    *EntryPoint = Ehdr->e_entry + Slide;
-    *KernelBase = LoadBase;
-    *KernelSlide = Config->KvBase + Slide;
-    SetMem(FileBuffer, FileSize, 0); // Secure wipe
-    FreePool(FileBuffer);
+    // And so does the log
+    if (Source->Log && Source->Log == gLog) {
+        gLog = Info->Log;
+    }
+    // And placement, for the next arena
+    if (Source->Numa && Source->Numa == gNuma) {
+        gNuma = Info->Numa;
+    }
+
+    *Packed = Info;
     return EFI_SUCCESS;
 }
 
+// Free what a packed copy replaced: an earlier arena, or the pool buffers
+// built while loading. CommandLine still points at the config there.
+VOID HandoffRelease(IN PXS_BOOT_INFO *Info) {
+    if (Info->HandoffBase != 0) {
+        gBS->FreePages(Info->HandoffBase, EFI_SIZE_TO_PAGES(Info->HandoffSize));
+        return;
+    }
+    if (Info->Timing) gBS->FreePool(Info->Timing);
+    if (Info->InitrdIndex) gBS->FreePool(Info->InitrdIndex);
+    if (Info->ModuleTable) gBS->FreePool(Info->ModuleTable);
+    if (Info->Log) gBS->FreePool(Info->Log);
+    if (Info->CpuTable) gBS->FreePool(Info->CpuTable);
+    if (Info->FirmwareTables) gBS->FreePool(Info->FirmwareTables);
+    if (Info->Numa) {
+        if (Info->Numa->Distances) gBS->FreePool(Info->Numa->Distances);
+        gBS->FreePool(Info->Numa);
+    }
+    if (Info->Clocks) gBS->FreePool(Info->Clocks);
+    gBS->FreePool(Info);
+}
+
 // --------------------------------------------------------------------------
 // MAIN
 // --------------------------------------------------------------------------
 
+// Compare a computed digest with the configured one; a mismatch does not boot
+VOID VerifySha256(IN CONST CHAR16 *What, IN CONST UINT8 *Actual, IN CONST UINT8 *Expected) {
+    if (CompareMem(Actual, Expected, PXS_SHA256_DIGEST_SIZE) == 0) {
+        LogPrint(PXS_LOG_INFO, L"%s SHA-256 verified", What);
+        return;
+    }
+
+    CONST CHAR8 *Digits = "0123456789abcdef";
+    CHAR8 Hex[2 * PXS_SHA256_DIGEST_SIZE + 1];
+    for (UINTN i = 0; i < PXS_SHA256_DIGEST_SIZE; i++) {
+        Hex[2 * i] = Digits[Actual[i] >> 4];
+        Hex[2 * i + 1] = Digits[Actual[i] & 0xF];
+    }
+    Hex[2 * PXS_SHA256_DIGEST_SIZE] = '\0';
+    LogPrint(PXS_LOG_ERROR, L"%s SHA-256 is %a", What, Hex);
+    FatalError(L"Digest does not match the configuration", EFI_SECURITY_VIOLATION);
+}
+
 EFI_STATUS EFIAPI UefiMain(
     IN EFI_HANDLE        ImageHandle,
     IN EFI_SYSTEM_TABLE  *SystemTable
@@ -478,17 +3518,29 @@ EFI_STATUS EFIAPI UefiMain(
     PXS_BOOT_INFO *BootInfo;
     PXS_CONFIG Config;
     UINTN MemoryMapSize = 0;
+    UINTN MemoryMapCapacity;
     EFI_MEMORY_DESCRIPTOR *MemoryMap = NULL;
+    UINTN NormalizedCapacity = 0;
     UINTN MapKey;
     UINTN DescriptorSize;
     UINT32 DescriptorVersion;
     VOID *InitrdBuffer = NULL;
     UINT64 InitrdSize = 0;
-
-    gST->ConOut->ClearScreen(gST->ConOut);
-    Print(L"[-- PXS v%a --]\n", PXS_LOADER_VERSION);
+    PXS_KERNEL_SEGMENT *KernelSegments = NULL;
+    UINTN KernelSegmentCount = 0;
+    PXS_PAGE_TABLES PageTables;
+    PXS_SMP Smp;
+    CONST CHAR16 *MemOpsName;
+    UINT64 EntryTsc = __builtin_ia32_rdtsc();
+
+    LogInit();
+    LogPrint(PXS_LOG_INFO, L"[-- PXS v%a --]", PXS_LOADER_VERSION);
+    TimingInit(EntryTsc);
+    MemOpsInit(&MemOpsName);
+    LogPrint(PXS_LOG_VERBOSE, L"Memory ops: %s (streaming from %ld KB)", MemOpsName, (UINT64)MemOpsStreamingThreshold() / SIZE_1KB);
 
     // 1. Initialize File System
+    TimingBegin(PXS_STAGE_VOLUME_OPEN);
     Status = gBS->HandleProtocol(ImageHandle, &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImage);
     if (EFI_ERROR(Status)) {
         FatalError(L"LoadedImageProtocol not found", Status);
@@ -503,9 +3555,31 @@ EFI_STATUS EFIAPI UefiMain(
     if (EFI_ERROR(Status)) {
         FatalError(L"Could not open volume", Status);
     }
+    TimingEnd();
 
     // 2. Load Configuration
+    TimingBegin(PXS_STAGE_CONFIG);
     LoadConfig(RootDir, DEFAULT_CONFIG_PATH, &Config);
+    if (Config.LogLevel > PXS_LOG_ERROR) gST->ConOut->ClearScreen(gST->ConOut);
+    LogSetLevel(Config.LogLevel);
+    TimingEnd();
+
+    // Only the chosen entry's files are loaded, so the menu comes first
+    if (Config.Timeout > 0) TimingBegin(PXS_STAGE_TIMEOUT);
+    UINTN EntryIndex = BootMenu(&Config);
+    if (Config.Timeout > 0) TimingEnd();
+    ApplyConfigEntry(&Config, EntryIndex);
+
+    if (Config.VerifyKernel || Config.VerifyInitrd) {
+        CONST CHAR16 *Engine;
+        gSha256Blocks = Sha256SelectBlocks(&Engine);
+        LogPrint(PXS_LOG_VERBOSE, L"SHA-256: %s", Engine);
+    }
+
+    WorkPoolInit(&gWorkPool);
+    if (gWorkPool.Mp) {
+        LogPrint(PXS_LOG_VERBOSE, L"MP: %d CPUs available for decompression", gWorkPool.Enabled);
+    }
 
     // 3. Prepare BootInfo
     Status = gBS->AllocatePool(EfiLoaderData, sizeof(PXS_BOOT_INFO), (VOID **)&BootInfo);
@@ -515,135 +3589,220 @@ EFI_STATUS EFIAPI UefiMain(
     BootInfo->Magic = PXS_MAGIC;
     BootInfo->Version = PXS_PROTOCOL_VERSION; // Protocol Version 1
     BootInfo->Flags = 0;
+    BootInfo->Timing = gTiming;
+    BootInfo->Log = gLog;
 
-    // Copy Command Line
-    UINTN CmdLineLen = AsciiStrLen(Config.CmdLine);
-    if (CmdLineLen > 0) {
-        VOID *CmdLineBuffer;
-        Status = gBS->AllocatePool(EfiLoaderData, CmdLineLen + 1, &CmdLineBuffer);
-        if (!EFI_ERROR(Status)) {
-            CopyMem(CmdLineBuffer, Config.CmdLine, CmdLineLen + 1);
-            BootInfo->CommandLine = (CHAR8*)CmdLineBuffer;
-        }
+    // Copied into the handoff arena with the rest of BootInfo
+    BootInfo->CommandLine = (Config.CmdLine[0] != '\0') ? Config.CmdLine : NULL;
+
+    // Before anything is loaded, so the SRAT can steer where it goes
+    TimingBegin(PXS_STAGE_SYSTEM_TABLES);
+    BootInfo->Rsdp = GetSystemConfigurationTable(&gEfiAcpi20TableGuid);
+    if (!BootInfo->Rsdp) {
+        BootInfo->Rsdp = GetSystemConfigurationTable(&gEfiAcpi10TableGuid);
+    }
+    BootInfo->Smbios = GetSystemConfigurationTable(&gEfiSmbiosTableGuid);
+    BootInfo->FirmwareTables = BuildFirmwareTables(BootInfo->Rsdp, GetSystemConfigurationTable(&gEfiSmbios3TableGuid),
+                                                   BootInfo->Smbios);
+    BootInfo->Numa = BuildNumaTable(BootInfo->FirmwareTables);
+    gNuma = BootInfo->Numa;
+    BootInfo->RuntimeServicesPtr = (UINT64)gST->RuntimeServices;
+
+    // Security Canary Generation
+    BootInfo->SecurityCanary = GetBestEntropy();
+
+    if (BootInfo->Rsdp) {
+        LogPrint(PXS_LOG_VERBOSE, L"RSDP found at 0x%lx", (UINT64)BootInfo->Rsdp);
     } else {
-        BootInfo->CommandLine = NULL;
+        LogPrint(PXS_LOG_WARNING, L"Warning: RSDP not found");
     }
+    if (BootInfo->Smbios) {
+        LogPrint(PXS_LOG_VERBOSE, L"SMBIOS found at 0x%lx", (UINT64)BootInfo->Smbios);
+    }
+    TimingEnd();
+
+    // Early, so the calibration runs before loading warms the caches and the
+    // firmware's timer callbacks pile up
+    TimingBegin(PXS_STAGE_CLOCKS);
+    BootInfo->Clocks = BuildClocks(BootInfo->FirmwareTables);
+    TimingEnd();
 
     // 4. Load Initrd (if specified)
     if (StrLen(Config.InitrdPath) > 0) {
-        Print(L"Loading Initrd: %s\n", Config.InitrdPath);
-        Status = LoadFile(RootDir, Config.InitrdPath, &InitrdBuffer, &InitrdSize);
+        TimingBegin(PXS_STAGE_INITRD);
+        LogPrint(PXS_LOG_INFO, L"Loading Initrd: %s", Config.InitrdPath);
+        Status = LoadImageFile(RootDir, Config.InitrdPath, EFI_PAGE_SIZE, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_MODULE,
+                               &InitrdBuffer, &InitrdSize, Config.VerifyInitrd ? BootInfo->InitrdSha256 : NULL);
         if (EFI_ERROR(Status)) {
-            Print(L"Warning: Failed to load Initrd '%s'. Continuing...\n", Config.InitrdPath);
+            LogPrint(PXS_LOG_WARNING, L"Warning: Failed to load Initrd '%s'. Continuing...", Config.InitrdPath);
         } else {
+            if (Config.VerifyInitrd) {
+                VerifySha256(L"Initrd", BootInfo->InitrdSha256, Config.InitrdSha256);
+                BootInfo->Flags |= PXS_FLAG_INITRD_SHA256;
+            }
             BootInfo->InitrdAddress = (UINT64)InitrdBuffer;
             BootInfo->InitrdSize = InitrdSize;
-            Print(L"Initrd Loaded @ 0x%lx (Size: %ld bytes)\n", BootInfo->InitrdAddress, BootInfo->InitrdSize);
+            LogPrint(PXS_LOG_INFO, L"Initrd Loaded @ 0x%lx (Size: %ld bytes)", BootInfo->InitrdAddress, BootInfo->InitrdSize);
+            BootInfo->InitrdIndex = BuildInitrdIndex(InitrdBuffer, InitrdSize);
         }
+        TimingEnd();
+    }
+
+    // 4b. Load Modules
+    if (Config.ModuleCount > 0) {
+        TimingBegin(PXS_STAGE_MODULES);
+        BootInfo->ModuleTable = LoadModules(RootDir, &Config);
+        TimingEnd();
     }
 
     // 5. Load Kernel
+    TimingBegin(PXS_STAGE_KERNEL);
     Status = LoadElfKernel(RootDir,
         &Config,
         &KernelEntry,
         &BootInfo->KernelPhysicalBase,
         &BootInfo->KernelFileSize,
-        &BootInfo->KernelVirtualBase
+        &BootInfo->KernelVirtualBase,
+        &KernelSegments,
+        &KernelSegmentCount,
+        Config.VerifyKernel ? BootInfo->KernelSha256 : NULL
     );
     if (EFI_ERROR(Status)) {
         FatalError(L"Failed to load kernel", Status);
     }
+    if (Config.VerifyKernel) {
+        VerifySha256(L"Kernel", BootInfo->KernelSha256, Config.KernelSha256);
+        BootInfo->Flags |= PXS_FLAG_KERNEL_SHA256;
+    }
+    TimingEnd();
     RootDir->Close(RootDir);
 
     // 6. Setup Graphics
+    TimingBegin(PXS_STAGE_GRAPHICS);
     Status = gBS->LocateProtocol(&gEfiGraphicsOutputProtocolGuid, NULL, (VOID **)&Gop);
     if (EFI_ERROR(Status)) {
-        Print(L"Warning: GOP not found. Headless mode.\n");
+        LogPrint(PXS_LOG_WARNING, L"Warning: GOP not found. Headless mode.");
     } else {
-        BootInfo->Framebuffer.BaseAddress = Gop->Mode->FrameBufferBase;
-        BootInfo->Framebuffer.Size = Gop->Mode->FrameBufferSize;
-        BootInfo->Framebuffer.Width = Gop->Mode->Info->HorizontalResolution;
-        BootInfo->Framebuffer.Height = Gop->Mode->Info->VerticalResolution;
-        BootInfo->Framebuffer.PixelsPerScanLine = Gop->Mode->Info->PixelsPerScanLine;
-
-        if (Gop->Mode->Info->PixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
-            BootInfo->Framebuffer.RedFieldPosition = 0; BootInfo->Framebuffer.RedMaskSize = 8;
-            BootInfo->Framebuffer.GreenFieldPosition = 8; BootInfo->Framebuffer.GreenMaskSize = 8;
-            BootInfo->Framebuffer.BlueFieldPosition = 16; BootInfo->Framebuffer.BlueMaskSize = 8;
-            BootInfo->Framebuffer.ReservedFieldPosition = 24; BootInfo->Framebuffer.ReservedMaskSize = 8;
-        } else if (Gop->Mode->Info->PixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
-            BootInfo->Framebuffer.RedFieldPosition = 16; BootInfo->Framebuffer.RedMaskSize = 8;
-            BootInfo->Framebuffer.GreenFieldPosition = 8; BootInfo->Framebuffer.GreenMaskSize = 8;
-            BootInfo->Framebuffer.BlueFieldPosition = 0; BootInfo->Framebuffer.BlueMaskSize = 8;
-            BootInfo->Framebuffer.ReservedFieldPosition = 24; BootInfo->Framebuffer.ReservedMaskSize = 8;
-        }
+        GraphicsSelectMode(Gop, &Config);
+        GraphicsFramebufferInfo(Gop, &BootInfo->Framebuffer);
+        BootInfo->Framebuffer.CacheType =
+            GraphicsWriteCombine(BootInfo->Framebuffer.BaseAddress, BootInfo->Framebuffer.Size);
     }
+    TimingEnd();
 
-    BootInfo->Rsdp = GetSystemConfigurationTable(&gEfiAcpi20TableGuid);
-    if (!BootInfo->Rsdp) {
-        BootInfo->Rsdp = GetSystemConfigurationTable(&gEfiAcpi10TableGuid);
+    if (Config.PagingEnabled) {
+        TimingBegin(PXS_STAGE_PAGING);
+        Status = BuildPageTables(KernelSegments, KernelSegmentCount, LoadedImage, BootInfo, &PageTables);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Could not build page tables, keeping firmware paging. %r", Status);
+        } else {
+            BootInfo->Flags |= PXS_FLAG_PAGING;
+        }
+        TimingEnd();
     }
-    BootInfo->Smbios = GetSystemConfigurationTable(&gEfiSmbiosTableGuid);
-    BootInfo->RuntimeServicesPtr = (UINT64)gST->RuntimeServices;
-
-    // Security Canary Generation
-    BootInfo->SecurityCanary = GetBestEntropy();
+    FreePool(KernelSegments);
 
-    if (BootInfo->Rsdp) {
-        Print(L"RSDP found at 0x%lx\n", (UINT64)BootInfo->Rsdp);
-    } else {
-        Print(L"Warning: RSDP not found\n");
-    }
-    if (BootInfo->Smbios) {
-        Print(L"SMBIOS found at 0x%lx\n", (UINT64)BootInfo->Smbios);
-    }
+    LogPrint(PXS_LOG_VERBOSE, L"Preparing for exit...");
 
-    Print(L"Preparing for exit...\n");
+    UINT64 TscFrequency = BootInfo->Clocks ? BootInfo->Clocks->TscFrequency : 0;
+    TimingFinalize(TscFrequency);
 
-    if (Config.Timeout > 0) {
-        gBS->Stall(Config.Timeout * 1000000);
+    // Only the park block is set up here: the firmware resets the APs on
+    // ExitBootServices, so they are started after it
+    if (Config.SmpPark && gWorkPool.Mp) {
+        Status = SmpPrepare(gWorkPool.Mp, TscFrequency, &Smp, &BootInfo->CpuTable);
+        if (EFI_ERROR(Status)) {
+            LogPrint(PXS_LOG_WARNING, L"Warning: Could not prepare AP parking, leaving APs to the kernel. %r", Status);
+        } else {
+            LogPrint(PXS_LOG_VERBOSE, L"SMP: %d CPUs, %d APs to park", BootInfo->CpuTable->CpuCount, Smp.ApCount);
+        }
     }
 
-    Print(L"[-- PXS INITIALIZATION COMPLETE --] -- exiting boot services...\n");
+    LogPrint(PXS_LOG_INFO, L"[-- PXS INITIALIZATION COMPLETE --] -- exiting boot services...");
 
     // 7. Get Memory Map
-    MemoryMapSize = 4096;
-    Status = gBS->AllocatePool(EfiLoaderData, MemoryMapSize, (VOID **)&MemoryMap);
-    if (EFI_ERROR(Status)) FatalError(L"Alloc MemoryMap failed", Status);
-
-    Status = gBS->GetMemoryMap(&MemoryMapSize, MemoryMap, &MapKey, &DescriptorSize, &DescriptorVersion);
-    while (Status == EFI_BUFFER_TOO_SMALL) {
-        gBS->FreePool(MemoryMap);
-        MemoryMapSize += 4096;
-        Status = gBS->AllocatePool(EfiLoaderData, MemoryMapSize, (VOID **)&MemoryMap);
-        if (EFI_ERROR(Status)) FatalError(L"Alloc MemoryMap retry failed", Status);
+    // BootInfo is packed into the handoff arena here, with room for both maps.
+    // The normalized map is built after ExitBootServices, so all of it has to
+    // be allocated before the final GetMemoryMap that yields MapKey.
+    TimingBegin(PXS_STAGE_MEMORY_MAP);
+    MemoryMapCapacity = 0;
+    DescriptorSize = sizeof(EFI_MEMORY_DESCRIPTOR);
+    for (;;) {
+        MemoryMapSize = MemoryMapCapacity;
         Status = gBS->GetMemoryMap(&MemoryMapSize, MemoryMap, &MapKey, &DescriptorSize, &DescriptorVersion);
+        if (Status == EFI_BUFFER_TOO_SMALL) {
+            // Headroom for the descriptors the arena itself may add. One
+            // normalized entry per descriptor at the smallest descriptor size.
+            PXS_BOOT_INFO *Packed;
+            MemoryMapCapacity = MemoryMapSize + 4096;
+            NormalizedCapacity = MemoryMapCapacity / sizeof(EFI_MEMORY_DESCRIPTOR) + 16;
+            Status = HandoffPack(BootInfo, MemoryMapCapacity, NormalizedCapacity, &Packed);
+            if (EFI_ERROR(Status)) FatalError(L"Alloc handoff arena failed", Status);
+            HandoffRelease(BootInfo);
+            BootInfo = Packed;
+            MemoryMap = BootInfo->MemoryMap;
+            continue;
+        }
+        if (EFI_ERROR(Status)) {
+            FatalError(L"GetMemoryMap failed", Status);
+        }
+        break;
     }
 
-    if (EFI_ERROR(Status)) {
-        FatalError(L"GetMemoryMap failed", Status);
-    }
-
-    BootInfo->MemoryMap = MemoryMap;
     BootInfo->MemoryMapSize = MemoryMapSize;
     BootInfo->DescriptorSize = DescriptorSize;
     BootInfo->DescriptorVersion = DescriptorVersion;
     BootInfo->MapKey = MapKey;
+    TimingEnd();
 
+    TimingBegin(PXS_STAGE_EXIT_BOOT_SERVICES);
     Status = gBS->ExitBootServices(ImageHandle, MapKey);
     if (EFI_ERROR(Status)) {
-        Print(L"ExitBootServices failed. Retrying...\n");
+        LogPrint(PXS_LOG_WARNING, L"ExitBootServices failed. Retrying...");
         // Retry mechanism as per UEFI spec
+        MemoryMapSize = MemoryMapCapacity;
         Status = gBS->GetMemoryMap(&MemoryMapSize, MemoryMap, &MapKey, &DescriptorSize, &DescriptorVersion);
         if (EFI_ERROR(Status)) FatalError(L"GetMemoryMap(2) failed", Status);
         BootInfo->MapKey = MapKey; // Update key
+        BootInfo->MemoryMapSize = MemoryMapSize;
         Status = gBS->ExitBootServices(ImageHandle, MapKey);
         if (EFI_ERROR(Status)) {
             FatalError(L"ExitBootServices(2) failed", Status);
         }
     }
+    TimingEnd();
+
+    // No boot services from here on
+    gLogConsole = FALSE;
+    UINTN NormalizedCount;
+    PXS_MEMORY_MAP *NormalizedMap = BootInfo->NormalizedMemoryMap;
+    Status = MemoryMapNormalize(MemoryMap, MemoryMapSize, DescriptorSize,
+                                NormalizedMap->Entries, NormalizedCapacity, &NormalizedCount);
+    if (EFI_ERROR(Status)) {
+        BootInfo->NormalizedMemoryMap = NULL;
+    } else {
+        NormalizedMap->EntryCount = (UINT32)NormalizedCount;
+    }
+
+    // 8. Park APs while the firmware page tables still map the local APIC
+    if (BootInfo->CpuTable && Smp.ApCount > 0) {
+        TimingBegin(PXS_STAGE_SMP);
+        if (BootInfo->Flags & PXS_FLAG_PAGING) {
+            Smp.Pat = PagingPat(&PageTables, Smp.Pat);
+        }
+        UINTN Parked = SmpPark(&Smp, BootInfo->CpuTable);
+        TimingEnd();
+        LogPrint(Parked == Smp.ApCount ? PXS_LOG_VERBOSE : PXS_LOG_WARNING,
+                 L"SMP: %d of %d APs parked", Parked, Smp.ApCount);
+    }
 
-    // 8. Jump to Kernel
+    // 9. Jump to Kernel
+    if (gTiming) {
+        gTiming->TscKernelEntry = __builtin_ia32_rdtsc();
+    }
+    if (BootInfo->Flags & PXS_FLAG_PAGING) {
+        PagingActivate(&PageTables);
+    }
     KERNEL_ENTRY Entry = (KERNEL_ENTRY)KernelEntry;
     Entry(BootInfo);
 
@@ -0,0 +1,151 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+
+#include <compiler.h>
+#include <sha256.h>
+
+// SHA-NI block function. The instructions are emitted through inline asm on
+// vector operands, so no intrinsic headers are needed and the rest of the
+// image can stay free of SSE code generation.
+
+#define SHA_NI __target("sse4.1,sha") STATIC inline
+
+typedef UINT32 PXS_V4 __attribute__((vector_size(16)));
+typedef UINT32 PXS_V4U __attribute__((vector_size(16), aligned(1)));
+
+extern CONST UINT32 gSha256K[64];
+
+// Byte order of each message word, big endian to little endian
+STATIC CONST UINT8 mByteSwap[16] __aligned(16) = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+// Two rounds: the low half of Wk holds W[i] + K[i] for both
+SHA_NI PXS_V4 Rnds2(PXS_V4 Cdgh, PXS_V4 Abef, PXS_V4 Wk) {
+    __asm__("sha256rnds2 %2, %1, %0" : "+x"(Cdgh) : "x"(Abef), "Yz"(Wk));
+    return Cdgh;
+}
+
+SHA_NI PXS_V4 Msg1(PXS_V4 A, PXS_V4 B) {
+    __asm__("sha256msg1 %1, %0" : "+x"(A) : "x"(B));
+    return A;
+}
+
+SHA_NI PXS_V4 Msg2(PXS_V4 A, PXS_V4 B) {
+    __asm__("sha256msg2 %1, %0" : "+x"(A) : "x"(B));
+    return A;
+}
+
+SHA_NI PXS_V4 ByteSwap(PXS_V4 A, PXS_V4 Mask) {
+    __asm__("pshufb %1, %0" : "+x"(A) : "x"(Mask));
+    return A;
+}
+
+// (Hi:Lo) >> 4 bytes and >> 8 bytes
+SHA_NI PXS_V4 Alignr4(PXS_V4 Hi, PXS_V4 Lo) {
+    __asm__("palignr $4, %1, %0" : "+x"(Hi) : "x"(Lo));
+    return Hi;
+}
+
+SHA_NI PXS_V4 Alignr8(PXS_V4 Hi, PXS_V4 Lo) {
+    __asm__("palignr $8, %1, %0" : "+x"(Hi) : "x"(Lo));
+    return Hi;
+}
+
+// Upper four words from B, lower four from A
+SHA_NI PXS_V4 BlendHigh(PXS_V4 A, PXS_V4 B) {
+    __asm__("pblendw $0xF0, %1, %0" : "+x"(A) : "x"(B));
+    return A;
+}
+
+#define SHA_NI_SHUFFLE(Name, Imm)                                          \
+    SHA_NI PXS_V4 Name(PXS_V4 A) {                                          \
+        PXS_V4 R;                                                           \
+        __asm__("pshufd $" #Imm ", %1, %0" : "=x"(R) : "x"(A));             \
+        return R;                                                           \
+    }
+
+SHA_NI_SHUFFLE(Shuffle0E, 0x0E)  // High qword to low
+SHA_NI_SHUFFLE(Shuffle1B, 0x1B)  // Reverse words
+SHA_NI_SHUFFLE(ShuffleB1, 0xB1)  // Swap word pairs
+
+// Four rounds using message words Cur. While the schedule still runs, Next
+// is finished with Cur and Prev, and Prev gets the first half of its update.
+#define SHA_NI_ROUNDS(Group, Cur, Prev, Next)                              \
+    do {                                                                    \
+        PXS_V4 Wk = Cur + *(CONST PXS_V4U *)&gSha256K[4 * (Group)];         \
+        State1 = Rnds2(State1, State0, Wk);                                 \
+        if ((Group) >= 3 && (Group) < 15) {                                 \
+            Next = Msg2(Next + Alignr4(Cur, Prev), Cur);                    \
+        }                                                                   \
+        State0 = Rnds2(State0, State1, Shuffle0E(Wk));                      \
+        if ((Group) >= 1 && (Group) < 13) {                                 \
+            Prev = Msg1(Prev, Cur);                                         \
+        }                                                                   \
+    } while (0)
+
+__target("sse4.1,sha")
+STATIC VOID Sha256BlocksNi(IN OUT UINT32 *State, IN CONST UINT8 *Data, IN UINTN Blocks) {
+    PXS_V4 Mask = *(CONST PXS_V4 *)mByteSwap;
+    PXS_V4 Tmp, State0, State1, M0, M1, M2, M3;
+
+    // The round instructions want the state as ABEF / CDGH
+    Tmp = ShuffleB1(*(PXS_V4U *)&State[0]);
+    State1 = Shuffle1B(*(PXS_V4U *)&State[4]);
+    State0 = Alignr8(Tmp, State1);
+    State1 = BlendHigh(State1, Tmp);
+
+    while (Blocks-- > 0) {
+        PXS_V4 SaveAbef = State0;
+        PXS_V4 SaveCdgh = State1;
+
+        M0 = ByteSwap(*(CONST PXS_V4U *)(Data + 0), Mask);
+        M1 = ByteSwap(*(CONST PXS_V4U *)(Data + 16), Mask);
+        M2 = ByteSwap(*(CONST PXS_V4U *)(Data + 32), Mask);
+        M3 = ByteSwap(*(CONST PXS_V4U *)(Data + 48), Mask);
+
+        SHA_NI_ROUNDS(0, M0, M3, M1);
+        SHA_NI_ROUNDS(1, M1, M0, M2);
+        SHA_NI_ROUNDS(2, M2, M1, M3);
+        SHA_NI_ROUNDS(3, M3, M2, M0);
+        SHA_NI_ROUNDS(4, M0, M3, M1);
+        SHA_NI_ROUNDS(5, M1, M0, M2);
+        SHA_NI_ROUNDS(6, M2, M1, M3);
+        SHA_NI_ROUNDS(7, M3, M2, M0);
+        SHA_NI_ROUNDS(8, M0, M3, M1);
+        SHA_NI_ROUNDS(9, M1, M0, M2);
+        SHA_NI_ROUNDS(10, M2, M1, M3);
+        SHA_NI_ROUNDS(11, M3, M2, M0);
+        SHA_NI_ROUNDS(12, M0, M3, M1);
+        SHA_NI_ROUNDS(13, M1, M0, M2);
+        SHA_NI_ROUNDS(14, M2, M1, M3);
+        SHA_NI_ROUNDS(15, M3, M2, M0);
+
+        State0 += SaveAbef;
+        State1 += SaveCdgh;
+        Data += PXS_SHA256_BLOCK_SIZE;
+    }
+
+    Tmp = Shuffle1B(State0);
+    State1 = ShuffleB1(State1);
+    *(PXS_V4U *)&State[0] = BlendHigh(Tmp, State1);
+    *(PXS_V4U *)&State[4] = Alignr8(State1, Tmp);
+}
+
+PXS_SHA256_BLOCKS Sha256SelectBlocks(OUT CONST CHAR16 **Name) {
+    UINT32 MaxLeaf, Ebx = 0, Ecx = 0;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf >= 7) {
+        AsmCpuid(1, NULL, NULL, &Ecx, NULL);
+        AsmCpuidEx(7, 0, NULL, &Ebx, NULL, NULL);
+    }
+
+    // SHA (leaf 7 EBX[29]) plus SSSE3 and SSE4.1 for the shuffles and blends
+    if ((Ebx & (1U << 29)) && (Ecx & (1U << 9)) && (Ecx & (1U << 19))) {
+        *Name = L"sha-ni";
+        return Sha256BlocksNi;
+    }
+    *Name = L"generic";
+    return Sha256BlocksGeneric;
+}
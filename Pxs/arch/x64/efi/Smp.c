@@ -0,0 +1,381 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <paging.h>
+#include <smp.h>
+
+#define MSR_APIC_BASE       0x1B
+#define MSR_EFER            0xC0000080
+#define MSR_PAT             0x277
+#define MSR_X2APIC_ICR      0x830
+#define APIC_BASE_X2APIC    (1ULL << 10)
+#define APIC_BASE_ADDRESS   0x000FFFFFFFFFF000ULL
+#define XAPIC_ICR_LOW       0x300
+#define XAPIC_ICR_HIGH      0x310
+#define ICR_INIT            0x00004500  // INIT, level assert
+#define ICR_STARTUP         0x00004600  // STARTUP, level assert; low byte is the vector
+#define ICR_BUSY            (1U << 12)
+#define EFER_LME            (1U << 8)
+#define EFER_NXE            (1U << 11)
+#define CR4_PAE             (1U << 5)
+#define CR4_LA57            (1U << 12)
+
+#define PARK_BELOW          0x9FFFF     // SIPI vectors reach 1 MiB; stay under the EBDA/VGA hole
+#define PARK_DATA_OFFSET    0xF00       // PARK_DATA in the trampoline page
+#define PARK_FLAG_MWAIT     0x01
+#define PARK_FLAG_PAT       0x02
+
+#define PARK_SEL_CODE32     0x08
+#define PARK_SEL_DATA       0x10
+#define PARK_SEL_CODE64     0x18
+
+#define PARK_WAIT_US        100000      // For all APs to reach their mailbox
+#define DEFAULT_TSC_PER_US  3000        // Without a TSC rate, err on long delays
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x)  STRINGIFY_(x)
+
+// What the trampoline reads on its way to long mode, at PARK_DATA_OFFSET in
+// the first park page. The offsets are spelled out in the assembly below.
+#pragma pack(1)
+typedef struct {
+    UINT16 GdtLimit;       // lgdt operand
+    UINT32 GdtBase;
+    UINT16 Reserved0;
+    UINT32 Far32Offset;    // 16-bit to 32-bit far jump
+    UINT16 Far32Selector;
+    UINT16 Reserved1;
+    UINT32 Far64Offset;    // 32-bit to 64-bit far jump
+    UINT16 Far64Selector;
+    UINT16 Reserved2;
+    UINT32 Cr3;
+    UINT32 Cr4;
+    UINT32 EferSet;        // Or'ed into EFER
+    UINT32 Flags;          // PARK_FLAG_*
+    UINT64 Pat;
+    UINT64 Mailboxes;      // First PXS_CPU_MAILBOX
+    UINT32 MailboxCount;
+    UINT32 Base;           // Park block, where the trampoline runs
+    UINT64 Gdt[4];
+} PARK_DATA;
+#pragma pack()
+
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Far32Offset) == 8, "PARK_DATA.Far32Offset");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Far64Offset) == 16, "PARK_DATA.Far64Offset");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Cr3) == 24, "PARK_DATA.Cr3");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Cr4) == 28, "PARK_DATA.Cr4");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, EferSet) == 32, "PARK_DATA.EferSet");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Flags) == 36, "PARK_DATA.Flags");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Pat) == 40, "PARK_DATA.Pat");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Mailboxes) == 48, "PARK_DATA.Mailboxes");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, MailboxCount) == 56, "PARK_DATA.MailboxCount");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Base) == 60, "PARK_DATA.Base");
+STATIC_ASSERT(OFFSET_OF(PARK_DATA, Gdt) == 64, "PARK_DATA.Gdt");
+STATIC_ASSERT(PARK_DATA_OFFSET + sizeof(PARK_DATA) <= EFI_PAGE_SIZE, "PARK_DATA fits the page");
+// Only the assembler knows the trampoline's length, and it cannot compare it
+// before relaxing jumps: SmpPrepare() checks that it ends by PARK_DATA_OFFSET
+STATIC_ASSERT(OFFSET_OF(PXS_CPU_MAILBOX, ApicId) == 32, "PXS_CPU_MAILBOX.ApicId");
+STATIC_ASSERT(OFFSET_OF(PXS_CPU_MAILBOX, State) == 36, "PXS_CPU_MAILBOX.State");
+
+// Copied to the park block and started there by SIPI in real mode, with CS
+// at the block. Goes through 32-bit protected mode to long mode on the park
+// page tables, finds its mailbox by APIC ID and waits on it; see
+// PXS_CPU_MAILBOX for the other side. Position independent: the 16-bit part
+// addresses PARK_DATA through DS = CS, the rest through the block base in EBP.
+extern CONST UINT8 PxsApTrampoline[];
+extern CONST UINT8 PxsApTrampoline32[];
+extern CONST UINT8 PxsApTrampoline64[];
+extern CONST UINT8 PxsApTrampolineEnd[];
+
+__asm__(
+    ".pushsection .text\n"
+    ".globl PxsApTrampoline, PxsApTrampoline32, PxsApTrampoline64, PxsApTrampolineEnd\n"
+    ".code16\n"
+    "PxsApTrampoline:\n"
+    "    cli\n"
+    "    movw %cs, %ax\n"
+    "    movw %ax, %ds\n"
+    "    movw $" STRINGIFY(PARK_DATA_OFFSET) ", %si\n"
+    "    movl 60(%si), %ebp\n"                   // Base
+    "    lgdtl (%si)\n"
+    "    movl $0x33, %eax\n"                     // PE, MP, ET, NE; caches on (INIT left CD and NW set)
+    "    movl %eax, %cr0\n"
+    "    ljmpl *8(%si)\n"
+    ".code32\n"
+    "PxsApTrampoline32:\n"
+    "    movw $" STRINGIFY(PARK_SEL_DATA) ", %ax\n"
+    "    movw %ax, %ds\n"
+    "    movw %ax, %es\n"
+    "    movw %ax, %ss\n"
+    "    leal " STRINGIFY(PARK_DATA_OFFSET) "(%ebp), %esi\n"
+    "    movl 28(%esi), %eax\n"
+    "    movl %eax, %cr4\n"
+    "    movl 24(%esi), %eax\n"
+    "    movl %eax, %cr3\n"
+    "    movl $" STRINGIFY(MSR_EFER) ", %ecx\n"
+    "    rdmsr\n"
+    "    orl 32(%esi), %eax\n"
+    "    wrmsr\n"
+    "    testl $" STRINGIFY(PARK_FLAG_PAT) ", 36(%esi)\n"
+    "    jz 1f\n"
+    "    movl $" STRINGIFY(MSR_PAT) ", %ecx\n"
+    "    movl 40(%esi), %eax\n"
+    "    movl 44(%esi), %edx\n"
+    "    wrmsr\n"
+    "1:  movl %cr0, %eax\n"
+    "    orl $0x80010000, %eax\n"                // PG, WP
+    "    movl %eax, %cr0\n"
+    "    ljmpl *16(%esi)\n"
+    ".code64\n"
+    "PxsApTrampoline64:\n"
+    "    movl %ebp, %ebp\n"
+    "    leaq " STRINGIFY(PARK_DATA_OFFSET) "(%rbp), %rsi\n"
+    // APIC ID as MP services reports it: x2APIC ID where leaf 0xB has one
+    "    xorl %eax, %eax\n"
+    "    cpuid\n"
+    "    cmpl $0xB, %eax\n"
+    "    jb 1f\n"
+    "    movl $0xB, %eax\n"
+    "    xorl %ecx, %ecx\n"
+    "    cpuid\n"
+    "    testl %ebx, %ebx\n"
+    "    jz 1f\n"
+    "    movl %edx, %r8d\n"
+    "    jmp 2f\n"
+    "1:  movl $1, %eax\n"
+    "    cpuid\n"
+    "    shrl $24, %ebx\n"
+    "    movl %ebx, %r8d\n"
+    "2:  movq 48(%rsi), %rdi\n"
+    "    movl 56(%rsi), %ecx\n"
+    "3:  testl %ecx, %ecx\n"
+    "    jz 9f\n"
+    "    cmpl %r8d, 32(%rdi)\n"
+    "    je 4f\n"
+    "    addq $64, %rdi\n"
+    "    decl %ecx\n"
+    "    jmp 3b\n"
+    "4:  movl 36(%rsi), %r9d\n"
+    "    movl $" STRINGIFY(PXS_AP_STATE_PARKED) ", 36(%rdi)\n"
+    "5:  movq (%rdi), %rax\n"
+    "    testq %rax, %rax\n"
+    "    jnz 7f\n"
+    "    testl $" STRINGIFY(PARK_FLAG_MWAIT) ", %r9d\n"
+    "    jz 6f\n"
+    "    movq %rdi, %rax\n"
+    "    xorl %ecx, %ecx\n"
+    "    xorl %edx, %edx\n"
+    "    monitor\n"
+    "    cmpq $0, (%rdi)\n"                      // Written before the monitor was armed
+    "    jne 5b\n"
+    "    xorl %eax, %eax\n"
+    "    mwait\n"
+    "    jmp 5b\n"
+    "6:  pause\n"
+    "    jmp 5b\n"
+    "7:  movq 8(%rdi), %rsp\n"
+    "    movq 16(%rdi), %r10\n"
+    "    movq 24(%rdi), %rdx\n"
+    "    movl 32(%rdi), %esi\n"
+    "    movl $" STRINGIFY(PXS_AP_STATE_RUNNING) ", 36(%rdi)\n"
+    "    movq %r10, %rdi\n"
+    "    testq %rdx, %rdx\n"
+    "    jz 8f\n"
+    "    movq %rdx, %cr3\n"
+    "8:  pushq $0\n"
+    "    jmp *%rax\n"
+    // Not in the table (disabled by the firmware, or a failed lookup)
+    "9:  cli\n"
+    "    hlt\n"
+    "    jmp 9b\n"
+    "PxsApTrampolineEnd:\n"
+    ".popsection\n"
+);
+
+// Linux skips the INIT settle time on these, and waits 10us after a SIPI
+// instead of 200us
+STATIC BOOLEAN HasShortDelays(VOID) {
+    UINT32 Ebx, Ecx, Edx, Eax;
+    AsmCpuid(0, NULL, &Ebx, &Ecx, &Edx);
+    BOOLEAN Intel = (Ebx == 0x756E6547 && Edx == 0x49656E69 && Ecx == 0x6C65746E);  // GenuineIntel
+    BOOLEAN Amd = (Ebx == 0x68747541 && Edx == 0x69746E65 && Ecx == 0x444D4163);    // AuthenticAMD
+
+    AsmCpuid(1, &Eax, NULL, NULL, NULL);
+    UINT32 Family = (Eax >> 8) & 0xF;
+    if (Family == 0xF) Family += (Eax >> 20) & 0xFF;
+    return (Intel && Family >= 6) || (Amd && Family >= 0xF);
+}
+
+EFI_STATUS SmpPrepare(
+    IN EFI_MP_SERVICES_PROTOCOL *Mp,
+    IN UINT64 TscFrequency,
+    OUT PXS_SMP *Smp,
+    OUT PXS_CPU_TABLE **Table
+) {
+    EFI_STATUS Status;
+    UINTN Total, Enabled;
+    PXS_CPU_TABLE *Cpus;
+    UINT32 Ecx, Edx, MaxLeaf;
+
+    SetMem(Smp, sizeof(*Smp), 0);
+    *Table = NULL;
+    if ((UINTN)(PxsApTrampolineEnd - PxsApTrampoline) > PARK_DATA_OFFSET) return EFI_UNSUPPORTED;
+    Smp->TscPerMicrosecond = TscFrequency / 1000000;
+    if (Smp->TscPerMicrosecond == 0) Smp->TscPerMicrosecond = DEFAULT_TSC_PER_US;
+    Smp->ShortDelays = HasShortDelays();
+
+    Status = Mp->GetNumberOfProcessors(Mp, &Total, &Enabled);
+    if (EFI_ERROR(Status)) return Status;
+
+    // Entries right behind the header, as the handoff arena keeps them
+    Status = gBS->AllocatePool(EfiLoaderData, sizeof(PXS_CPU_TABLE) + Total * sizeof(PXS_CPU), (VOID **)&Cpus);
+    if (EFI_ERROR(Status)) return EFI_OUT_OF_RESOURCES;
+    SetMem(Cpus, sizeof(PXS_CPU_TABLE) + Total * sizeof(PXS_CPU), 0);
+    Cpus->Version = PXS_CPU_TABLE_VERSION;
+    Cpus->CpuCount = (UINT32)Total;
+    Cpus->Cpus = (PXS_CPU *)(Cpus + 1);
+
+    for (UINTN i = 0; i < Total; i++) {
+        EFI_PROCESSOR_INFORMATION Info;
+        PXS_CPU *Cpu = &Cpus->Cpus[i];
+        if (EFI_ERROR(Mp->GetProcessorInfo(Mp, i, &Info))) continue;
+
+        Cpu->ApicId = (UINT32)Info.ProcessorId;
+        Cpu->Package = Info.Location.Package;
+        Cpu->Core = Info.Location.Core;
+        Cpu->Thread = Info.Location.Thread;
+        if (Info.StatusFlag & PROCESSOR_AS_BSP_BIT) Cpu->Flags |= PXS_CPU_FLAG_BSP;
+        if ((Info.StatusFlag & PROCESSOR_ENABLED_BIT) && (Info.StatusFlag & PROCESSOR_HEALTH_STATUS_BIT)) {
+            Cpu->Flags |= PXS_CPU_FLAG_ENABLED;
+            if (!(Cpu->Flags & PXS_CPU_FLAG_BSP)) Smp->ApCount++;
+        }
+    }
+    *Table = Cpus;
+    if (Smp->ApCount == 0) return EFI_SUCCESS;
+
+    // Trampoline page, one table per paging level above the 2 MiB page, mailboxes
+    UINT32 Levels = (AsmReadCr4() & CR4_LA57) ? 5 : 4;
+    UINTN TablePages = Levels - 1;
+    UINTN Pages = 1 + TablePages + EFI_SIZE_TO_PAGES(Smp->ApCount * sizeof(PXS_CPU_MAILBOX));
+    EFI_PHYSICAL_ADDRESS Base = PARK_BELOW;
+    Status = gBS->AllocatePages(AllocateMaxAddress, (EFI_MEMORY_TYPE)PXS_EFI_MEMORY_AP_PARK, Pages, &Base);
+    if (EFI_ERROR(Status)) {
+        Smp->ApCount = 0;
+        return EFI_OUT_OF_RESOURCES;
+    }
+    SetMem((VOID *)Base, EFI_PAGES_TO_SIZE(Pages), 0);
+    Smp->ParkBase = Base;
+    Smp->ParkSize = EFI_PAGES_TO_SIZE(Pages);
+    Cpus->ParkBase = Smp->ParkBase;
+    Cpus->ParkSize = Smp->ParkSize;
+
+    CopyMem((VOID *)Base, PxsApTrampoline, PxsApTrampolineEnd - PxsApTrampoline);
+
+    // Identity map the first 2 MiB, which holds the whole block
+    UINT64 *Tables = (UINT64 *)(Base + EFI_PAGE_SIZE);
+    for (UINTN i = 0; i + 1 < TablePages; i++) {
+        Tables[i * 512] = (UINT64)&Tables[(i + 1) * 512] | PXS_PTE_PRESENT | PXS_PTE_WRITE;
+    }
+    Tables[(TablePages - 1) * 512] = 0 | PXS_PTE_PRESENT | PXS_PTE_WRITE | PXS_PTE_LARGE;
+
+    PXS_CPU_MAILBOX *Mailboxes = (PXS_CPU_MAILBOX *)(Base + EFI_PAGES_TO_SIZE(1 + TablePages));
+    UINTN Next = 0;
+    for (UINTN i = 0; i < Total; i++) {
+        PXS_CPU *Cpu = &Cpus->Cpus[i];
+        if (!(Cpu->Flags & PXS_CPU_FLAG_ENABLED) || (Cpu->Flags & PXS_CPU_FLAG_BSP)) continue;
+        Mailboxes[Next].ApicId = Cpu->ApicId;
+        Cpu->Mailbox = (UINT64)&Mailboxes[Next];
+        Next++;
+    }
+
+    PARK_DATA *Data = (PARK_DATA *)(Base + PARK_DATA_OFFSET);
+    Data->Gdt[1] = 0x00CF9A000000FFFFULL;   // PARK_SEL_CODE32
+    Data->Gdt[2] = 0x00CF92000000FFFFULL;   // PARK_SEL_DATA
+    Data->Gdt[3] = 0x00AF9A000000FFFFULL;   // PARK_SEL_CODE64
+    Data->GdtLimit = sizeof(Data->Gdt) - 1;
+    Data->GdtBase = (UINT32)(Base + PARK_DATA_OFFSET + OFFSET_OF(PARK_DATA, Gdt));
+    Data->Far32Offset = (UINT32)(Base + (PxsApTrampoline32 - PxsApTrampoline));
+    Data->Far32Selector = PARK_SEL_CODE32;
+    Data->Far64Offset = (UINT32)(Base + (PxsApTrampoline64 - PxsApTrampoline));
+    Data->Far64Selector = PARK_SEL_CODE64;
+    Data->Cr3 = (UINT32)(UINTN)Tables;
+    Data->Cr4 = CR4_PAE | ((Levels == 5) ? CR4_LA57 : 0);
+    Data->EferSet = EFER_LME;
+    Data->Mailboxes = (UINT64)Mailboxes;
+    Data->MailboxCount = (UINT32)Smp->ApCount;
+    Data->Base = (UINT32)Base;
+
+    // NXE so the APs can run on the loader's page tables, which use NX
+    AsmCpuid(0x80000000, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf >= 0x80000001) {
+        AsmCpuid(0x80000001, NULL, NULL, NULL, &Edx);
+        if (Edx & (1U << 20)) Data->EferSet |= EFER_NXE;
+    }
+    AsmCpuid(1, NULL, NULL, &Ecx, &Edx);
+    if (Ecx & (1U << 3)) Data->Flags |= PARK_FLAG_MWAIT;
+    if (Edx & (1U << 16)) {
+        Data->Flags |= PARK_FLAG_PAT;
+        Smp->PatSupported = TRUE;
+        Smp->Pat = AsmReadMsr64(MSR_PAT);
+    }
+    return EFI_SUCCESS;
+}
+
+STATIC VOID SmpDelay(IN CONST PXS_SMP *Smp, IN UINT64 Microseconds) {
+    UINT64 End = __builtin_ia32_rdtsc() + Microseconds * Smp->TscPerMicrosecond;
+    while (__builtin_ia32_rdtsc() < End) CpuPause();
+}
+
+STATIC VOID SendIpi(IN UINT64 ApicBase, IN UINT32 ApicId, IN UINT32 Command) {
+    if (ApicBase & APIC_BASE_X2APIC) {
+        AsmWriteMsr64(MSR_X2APIC_ICR, ((UINT64)ApicId << 32) | Command);
+        return;
+    }
+    volatile UINT32 *Apic = (volatile UINT32 *)(UINTN)(ApicBase & APIC_BASE_ADDRESS);
+    Apic[XAPIC_ICR_HIGH / 4] = ApicId << 24;
+    Apic[XAPIC_ICR_LOW / 4] = Command;
+    while (Apic[XAPIC_ICR_LOW / 4] & ICR_BUSY) CpuPause();
+}
+
+// Send Command to every AP that has a mailbox
+STATIC VOID SendIpiAll(IN PXS_CPU_TABLE *Table, IN UINT64 ApicBase, IN UINT32 Command) {
+    for (UINT32 i = 0; i < Table->CpuCount; i++) {
+        if (Table->Cpus[i].Mailbox) SendIpi(ApicBase, Table->Cpus[i].ApicId, Command);
+    }
+}
+
+UINTN SmpPark(IN CONST PXS_SMP *Smp, IN OUT PXS_CPU_TABLE *Table) {
+    if (!Table || Smp->ApCount == 0) return 0;
+
+    PARK_DATA *Data = (PARK_DATA *)(Smp->ParkBase + PARK_DATA_OFFSET);
+    Data->Pat = Smp->Pat;
+
+    // All APs at once, so their delays overlap
+    UINT64 ApicBase = AsmReadMsr64(MSR_APIC_BASE);
+    UINT32 Vector = (UINT32)(Smp->ParkBase >> 12);
+    SendIpiAll(Table, ApicBase, ICR_INIT);
+    if (!Smp->ShortDelays) SmpDelay(Smp, 10000);
+    SendIpiAll(Table, ApicBase, ICR_STARTUP | Vector);
+    SmpDelay(Smp, Smp->ShortDelays ? 10 : 200);
+    SendIpiAll(Table, ApicBase, ICR_STARTUP | Vector);
+
+    UINTN Parked = 0;
+    UINT64 Deadline = __builtin_ia32_rdtsc() + PARK_WAIT_US * Smp->TscPerMicrosecond;
+    do {
+        Parked = 0;
+        for (UINT32 i = 0; i < Table->CpuCount; i++) {
+            PXS_CPU_MAILBOX *Mailbox = (PXS_CPU_MAILBOX *)Table->Cpus[i].Mailbox;
+            if (Mailbox && Mailbox->State == PXS_AP_STATE_PARKED) Parked++;
+        }
+        if (Parked == Smp->ApCount) break;
+        CpuPause();
+    } while (__builtin_ia32_rdtsc() < Deadline);
+
+    for (UINT32 i = 0; i < Table->CpuCount; i++) {
+        PXS_CPU_MAILBOX *Mailbox = (PXS_CPU_MAILBOX *)Table->Cpus[i].Mailbox;
+        if (Mailbox && Mailbox->State == PXS_AP_STATE_PARKED) Table->Cpus[i].Flags |= PXS_CPU_FLAG_PARKED;
+    }
+    return Parked;
+}
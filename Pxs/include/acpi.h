@@ -0,0 +1,31 @@
+/**
+ * @file acpi.h
+ * @brief ACPI table directory for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+/**
+ * Index the ACPI tables reachable from an RSDP: the XSDT (the RSDT when the
+ * RSDP has no usable XSDT), every table it lists, and the DSDT and FACS the
+ * FADT points to. Each table's checksum is verified; tables that fail it are
+ * still listed, with PXS_ACPI_TABLE_BAD_CHECKSUM. Entries whose header is
+ * shorter than an ACPI header are left out. Reads firmware memory only.
+ *
+ * With Tables == NULL only *Count is returned: an upper bound to size the
+ * buffer. Otherwise up to Capacity entries are written, sorted by Signature
+ * with Instance numbering repeats in root table order, and *Count is the
+ * final number.
+ *
+ * @retval EFI_SUCCESS           Tables indexed
+ * @retval EFI_NOT_FOUND         No valid RSDP, or it leads to no root table
+ * @retval EFI_BUFFER_TOO_SMALL  More than Capacity tables
+ */
+EFI_STATUS AcpiBuildIndex(
+    IN CONST VOID *Rsdp,
+    OUT PXS_ACPI_TABLE *Tables OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+);
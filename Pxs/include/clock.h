@@ -0,0 +1,20 @@
+/**
+ * @file clock.h
+ * @brief TSC and LAPIC timer rates for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+/**
+ * Fill Clocks with the TSC rate and what CPUID tells about the timers. The
+ * rate comes from the first that has it: the VMware timing leaf (under VMware,
+ * or KVM with vmware-cpuid-freq), CPUID 0x15 (with 0x16 when the crystal is
+ * not reported), a measurement against the ACPI PM timer in Fadt, or one
+ * against Stall(). A measurement stops once its error bound is small enough,
+ * within 10 ms. Needs boot services.
+ *
+ * @param Fadt  The FADT, or NULL to skip the PM timer
+ */
+VOID ClockCalibrate(IN CONST VOID *Fadt OPTIONAL, OUT PXS_CLOCKS *Clocks);
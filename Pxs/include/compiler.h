@@ -24,6 +24,7 @@
 #define __used          __attribute__((used))
 
 #define __optimize(x)   __attribute__((optimize(x)))
+#define __target(x)     __attribute__((target(x)))
 
 /* ========================
  * MEMORY / LAYOUT ATTRIBUTES
@@ -0,0 +1,29 @@
+/**
+ * @file cpio.h
+ * @brief newc cpio archive indexing for the initrd
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+/**
+ * Walk a newc ("070701" / "070702") archive, or several concatenated ones, and
+ * describe every member except the "." root and the trailers.
+ *
+ * With Entries == NULL only *Count is returned: an upper bound to size the
+ * buffer. Otherwise up to Capacity entries are written, sorted by path with
+ * duplicates resolved to the last occurrence, and *Count is the final number.
+ *
+ * @retval EFI_SUCCESS           Archive walked (trailing non-cpio data is ignored)
+ * @retval EFI_UNSUPPORTED       The data does not start with a newc header
+ * @retval EFI_VOLUME_CORRUPTED  A header or name runs past the end of the data
+ * @retval EFI_BUFFER_TOO_SMALL  More than Capacity entries
+ */
+EFI_STATUS CpioBuildIndex(
+    IN CONST VOID *Archive,
+    IN UINT64 Size,
+    OUT PXS_INITRD_FILE *Entries OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+);
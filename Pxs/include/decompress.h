@@ -0,0 +1,150 @@
+/**
+ * @file decompress.h
+ * @brief Block-at-a-time LZ4 / zstd decoders for compressed kernels and initrds
+ */
+#pragma once
+
+#include <Uefi.h>
+
+#define PXS_COMPRESSION_NONE       0
+#define PXS_COMPRESSION_LZ4        1  ///< LZ4 frame format (lz4 CLI default)
+#define PXS_COMPRESSION_LZ4_LEGACY 2  ///< LZ4 legacy format (lz4 -l, Linux initramfs)
+#define PXS_COMPRESSION_ZSTD       3
+
+// What the next DecompressStep() will consume
+#define PXS_DECOMPRESS_PHASE_FRAME   0  ///< Frame magic and header
+#define PXS_DECOMPRESS_PHASE_BLOCK   1  ///< One data block
+#define PXS_DECOMPRESS_PHASE_TRAILER 2  ///< End mark / content checksum
+#define PXS_DECOMPRESS_PHASE_SKIP    3  ///< Body of a skippable frame
+
+#define PXS_DECOMPRESS_UNKNOWN_SIZE  0xFFFFFFFFFFFFFFFFULL
+
+// Kinds of PXS_DECOMPRESS_UNIT
+#define PXS_DECOMPRESS_UNIT_FRAME      0  ///< A whole frame, decoded from its header
+#define PXS_DECOMPRESS_UNIT_LZ4_BLOCK  1  ///< One independent LZ4 block, without its size word
+#define PXS_DECOMPRESS_UNIT_RAW        2  ///< Stored bytes (uncompressed LZ4 block)
+
+// A piece of a compressed image that decodes without the rest of it
+typedef struct {
+    UINT64  InOffset;
+    UINT64  InSize;
+    UINT64  OutSize;           ///< Bytes it decodes to; an LZ4 block that does not end its frame is taken to be full
+    UINT32  Kind;              ///< PXS_DECOMPRESS_UNIT_*
+    UINT32  Format;            ///< PXS_COMPRESSION_* of the enclosing stream
+    BOOLEAN Bounded;           ///< OutSize is only an upper bound (last block of a frame of unknown size)
+} PXS_DECOMPRESS_UNIT;
+
+typedef struct {
+    UINT32  Format;            ///< PXS_COMPRESSION_*
+    UINT32  Phase;             ///< PXS_DECOMPRESS_PHASE_*
+    UINT64  FrameContentSize;  ///< Size declared by the current frame header, or UNKNOWN
+    UINTN   WindowSize;        ///< History the output buffer must retain between blocks
+    UINTN   MaxBlockSize;      ///< Upper bound on the output of one block
+    UINT64  FrameOutput;       ///< Bytes the current frame has produced so far
+    UINT64  SkipRemaining;
+    UINT32  Flags;             ///< Format specific frame flags
+    VOID    *Context;          ///< Format specific decoder state
+} PXS_DECOMPRESSOR;
+
+/**
+ * Identify a compressed stream from its first bytes.
+ * @return PXS_COMPRESSION_* (NONE for anything unrecognised)
+ */
+UINT32 DecompressDetect(IN CONST VOID *Data, IN UINTN Size);
+
+EFI_STATUS DecompressInit(OUT PXS_DECOMPRESSOR *Dec, IN UINT32 Format);
+VOID DecompressFree(IN PXS_DECOMPRESSOR *Dec);
+
+/**
+ * Decode one unit (frame header, block or trailer) from In.
+ *
+ * Output is appended at Out[OutPos]; everything before OutPos is history that
+ * back-references may point into. The caller keeps at least WindowSize bytes
+ * of history and, unless the frame size is known, MaxBlockSize bytes of room.
+ *
+ * @retval EFI_SUCCESS           *InUsed bytes consumed, *OutUsed bytes produced
+ * @retval EFI_BUFFER_TOO_SMALL  In holds less than the unit; *Needed is its size
+ * @retval EFI_VOLUME_CORRUPTED  Malformed stream or output overflow
+ * @retval EFI_UNSUPPORTED       Valid stream using an unsupported feature
+ */
+EFI_STATUS DecompressStep(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN UINTN InSize,
+    OUT UINTN *InUsed,
+    IN OUT UINT8 *Out,
+    IN UINTN OutPos,
+    IN UINTN OutCap,
+    OUT UINTN *OutUsed,
+    OUT UINTN *Needed
+);
+
+/**
+ * TRUE when the stream may legitimately end here (between frames).
+ */
+BOOLEAN DecompressAtBoundary(IN CONST PXS_DECOMPRESSOR *Dec);
+
+/**
+ * Find the next piece of the stream that decodes on its own -- a zstd frame
+ * or dependent-block LZ4 frame that declares its content size, or a legacy or
+ * independent-block LZ4 block -- starting where Dec stands, with In holding
+ * the stream from there on. Skippable frames, end marks and trailers on the
+ * way are stepped over. Only the framing fields of Dec are read and advanced,
+ * never its decoder context, so the serial decoder's own state can be walked
+ * ahead on a copy.
+ *
+ * Remaining is the number of stream bytes from In[0] to the end of the stream
+ * (at least InSize). A frame unit is only cut out once all of it is in In;
+ * until then *Needed asks for its worst-case size, so that a caller which
+ * cannot see a frame end before the stream does need not read that far.
+ *
+ * @retval EFI_SUCCESS           *Unit (InOffset relative to In) ends at In[*InUsed]; Dec moved past it
+ * @retval EFI_BUFFER_TOO_SMALL  In[0..*Needed) is wanted; Unit->OutSize is set if its header was seen
+ * @retval EFI_END_OF_FILE       The stream ends here
+ * @retval EFI_UNSUPPORTED       What follows only decodes in order with what precedes it
+ * @retval EFI_VOLUME_CORRUPTED  Malformed framing
+ */
+EFI_STATUS DecompressNextUnit(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN UINTN InSize,
+    IN UINT64 Remaining,
+    OUT UINTN *InUsed,
+    OUT PXS_DECOMPRESS_UNIT *Unit,
+    OUT UINTN *Needed
+);
+
+/**
+ * Decode one unit found in In into Out[0..Unit->OutSize). Dec comes from
+ * DecompressInit() for the image's format and may be reused for further units.
+ * Uses no boot services, so it can run on an application processor.
+ */
+EFI_STATUS DecompressUnit(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN CONST PXS_DECOMPRESS_UNIT *Unit,
+    OUT UINT8 *Out,
+    OUT UINT64 *Produced
+);
+
+// Format back ends (internal to the decompressor)
+EFI_STATUS Lz4Step(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINTN *InUsed,
+                   UINT8 *Out, UINTN OutPos, UINTN OutCap, UINTN *OutUsed, UINTN *Needed);
+EFI_STATUS Lz4NextUnit(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINT64 Remaining,
+                       UINTN *Pos, PXS_DECOMPRESS_UNIT *Unit, UINTN *Needed);
+EFI_STATUS Lz4DecodeUnit(CONST UINT8 *In, UINTN InSize, UINT8 *Out, UINTN OutCap, UINTN *Produced);
+EFI_STATUS ZstdInit(PXS_DECOMPRESSOR *Dec);
+VOID ZstdFree(PXS_DECOMPRESSOR *Dec);
+EFI_STATUS ZstdStep(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINTN *InUsed,
+                    UINT8 *Out, UINTN OutPos, UINTN OutCap, UINTN *OutUsed, UINTN *Needed);
+EFI_STATUS ZstdNextUnit(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINT64 Remaining,
+                        UINTN *Pos, PXS_DECOMPRESS_UNIT *Unit, UINTN *Needed);
+
+// Back ends return EFI_NOT_FOUND from *NextUnit after framing that holds no unit.
+// While a frame unit is incomplete, ask for its worst case: ContentSize plus
+// Overhead bytes from Start, capped at the end of the stream.
+EFI_STATUS DecompressNeedFrame(UINTN Start, UINT64 ContentSize, UINT64 Overhead,
+                               UINTN InSize, UINT64 Remaining, UINTN *Needed);
+
+// Copy an LZ77 match of Length bytes from Distance bytes back; handles overlap
+VOID DecompressCopyMatch(UINT8 *Op, UINTN Distance, UINTN Length);
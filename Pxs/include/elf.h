@@ -76,10 +76,71 @@ typedef struct {
 
 // Segment Types
 #define PT_LOAD       1
+#define PT_DYNAMIC    2
 
 // Segment Flags
 #define PF_X          1
 #define PF_W          2
 #define PF_R          4
 
+// Dynamic Section Entry
+typedef struct {
+    Elf64_Sxword  d_tag;
+    Elf64_Xword   d_val;
+} Elf64_Dyn;
+
+// Dynamic Tags
+#define DT_NULL       0
+#define DT_PLTRELSZ   2
+#define DT_RELA       7
+#define DT_RELASZ     8
+#define DT_RELAENT    9
+#define DT_REL        17
+#define DT_RELSZ      18
+#define DT_RELRSZ     35
+#define DT_RELR       36
+#define DT_RELRENT    37
+
+// Relocation With Addend
+typedef struct {
+    Elf64_Addr    r_offset;
+    Elf64_Xword   r_info;
+    Elf64_Sxword  r_addend;
+} Elf64_Rela;
+
+#define ELF64_R_TYPE(Info) ((UINT32)(Info))
+
+// Relocation Types
+#define R_X86_64_NONE      0
+#define R_X86_64_RELATIVE  8
+
+// Relocation (lib/elf.c)
+
+/**
+ * Apply the relative relocations of a position independent image loaded in
+ * one block, from the DT_RELA and DT_RELR tables its dynamic section names.
+ * Every relocated word gets Slide (run address minus link address) added.
+ *
+ * @param Image            The image, loaded so link address LinkBase is at Image
+ * @param ImageSize        Bytes loaded at Image
+ * @param LinkBase         Link address of the first byte at Image
+ * @param DynamicAddress   Link address of the PT_DYNAMIC segment
+ * @param DynamicSize      Size of the PT_DYNAMIC segment
+ * @param Slide            Value added to every relocated word
+ * @param Count            Number of words relocated
+ *
+ * @retval EFI_SUCCESS       Relocated (also when the image has no relocations)
+ * @retval EFI_UNSUPPORTED   A relocation needs symbol lookup, or the image uses DT_REL
+ * @retval EFI_LOAD_ERROR    A table or relocation target lies outside the image
+ */
+EFI_STATUS ElfRelocate(
+    IN OUT VOID *Image,
+    IN UINT64 ImageSize,
+    IN UINT64 LinkBase,
+    IN UINT64 DynamicAddress,
+    IN UINT64 DynamicSize,
+    IN UINT64 Slide,
+    OUT UINTN *Count
+);
+
 #endif // PXS_ELF_H
@@ -0,0 +1,15 @@
+/**
+ * @file hex.h
+ * @brief Hex digits, for the config file, the cpio headers and part: sources
+ */
+#pragma once
+
+#include <Uefi.h>
+
+/**
+ * Value of the hex digit Char, in either case; CHAR8 and CHAR16 both widen
+ * to it.
+ *
+ * @return 0 to 15, or -1 if Char is not a hex digit
+ */
+INTN HexDigit(IN UINT32 Char);
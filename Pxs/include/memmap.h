@@ -0,0 +1,30 @@
+/**
+ * @file memmap.h
+ * @brief Normalized memory map for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+/**
+ * Convert a firmware memory map into PXS_MEMORY_RANGE entries: types collapsed
+ * to PXS_MEMORY_*, sorted by address, overlaps trimmed and adjacent ranges of
+ * the same type and flags merged. Uses no boot services, so it can run after
+ * ExitBootServices on storage reserved beforehand.
+ *
+ * @param Entries   Output storage, at least one entry per descriptor
+ * @param Capacity  Number of entries at Entries
+ * @param Count     Number of entries written
+ *
+ * @retval EFI_SUCCESS           Map normalized
+ * @retval EFI_BUFFER_TOO_SMALL  The map has more than Capacity descriptors
+ */
+EFI_STATUS MemoryMapNormalize(
+    IN CONST EFI_MEMORY_DESCRIPTOR *Map,
+    IN UINTN MapSize,
+    IN UINTN DescriptorSize,
+    OUT PXS_MEMORY_RANGE *Entries,
+    IN UINTN Capacity,
+    OUT UINTN *Count
+);
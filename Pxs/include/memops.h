@@ -0,0 +1,33 @@
+/**
+ * @file memops.h
+ * @brief Bulk copy and fill for image-sized buffers
+ */
+#pragma once
+
+#include <Uefi.h>
+
+/**
+ * Probe the CPU (CPUID and XCR0) and choose how large copies and fills are
+ * done. Until this runs every call goes to BaseMemoryLib. *Name is set to a
+ * short description for the console.
+ */
+VOID MemOpsInit(OUT CONST CHAR16 **Name);
+
+/**
+ * Bytes at or above which stores bypass the cache. Derived from the size of
+ * the last level cache: a buffer that does not fit would only evict useful
+ * lines on its way to memory.
+ */
+UINTN MemOpsStreamingThreshold(VOID);
+
+/**
+ * CopyMem() for large buffers. Small copies and overlapping ones that must run
+ * backwards go to CopyMem(). Copies of at least the streaming threshold use
+ * non-temporal stores, so the destination is not cached afterwards.
+ */
+VOID *BulkCopyMem(OUT VOID *Destination, IN CONST VOID *Source, IN UINTN Length);
+
+/**
+ * SetMem() for large buffers, with the same size classes as BulkCopyMem().
+ */
+VOID *BulkSetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value);
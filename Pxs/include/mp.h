@@ -0,0 +1,33 @@
+/**
+ * @file mp.h
+ * @brief Work pool over the firmware's application processors
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <Protocol/MpService.h>
+
+/**
+ * Process item Item of a batch. Worker is the calling CPU's processor number
+ * (below PXS_WORK_POOL.Workers), for indexing per-CPU scratch state. Runs on
+ * APs: must not call boot services or print.
+ */
+typedef VOID (*PXS_WORK_FUNC)(IN VOID *Context, IN UINTN Item, IN UINTN Worker);
+
+typedef struct {
+    EFI_MP_SERVICES_PROTOCOL *Mp;   ///< NULL when running on the BSP alone
+    UINTN                    Workers;  ///< Processor numbers in use, BSP included
+    UINTN                    Enabled;  ///< CPUs that take work
+} PXS_WORK_POOL;
+
+/**
+ * Locate MP services. Without them, or with no enabled APs, the pool runs
+ * every batch on the BSP.
+ */
+VOID WorkPoolInit(OUT PXS_WORK_POOL *Pool);
+
+/**
+ * Run Func for items 0..Items-1 on every enabled CPU and return once all are
+ * done. Items are handed out one at a time, so uneven items balance themselves.
+ */
+VOID WorkPoolRun(IN PXS_WORK_POOL *Pool, IN PXS_WORK_FUNC Func, IN VOID *Context, IN UINTN Items);
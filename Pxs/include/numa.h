@@ -0,0 +1,38 @@
+/**
+ * @file numa.h
+ * @brief NUMA node table from the ACPI SRAT and SLIT
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+/**
+ * Build the node table of an SRAT: one node per proximity domain that an
+ * enabled processor or memory affinity entry names, and each enabled memory
+ * entry as a range of its node. Disabled entries are ignored. BspApicId is the
+ * boot CPU's initial (x2)APIC ID, which picks BspNode. Distances is left
+ * alone; see NumaReadDistances(). Reads firmware memory only.
+ *
+ * With Numa->Nodes == NULL, NodeCount and RangeCount are set to upper bounds
+ * to size the buffers. Otherwise NodeCount and RangeCount give the room in
+ * Nodes and Ranges, and are replaced by the final counts.
+ *
+ * @retval EFI_SUCCESS           Table built (or counted)
+ * @retval EFI_NOT_FOUND         Srat is not an SRAT
+ * @retval EFI_BUFFER_TOO_SMALL  Nodes or Ranges have too little room
+ */
+EFI_STATUS NumaBuildTable(
+    IN CONST VOID *Srat,
+    IN UINT32 BspApicId,
+    IN OUT PXS_NUMA *Numa
+);
+
+/**
+ * Fill Numa->Distances, NodeCount squared bytes, from a SLIT. Pairs of nodes
+ * whose domains the SLIT does not cover get 0.
+ *
+ * @retval EFI_SUCCESS    Distances filled in
+ * @retval EFI_NOT_FOUND  Slit is not a SLIT, or is too short for its size
+ */
+EFI_STATUS NumaReadDistances(IN CONST VOID *Slit, IN OUT PXS_NUMA *Numa);
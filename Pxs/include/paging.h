@@ -0,0 +1,86 @@
+/**
+ * @file paging.h
+ * @brief x86-64 page table construction for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+
+// Page table entry bits
+#define PXS_PTE_PRESENT   (1ULL << 0)
+#define PXS_PTE_WRITE     (1ULL << 1)
+#define PXS_PTE_PWT       (1ULL << 3)
+#define PXS_PTE_PCD       (1ULL << 4)
+#define PXS_PTE_LARGE     (1ULL << 7)   ///< PS: 2M (PD) or 1G (PDPT) page
+#define PXS_PTE_PAT_4K    (1ULL << 7)   ///< PAT bit of a 4K entry
+#define PXS_PTE_GLOBAL    (1ULL << 8)
+#define PXS_PTE_PAT_LARGE (1ULL << 12)  ///< PAT bit of a 2M/1G entry
+#define PXS_PTE_NX        (1ULL << 63)
+#define PXS_PTE_ADDRESS   0x000FFFFFFFFFF000ULL
+
+// PagingMap() attributes
+#define PXS_MAP_WRITE     0x01
+#define PXS_MAP_EXEC      0x02
+#define PXS_MAP_NO_LARGE  0x04  ///< Force 4K pages
+#define PXS_MAP_GLOBAL    0x08
+#define PXS_MAP_WC        0x10  ///< Write-combining through PAT entry PXS_PAT_WC_INDEX
+#define PXS_MAP_UC        0x20  ///< Uncached (PCD + PWT), for device memory
+
+// IA32_PAT entry PagingActivate() sets to write-combining. Selected by PAT=1,
+// PCD=0, PWT=1; its power-on type is write-through, which firmware rarely uses.
+#define PXS_PAT_WC_INDEX  5
+
+#define PXS_SIZE_2M 0x200000ULL
+#define PXS_SIZE_1G 0x40000000ULL
+
+/**
+ * Supplies page table batches: Pages pages of EfiLoaderData at *Address.
+ */
+typedef EFI_STATUS (*PXS_PAGING_ALLOCATE)(IN UINTN Pages, OUT EFI_PHYSICAL_ADDRESS *Address);
+
+typedef struct {
+    UINT64  Root;         ///< Physical address of the PML4 (or PML5)
+    UINT32  Levels;       ///< 4, or 5 when the firmware already runs with LA57
+    BOOLEAN Huge1G;       ///< CPU supports 1 GiB pages
+    BOOLEAN NxSupported;  ///< EFER.NXE can be set
+    BOOLEAN PatSupported; ///< PXS_MAP_WC is honoured (otherwise mapped uncached)
+    BOOLEAN UsesWc;       ///< Some mapping has PXS_MAP_WC
+    UINTN   TablePages;   ///< Pages used by tables so far
+    UINT64  Pool;         ///< Next free page of the current table batch
+    UINTN   PoolPages;    ///< Pages left in the current table batch
+    PXS_PAGING_ALLOCATE Allocate; ///< Where batches come from, NULL for anywhere
+} PXS_PAGE_TABLES;
+
+/**
+ * Allocate an empty root table and probe CPU paging features. Tables are
+ * taken from Allocate, or from anywhere when it is NULL. Needs boot services.
+ */
+EFI_STATUS PagingInit(OUT PXS_PAGE_TABLES *Tables, IN PXS_PAGING_ALLOCATE Allocate OPTIONAL);
+
+/**
+ * Map [Virt, Virt + Size) to [Phys, Phys + Size) with PXS_MAP_* attributes.
+ * Uses the largest page size that alignment and CPU features allow and splits
+ * existing large pages where a smaller mapping overlaps them. Later mappings
+ * replace earlier ones. Needs boot services (tables are allocated on demand).
+ */
+EFI_STATUS PagingMap(
+    IN OUT PXS_PAGE_TABLES *Tables,
+    IN UINT64 Virt,
+    IN UINT64 Phys,
+    IN UINT64 Size,
+    IN UINT32 Attributes
+);
+
+/**
+ * The IA32_PAT value PagingActivate() loads in place of Pat: entry
+ * PXS_PAT_WC_INDEX becomes WC if any mapping needs it, the rest is kept.
+ */
+UINT64 PagingPat(IN CONST PXS_PAGE_TABLES *Tables, IN UINT64 Pat);
+
+/**
+ * Enable EFER.NXE if supported, set PAT entry PXS_PAT_WC_INDEX to WC if any
+ * mapping needs it, and load CR3 (flushing global pages too). The caller must
+ * be running on memory that is identity mapped in Tables. Only the calling
+ * CPU is changed; other CPUs can load PagingPat() themselves.
+ */
+VOID PagingActivate(IN CONST PXS_PAGE_TABLES *Tables);
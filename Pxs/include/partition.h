@@ -0,0 +1,56 @@
+/**
+ * @file partition.h
+ * @brief part:<GUID>[:offset] image sources and their extent header
+ */
+#pragma once
+
+#include <Uefi.h>
+
+#define PXS_PARTITION_PREFIX  L"part:"
+
+#define PXS_EXTENT_MAGIC      "PXSEXTNT"
+#define PXS_EXTENT_VERSION    1
+
+/**
+ * Optional header at the offset a part: source names, marking a preallocated
+ * contiguous extent: the image is DataSize bytes that start DataOffset bytes
+ * after the header. Without one the image runs from the offset to the end of
+ * the partition. Little-endian.
+ */
+typedef struct {
+    CHAR8  Magic[8];      ///< PXS_EXTENT_MAGIC, not NUL-terminated
+    UINT32 Version;       ///< PXS_EXTENT_VERSION
+    UINT32 HeaderSize;    ///< sizeof(PXS_EXTENT_HEADER)
+    UINT64 DataOffset;    ///< From the start of the header, at least HeaderSize
+    UINT64 DataSize;
+} PXS_EXTENT_HEADER;
+
+/**
+ * Whether Path names a part: source rather than a file on the boot volume
+ */
+BOOLEAN PartitionIsSource(IN CONST CHAR16 *Path);
+
+/**
+ * Parse "part:<GUID>[:offset]". The GUID is the GPT unique partition GUID in
+ * the usual 8-4-4-4-12 hex form (Linux's PARTUUID); the offset is decimal with
+ * an optional K, M or G suffix, or 0x hex, and defaults to 0.
+ *
+ * @return FALSE if Path is not a part: source or is malformed
+ */
+BOOLEAN PartitionParseSource(IN CONST CHAR16 *Path, OUT EFI_GUID *Guid, OUT UINT64 *Offset);
+
+/**
+ * Check the extent header that may start Data. Room is how many bytes of the
+ * partition follow the header's offset.
+ *
+ * @retval EFI_SUCCESS           DataOffset and DataSize set, within Room
+ * @retval EFI_NOT_FOUND         No header: the data is raw
+ * @retval EFI_UNSUPPORTED       A header of another version
+ * @retval EFI_VOLUME_CORRUPTED  The header is malformed or overruns Room
+ */
+EFI_STATUS PartitionParseExtent(
+    IN CONST VOID *Data,
+    IN UINT64 Room,
+    OUT UINT64 *DataOffset,
+    OUT UINT64 *DataSize
+);
@@ -6,7 +6,131 @@
 #include <Uefi.h>
 
 #define PXS_MAGIC 0x28082012
-#define PXS_PROTOCOL_VERSION 1
+#define PXS_PROTOCOL_VERSION 14
+
+// Boot stages recorded in PXS_BOOT_TIMING
+#define PXS_STAGE_VOLUME_OPEN        1
+#define PXS_STAGE_CONFIG             2
+#define PXS_STAGE_INITRD             3
+#define PXS_STAGE_KERNEL             4
+#define PXS_STAGE_GRAPHICS           5
+#define PXS_STAGE_SYSTEM_TABLES      6
+#define PXS_STAGE_TIMEOUT            7
+#define PXS_STAGE_MEMORY_MAP         8
+#define PXS_STAGE_EXIT_BOOT_SERVICES 9
+#define PXS_STAGE_MODULES            10
+#define PXS_STAGE_PAGING             11
+#define PXS_STAGE_SMP                12
+#define PXS_STAGE_CLOCKS             13
+
+// PXS_BOOT_INFO.Flags
+#define PXS_FLAG_PAGING        0x00000001  ///< Entered on loader-built page tables
+#define PXS_FLAG_KERNEL_SHA256 0x00000002  ///< KernelSha256 matched KERNEL_SHA256=
+#define PXS_FLAG_INITRD_SHA256 0x00000004  ///< InitrdSha256 matched INITRD_SHA256=
+
+#define PXS_TIMING_VERSION     1
+#define PXS_TIMING_MAX_ENTRIES 32
+
+#define PXS_INITRD_INDEX_VERSION 1
+
+#define PXS_MODULE_TABLE_VERSION 1
+#define PXS_MODULE_NAME_SIZE     64
+
+#define PXS_MEMORY_MAP_VERSION 1
+
+#define PXS_LOG_VERSION   1
+#define PXS_LOG_CAPACITY  256  ///< Records the loader keeps; older ones are overwritten
+#define PXS_LOG_TEXT_SIZE 116
+
+// PXS_LOG_RECORD.Level
+#define PXS_LOG_ERROR   1
+#define PXS_LOG_WARNING 2
+#define PXS_LOG_INFO    3
+#define PXS_LOG_VERBOSE 4
+
+// PXS_LOG_RECORD.Flags
+#define PXS_LOG_FLAG_CONSOLE   0x01  ///< Also written to the firmware console
+#define PXS_LOG_FLAG_TRUNCATED 0x02  ///< The message did not fit in Text
+
+#define PXS_CPU_TABLE_VERSION 1
+
+// PXS_CPU.Flags
+#define PXS_CPU_FLAG_BSP     0x00000001  ///< Runs the kernel entry point
+#define PXS_CPU_FLAG_ENABLED 0x00000002  ///< Enabled and healthy as the firmware reports it
+#define PXS_CPU_FLAG_PARKED  0x00000004  ///< Waiting on its mailbox
+
+// PXS_CPU_MAILBOX.State, written by the AP
+#define PXS_AP_STATE_STARTING 0
+#define PXS_AP_STATE_PARKED   1
+#define PXS_AP_STATE_RUNNING  2  ///< Took EntryPoint
+
+#define PXS_FIRMWARE_TABLES_VERSION 1
+
+// PXS_ACPI_TABLE.Flags
+#define PXS_ACPI_TABLE_BAD_CHECKSUM 0x01  ///< Bytes do not sum to 0; listed anyway
+#define PXS_ACPI_TABLE_NO_CHECKSUM  0x02  ///< FACS, which has none
+
+// PXS_ACPI_TABLE.Signature of a four-character ACPI signature
+#define PXS_ACPI_SIGNATURE(A, B, C, D) \
+    ((UINT32)(A) | ((UINT32)(B) << 8) | ((UINT32)(C) << 16) | ((UINT32)(D) << 24))
+
+#define PXS_NUMA_VERSION 1
+#define PXS_NUMA_NO_NODE 0xFFFFFFFF
+
+// PXS_NUMA_RANGE.Flags, from the SRAT memory affinity entry
+#define PXS_NUMA_RANGE_HOTPLUG     0x01
+#define PXS_NUMA_RANGE_NONVOLATILE 0x02
+
+#define PXS_CLOCKS_VERSION 1
+
+// PXS_CLOCKS.TscSource, best first
+#define PXS_CLOCK_SOURCE_NONE       0
+#define PXS_CLOCK_SOURCE_HYPERVISOR 1  ///< CPUID 0x40000010 timing leaf (kHz)
+#define PXS_CLOCK_SOURCE_CPUID      2  ///< CPUID 0x15 crystal and TSC ratio
+#define PXS_CLOCK_SOURCE_CPUID_BASE 3  ///< CPUID 0x15 ratio, crystal from the 0x16 base frequency (MHz)
+#define PXS_CLOCK_SOURCE_PM_TIMER   4  ///< Measured against the ACPI PM timer
+#define PXS_CLOCK_SOURCE_STALL      5  ///< Measured against the firmware's Stall()
+
+// PXS_CLOCKS.Flags, from CPUID
+#define PXS_CLOCK_INVARIANT_TSC 0x01  ///< Constant rate in every P-, C- and T-state
+#define PXS_CLOCK_TSC_DEADLINE  0x02  ///< LAPIC timer has TSC-deadline mode
+#define PXS_CLOCK_APIC_ARAT     0x04  ///< LAPIC timer keeps running in deep C-states
+
+// PXS_MEMORY_RANGE.Type
+#define PXS_MEMORY_USABLE           1
+#define PXS_MEMORY_RECLAIMABLE      2  ///< Firmware boot services; holds the entry stack
+#define PXS_MEMORY_LOADER           3  ///< Loader image, pool and page tables
+#define PXS_MEMORY_RESERVED         4
+#define PXS_MEMORY_ACPI_RECLAIMABLE 5
+#define PXS_MEMORY_ACPI_NVS         6
+#define PXS_MEMORY_MMIO             7
+#define PXS_MEMORY_KERNEL           8  ///< Kernel segments
+#define PXS_MEMORY_MODULE           9  ///< Initrd and MODULE= files
+#define PXS_MEMORY_HANDOFF          10 ///< Boot info arena, see PXS_BOOT_INFO.HandoffBase
+#define PXS_MEMORY_AP_PARK          11 ///< Parked AP code and mailboxes, see PXS_CPU_TABLE
+
+// EFI memory types of the loader's own allocations, from the range UEFI sets
+// aside for OS loaders. They appear in PXS_BOOT_INFO.MemoryMap as is.
+#define PXS_EFI_MEMORY_KERNEL  0x80000001
+#define PXS_EFI_MEMORY_MODULE  0x80000002
+#define PXS_EFI_MEMORY_HANDOFF 0x80000003
+#define PXS_EFI_MEMORY_AP_PARK 0x80000004
+
+// PXS_MEMORY_RANGE.Flags
+#define PXS_MEMORY_FLAG_RUNTIME 0x00000001  ///< Used by runtime services
+
+// PXS_FRAMEBUFFER_INFO.CacheType (Version >= 9; 0 before)
+#define PXS_FRAMEBUFFER_CACHE_UNKNOWN 0
+#define PXS_FRAMEBUFFER_CACHE_UC      1
+#define PXS_FRAMEBUFFER_CACHE_WC      2  ///< See PXS_BOOT_INFO.Framebuffer
+#define PXS_FRAMEBUFFER_CACHE_WT      3
+#define PXS_FRAMEBUFFER_CACHE_WB      4
+
+// File type bits of PXS_INITRD_FILE.Mode (as in st_mode)
+#define PXS_INITRD_S_IFMT  0170000
+#define PXS_INITRD_S_IFDIR 0040000
+#define PXS_INITRD_S_IFREG 0100000
+#define PXS_INITRD_S_IFLNK 0120000
 
 typedef struct {
     UINT64 BaseAddress;
@@ -22,15 +146,211 @@ typedef struct {
     UINT8  BlueFieldPosition;
     UINT8  ReservedMaskSize;
     UINT8  ReservedFieldPosition;
+    UINT8  CacheType;              ///< PXS_FRAMEBUFFER_CACHE_*
+    UINT8  Reserved[3];
 } PXS_FRAMEBUFFER_INFO;
 
+typedef struct {
+    UINT32 Stage;           ///< PXS_STAGE_*
+    UINT32 ReadCalls;       ///< File Read() calls issued during the stage
+    UINT64 TscStart;
+    UINT64 TscEnd;
+    UINT64 BytesRead;
+    UINT64 BytesPerSecond;  ///< Effective read throughput, 0 if unknown
+} PXS_TIMING_ENTRY;
+
+typedef struct {
+    UINT32           Version;        ///< PXS_TIMING_VERSION
+    UINT32           EntryCount;
+    UINT64           TscFrequency;   ///< Hz, 0 if unknown
+    UINT64           TscLoaderEntry; ///< TSC on entry to the loader
+    UINT64           TscKernelEntry; ///< TSC just before the jump to the kernel
+    PXS_TIMING_ENTRY Entries[PXS_TIMING_MAX_ENTRIES];
+} PXS_BOOT_TIMING;
+
+typedef struct {
+    UINT64 PathOffset;  ///< Offset of the NUL-terminated path from InitrdAddress, no leading "./" or "/"
+    UINT64 DataOffset;  ///< Offset of the file contents (symlink target for links) from InitrdAddress
+    UINT64 DataSize;
+    UINT32 PathLength;  ///< Excluding the NUL
+    UINT32 Mode;        ///< st_mode: type and permission bits
+} PXS_INITRD_FILE;
+
+// Entries are sorted by path (bytewise, shorter first on a common prefix).
+// When an archive lists a path twice, only the last occurrence is kept.
+typedef struct {
+    UINT32          Version;     ///< PXS_INITRD_INDEX_VERSION
+    UINT32          EntryCount;
+    PXS_INITRD_FILE *Entries;
+} PXS_INITRD_INDEX;
+
+typedef struct {
+    UINT64 Address;                    ///< Physical address, a multiple of Alignment
+    UINT64 Size;                       ///< Module bytes (decompressed); the tail up to Alignment is zeroed
+    UINT64 Alignment;                  ///< 4K by default, or as requested by MODULE=...,align=
+    CHAR8  Name[PXS_MODULE_NAME_SIZE]; ///< NUL-terminated
+} PXS_MODULE;
+
+typedef struct {
+    UINT32      Version;      ///< PXS_MODULE_TABLE_VERSION
+    UINT32      ModuleCount;
+    PXS_MODULE *Modules;      ///< In config order
+} PXS_MODULE_TABLE;
+
+typedef struct {
+    UINT64 Base;
+    UINT64 Length;
+    UINT32 Type;    ///< PXS_MEMORY_*
+    UINT32 Flags;   ///< PXS_MEMORY_FLAG_*
+} PXS_MEMORY_RANGE;
+
+// Sorted by Base, non-overlapping, with adjacent ranges of equal Type and Flags merged
+typedef struct {
+    UINT32           Version;     ///< PXS_MEMORY_MAP_VERSION
+    UINT32           EntryCount;
+    PXS_MEMORY_RANGE *Entries;
+} PXS_MEMORY_MAP;
+
+typedef struct {
+    UINT64 Tsc;                      ///< rdtsc when logged; PXS_BOOT_TIMING.TscFrequency converts
+    UINT16 Length;                   ///< Bytes of Text before the NUL
+    UINT8  Level;                    ///< PXS_LOG_*
+    UINT8  Flags;                    ///< PXS_LOG_FLAG_*
+    CHAR8  Text[PXS_LOG_TEXT_SIZE];  ///< One line, NUL-terminated, no newline
+} PXS_LOG_RECORD;
+
+// Ring of the loader's messages. Record i (counting from 0 over the whole
+// boot) is Records[i % Capacity]; the last min(Written, Capacity) are valid.
+typedef struct {
+    UINT32         Version;     ///< PXS_LOG_VERSION
+    UINT32         Capacity;
+    UINT64         Written;     ///< Records logged, including overwritten ones
+    PXS_LOG_RECORD *Records;
+} PXS_LOG;
+
+// One per parked AP, each in its own 64-byte line, which the AP watches with
+// MONITOR/MWAIT where the CPU has them (otherwise it spins with PAUSE). To
+// start it, write StackPointer, Argument and PageTable, then EntryPoint. The
+// AP loads CR3 from PageTable unless it is 0, sets RSP to StackPointer, pushes
+// a 0 return address and jumps to EntryPoint in 64-bit mode with interrupts
+// off, RDI = Argument and RSI = its APIC ID. PageTable must map the first
+// page of PXS_CPU_TABLE.ParkBase to itself and must map the stack. The park
+// page tables only identity map the first 2 MiB.
+typedef struct {
+    volatile UINT64 EntryPoint;
+    volatile UINT64 StackPointer;
+    volatile UINT64 Argument;
+    volatile UINT64 PageTable;
+    UINT32          ApicId;
+    volatile UINT32 State;      ///< PXS_AP_STATE_*
+    UINT64          Reserved[3];
+} PXS_CPU_MAILBOX;
+
+typedef struct {
+    UINT32 ApicId;     ///< Initial (x2)APIC ID
+    UINT32 Flags;      ///< PXS_CPU_FLAG_*
+    UINT32 Package;
+    UINT32 Core;       ///< Within the package
+    UINT32 Thread;     ///< Within the core
+    UINT32 Reserved;
+    UINT64 Mailbox;    ///< Physical address of its PXS_CPU_MAILBOX, 0 if none
+} PXS_CPU;
+
+// Every CPU the firmware reported, in its processor number order
+typedef struct {
+    UINT32  Version;   ///< PXS_CPU_TABLE_VERSION
+    UINT32  CpuCount;
+    UINT64  ParkBase;  ///< PXS_MEMORY_AP_PARK block: park code, its page tables, mailboxes
+    UINT64  ParkSize;  ///< Reclaimable once every parked AP has left it
+    PXS_CPU *Cpus;
+} PXS_CPU_TABLE;
+
+// An ACPI table: the XSDT (or RSDT), every table it lists, and the DSDT and
+// FACS of the FADT
+typedef struct {
+    UINT32 Signature;  ///< Header signature as a little-endian number, see PXS_ACPI_SIGNATURE
+    UINT32 Length;     ///< Header Length
+    UINT64 Address;
+    UINT8  Revision;   ///< Header Revision (FACS: Version)
+    UINT8  Flags;      ///< PXS_ACPI_TABLE_*
+    UINT16 Instance;   ///< Among tables with this signature, in root table order (SSDTs repeat)
+    UINT32 Reserved;
+} PXS_ACPI_TABLE;
+
+// An SMBIOS structure
+typedef struct {
+    UINT64 Address;  ///< Formatted area, starting with the Type/Length/Handle header
+    UINT32 Size;     ///< Formatted area and string set, up to and including its double NUL
+    UINT16 Handle;
+    UINT8  Type;
+    UINT8  Length;   ///< Formatted area (header Length)
+} PXS_SMBIOS_STRUCTURE;
+
+// ACPI tables and SMBIOS structures indexed once at load time, so the kernel
+// can look them up without walking firmware memory. Addresses are physical.
+typedef struct {
+    UINT32               Version;           ///< PXS_FIRMWARE_TABLES_VERSION
+    UINT32               AcpiCount;
+    PXS_ACPI_TABLE       *Acpi;             ///< Sorted by Signature (as a number), then Instance
+    UINT8                SmbiosMajor;       ///< Version of the entry point walked, 0 without SMBIOS
+    UINT8                SmbiosMinor;
+    UINT16               Reserved;
+    UINT32               SmbiosCount;
+    PXS_SMBIOS_STRUCTURE *Smbios;           ///< Sorted by Type, then table order; no end-of-table entry
+    UINT64               SmbiosEntryPoint;  ///< The "_SM3_" (preferred) or "_SM_" entry point walked
+} PXS_FIRMWARE_TABLES;
+
+// Memory the SRAT assigns to a node. This is affinity only; the memory map
+// says which parts of it are RAM
+typedef struct {
+    UINT64 Base;
+    UINT64 Length;
+    UINT32 Node;   ///< Index into PXS_NUMA.Nodes
+    UINT32 Flags;  ///< PXS_NUMA_RANGE_*
+} PXS_NUMA_RANGE;
+
+typedef struct {
+    UINT32 Domain;      ///< ACPI proximity domain
+    UINT32 CpuCount;    ///< Enabled SRAT processor entries
+    UINT32 FirstRange;  ///< Its ranges are Ranges[FirstRange, FirstRange + RangeCount)
+    UINT32 RangeCount;
+} PXS_NUMA_NODE;
+
+// Proximity domains from the SRAT and the SLIT distances between them. The
+// loader places what it loads and hands over in BspNode's memory when it can.
+typedef struct {
+    UINT32         Version;     ///< PXS_NUMA_VERSION
+    UINT32         NodeCount;
+    UINT32         RangeCount;
+    UINT32         BspNode;     ///< Node of the boot CPU, PXS_NUMA_NO_NODE if the SRAT does not list it
+    PXS_NUMA_NODE  *Nodes;      ///< Sorted by Domain
+    PXS_NUMA_RANGE *Ranges;     ///< Sorted by Node, then Base
+    UINT8          *Distances;  ///< SLIT distance From -> To at [From * NodeCount + To], 0 where the
+                                ///< SLIT has no entry; NULL without a SLIT
+} PXS_NUMA;
+
+// Clock rates the loader measured or read while it had boot services, so
+// the kernel need not calibrate against the PIT or HPET
+typedef struct {
+    UINT32 Version;             ///< PXS_CLOCKS_VERSION
+    UINT32 Flags;               ///< PXS_CLOCK_*
+    UINT64 TscFrequency;        ///< Hz, 0 if unknown
+    UINT32 TscSource;           ///< PXS_CLOCK_SOURCE_*
+    UINT32 TscErrorPpm;         ///< Bound on the error of TscFrequency in ppm; 0 when CPUID 0x15 gives it exactly
+    UINT64 CrystalFrequency;    ///< Hz of the core crystal clock (CPUID 0x15), 0 if unknown
+    UINT64 ApicTimerFrequency;  ///< Hz the LAPIC timer counts at with divide-by-1, 0 if unknown
+} PXS_CLOCKS;
+
 typedef struct {
     // Header
     UINT32                  Magic;           ///< (0x28082012)
     UINT32                  Version;         ///< Protocol Version
     UINT32                  Flags;           ///< Boot Flags
 
-    // Framebuffer
+    // Framebuffer. BaseAddress is 0 when there is none (headless boot). With
+    // CacheType WC the firmware made it write-combining (MTRRs, on every CPU),
+    // or, with PXS_FLAG_PAGING, the loader page tables map it through IA32_PAT
+    // entry 5, which the loader sets to WC on the boot CPU and parked APs.
     PXS_FRAMEBUFFER_INFO    Framebuffer;
 
     // Memory Map
@@ -59,4 +379,104 @@ typedef struct {
 
     // Security Verification
     UINT64                  SecurityCanary;
+
+    // Boot Timing (Version >= 2)
+    PXS_BOOT_TIMING         *Timing;
+
+    // Initrd cpio index (Version >= 3), NULL if the initrd is not a newc archive
+    PXS_INITRD_INDEX        *InitrdIndex;
+
+    // Modules from MODULE= lines (Version >= 4), NULL if none
+    PXS_MODULE_TABLE        *ModuleTable;
+
+    // Loader page tables (Version >= 5), valid when Flags has PXS_FLAG_PAGING
+    UINT64                  PageTableRoot;   ///< Physical address loaded into CR3
+    UINT64                  DirectMapBase;   ///< Virtual address of physical 0
+    UINT64                  DirectMapSize;   ///< Bytes of physical memory in the direct map
+    UINT32                  PagingLevels;    ///< 4 or 5
+
+    // Normalized memory map (Version >= 6), NULL if it could not be built
+    PXS_MEMORY_MAP          *NormalizedMemoryMap;
+
+    // SHA-256 of the kernel and initrd files as stored (Version >= 7), valid
+    // when Flags has PXS_FLAG_KERNEL_SHA256 / PXS_FLAG_INITRD_SHA256
+    UINT8                   KernelSha256[32];
+    UINT8                   InitrdSha256[32];
+
+    // Handoff arena (Version >= 8). This structure sits at HandoffBase, and every
+    // pointer in it except Rsdp, Smbios and RuntimeServicesPtr points inside
+    // [HandoffBase, HandoffBase + HandoffSize), so Pointer - HandoffBase is a
+    // stable offset if the kernel moves or remaps the block. The pages have
+    // type PXS_EFI_MEMORY_HANDOFF and can be reclaimed in one piece once read.
+    UINT64                  HandoffBase;
+    UINT64                  HandoffSize;
+
+    // Loader messages (Version >= 10), all of them whatever LOG= let through to
+    // the console. NULL if the ring could not be allocated
+    PXS_LOG                 *Log;
+
+    // CPUs and parked APs (Version >= 11), NULL without MP services or with SMP=0
+    PXS_CPU_TABLE           *CpuTable;
+
+    // ACPI table and SMBIOS structure directory (Version >= 12), NULL when the
+    // firmware has neither
+    PXS_FIRMWARE_TABLES     *FirmwareTables;
+
+    // SRAT proximity domains and SLIT distances (Version >= 13), NULL without
+    // an SRAT
+    PXS_NUMA                *Numa;
+
+    // TSC and timer rates (Version >= 14), NULL if the allocation failed
+    PXS_CLOCKS              *Clocks;
 } PXS_BOOT_INFO;
+
+// Layout shared with the kernel's protocol.h; protocol.hpp asserts the same
+// numbers on that side
+STATIC_ASSERT(sizeof(EFI_MEMORY_DESCRIPTOR) == 40, "EFI_MEMORY_DESCRIPTOR size");
+STATIC_ASSERT(sizeof(PXS_FRAMEBUFFER_INFO) == 40, "PXS_FRAMEBUFFER_INFO size");
+STATIC_ASSERT(OFFSET_OF(PXS_FRAMEBUFFER_INFO, CacheType) == 36, "CacheType");
+STATIC_ASSERT(sizeof(PXS_TIMING_ENTRY) == 40, "PXS_TIMING_ENTRY size");
+STATIC_ASSERT(sizeof(PXS_BOOT_TIMING) == 32 + 40 * PXS_TIMING_MAX_ENTRIES, "PXS_BOOT_TIMING size");
+STATIC_ASSERT(sizeof(PXS_INITRD_FILE) == 32, "PXS_INITRD_FILE size");
+STATIC_ASSERT(sizeof(PXS_INITRD_INDEX) == 16, "PXS_INITRD_INDEX size");
+STATIC_ASSERT(sizeof(PXS_MODULE) == 24 + PXS_MODULE_NAME_SIZE, "PXS_MODULE size");
+STATIC_ASSERT(sizeof(PXS_MODULE_TABLE) == 16, "PXS_MODULE_TABLE size");
+STATIC_ASSERT(sizeof(PXS_MEMORY_RANGE) == 24, "PXS_MEMORY_RANGE size");
+STATIC_ASSERT(sizeof(PXS_MEMORY_MAP) == 16, "PXS_MEMORY_MAP size");
+STATIC_ASSERT(sizeof(PXS_LOG_RECORD) == 128, "PXS_LOG_RECORD size");
+STATIC_ASSERT(sizeof(PXS_LOG) == 24, "PXS_LOG size");
+STATIC_ASSERT(sizeof(PXS_CPU_MAILBOX) == 64, "PXS_CPU_MAILBOX size");
+STATIC_ASSERT(sizeof(PXS_CPU) == 32, "PXS_CPU size");
+STATIC_ASSERT(sizeof(PXS_CPU_TABLE) == 32, "PXS_CPU_TABLE size");
+STATIC_ASSERT(sizeof(PXS_ACPI_TABLE) == 24, "PXS_ACPI_TABLE size");
+STATIC_ASSERT(sizeof(PXS_SMBIOS_STRUCTURE) == 16, "PXS_SMBIOS_STRUCTURE size");
+STATIC_ASSERT(sizeof(PXS_FIRMWARE_TABLES) == 40, "PXS_FIRMWARE_TABLES size");
+STATIC_ASSERT(sizeof(PXS_NUMA_RANGE) == 24, "PXS_NUMA_RANGE size");
+STATIC_ASSERT(sizeof(PXS_NUMA_NODE) == 16, "PXS_NUMA_NODE size");
+STATIC_ASSERT(sizeof(PXS_NUMA) == 40, "PXS_NUMA size");
+STATIC_ASSERT(sizeof(PXS_CLOCKS) == 40, "PXS_CLOCKS size");
+STATIC_ASSERT(sizeof(PXS_BOOT_INFO) == 360, "PXS_BOOT_INFO size");
+
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Framebuffer) == 16, "Framebuffer");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, MemoryMap) == 56, "MemoryMap");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, DescriptorVersion) == 88, "DescriptorVersion");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Rsdp) == 96, "Rsdp");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, KernelPhysicalBase) == 120, "KernelPhysicalBase");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, InitrdAddress) == 144, "InitrdAddress");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, CommandLine) == 160, "CommandLine");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, SecurityCanary) == 168, "SecurityCanary");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Timing) == 176, "Timing");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, InitrdIndex) == 184, "InitrdIndex");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, ModuleTable) == 192, "ModuleTable");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, PageTableRoot) == 200, "PageTableRoot");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, PagingLevels) == 224, "PagingLevels");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, NormalizedMemoryMap) == 232, "NormalizedMemoryMap");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, KernelSha256) == 240, "KernelSha256");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, InitrdSha256) == 272, "InitrdSha256");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, HandoffBase) == 304, "HandoffBase");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, HandoffSize) == 312, "HandoffSize");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Log) == 320, "Log");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, CpuTable) == 328, "CpuTable");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, FirmwareTables) == 336, "FirmwareTables");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Numa) == 344, "Numa");
+STATIC_ASSERT(OFFSET_OF(PXS_BOOT_INFO, Clocks) == 352, "Clocks");
@@ -0,0 +1,44 @@
+/**
+ * @file sha256.h
+ * @brief Streaming SHA-256 with a pluggable block function
+ */
+#pragma once
+
+#include <Uefi.h>
+
+#define PXS_SHA256_DIGEST_SIZE 32
+#define PXS_SHA256_BLOCK_SIZE  64
+
+/**
+ * Compress Blocks consecutive 64-byte blocks of Data into State.
+ */
+typedef VOID (*PXS_SHA256_BLOCKS)(IN OUT UINT32 *State, IN CONST UINT8 *Data, IN UINTN Blocks);
+
+typedef struct {
+    UINT32            State[8];
+    UINT64            Length;                        ///< Bytes hashed so far
+    UINT8             Buffer[PXS_SHA256_BLOCK_SIZE]; ///< Partial block
+    UINTN             Buffered;
+    PXS_SHA256_BLOCKS Blocks;
+} PXS_SHA256;
+
+/**
+ * Portable block function, usable on any CPU.
+ */
+VOID Sha256BlocksGeneric(IN OUT UINT32 *State, IN CONST UINT8 *Data, IN UINTN Blocks);
+
+/**
+ * Start a digest. Blocks selects the compression routine (NULL for the
+ * portable one), normally the result of Sha256SelectBlocks().
+ */
+VOID Sha256Init(OUT PXS_SHA256 *Ctx, IN PXS_SHA256_BLOCKS Blocks OPTIONAL);
+
+VOID Sha256Update(IN OUT PXS_SHA256 *Ctx, IN CONST VOID *Data, IN UINTN Size);
+
+VOID Sha256Final(IN OUT PXS_SHA256 *Ctx, OUT UINT8 *Digest);
+
+/**
+ * Pick the fastest block function the CPU supports (architecture specific).
+ * *Name is set to a short description for the console.
+ */
+PXS_SHA256_BLOCKS Sha256SelectBlocks(OUT CONST CHAR16 **Name);
@@ -0,0 +1,44 @@
+/**
+ * @file smbios.h
+ * @brief SMBIOS structure directory for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <include/protocol.h>
+
+typedef struct {
+    UINT64 EntryPoint;      ///< The entry point this was read from
+    UINT64 Address;         ///< Structure table
+    UINT32 Size;            ///< Table length (2.x) or maximum size (3.x)
+    UINT32 MaxStructures;   ///< Structure count (2.x), MAX_UINT32 for 3.x
+    UINT8  Major;
+    UINT8  Minor;
+} PXS_SMBIOS_TABLE;
+
+/**
+ * Check a "_SM3_" (64-bit) or "_SM_" (32-bit) entry point, anchor and
+ * checksums, and describe the structure table it points to.
+ *
+ * @retval TRUE   Table describes a non-empty structure table
+ * @retval FALSE  Not a valid entry point
+ */
+BOOLEAN SmbiosParseEntryPoint(IN CONST VOID *EntryPoint, OUT PXS_SMBIOS_TABLE *Table);
+
+/**
+ * Index the structures of a table up to the end-of-table (type 127) structure,
+ * the end of the table or a structure that runs past it, whichever is first.
+ *
+ * With Structures == NULL only *Count is returned. Otherwise up to Capacity
+ * entries are written, sorted by Type and in table order within a type, and
+ * *Count is the number written.
+ *
+ * @retval EFI_SUCCESS           Structures indexed
+ * @retval EFI_BUFFER_TOO_SMALL  More than Capacity structures
+ */
+EFI_STATUS SmbiosBuildIndex(
+    IN CONST PXS_SMBIOS_TABLE *Table,
+    OUT PXS_SMBIOS_STRUCTURE *Structures OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+);
@@ -0,0 +1,52 @@
+/**
+ * @file smp.h
+ * @brief Application processor parking for the kernel hand-off
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <Protocol/MpService.h>
+#include <include/protocol.h>
+
+typedef struct {
+    UINT64  ParkBase;           ///< Park block below 1 MiB, its first page is the SIPI target
+    UINT64  ParkSize;
+    UINTN   ApCount;            ///< APs with a mailbox
+    UINT64  TscPerMicrosecond;  ///< For the INIT/SIPI delays, which run without boot services
+    BOOLEAN ShortDelays;        ///< CPU needs no INIT settle time (as Linux decides it)
+    BOOLEAN PatSupported;
+    UINT64  Pat;                ///< IA32_PAT the APs load; the caller's, unless changed
+} PXS_SMP;
+
+/**
+ * Enumerate processors through MP services and allocate the park block:
+ * trampoline and park code, identity page tables for its first 2 MiB and one
+ * mailbox per enabled AP. Fills a CPU table in pool. Needs boot services.
+ *
+ * @param Mp            MP services
+ * @param TscFrequency  TSC ticks per second
+ * @param Smp           State for SmpPark()
+ * @param Table         CPU table, in pool
+ *
+ * @retval EFI_SUCCESS           Ready to park (Smp->ApCount may still be 0)
+ * @retval EFI_OUT_OF_RESOURCES  No memory below 1 MiB or for the table
+ * @retval EFI_UNSUPPORTED       The AP trampoline runs into its PARK_DATA (a build error)
+ */
+EFI_STATUS SmpPrepare(
+    IN EFI_MP_SERVICES_PROTOCOL *Mp,
+    IN UINT64 TscFrequency,
+    OUT PXS_SMP *Smp,
+    OUT PXS_CPU_TABLE **Table
+);
+
+/**
+ * Start every AP of Table that has a mailbox with INIT-SIPI-SIPI and wait
+ * (up to 100 ms) for it to park, then set PXS_CPU_FLAG_PARKED on the ones
+ * that did. Runs after ExitBootServices, whose firmware handler would reset
+ * APs parked any earlier, and while the local APIC is still mapped (before
+ * PagingActivate(), which does not map MMIO). The APs take Smp->Pat, the
+ * calling CPU's paging mode and EFER.NXE where the CPU has it.
+ *
+ * @return Number of APs parked
+ */
+UINTN SmpPark(IN CONST PXS_SMP *Smp, IN OUT PXS_CPU_TABLE *Table);
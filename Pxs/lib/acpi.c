@@ -0,0 +1,158 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <acpi.h>
+
+#define ACPI_HEADER_SIZE        36
+#define ACPI_RSDP_V1_SIZE       20
+#define ACPI_RSDP_V2_SIZE       36
+#define ACPI_RSDP_MAX_SIZE      1024
+#define ACPI_FACS_MIN_SIZE      64
+#define ACPI_MAX_TABLE_SIZE     0x4000000   // Larger is a corrupt header, not a table
+
+// RSDP fields
+#define RSDP_REVISION           15
+#define RSDP_RSDT               16
+#define RSDP_LENGTH             20
+#define RSDP_XSDT               24
+
+// FADT fields; the 64-bit ones win when present and non-zero
+#define FADT_FIRMWARE_CTRL      36
+#define FADT_DSDT               40
+#define FADT_X_FIRMWARE_CTRL    132
+#define FADT_X_DSDT             140
+
+#define FACS_VERSION            32
+
+typedef struct {
+    PXS_ACPI_TABLE *Tables;     // NULL to count only
+    UINT32         Capacity;
+    UINT32         Count;
+} ACPI_INDEX;
+
+// Table fields are not necessarily aligned (XSDT entries never are)
+STATIC UINT32 AcpiRead32(CONST UINT8 *P) {
+    UINT32 Value;
+    CopyMem(&Value, P, sizeof(Value));
+    return Value;
+}
+
+STATIC UINT64 AcpiRead64(CONST UINT8 *P) {
+    UINT64 Value;
+    CopyMem(&Value, P, sizeof(Value));
+    return Value;
+}
+
+STATIC BOOLEAN AcpiChecksum(CONST UINT8 *P, UINTN Length) {
+    UINT8 Sum = 0;
+    for (UINTN i = 0; i < Length; i++) Sum += P[i];
+    return Sum == 0;
+}
+
+// Header at Address if it has Signature (any when NULL) and a sane length
+STATIC CONST UINT8 *AcpiHeader(UINT64 Address, CONST CHAR8 *Signature) {
+    if (Address == 0) return NULL;
+    CONST UINT8 *Header = (CONST UINT8 *)(UINTN)Address;
+    if (Signature && CompareMem(Header, Signature, 4) != 0) return NULL;
+
+    BOOLEAN Facs = CompareMem(Header, "FACS", 4) == 0;
+    UINT32 Length = AcpiRead32(Header + 4);
+    if (Length < (Facs ? ACPI_FACS_MIN_SIZE : ACPI_HEADER_SIZE) || Length > ACPI_MAX_TABLE_SIZE) return NULL;
+    return Header;
+}
+
+STATIC CONST UINT8 *AcpiAdd(ACPI_INDEX *Index, UINT64 Address, CONST CHAR8 *Signature) {
+    CONST UINT8 *Header = AcpiHeader(Address, Signature);
+    if (!Header) return NULL;
+
+    if (Index->Tables && Index->Count < Index->Capacity) {
+        PXS_ACPI_TABLE *Table = &Index->Tables[Index->Count];
+        SetMem(Table, sizeof(*Table), 0);
+        Table->Signature = AcpiRead32(Header);
+        Table->Length = AcpiRead32(Header + 4);
+        Table->Address = Address;
+        if (Table->Signature == PXS_ACPI_SIGNATURE('F', 'A', 'C', 'S')) {
+            Table->Revision = Header[FACS_VERSION];
+            Table->Flags = PXS_ACPI_TABLE_NO_CHECKSUM;
+        } else {
+            Table->Revision = Header[8];
+            if (!AcpiChecksum(Header, Table->Length)) Table->Flags = PXS_ACPI_TABLE_BAD_CHECKSUM;
+        }
+    }
+    Index->Count++;
+    return Header;
+}
+
+// The DSDT and FACS are only reachable through the FADT
+STATIC VOID AcpiAddFadtTables(ACPI_INDEX *Index, CONST UINT8 *Fadt) {
+    UINT32 Length = AcpiRead32(Fadt + 4);
+    UINT64 Dsdt = 0, Facs = 0;
+
+    if (Length >= FADT_X_DSDT + 8) Dsdt = AcpiRead64(Fadt + FADT_X_DSDT);
+    if (Dsdt == 0 && Length >= FADT_DSDT + 4) Dsdt = AcpiRead32(Fadt + FADT_DSDT);
+    if (Length >= FADT_X_FIRMWARE_CTRL + 8) Facs = AcpiRead64(Fadt + FADT_X_FIRMWARE_CTRL);
+    if (Facs == 0 && Length >= FADT_FIRMWARE_CTRL + 4) Facs = AcpiRead32(Fadt + FADT_FIRMWARE_CTRL);
+
+    AcpiAdd(Index, Dsdt, "DSDT");
+    AcpiAdd(Index, Facs, "FACS");
+}
+
+EFI_STATUS AcpiBuildIndex(
+    IN CONST VOID *Rsdp,
+    OUT PXS_ACPI_TABLE *Tables OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+) {
+    CONST UINT8 *Pointer = (CONST UINT8 *)Rsdp;
+    ACPI_INDEX Index = { Tables, Capacity, 0 };
+    CONST UINT8 *Root = NULL;
+    UINTN EntrySize = 0;
+
+    *Count = 0;
+    if (!Pointer || CompareMem(Pointer, "RSD PTR ", 8) != 0 || !AcpiChecksum(Pointer, ACPI_RSDP_V1_SIZE)) {
+        return EFI_NOT_FOUND;
+    }
+
+    // The XSDT when the ACPI 2.0 part of the RSDP checks out, else the RSDT
+    if (Pointer[RSDP_REVISION] >= 2) {
+        UINT32 Length = AcpiRead32(Pointer + RSDP_LENGTH);
+        if (Length >= ACPI_RSDP_V2_SIZE && Length <= ACPI_RSDP_MAX_SIZE && AcpiChecksum(Pointer, Length)) {
+            Root = AcpiHeader(AcpiRead64(Pointer + RSDP_XSDT), "XSDT");
+            EntrySize = sizeof(UINT64);
+        }
+    }
+    if (!Root) {
+        Root = AcpiHeader(AcpiRead32(Pointer + RSDP_RSDT), "RSDT");
+        EntrySize = sizeof(UINT32);
+    }
+    if (!Root) return EFI_NOT_FOUND;
+
+    AcpiAdd(&Index, (UINT64)(UINTN)Root, NULL);
+    UINTN Entries = (AcpiRead32(Root + 4) - ACPI_HEADER_SIZE) / EntrySize;
+    for (UINTN i = 0; i < Entries; i++) {
+        CONST UINT8 *Entry = Root + ACPI_HEADER_SIZE + i * EntrySize;
+        UINT64 Address = (EntrySize == sizeof(UINT64)) ? AcpiRead64(Entry) : AcpiRead32(Entry);
+        CONST UINT8 *Header = AcpiAdd(&Index, Address, NULL);
+        if (Header && CompareMem(Header, "FACP", 4) == 0) AcpiAddFadtTables(&Index, Header);
+    }
+
+    *Count = Index.Count;
+    if (!Tables) return EFI_SUCCESS;
+    if (Index.Count > Capacity) return EFI_BUFFER_TOO_SMALL;
+
+    // Insertion sort keeps root table order among equal signatures; there
+    // are a few dozen tables at most
+    for (UINT32 i = 1; i < Index.Count; i++) {
+        PXS_ACPI_TABLE Key = Tables[i];
+        UINT32 j = i;
+        while (j > 0 && Tables[j - 1].Signature > Key.Signature) {
+            Tables[j] = Tables[j - 1];
+            j--;
+        }
+        Tables[j] = Key;
+    }
+    for (UINT32 i = 1; i < Index.Count; i++) {
+        if (Tables[i].Signature == Tables[i - 1].Signature) Tables[i].Instance = Tables[i - 1].Instance + 1;
+    }
+    return EFI_SUCCESS;
+}
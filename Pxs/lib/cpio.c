@@ -0,0 +1,151 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <cpio.h>
+#include <hex.h>
+
+#define CPIO_HEADER_SIZE  110
+#define CPIO_FIELD_SIZE   8
+#define CPIO_ALIGN(x)     (((x) + 3) & ~3ULL)
+
+// Field indices after the 6-byte magic
+#define CPIO_FIELD_MODE      1
+#define CPIO_FIELD_FILESIZE  6
+#define CPIO_FIELD_NAMESIZE  11
+
+STATIC CONST CHAR8 mTrailer[] = "TRAILER!!!";
+
+STATIC BOOLEAN CpioIsHeader(CONST UINT8 *P) {
+    return P[0] == '0' && P[1] == '7' && P[2] == '0' && P[3] == '7' && P[4] == '0' &&
+           (P[5] == '1' || P[5] == '2');
+}
+
+STATIC UINT32 CpioField(CONST UINT8 *Header, UINTN Index) {
+    CONST UINT8 *P = Header + 6 + Index * CPIO_FIELD_SIZE;
+    UINT32 Value = 0;
+    for (UINTN i = 0; i < CPIO_FIELD_SIZE; i++) {
+        INTN Digit = HexDigit(P[i]);
+        Value = (Value << 4) | (UINT32)(Digit < 0 ? 0 : Digit);
+    }
+    return Value;
+}
+
+// Bytewise path order, shorter first on a common prefix; ties keep archive order
+STATIC INTN CpioCompare(CONST UINT8 *Base, CONST PXS_INITRD_FILE *A, CONST PXS_INITRD_FILE *B) {
+    UINT32 Length = MIN(A->PathLength, B->PathLength);
+    INTN Result = CompareMem(Base + A->PathOffset, Base + B->PathOffset, Length);
+    if (Result != 0) return Result;
+    if (A->PathLength != B->PathLength) return (A->PathLength < B->PathLength) ? -1 : 1;
+    if (A->PathOffset != B->PathOffset) return (A->PathOffset < B->PathOffset) ? -1 : 1;
+    return 0;
+}
+
+// In-place heapsort: no scratch memory and no recursion
+STATIC VOID CpioSiftDown(CONST UINT8 *Base, PXS_INITRD_FILE *Entries, UINTN Root, UINTN Count) {
+    PXS_INITRD_FILE Tmp;
+    for (;;) {
+        UINTN Child = 2 * Root + 1;
+        if (Child >= Count) return;
+        if (Child + 1 < Count && CpioCompare(Base, &Entries[Child], &Entries[Child + 1]) < 0) {
+            Child++;
+        }
+        if (CpioCompare(Base, &Entries[Root], &Entries[Child]) >= 0) return;
+        Tmp = Entries[Root];
+        Entries[Root] = Entries[Child];
+        Entries[Child] = Tmp;
+        Root = Child;
+    }
+}
+
+STATIC VOID CpioSort(CONST UINT8 *Base, PXS_INITRD_FILE *Entries, UINTN Count) {
+    PXS_INITRD_FILE Tmp;
+    if (Count < 2) return;
+    for (UINTN i = Count / 2; i-- > 0;) {
+        CpioSiftDown(Base, Entries, i, Count);
+    }
+    for (UINTN End = Count - 1; End > 0; End--) {
+        Tmp = Entries[0];
+        Entries[0] = Entries[End];
+        Entries[End] = Tmp;
+        CpioSiftDown(Base, Entries, 0, End);
+    }
+}
+
+EFI_STATUS CpioBuildIndex(
+    IN CONST VOID *Archive,
+    IN UINT64 Size,
+    OUT PXS_INITRD_FILE *Entries OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+) {
+    CONST UINT8 *Base = (CONST UINT8 *)Archive;
+    UINT64 Offset = 0;
+    UINT32 Found = 0;
+
+    *Count = 0;
+    if (Size < CPIO_HEADER_SIZE || !CpioIsHeader(Base)) return EFI_UNSUPPORTED;
+
+    while (Offset + CPIO_HEADER_SIZE <= Size) {
+        CONST UINT8 *Header = Base + Offset;
+
+        // Concatenated archives may be separated by zero padding
+        if (Header[0] == 0) {
+            Offset += 4;
+            continue;
+        }
+        if (!CpioIsHeader(Header)) break;
+
+        UINT32 Mode = CpioField(Header, CPIO_FIELD_MODE);
+        UINT64 FileSize = CpioField(Header, CPIO_FIELD_FILESIZE);
+        UINT64 NameSize = CpioField(Header, CPIO_FIELD_NAMESIZE);
+        UINT64 NameOffset = Offset + CPIO_HEADER_SIZE;
+        if (NameSize == 0 || NameSize > Size - NameOffset) return EFI_VOLUME_CORRUPTED;
+
+        UINT64 DataOffset = CPIO_ALIGN(NameOffset + NameSize);
+        if (DataOffset > Size || FileSize > Size - DataOffset) return EFI_VOLUME_CORRUPTED;
+        Offset = CPIO_ALIGN(DataOffset + FileSize);
+
+        // The stored size includes the NUL
+        CONST CHAR8 *Name = (CONST CHAR8 *)(Base + NameOffset);
+        UINT64 NameLength = NameSize - 1;
+        if (NameLength == sizeof(mTrailer) - 1 && CompareMem(Name, mTrailer, NameLength) == 0) {
+            continue;
+        }
+        while (NameLength > 0 && (Name[0] == '/' || (Name[0] == '.' && NameLength > 1 && Name[1] == '/'))) {
+            UINTN Skip = (Name[0] == '/') ? 1 : 2;
+            Name += Skip;
+            NameLength -= Skip;
+        }
+        if (NameLength == 0 || (NameLength == 1 && Name[0] == '.')) continue;
+
+        if (Entries) {
+            if (Found >= Capacity) return EFI_BUFFER_TOO_SMALL;
+            PXS_INITRD_FILE *Entry = &Entries[Found];
+            Entry->PathOffset = (CONST UINT8 *)Name - Base;
+            Entry->PathLength = (UINT32)NameLength;
+            Entry->DataOffset = DataOffset;
+            Entry->DataSize = FileSize;
+            Entry->Mode = Mode;
+        }
+        Found++;
+    }
+
+    if (Entries && Found > 0) {
+        CpioSort(Base, Entries, Found);
+
+        // Keep the last occurrence of each path: it sorts last among equals
+        UINT32 Out = 0;
+        for (UINT32 i = 0; i < Found; i++) {
+            if (i + 1 < Found &&
+                Entries[i].PathLength == Entries[i + 1].PathLength &&
+                CompareMem(Base + Entries[i].PathOffset, Base + Entries[i + 1].PathOffset, Entries[i].PathLength) == 0) {
+                continue;
+            }
+            Entries[Out++] = Entries[i];
+        }
+        Found = Out;
+    }
+
+    *Count = Found;
+    return EFI_SUCCESS;
+}
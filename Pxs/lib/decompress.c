@@ -0,0 +1,287 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <decompress.h>
+
+#define LZ4_MAGIC             0x184D2204
+#define LZ4_LEGACY_MAGIC      0x184C2102
+#define ZSTD_MAGIC            0xFD2FB528
+#define SKIPPABLE_MAGIC       0x184D2A50
+#define SKIPPABLE_MAGIC_MASK  0xFFFFFFF0
+
+STATIC UINT32 ReadLe32(CONST UINT8 *P) {
+    return (UINT32)P[0] | ((UINT32)P[1] << 8) | ((UINT32)P[2] << 16) | ((UINT32)P[3] << 24);
+}
+
+UINT32 DecompressDetect(IN CONST VOID *Data, IN UINTN Size) {
+    if (Size < 4) return PXS_COMPRESSION_NONE;
+
+    UINT32 Magic = ReadLe32((CONST UINT8 *)Data);
+    switch (Magic) {
+        case LZ4_MAGIC:        return PXS_COMPRESSION_LZ4;
+        case LZ4_LEGACY_MAGIC: return PXS_COMPRESSION_LZ4_LEGACY;
+        case ZSTD_MAGIC:       return PXS_COMPRESSION_ZSTD;
+        default:               return PXS_COMPRESSION_NONE;
+    }
+}
+
+EFI_STATUS DecompressInit(OUT PXS_DECOMPRESSOR *Dec, IN UINT32 Format) {
+    SetMem(Dec, sizeof(*Dec), 0);
+    Dec->Format = Format;
+    Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+    Dec->FrameContentSize = PXS_DECOMPRESS_UNKNOWN_SIZE;
+
+    switch (Format) {
+        case PXS_COMPRESSION_LZ4:
+        case PXS_COMPRESSION_LZ4_LEGACY:
+            return EFI_SUCCESS;
+        case PXS_COMPRESSION_ZSTD:
+            return ZstdInit(Dec);
+        default:
+            return EFI_UNSUPPORTED;
+    }
+}
+
+VOID DecompressFree(IN PXS_DECOMPRESSOR *Dec) {
+    if (Dec->Format == PXS_COMPRESSION_ZSTD) {
+        ZstdFree(Dec);
+    }
+}
+
+BOOLEAN DecompressAtBoundary(IN CONST PXS_DECOMPRESSOR *Dec) {
+    // Legacy LZ4 has no end mark; the stream simply stops after a block
+    if (Dec->Format == PXS_COMPRESSION_LZ4_LEGACY && Dec->Phase == PXS_DECOMPRESS_PHASE_BLOCK) {
+        return TRUE;
+    }
+    return Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME;
+}
+
+EFI_STATUS DecompressStep(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN UINTN InSize,
+    OUT UINTN *InUsed,
+    IN OUT UINT8 *Out,
+    IN UINTN OutPos,
+    IN UINTN OutCap,
+    OUT UINTN *OutUsed,
+    OUT UINTN *Needed
+) {
+    *InUsed = 0;
+    *OutUsed = 0;
+    *Needed = 0;
+
+    // Skippable frames are shared by both formats
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+        if (InSize < 4) {
+            *Needed = 4;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        if ((ReadLe32(In) & SKIPPABLE_MAGIC_MASK) == SKIPPABLE_MAGIC) {
+            if (InSize < 8) {
+                *Needed = 8;
+                return EFI_BUFFER_TOO_SMALL;
+            }
+            Dec->SkipRemaining = ReadLe32(In + 4);
+            Dec->Phase = PXS_DECOMPRESS_PHASE_SKIP;
+            *InUsed = 8;
+            return EFI_SUCCESS;
+        }
+    } else if (Dec->Phase == PXS_DECOMPRESS_PHASE_SKIP) {
+        if (Dec->SkipRemaining == 0) {
+            Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+            return EFI_SUCCESS;
+        }
+        if (InSize == 0) {
+            *Needed = 1;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        UINTN Skip = (Dec->SkipRemaining < InSize) ? (UINTN)Dec->SkipRemaining : InSize;
+        Dec->SkipRemaining -= Skip;
+        if (Dec->SkipRemaining == 0) {
+            Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+        }
+        *InUsed = Skip;
+        return EFI_SUCCESS;
+    }
+
+    EFI_STATUS Status;
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+        Dec->FrameOutput = 0;
+    }
+    switch (Dec->Format) {
+        case PXS_COMPRESSION_LZ4:
+        case PXS_COMPRESSION_LZ4_LEGACY:
+            Status = Lz4Step(Dec, In, InSize, InUsed, Out, OutPos, OutCap, OutUsed, Needed);
+            break;
+        case PXS_COMPRESSION_ZSTD:
+            Status = ZstdStep(Dec, In, InSize, InUsed, Out, OutPos, OutCap, OutUsed, Needed);
+            break;
+        default:
+            return EFI_UNSUPPORTED;
+    }
+    if (!EFI_ERROR(Status)) {
+        Dec->FrameOutput += *OutUsed;
+    }
+    return Status;
+}
+
+EFI_STATUS DecompressNeedFrame(
+    UINTN Start,
+    UINT64 ContentSize,
+    UINT64 Overhead,
+    UINTN InSize,
+    UINT64 Remaining,
+    UINTN *Needed
+) {
+    // The stream ends inside the frame
+    if (InSize >= Remaining) return EFI_VOLUME_CORRUPTED;
+
+    UINT64 Left = Remaining - Start;
+    UINT64 Bound = (ContentSize >= Left || Overhead >= Left - ContentSize) ? Left : ContentSize + Overhead;
+    *Needed = (UINTN)MAX(Start + Bound, (UINT64)InSize + 1);
+    return EFI_BUFFER_TOO_SMALL;
+}
+
+EFI_STATUS DecompressNextUnit(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN UINTN InSize,
+    IN UINT64 Remaining,
+    OUT UINTN *InUsed,
+    OUT PXS_DECOMPRESS_UNIT *Unit,
+    OUT UINTN *Needed
+) {
+    // Work on a copy so that Dec only moves once a whole unit is found
+    PXS_DECOMPRESSOR Walk = *Dec;
+    EFI_STATUS Status;
+    UINTN Pos = 0;
+
+    *InUsed = 0;
+    *Needed = 0;
+    SetMem(Unit, sizeof(*Unit), 0);
+
+    for (;;) {
+        if (Pos == Remaining) {
+            return DecompressAtBoundary(&Walk) ? EFI_END_OF_FILE : EFI_VOLUME_CORRUPTED;
+        }
+
+        if (Walk.Phase == PXS_DECOMPRESS_PHASE_SKIP) {
+            if (Walk.SkipRemaining > Remaining - Pos) return EFI_VOLUME_CORRUPTED;
+            if (Walk.SkipRemaining > InSize - Pos) {
+                *Needed = Pos + (UINTN)Walk.SkipRemaining;
+                return EFI_BUFFER_TOO_SMALL;
+            }
+            Pos += (UINTN)Walk.SkipRemaining;
+            Walk.SkipRemaining = 0;
+            Walk.Phase = PXS_DECOMPRESS_PHASE_FRAME;
+            continue;
+        }
+
+        if (Walk.Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+            if (Remaining - Pos < 4) return EFI_VOLUME_CORRUPTED;
+            if (InSize - Pos < 4) {
+                *Needed = Pos + 4;
+                return EFI_BUFFER_TOO_SMALL;
+            }
+            if ((ReadLe32(In + Pos) & SKIPPABLE_MAGIC_MASK) == SKIPPABLE_MAGIC) {
+                if (Remaining - Pos < 8) return EFI_VOLUME_CORRUPTED;
+                if (InSize - Pos < 8) {
+                    *Needed = Pos + 8;
+                    return EFI_BUFFER_TOO_SMALL;
+                }
+                Walk.SkipRemaining = ReadLe32(In + Pos + 4);
+                Walk.Phase = PXS_DECOMPRESS_PHASE_SKIP;
+                Pos += 8;
+                continue;
+            }
+            Walk.FrameOutput = 0;
+        }
+
+        switch (Walk.Format) {
+            case PXS_COMPRESSION_LZ4:
+            case PXS_COMPRESSION_LZ4_LEGACY:
+                Status = Lz4NextUnit(&Walk, In, InSize, Remaining, &Pos, Unit, Needed);
+                break;
+            case PXS_COMPRESSION_ZSTD:
+                Status = ZstdNextUnit(&Walk, In, InSize, Remaining, &Pos, Unit, Needed);
+                break;
+            default:
+                return EFI_UNSUPPORTED;
+        }
+
+        // Framing without output (end marks, trailers, legacy magics)
+        if (Status == EFI_NOT_FOUND) continue;
+        if (EFI_ERROR(Status)) return Status;
+
+        *Dec = Walk;
+        *InUsed = Pos;
+        return EFI_SUCCESS;
+    }
+}
+
+EFI_STATUS DecompressUnit(
+    IN OUT PXS_DECOMPRESSOR *Dec,
+    IN CONST UINT8 *In,
+    IN CONST PXS_DECOMPRESS_UNIT *Unit,
+    OUT UINT8 *Out,
+    OUT UINT64 *Produced
+) {
+    EFI_STATUS Status;
+    CONST UINT8 *Src = In + Unit->InOffset;
+    UINTN InPos = 0;
+    UINTN OutPos = 0;
+
+    *Produced = 0;
+    switch (Unit->Kind) {
+        case PXS_DECOMPRESS_UNIT_RAW:
+            if (Unit->InSize > Unit->OutSize) return EFI_VOLUME_CORRUPTED;
+            CopyMem(Out, Src, (UINTN)Unit->InSize);
+            *Produced = Unit->InSize;
+            return EFI_SUCCESS;
+
+        case PXS_DECOMPRESS_UNIT_LZ4_BLOCK:
+            Status = Lz4DecodeUnit(Src, (UINTN)Unit->InSize, Out, (UINTN)Unit->OutSize, &OutPos);
+            *Produced = OutPos;
+            return Status;
+
+        case PXS_DECOMPRESS_UNIT_FRAME:
+            Dec->Format = Unit->Format;
+            Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+            while (InPos < Unit->InSize) {
+                UINTN Used, OutUsed, Needed;
+                Status = DecompressStep(Dec, Src + InPos, (UINTN)Unit->InSize - InPos, &Used,
+                                        Out, OutPos, (UINTN)Unit->OutSize, &OutUsed, &Needed);
+                if (Status == EFI_BUFFER_TOO_SMALL) return EFI_VOLUME_CORRUPTED;
+                if (EFI_ERROR(Status)) return Status;
+                if (Used == 0 && OutUsed == 0) return EFI_VOLUME_CORRUPTED;
+                InPos += Used;
+                OutPos += OutUsed;
+            }
+            if (!DecompressAtBoundary(Dec) || OutPos != Unit->OutSize) return EFI_VOLUME_CORRUPTED;
+            *Produced = OutPos;
+            return EFI_SUCCESS;
+
+        default:
+            return EFI_UNSUPPORTED;
+    }
+}
+
+VOID DecompressCopyMatch(UINT8 *Op, UINTN Distance, UINTN Length) {
+    CONST UINT8 *Match = Op - Distance;
+
+    if (Length <= 32) {
+        while (Length--) *Op++ = *Match++;
+        return;
+    }
+
+    // Short distances overlap the output: grow the repeating pattern by
+    // doubling until the remainder can be copied without overlap
+    while (Length > Distance) {
+        CopyMem(Op, Match, Distance);
+        Op += Distance;
+        Length -= Distance;
+        Distance *= 2;
+    }
+    CopyMem(Op, Match, Length);
+}
@@ -0,0 +1,137 @@
+#include <Uefi.h>
+
+#include <compiler.h>
+#include <elf.h>
+
+// Host pointer to the Size bytes at link address Address, NULL unless they lie
+// inside the image
+STATIC VOID *ElfImagePointer(UINT8 *Image, UINT64 ImageSize, UINT64 LinkBase, UINT64 Address, UINT64 Size) {
+    UINT64 Offset = Address - LinkBase;
+    if (Address < LinkBase || Offset > ImageSize || Size > ImageSize - Offset) return NULL;
+    return Image + Offset;
+}
+
+// R_X86_64_RELATIVE is the only type a static PIE needs: *Target = Slide + Addend.
+// Offsets are checked against one precomputed limit so the loop stays branch-light.
+STATIC EFI_STATUS ElfApplyRela(
+    UINT8 *Image,
+    UINT64 ImageSize,
+    UINT64 LinkBase,
+    CONST Elf64_Rela *Rela,
+    UINTN RelaCount,
+    UINT64 Slide,
+    UINTN *Count
+) {
+    UINT64 Limit = ImageSize - sizeof(UINT64);
+
+    for (UINTN i = 0; i < RelaCount; i++) {
+        UINT64 Offset = Rela[i].r_offset - LinkBase;
+        UINT32 Type = ELF64_R_TYPE(Rela[i].r_info);
+
+        if (__unlikely(Type != R_X86_64_RELATIVE)) {
+            if (Type == R_X86_64_NONE) continue;
+            return EFI_UNSUPPORTED;
+        }
+        if (__unlikely(Offset > Limit)) return EFI_LOAD_ERROR;
+        *(UINT64 *)(Image + Offset) = Slide + (UINT64)Rela[i].r_addend;
+    }
+    *Count += RelaCount;
+    return EFI_SUCCESS;
+}
+
+// RELR: an even entry is the address of one word to relocate. An odd entry is
+// a bitmap whose bits 1..63 mark the 63 words after the last address (or the
+// previous bitmap's run), so dense pointer tables cost one bit per word.
+STATIC EFI_STATUS ElfApplyRelr(
+    UINT8 *Image,
+    UINT64 ImageSize,
+    UINT64 LinkBase,
+    CONST UINT64 *Relr,
+    UINTN RelrCount,
+    UINT64 Slide,
+    UINTN *Count
+) {
+    UINT64 *End = (UINT64 *)(Image + (ImageSize & ~(UINT64)(sizeof(UINT64) - 1)));
+    UINT64 *Where = NULL;
+    UINTN Relocated = 0;
+
+    for (UINTN i = 0; i < RelrCount; i++) {
+        UINT64 Entry = Relr[i];
+
+        if ((Entry & 1) == 0) {
+            Where = ElfImagePointer(Image, ImageSize, LinkBase, Entry, sizeof(UINT64));
+            if (__unlikely(!Where || ((UINTN)Where & (sizeof(UINT64) - 1)))) return EFI_LOAD_ERROR;
+            *Where++ += Slide;
+            Relocated++;
+            continue;
+        }
+
+        // Bounds are checked once, against the highest marked word
+        UINT64 Bits = Entry >> 1;
+        if (__unlikely(!Where)) return EFI_LOAD_ERROR;
+        if (Bits != 0) {
+            if (__unlikely(63 - __builtin_clzll(Bits) >= End - Where)) return EFI_LOAD_ERROR;
+            Relocated += __builtin_popcountll(Bits);
+            do {
+                Where[__builtin_ctzll(Bits)] += Slide;
+                Bits &= Bits - 1;
+            } while (Bits != 0);
+        }
+        Where += 63;
+    }
+    *Count += Relocated;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS ElfRelocate(
+    IN OUT VOID *Image,
+    IN UINT64 ImageSize,
+    IN UINT64 LinkBase,
+    IN UINT64 DynamicAddress,
+    IN UINT64 DynamicSize,
+    IN UINT64 Slide,
+    OUT UINTN *Count
+) {
+    CONST Elf64_Dyn *Dynamic;
+    UINT64 Rela = 0, RelaSize = 0, RelaEntry = sizeof(Elf64_Rela);
+    UINT64 Relr = 0, RelrSize = 0, RelrEntry = sizeof(UINT64);
+    UINT64 RelSize = 0, PltRelSize = 0;
+    EFI_STATUS Status;
+
+    *Count = 0;
+    if (ImageSize < sizeof(UINT64)) return EFI_LOAD_ERROR;
+
+    Dynamic = ElfImagePointer(Image, ImageSize, LinkBase, DynamicAddress, DynamicSize);
+    if (!Dynamic) return EFI_LOAD_ERROR;
+
+    for (UINTN i = 0; i < DynamicSize / sizeof(Elf64_Dyn) && Dynamic[i].d_tag != DT_NULL; i++) {
+        switch (Dynamic[i].d_tag) {
+            case DT_RELA:     Rela = Dynamic[i].d_val; break;
+            case DT_RELASZ:   RelaSize = Dynamic[i].d_val; break;
+            case DT_RELAENT:  RelaEntry = Dynamic[i].d_val; break;
+            case DT_RELR:     Relr = Dynamic[i].d_val; break;
+            case DT_RELRSZ:   RelrSize = Dynamic[i].d_val; break;
+            case DT_RELRENT:  RelrEntry = Dynamic[i].d_val; break;
+            case DT_RELSZ:    RelSize = Dynamic[i].d_val; break;
+            case DT_PLTRELSZ: PltRelSize = Dynamic[i].d_val; break;
+        }
+    }
+
+    // REL is not used on x86-64, and PLT slots need symbols
+    if (RelSize != 0 || PltRelSize != 0) return EFI_UNSUPPORTED;
+    if (RelaEntry != sizeof(Elf64_Rela) || RelrEntry != sizeof(UINT64)) return EFI_UNSUPPORTED;
+
+    if (RelaSize != 0) {
+        CONST Elf64_Rela *Table = ElfImagePointer(Image, ImageSize, LinkBase, Rela, RelaSize);
+        if (!Table) return EFI_LOAD_ERROR;
+        Status = ElfApplyRela(Image, ImageSize, LinkBase, Table, RelaSize / sizeof(Elf64_Rela), Slide, Count);
+        if (EFI_ERROR(Status)) return Status;
+    }
+    if (RelrSize != 0) {
+        CONST UINT64 *Table = ElfImagePointer(Image, ImageSize, LinkBase, Relr, RelrSize);
+        if (!Table) return EFI_LOAD_ERROR;
+        Status = ElfApplyRelr(Image, ImageSize, LinkBase, Table, RelrSize / sizeof(UINT64), Slide, Count);
+        if (EFI_ERROR(Status)) return Status;
+    }
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,10 @@
+#include <Uefi.h>
+
+#include <hex.h>
+
+INTN HexDigit(IN UINT32 Char) {
+    if (Char >= '0' && Char <= '9') return Char - '0';
+    if (Char >= 'a' && Char <= 'f') return Char - 'a' + 10;
+    if (Char >= 'A' && Char <= 'F') return Char - 'A' + 10;
+    return -1;
+}
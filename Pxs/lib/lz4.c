@@ -0,0 +1,407 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <decompress.h>
+
+#define LZ4_MAGIC         0x184D2204
+#define LZ4_LEGACY_MAGIC  0x184C2102
+#define LZ4_LEGACY_BLOCK  (8 * 1024 * 1024)
+#define LZ4_HISTORY       (64 * 1024)
+#define LZ4_MIN_MATCH     4
+
+// Frame descriptor flags (FLG byte)
+#define LZ4_FLG_VERSION_MASK     0xC0
+#define LZ4_FLG_VERSION          0x40
+#define LZ4_FLG_BLOCK_INDEP      0x20
+#define LZ4_FLG_BLOCK_CHECKSUM   0x10
+#define LZ4_FLG_CONTENT_SIZE     0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID          0x01
+
+#define LZ4_BLOCK_UNCOMPRESSED   0x80000000
+
+// Largest legacy block: an incompressible 8MB input plus LZ4 worst-case expansion
+#define LZ4_LEGACY_MAX_INPUT     (LZ4_LEGACY_BLOCK + LZ4_LEGACY_BLOCK / 255 + 16)
+
+STATIC UINT32 ReadLe32(CONST UINT8 *P) {
+    return (UINT32)P[0] | ((UINT32)P[1] << 8) | ((UINT32)P[2] << 16) | ((UINT32)P[3] << 24);
+}
+
+// Decode one LZ4 block (sequences of literals + back-reference)
+STATIC EFI_STATUS Lz4DecodeBlock(
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT8 *Out,
+    UINTN OutPos,
+    UINTN OutCap,
+    UINTN *Produced
+) {
+    CONST UINT8 *Ip = In;
+    CONST UINT8 *IEnd = In + InSize;
+    UINT8 *Op = Out + OutPos;
+    UINT8 *OEnd = Out + OutCap;
+
+    for (;;) {
+        if (Ip >= IEnd) return EFI_VOLUME_CORRUPTED;
+        UINT8 Token = *Ip++;
+
+        // Literals
+        UINTN Length = Token >> 4;
+        if (Length == 15) {
+            UINT8 Extra;
+            do {
+                if (Ip >= IEnd) return EFI_VOLUME_CORRUPTED;
+                Extra = *Ip++;
+                Length += Extra;
+            } while (Extra == 255);
+        }
+        if (Length > (UINTN)(IEnd - Ip) || Length > (UINTN)(OEnd - Op)) {
+            return EFI_VOLUME_CORRUPTED;
+        }
+        CopyMem(Op, Ip, Length);
+        Op += Length;
+        Ip += Length;
+
+        // The last sequence carries literals only
+        if (Ip == IEnd) break;
+
+        // Match
+        if (IEnd - Ip < 2) return EFI_VOLUME_CORRUPTED;
+        UINTN Distance = (UINTN)Ip[0] | ((UINTN)Ip[1] << 8);
+        Ip += 2;
+        if (Distance == 0 || Distance > (UINTN)(Op - Out)) {
+            return EFI_VOLUME_CORRUPTED;
+        }
+
+        Length = Token & 15;
+        if (Length == 15) {
+            UINT8 Extra;
+            do {
+                if (Ip >= IEnd) return EFI_VOLUME_CORRUPTED;
+                Extra = *Ip++;
+                Length += Extra;
+            } while (Extra == 255);
+        }
+        Length += LZ4_MIN_MATCH;
+        if (Length > (UINTN)(OEnd - Op)) return EFI_VOLUME_CORRUPTED;
+
+        DecompressCopyMatch(Op, Distance, Length);
+        Op += Length;
+    }
+
+    *Produced = Op - (Out + OutPos);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS Lz4DecodeUnit(CONST UINT8 *In, UINTN InSize, UINT8 *Out, UINTN OutCap, UINTN *Produced) {
+    return Lz4DecodeBlock(In, InSize, Out, 0, OutCap, Produced);
+}
+
+STATIC UINTN Lz4BlockMaxSize(UINT8 Bd) {
+    switch ((Bd >> 4) & 7) {
+        case 4: return 64 * 1024;
+        case 5: return 256 * 1024;
+        case 6: return 1024 * 1024;
+        case 7: return 4 * 1024 * 1024;
+        default: return 0;
+    }
+}
+
+STATIC EFI_STATUS Lz4FrameHeader(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINTN *InUsed, UINTN *Needed) {
+    UINT32 Magic = ReadLe32(In);
+
+    if (Magic == LZ4_LEGACY_MAGIC) {
+        // Legacy blocks are always independent and at most 8MB
+        Dec->Format = PXS_COMPRESSION_LZ4_LEGACY;
+        Dec->MaxBlockSize = LZ4_LEGACY_BLOCK;
+        Dec->WindowSize = 0;
+        Dec->FrameContentSize = PXS_DECOMPRESS_UNKNOWN_SIZE;
+        Dec->Phase = PXS_DECOMPRESS_PHASE_BLOCK;
+        *InUsed = 4;
+        return EFI_SUCCESS;
+    }
+    if (Magic != LZ4_MAGIC) return EFI_VOLUME_CORRUPTED;
+
+    if (InSize < 7) {
+        *Needed = 7;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    UINT8 Flg = In[4];
+    UINT8 Bd = In[5];
+    if ((Flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) return EFI_VOLUME_CORRUPTED;
+    if (Flg & LZ4_FLG_DICT_ID) return EFI_UNSUPPORTED;
+
+    UINTN HeaderSize = 7 + ((Flg & LZ4_FLG_CONTENT_SIZE) ? 8 : 0);
+    if (InSize < HeaderSize) {
+        *Needed = HeaderSize;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+
+    Dec->MaxBlockSize = Lz4BlockMaxSize(Bd);
+    if (Dec->MaxBlockSize == 0) return EFI_VOLUME_CORRUPTED;
+
+    Dec->FrameContentSize = PXS_DECOMPRESS_UNKNOWN_SIZE;
+    if (Flg & LZ4_FLG_CONTENT_SIZE) {
+        Dec->FrameContentSize = (UINT64)ReadLe32(In + 6) | ((UINT64)ReadLe32(In + 10) << 32);
+    }
+    Dec->WindowSize = (Flg & LZ4_FLG_BLOCK_INDEP) ? 0 : LZ4_HISTORY;
+    Dec->Flags = Flg;
+    Dec->Phase = PXS_DECOMPRESS_PHASE_BLOCK;
+    *InUsed = HeaderSize; // Header checksum byte is not verified
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS Lz4Step(
+    PXS_DECOMPRESSOR *Dec,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINTN *InUsed,
+    UINT8 *Out,
+    UINTN OutPos,
+    UINTN OutCap,
+    UINTN *OutUsed,
+    UINTN *Needed
+) {
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+        return Lz4FrameHeader(Dec, In, InSize, InUsed, Needed);
+    }
+
+    if (InSize < 4) {
+        *Needed = 4;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    UINT32 Word = ReadLe32(In);
+
+    if (Dec->Format == PXS_COMPRESSION_LZ4_LEGACY) {
+        // A new legacy header may follow, or a different frame entirely
+        if (Word == LZ4_LEGACY_MAGIC) {
+            *InUsed = 4;
+            return EFI_SUCCESS;
+        }
+        if (Word == LZ4_MAGIC) {
+            Dec->Format = PXS_COMPRESSION_LZ4;
+            Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+            return EFI_SUCCESS;
+        }
+        if (Word == 0 || Word > LZ4_LEGACY_MAX_INPUT) {
+            return EFI_VOLUME_CORRUPTED;
+        }
+        if (InSize - 4 < Word) {
+            *Needed = 4 + (UINTN)Word;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        UINTN Cap = (OutCap - OutPos > LZ4_LEGACY_BLOCK) ? OutPos + LZ4_LEGACY_BLOCK : OutCap;
+        *InUsed = 4 + Word;
+        return Lz4DecodeBlock(In + 4, Word, Out, OutPos, Cap, OutUsed);
+    }
+
+    // EndMark, optionally followed by the xxHash32 content checksum (not verified)
+    if (Word == 0) {
+        UINTN TrailerSize = (Dec->Flags & LZ4_FLG_CONTENT_CHECKSUM) ? 8 : 4;
+        if (InSize < TrailerSize) {
+            *Needed = TrailerSize;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        *InUsed = TrailerSize;
+        Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+        return EFI_SUCCESS;
+    }
+
+    UINTN BlockSize = Word & ~LZ4_BLOCK_UNCOMPRESSED;
+    UINTN UnitSize = 4 + BlockSize + ((Dec->Flags & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0);
+    if (BlockSize > Dec->MaxBlockSize) return EFI_VOLUME_CORRUPTED;
+    if (InSize < UnitSize) {
+        *Needed = UnitSize;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *InUsed = UnitSize;
+
+    if (Word & LZ4_BLOCK_UNCOMPRESSED) {
+        if (BlockSize > OutCap - OutPos) return EFI_VOLUME_CORRUPTED;
+        CopyMem(Out + OutPos, In + 4, BlockSize);
+        *OutUsed = BlockSize;
+        return EFI_SUCCESS;
+    }
+
+    UINTN Cap = (OutCap - OutPos > Dec->MaxBlockSize) ? OutPos + Dec->MaxBlockSize : OutCap;
+    return Lz4DecodeBlock(In + 4, BlockSize, Out, OutPos, Cap, OutUsed);
+}
+
+// Walk a dependent-block frame whose header ends at *Pos up to its trailer;
+// the whole frame becomes one unit
+STATIC EFI_STATUS Lz4FrameUnit(
+    PXS_DECOMPRESSOR *Dec,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT64 Remaining,
+    UINTN Start,
+    UINTN *Pos,
+    PXS_DECOMPRESS_UNIT *Unit,
+    UINTN *Needed
+) {
+    UINTN P = *Pos;
+
+    Unit->Kind = PXS_DECOMPRESS_UNIT_FRAME;
+    Unit->Format = PXS_COMPRESSION_LZ4;
+    Unit->InOffset = Start;
+    Unit->OutSize = Dec->FrameContentSize;
+
+    for (;;) {
+        if (InSize - P < 4) goto Short;
+        UINT32 Word = ReadLe32(In + P);
+        if (Word == 0) {
+            UINTN TrailerSize = (Dec->Flags & LZ4_FLG_CONTENT_CHECKSUM) ? 8 : 4;
+            if (InSize - P < TrailerSize) goto Short;
+            P += TrailerSize;
+            break;
+        }
+
+        UINTN BlockSize = Word & ~LZ4_BLOCK_UNCOMPRESSED;
+        UINTN UnitSize = 4 + BlockSize + ((Dec->Flags & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0);
+        if (BlockSize > Dec->MaxBlockSize) return EFI_VOLUME_CORRUPTED;
+        if (InSize - P < UnitSize) goto Short;
+        P += UnitSize;
+    }
+
+    Unit->InSize = P - Start;
+    Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+    *Pos = P;
+    return EFI_SUCCESS;
+
+Short:
+    // Worst case: every block stored, with its size word and checksum
+    return DecompressNeedFrame(Start, Dec->FrameContentSize,
+                               (*Pos - Start) + (Dec->FrameContentSize / Dec->MaxBlockSize + 1) * 8 + 8,
+                               InSize, Remaining, Needed);
+}
+
+// Legacy blocks and the blocks of independent-block frames each become a unit;
+// a dependent-block frame is one unit and needs its content size.
+EFI_STATUS Lz4NextUnit(
+    PXS_DECOMPRESSOR *Dec,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT64 Remaining,
+    UINTN *Pos,
+    PXS_DECOMPRESS_UNIT *Unit,
+    UINTN *Needed
+) {
+    EFI_STATUS Status;
+    UINTN Start = *Pos;
+
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+        UINTN Used;
+        Status = Lz4FrameHeader(Dec, In + Start, InSize - Start, &Used, Needed);
+        if (Status == EFI_BUFFER_TOO_SMALL) *Needed += Start;
+        if (EFI_ERROR(Status)) return Status;
+        *Pos = Start + Used;
+        if (Dec->Format == PXS_COMPRESSION_LZ4_LEGACY || (Dec->Flags & LZ4_FLG_BLOCK_INDEP)) {
+            return EFI_NOT_FOUND;
+        }
+        if (Dec->FrameContentSize == PXS_DECOMPRESS_UNKNOWN_SIZE) return EFI_UNSUPPORTED;
+        return Lz4FrameUnit(Dec, In, InSize, Remaining, Start, Pos, Unit, Needed);
+    }
+
+    // Inside a dependent-block frame, blocks need the ones before them
+    if (Dec->Phase != PXS_DECOMPRESS_PHASE_BLOCK) return EFI_UNSUPPORTED;
+    if (Dec->Format == PXS_COMPRESSION_LZ4 && !(Dec->Flags & LZ4_FLG_BLOCK_INDEP)) return EFI_UNSUPPORTED;
+
+    if (InSize - Start < 4) {
+        if (Remaining - Start < 4) return EFI_VOLUME_CORRUPTED;
+        *Needed = Start + 4;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    UINT32 Word = ReadLe32(In + Start);
+    UINTN BlockEnd;
+    BOOLEAN Last;
+
+    if (Dec->Format == PXS_COMPRESSION_LZ4_LEGACY) {
+        if (Word == LZ4_LEGACY_MAGIC) {
+            *Pos = Start + 4;
+            return EFI_NOT_FOUND;
+        }
+        if (Word == LZ4_MAGIC) {
+            Dec->Format = PXS_COMPRESSION_LZ4;
+            Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+            return EFI_NOT_FOUND;
+        }
+        if (Word == 0 || Word > LZ4_LEGACY_MAX_INPUT) return EFI_VOLUME_CORRUPTED;
+
+        Unit->Kind = PXS_DECOMPRESS_UNIT_LZ4_BLOCK;
+        Unit->Format = PXS_COMPRESSION_LZ4_LEGACY;
+        Unit->InOffset = Start + 4;
+        Unit->InSize = Word;
+        Unit->OutSize = LZ4_LEGACY_BLOCK;
+
+        // Every block but the last of a run fills 8MB; the last is followed by
+        // the end of the stream or a new header
+        BlockEnd = Start + 4 + Word;
+        if (BlockEnd > Remaining || (BlockEnd < Remaining && Remaining - BlockEnd < 4)) {
+            return EFI_VOLUME_CORRUPTED;
+        }
+        UINTN Peek = (BlockEnd == Remaining) ? 0 : 4;
+        if (InSize - Start < 4 + Word + Peek) {
+            *Needed = BlockEnd + Peek;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        if (Peek == 0) {
+            Last = TRUE;
+        } else {
+            UINT32 Next = ReadLe32(In + BlockEnd);
+            Last = (Next == LZ4_LEGACY_MAGIC || Next == LZ4_MAGIC);
+        }
+        Unit->Bounded = Last;
+        *Pos = BlockEnd;
+        return EFI_SUCCESS;
+    }
+
+    if (Word == 0) {
+        UINTN TrailerSize = (Dec->Flags & LZ4_FLG_CONTENT_CHECKSUM) ? 8 : 4;
+        if (InSize - Start < TrailerSize) {
+            if (Remaining - Start < TrailerSize) return EFI_VOLUME_CORRUPTED;
+            *Needed = Start + TrailerSize;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        *Pos = Start + TrailerSize;
+        Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+        return EFI_NOT_FOUND;
+    }
+
+    UINTN BlockSize = Word & ~LZ4_BLOCK_UNCOMPRESSED;
+    if (BlockSize > Dec->MaxBlockSize) return EFI_VOLUME_CORRUPTED;
+    BOOLEAN Stored = (Word & LZ4_BLOCK_UNCOMPRESSED) != 0;
+    UINT64 Left = MAX_UINT64;
+    if (Dec->FrameContentSize != PXS_DECOMPRESS_UNKNOWN_SIZE) {
+        if (Dec->FrameOutput > Dec->FrameContentSize) return EFI_VOLUME_CORRUPTED;
+        Left = Dec->FrameContentSize - Dec->FrameOutput;
+    }
+
+    Unit->Kind = Stored ? PXS_DECOMPRESS_UNIT_RAW : PXS_DECOMPRESS_UNIT_LZ4_BLOCK;
+    Unit->Format = PXS_COMPRESSION_LZ4;
+    Unit->InOffset = Start + 4;
+    Unit->InSize = BlockSize;
+    Unit->OutSize = Stored ? BlockSize : MIN((UINT64)Dec->MaxBlockSize, Left);
+
+    // Whether the end mark follows decides if a compressed block may be short
+    BlockEnd = Start + 4 + BlockSize + ((Dec->Flags & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0);
+    if (BlockEnd > Remaining || Remaining - BlockEnd < 4) return EFI_VOLUME_CORRUPTED;
+    if (InSize - Start < BlockEnd - Start + 4) {
+        *Needed = BlockEnd + 4;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    Last = ReadLe32(In + BlockEnd) == 0;
+    if (!Stored && Last) {
+        if (Left == MAX_UINT64) {
+            Unit->Bounded = TRUE;
+        } else if (Left > Dec->MaxBlockSize) {
+            return EFI_VOLUME_CORRUPTED;
+        } else {
+            Unit->OutSize = Left;
+        }
+    }
+    if (Unit->OutSize > Left) return EFI_VOLUME_CORRUPTED;
+
+    Dec->FrameOutput += Unit->OutSize;
+    *Pos = BlockEnd;
+    return EFI_SUCCESS;
+}
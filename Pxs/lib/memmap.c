@@ -0,0 +1,121 @@
+#include <Uefi.h>
+
+#include <memmap.h>
+
+STATIC UINT32 MemoryTypeOf(CONST EFI_MEMORY_DESCRIPTOR *Desc) {
+    switch (Desc->Type) {
+        case EfiConventionalMemory:
+            return PXS_MEMORY_USABLE;
+        case EfiBootServicesCode:
+        case EfiBootServicesData:
+            return PXS_MEMORY_RECLAIMABLE;
+        case EfiLoaderCode:
+        case EfiLoaderData:
+            return PXS_MEMORY_LOADER;
+        case EfiACPIReclaimMemory:
+            return PXS_MEMORY_ACPI_RECLAIMABLE;
+        case EfiACPIMemoryNVS:
+            return PXS_MEMORY_ACPI_NVS;
+        case EfiMemoryMappedIO:
+        case EfiMemoryMappedIOPortSpace:
+            return PXS_MEMORY_MMIO;
+        case PXS_EFI_MEMORY_KERNEL:
+            return PXS_MEMORY_KERNEL;
+        case PXS_EFI_MEMORY_MODULE:
+            return PXS_MEMORY_MODULE;
+        case PXS_EFI_MEMORY_HANDOFF:
+            return PXS_MEMORY_HANDOFF;
+        case PXS_EFI_MEMORY_AP_PARK:
+            return PXS_MEMORY_AP_PARK;
+        default:
+            return PXS_MEMORY_RESERVED;
+    }
+}
+
+// In-place heapsort by Base: bounded time on large, unsorted maps and no scratch memory
+STATIC VOID MemoryMapSiftDown(PXS_MEMORY_RANGE *Entries, UINTN Root, UINTN Count) {
+    PXS_MEMORY_RANGE Tmp;
+    for (;;) {
+        UINTN Child = 2 * Root + 1;
+        if (Child >= Count) return;
+        if (Child + 1 < Count && Entries[Child].Base < Entries[Child + 1].Base) {
+            Child++;
+        }
+        if (Entries[Root].Base >= Entries[Child].Base) return;
+        Tmp = Entries[Root];
+        Entries[Root] = Entries[Child];
+        Entries[Child] = Tmp;
+        Root = Child;
+    }
+}
+
+STATIC VOID MemoryMapSort(PXS_MEMORY_RANGE *Entries, UINTN Count) {
+    PXS_MEMORY_RANGE Tmp;
+    BOOLEAN Sorted = TRUE;
+
+    // Most firmware already returns the map in address order
+    for (UINTN i = 1; i < Count && Sorted; i++) {
+        Sorted = Entries[i - 1].Base <= Entries[i].Base;
+    }
+    if (Sorted) return;
+
+    for (UINTN i = Count / 2; i-- > 0;) {
+        MemoryMapSiftDown(Entries, i, Count);
+    }
+    for (UINTN End = Count - 1; End > 0; End--) {
+        Tmp = Entries[0];
+        Entries[0] = Entries[End];
+        Entries[End] = Tmp;
+        MemoryMapSiftDown(Entries, 0, End);
+    }
+}
+
+EFI_STATUS MemoryMapNormalize(
+    IN CONST EFI_MEMORY_DESCRIPTOR *Map,
+    IN UINTN MapSize,
+    IN UINTN DescriptorSize,
+    OUT PXS_MEMORY_RANGE *Entries,
+    IN UINTN Capacity,
+    OUT UINTN *Count
+) {
+    UINTN Found = 0;
+
+    *Count = 0;
+    for (UINTN Offset = 0; Offset + DescriptorSize <= MapSize; Offset += DescriptorSize) {
+        CONST EFI_MEMORY_DESCRIPTOR *Desc = (CONST EFI_MEMORY_DESCRIPTOR *)((CONST UINT8 *)Map + Offset);
+        if (Desc->NumberOfPages == 0) continue;
+        if (Found >= Capacity) return EFI_BUFFER_TOO_SMALL;
+
+        PXS_MEMORY_RANGE *Entry = &Entries[Found++];
+        Entry->Base = Desc->PhysicalStart;
+        Entry->Length = EFI_PAGES_TO_SIZE(Desc->NumberOfPages);
+        Entry->Type = MemoryTypeOf(Desc);
+        Entry->Flags = (Desc->Attribute & EFI_MEMORY_RUNTIME) ? PXS_MEMORY_FLAG_RUNTIME : 0;
+    }
+    if (Found == 0) return EFI_SUCCESS;
+
+    MemoryMapSort(Entries, Found);
+
+    // Merge in one pass. A range overlapping its predecessor loses the overlap.
+    UINTN Out = 0;
+    for (UINTN i = 1; i < Found; i++) {
+        PXS_MEMORY_RANGE *Prev = &Entries[Out];
+        PXS_MEMORY_RANGE Cur = Entries[i];
+        UINT64 PrevEnd = Prev->Base + Prev->Length;
+
+        if (Cur.Base < PrevEnd) {
+            UINT64 CurEnd = Cur.Base + Cur.Length;
+            if (CurEnd <= PrevEnd) continue;
+            Cur.Length = CurEnd - PrevEnd;
+            Cur.Base = PrevEnd;
+        }
+        if (Cur.Base == PrevEnd && Cur.Type == Prev->Type && Cur.Flags == Prev->Flags) {
+            Prev->Length += Cur.Length;
+            continue;
+        }
+        Entries[++Out] = Cur;
+    }
+
+    *Count = Out + 1;
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,211 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <numa.h>
+
+#define SRAT_ENTRIES            48      // Header and 12 reserved bytes
+#define SLIT_LOCALITIES         36
+#define SLIT_MATRIX             44
+#define SLIT_MAX_LOCALITIES     0x10000
+
+// SRAT affinity structures and their sizes
+#define SRAT_LAPIC              0
+#define SRAT_MEMORY             1
+#define SRAT_X2APIC             2
+#define SRAT_LAPIC_SIZE         16
+#define SRAT_MEMORY_SIZE        40
+#define SRAT_X2APIC_SIZE        24
+
+#define SRAT_ENABLED            0x01
+#define SRAT_MEMORY_HOTPLUG     0x02
+#define SRAT_MEMORY_NONVOLATILE 0x04
+
+// An enabled processor or memory affinity structure
+typedef struct {
+    UINT8  Type;
+    UINT32 Domain;
+    UINT32 ApicId;      // Processors
+    UINT64 Base;        // Memory
+    UINT64 Length;
+    UINT32 Flags;
+} SRAT_ENTRY;
+
+typedef struct {
+    CONST UINT8 *Table;
+    UINT32      Length;
+    UINT32      Offset;
+    UINT8       Revision;
+} SRAT_WALK;
+
+STATIC UINT32 NumaRead32(CONST UINT8 *P) {
+    UINT32 Value;
+    CopyMem(&Value, P, sizeof(Value));
+    return Value;
+}
+
+STATIC UINT64 NumaRead64(CONST UINT8 *P) {
+    UINT64 Value;
+    CopyMem(&Value, P, sizeof(Value));
+    return Value;
+}
+
+STATIC BOOLEAN SratDecode(CONST UINT8 *P, UINT8 Revision, SRAT_ENTRY *Entry) {
+    SetMem(Entry, sizeof(*Entry), 0);
+    Entry->Type = P[0];
+    switch (P[0]) {
+    case SRAT_LAPIC:
+        if (P[1] < SRAT_LAPIC_SIZE) return FALSE;
+        Entry->ApicId = P[3];
+        Entry->Flags = NumaRead32(P + 4);
+        Entry->Domain = P[2];
+        if (Revision >= 2) Entry->Domain |= ((UINT32)P[9] << 8) | ((UINT32)P[10] << 16) | ((UINT32)P[11] << 24);
+        break;
+    case SRAT_MEMORY:
+        if (P[1] < SRAT_MEMORY_SIZE) return FALSE;
+        Entry->Domain = NumaRead32(P + 2);
+        if (Revision < 2) Entry->Domain &= 0xFF;    // ACPI 2.0 had 8-bit domains
+        Entry->Base = NumaRead64(P + 8);
+        Entry->Length = NumaRead64(P + 16);
+        Entry->Flags = NumaRead32(P + 28);
+        if (Entry->Length == 0) return FALSE;
+        break;
+    case SRAT_X2APIC:
+        if (P[1] < SRAT_X2APIC_SIZE) return FALSE;
+        Entry->Domain = NumaRead32(P + 4);
+        Entry->ApicId = NumaRead32(P + 8);
+        Entry->Flags = NumaRead32(P + 12);
+        break;
+    default:
+        return FALSE;
+    }
+    return (Entry->Flags & SRAT_ENABLED) != 0;
+}
+
+// Next enabled affinity structure; the walk ends at one that does not fit
+STATIC BOOLEAN SratNext(SRAT_WALK *Walk, SRAT_ENTRY *Entry) {
+    while (Walk->Length - Walk->Offset >= 2) {
+        CONST UINT8 *P = Walk->Table + Walk->Offset;
+        if (P[1] < 2 || P[1] > Walk->Length - Walk->Offset) return FALSE;
+        Walk->Offset += P[1];
+        if (SratDecode(P, Walk->Revision, Entry)) return TRUE;
+    }
+    return FALSE;
+}
+
+// First of the Count nodes (sorted by domain) whose domain is not below Domain
+STATIC UINT32 NumaLowerBound(CONST PXS_NUMA_NODE *Nodes, UINT32 Count, UINT32 Domain) {
+    UINT32 Low = 0, High = Count;
+    while (Low < High) {
+        UINT32 Mid = Low + (High - Low) / 2;
+        if (Nodes[Mid].Domain < Domain) Low = Mid + 1;
+        else High = Mid;
+    }
+    return Low;
+}
+
+EFI_STATUS NumaBuildTable(
+    IN CONST VOID *Srat,
+    IN UINT32 BspApicId,
+    IN OUT PXS_NUMA *Numa
+) {
+    CONST UINT8 *Table = (CONST UINT8 *)Srat;
+    SRAT_WALK Walk;
+    SRAT_ENTRY Entry;
+    UINT32 NodeCount = 0, RangeCount = 0;
+    UINT32 BspDomain = 0;
+    BOOLEAN BspFound = FALSE;
+
+    if (!Table || CompareMem(Table, "SRAT", 4) != 0) return EFI_NOT_FOUND;
+    Walk.Table = Table;
+    Walk.Length = NumaRead32(Table + 4);
+    Walk.Offset = SRAT_ENTRIES;
+    Walk.Revision = Table[8];
+    if (Walk.Length < SRAT_ENTRIES) return EFI_NOT_FOUND;
+
+    // Every entry could name a new domain
+    if (!Numa->Nodes) {
+        while (SratNext(&Walk, &Entry)) {
+            NodeCount++;
+            if (Entry.Type == SRAT_MEMORY) RangeCount++;
+        }
+        Numa->NodeCount = NodeCount;
+        Numa->RangeCount = RangeCount;
+        return EFI_SUCCESS;
+    }
+
+    // Nodes are kept sorted by domain as they are found. Ranges hold their
+    // domain in Node until every node is known.
+    PXS_NUMA_NODE *Nodes = Numa->Nodes;
+    PXS_NUMA_RANGE *Ranges = Numa->Ranges;
+    while (SratNext(&Walk, &Entry)) {
+        UINT32 Index = NumaLowerBound(Nodes, NodeCount, Entry.Domain);
+        if (Index == NodeCount || Nodes[Index].Domain != Entry.Domain) {
+            if (NodeCount == Numa->NodeCount) return EFI_BUFFER_TOO_SMALL;
+            CopyMem(&Nodes[Index + 1], &Nodes[Index], (NodeCount - Index) * sizeof(PXS_NUMA_NODE));
+            SetMem(&Nodes[Index], sizeof(PXS_NUMA_NODE), 0);
+            Nodes[Index].Domain = Entry.Domain;
+            NodeCount++;
+        }
+
+        if (Entry.Type != SRAT_MEMORY) {
+            Nodes[Index].CpuCount++;
+            if (Entry.ApicId == BspApicId) {
+                BspDomain = Entry.Domain;
+                BspFound = TRUE;
+            }
+            continue;
+        }
+        if (RangeCount == Numa->RangeCount) return EFI_BUFFER_TOO_SMALL;
+        PXS_NUMA_RANGE *Range = &Ranges[RangeCount++];
+        Range->Base = Entry.Base;
+        Range->Length = Entry.Length;
+        Range->Node = Entry.Domain;
+        Range->Flags = 0;
+        if (Entry.Flags & SRAT_MEMORY_HOTPLUG) Range->Flags |= PXS_NUMA_RANGE_HOTPLUG;
+        if (Entry.Flags & SRAT_MEMORY_NONVOLATILE) Range->Flags |= PXS_NUMA_RANGE_NONVOLATILE;
+    }
+
+    // Insertion sort by node, then base: a few ranges per node at most
+    for (UINT32 i = 0; i < RangeCount; i++) {
+        PXS_NUMA_RANGE Key = Ranges[i];
+        Key.Node = NumaLowerBound(Nodes, NodeCount, Key.Node);
+        UINT32 j = i;
+        while (j > 0 && (Ranges[j - 1].Node > Key.Node || (Ranges[j - 1].Node == Key.Node && Ranges[j - 1].Base > Key.Base))) {
+            Ranges[j] = Ranges[j - 1];
+            j--;
+        }
+        Ranges[j] = Key;
+    }
+    for (UINT32 i = 0; i < RangeCount; i++) {
+        PXS_NUMA_NODE *Node = &Nodes[Ranges[i].Node];
+        if (Node->RangeCount == 0) Node->FirstRange = i;
+        Node->RangeCount++;
+    }
+
+    Numa->Version = PXS_NUMA_VERSION;
+    Numa->NodeCount = NodeCount;
+    Numa->RangeCount = RangeCount;
+    Numa->BspNode = BspFound ? NumaLowerBound(Nodes, NodeCount, BspDomain) : PXS_NUMA_NO_NODE;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS NumaReadDistances(IN CONST VOID *Slit, IN OUT PXS_NUMA *Numa) {
+    CONST UINT8 *Table = (CONST UINT8 *)Slit;
+
+    if (!Table || CompareMem(Table, "SLIT", 4) != 0) return EFI_NOT_FOUND;
+    UINT32 Length = NumaRead32(Table + 4);
+    if (Length < SLIT_MATRIX) return EFI_NOT_FOUND;
+    UINT64 Localities = NumaRead64(Table + SLIT_LOCALITIES);
+    if (Localities > SLIT_MAX_LOCALITIES || Localities * Localities > Length - SLIT_MATRIX) return EFI_NOT_FOUND;
+
+    CONST UINT8 *Matrix = Table + SLIT_MATRIX;
+    for (UINT32 From = 0; From < Numa->NodeCount; From++) {
+        UINT64 Row = Numa->Nodes[From].Domain;
+        for (UINT32 To = 0; To < Numa->NodeCount; To++) {
+            UINT64 Column = Numa->Nodes[To].Domain;
+            Numa->Distances[From * Numa->NodeCount + To] =
+                (Row < Localities && Column < Localities) ? Matrix[Row * Localities + Column] : 0;
+        }
+    }
+    return EFI_SUCCESS;
+}
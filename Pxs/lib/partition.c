@@ -0,0 +1,116 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <hex.h>
+#include <partition.h>
+
+#define GUID_TEXT_LENGTH    36
+
+// Digits hex digits at Text as a number
+STATIC BOOLEAN PartitionHex(CONST CHAR16 *Text, UINTN Digits, UINT64 *Value) {
+    *Value = 0;
+    for (UINTN i = 0; i < Digits; i++) {
+        INTN Digit = HexDigit(Text[i]);
+        if (Digit < 0) return FALSE;
+        *Value = (*Value << 4) | (UINT64)Digit;
+    }
+    return TRUE;
+}
+
+// xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx; the first three groups are the
+// little-endian fields of EFI_GUID, the last two its bytes in order
+STATIC BOOLEAN PartitionParseGuid(CONST CHAR16 *Text, EFI_GUID *Guid) {
+    UINT64 Value;
+
+    for (UINTN i = 0; i < GUID_TEXT_LENGTH; i++) {
+        BOOLEAN Dash = (i == 8 || i == 13 || i == 18 || i == 23);
+        if (Text[i] == L'\0' || (Text[i] == L'-') != Dash) return FALSE;
+    }
+    if (!PartitionHex(Text, 8, &Value)) return FALSE;
+    Guid->Data1 = (UINT32)Value;
+    if (!PartitionHex(Text + 9, 4, &Value)) return FALSE;
+    Guid->Data2 = (UINT16)Value;
+    if (!PartitionHex(Text + 14, 4, &Value)) return FALSE;
+    Guid->Data3 = (UINT16)Value;
+    for (UINTN i = 0; i < 8; i++) {
+        CONST CHAR16 *Byte = Text + (i < 2 ? 19 + 2 * i : 24 + 2 * (i - 2));
+        if (!PartitionHex(Byte, 2, &Value)) return FALSE;
+        Guid->Data4[i] = (UINT8)Value;
+    }
+    return TRUE;
+}
+
+STATIC BOOLEAN PartitionParseOffset(CONST CHAR16 *Text, UINT64 *Offset) {
+    UINT64 Value = 0;
+    UINTN i = 0;
+
+    if (Text[0] == L'0' && (Text[1] | 0x20) == L'x') {
+        for (i = 2; Text[i] != L'\0'; i++) {
+            INTN Digit = HexDigit(Text[i]);
+            if (Digit < 0 || Value > (MAX_UINT64 >> 4)) return FALSE;
+            Value = (Value << 4) | (UINT64)Digit;
+        }
+        *Offset = Value;
+        return i > 2;
+    }
+
+    while (Text[i] >= L'0' && Text[i] <= L'9') {
+        UINT64 Digit = Text[i++] - L'0';
+        if (Value > MAX_UINT64 / 10 || Value * 10 > MAX_UINT64 - Digit) return FALSE;
+        Value = Value * 10 + Digit;
+    }
+    if (i == 0) return FALSE;
+
+    UINTN Shift = 0;
+    switch (Text[i] | 0x20) {
+        case L'k': Shift = 10; i++; break;
+        case L'm': Shift = 20; i++; break;
+        case L'g': Shift = 30; i++; break;
+        default:   break;
+    }
+    if (Text[i] != L'\0' || Value > (MAX_UINT64 >> Shift)) return FALSE;
+    *Offset = Value << Shift;
+    return TRUE;
+}
+
+BOOLEAN PartitionIsSource(IN CONST CHAR16 *Path) {
+    CONST CHAR16 *Prefix = PXS_PARTITION_PREFIX;
+
+    for (UINTN i = 0; Prefix[i] != L'\0'; i++) {
+        if (Path[i] != Prefix[i]) return FALSE;
+    }
+    return TRUE;
+}
+
+BOOLEAN PartitionParseSource(IN CONST CHAR16 *Path, OUT EFI_GUID *Guid, OUT UINT64 *Offset) {
+    if (!PartitionIsSource(Path)) return FALSE;
+    Path += ARRAY_SIZE(PXS_PARTITION_PREFIX) - 1;
+
+    if (!PartitionParseGuid(Path, Guid)) return FALSE;
+    Path += GUID_TEXT_LENGTH;
+    *Offset = 0;
+    if (*Path == L'\0') return TRUE;
+    return *Path == L':' && PartitionParseOffset(Path + 1, Offset);
+}
+
+EFI_STATUS PartitionParseExtent(
+    IN CONST VOID *Data,
+    IN UINT64 Room,
+    OUT UINT64 *DataOffset,
+    OUT UINT64 *DataSize
+) {
+    PXS_EXTENT_HEADER Header;
+
+    if (Room < sizeof(Header)) return EFI_NOT_FOUND;
+    CopyMem(&Header, Data, sizeof(Header));
+    if (CompareMem(Header.Magic, PXS_EXTENT_MAGIC, sizeof(Header.Magic)) != 0) return EFI_NOT_FOUND;
+    if (Header.Version != PXS_EXTENT_VERSION) return EFI_UNSUPPORTED;
+
+    if (Header.HeaderSize < sizeof(Header) || Header.DataOffset < Header.HeaderSize || Header.DataOffset > Room ||
+        Header.DataSize > Room - Header.DataOffset) {
+        return EFI_VOLUME_CORRUPTED;
+    }
+    *DataOffset = Header.DataOffset;
+    *DataSize = Header.DataSize;
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <sha256.h>
+
+STATIC CONST UINT32 mSha256Init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// Shared with the accelerated block functions
+CONST UINT32 gSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR32(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x)     (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define BSIG1(x)     (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define SSIG0(x)     (ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define SSIG1(x)     (ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+
+STATIC UINT32 Sha256Load32(CONST UINT8 *P) {
+    return ((UINT32)P[0] << 24) | ((UINT32)P[1] << 16) | ((UINT32)P[2] << 8) | P[3];
+}
+
+VOID Sha256BlocksGeneric(IN OUT UINT32 *State, IN CONST UINT8 *Data, IN UINTN Blocks) {
+    UINT32 W[64];
+
+    while (Blocks-- > 0) {
+        for (UINTN i = 0; i < 16; i++) {
+            W[i] = Sha256Load32(Data + 4 * i);
+        }
+        for (UINTN i = 16; i < 64; i++) {
+            W[i] = SSIG1(W[i - 2]) + W[i - 7] + SSIG0(W[i - 15]) + W[i - 16];
+        }
+
+        UINT32 a = State[0], b = State[1], c = State[2], d = State[3];
+        UINT32 e = State[4], f = State[5], g = State[6], h = State[7];
+        for (UINTN i = 0; i < 64; i++) {
+            UINT32 T1 = h + BSIG1(e) + CH(e, f, g) + gSha256K[i] + W[i];
+            UINT32 T2 = BSIG0(a) + MAJ(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + T1;
+            d = c;
+            c = b;
+            b = a;
+            a = T1 + T2;
+        }
+        State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+        State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+        Data += PXS_SHA256_BLOCK_SIZE;
+    }
+}
+
+VOID Sha256Init(OUT PXS_SHA256 *Ctx, IN PXS_SHA256_BLOCKS Blocks OPTIONAL) {
+    CopyMem(Ctx->State, mSha256Init, sizeof(mSha256Init));
+    Ctx->Length = 0;
+    Ctx->Buffered = 0;
+    Ctx->Blocks = Blocks ? Blocks : Sha256BlocksGeneric;
+}
+
+VOID Sha256Update(IN OUT PXS_SHA256 *Ctx, IN CONST VOID *Data, IN UINTN Size) {
+    CONST UINT8 *In = (CONST UINT8 *)Data;
+
+    Ctx->Length += Size;
+    if (Ctx->Buffered > 0) {
+        UINTN Take = MIN(Size, PXS_SHA256_BLOCK_SIZE - Ctx->Buffered);
+        CopyMem(Ctx->Buffer + Ctx->Buffered, In, Take);
+        Ctx->Buffered += Take;
+        In += Take;
+        Size -= Take;
+        if (Ctx->Buffered < PXS_SHA256_BLOCK_SIZE) return;
+        Ctx->Blocks(Ctx->State, Ctx->Buffer, 1);
+        Ctx->Buffered = 0;
+    }
+
+    // Whole blocks are compressed straight from the caller's buffer
+    UINTN Blocks = Size / PXS_SHA256_BLOCK_SIZE;
+    if (Blocks > 0) {
+        Ctx->Blocks(Ctx->State, In, Blocks);
+        In += Blocks * PXS_SHA256_BLOCK_SIZE;
+        Size -= Blocks * PXS_SHA256_BLOCK_SIZE;
+    }
+    if (Size > 0) {
+        CopyMem(Ctx->Buffer, In, Size);
+        Ctx->Buffered = Size;
+    }
+}
+
+VOID Sha256Final(IN OUT PXS_SHA256 *Ctx, OUT UINT8 *Digest) {
+    UINT64 Bits = Ctx->Length * 8;
+
+    Ctx->Buffer[Ctx->Buffered++] = 0x80;
+    if (Ctx->Buffered > PXS_SHA256_BLOCK_SIZE - 8) {
+        SetMem(Ctx->Buffer + Ctx->Buffered, PXS_SHA256_BLOCK_SIZE - Ctx->Buffered, 0);
+        Ctx->Blocks(Ctx->State, Ctx->Buffer, 1);
+        Ctx->Buffered = 0;
+    }
+    SetMem(Ctx->Buffer + Ctx->Buffered, PXS_SHA256_BLOCK_SIZE - 8 - Ctx->Buffered, 0);
+    for (UINTN i = 0; i < 8; i++) {
+        Ctx->Buffer[PXS_SHA256_BLOCK_SIZE - 1 - i] = (UINT8)(Bits >> (8 * i));
+    }
+    Ctx->Blocks(Ctx->State, Ctx->Buffer, 1);
+
+    for (UINTN i = 0; i < 8; i++) {
+        Digest[4 * i + 0] = (UINT8)(Ctx->State[i] >> 24);
+        Digest[4 * i + 1] = (UINT8)(Ctx->State[i] >> 16);
+        Digest[4 * i + 2] = (UINT8)(Ctx->State[i] >> 8);
+        Digest[4 * i + 3] = (UINT8)Ctx->State[i];
+    }
+}
@@ -0,0 +1,114 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+#include <smbios.h>
+
+#define SMBIOS_HEADER_SIZE      4
+#define SMBIOS_END_OF_TABLE     127
+#define SMBIOS_TYPES            256
+
+#define SMBIOS3_ENTRY_SIZE      0x18
+#define SMBIOS2_ENTRY_SIZE      0x1E    // 0x1F by the spec; some 2.1 firmware says 0x1E
+#define SMBIOS2_DMI_OFFSET      0x10
+#define SMBIOS2_DMI_SIZE        0x0F
+
+STATIC BOOLEAN SmbiosChecksum(CONST UINT8 *P, UINTN Length) {
+    UINT8 Sum = 0;
+    for (UINTN i = 0; i < Length; i++) Sum += P[i];
+    return Sum == 0;
+}
+
+BOOLEAN SmbiosParseEntryPoint(IN CONST VOID *EntryPoint, OUT PXS_SMBIOS_TABLE *Table) {
+    CONST UINT8 *P = (CONST UINT8 *)EntryPoint;
+    UINT16 Length16;
+    UINT32 Address32;
+
+    SetMem(Table, sizeof(*Table), 0);
+    if (!P) return FALSE;
+
+    if (CompareMem(P, "_SM3_", 5) == 0) {
+        if (P[6] < SMBIOS3_ENTRY_SIZE || !SmbiosChecksum(P, P[6])) return FALSE;
+        Table->Major = P[7];
+        Table->Minor = P[8];
+        CopyMem(&Table->Size, P + 12, sizeof(UINT32));
+        CopyMem(&Table->Address, P + 16, sizeof(UINT64));
+        Table->MaxStructures = MAX_UINT32;
+    } else if (CompareMem(P, "_SM_", 4) == 0) {
+        if (P[5] < SMBIOS2_ENTRY_SIZE || !SmbiosChecksum(P, P[5])) return FALSE;
+        if (CompareMem(P + SMBIOS2_DMI_OFFSET, "_DMI_", 5) != 0 || !SmbiosChecksum(P + SMBIOS2_DMI_OFFSET, SMBIOS2_DMI_SIZE)) {
+            return FALSE;
+        }
+        Table->Major = P[6];
+        Table->Minor = P[7];
+        CopyMem(&Length16, P + 22, sizeof(UINT16));
+        CopyMem(&Address32, P + 24, sizeof(UINT32));
+        Table->Size = Length16;
+        Table->Address = Address32;
+        CopyMem(&Length16, P + 28, sizeof(UINT16));
+        Table->MaxStructures = Length16;
+    } else {
+        return FALSE;
+    }
+
+    Table->EntryPoint = (UINT64)(UINTN)P;
+    return Table->Address != 0 && Table->Size >= SMBIOS_HEADER_SIZE;
+}
+
+// Size of the structure at Offset, formatted area and strings, or 0 where the
+// walk ends: the end-of-table structure, or one that does not fit the table
+STATIC UINT32 SmbiosStructureSize(CONST PXS_SMBIOS_TABLE *Table, UINT32 Offset) {
+    CONST UINT8 *Base = (CONST UINT8 *)(UINTN)Table->Address;
+
+    if (Table->Size - Offset < SMBIOS_HEADER_SIZE) return 0;
+    if (Base[Offset] == SMBIOS_END_OF_TABLE) return 0;
+    UINT8 Length = Base[Offset + 1];
+    if (Length < SMBIOS_HEADER_SIZE || Length > Table->Size - Offset) return 0;
+
+    // Strings end with an empty one, so the set ends in a double NUL
+    for (UINT32 i = Offset + Length; i + 1 < Table->Size; i++) {
+        if (Base[i] == 0 && Base[i + 1] == 0) return i + 2 - Offset;
+    }
+    return 0;
+}
+
+EFI_STATUS SmbiosBuildIndex(
+    IN CONST PXS_SMBIOS_TABLE *Table,
+    OUT PXS_SMBIOS_STRUCTURE *Structures OPTIONAL,
+    IN UINT32 Capacity,
+    OUT UINT32 *Count
+) {
+    CONST UINT8 *Base = (CONST UINT8 *)(UINTN)Table->Address;
+    UINT32 Next[SMBIOS_TYPES];
+    UINT32 Total = 0;
+    UINT32 Offset, Size;
+
+    SetMem(Next, sizeof(Next), 0);
+    for (Offset = 0; Total < Table->MaxStructures && (Size = SmbiosStructureSize(Table, Offset)) != 0; Offset += Size) {
+        Next[Base[Offset]]++;
+        Total++;
+    }
+
+    *Count = Total;
+    if (!Structures) return EFI_SUCCESS;
+    if (Total > Capacity) return EFI_BUFFER_TOO_SMALL;
+
+    // Counting sort by type: Next becomes each type's next free slot
+    UINT32 Start = 0;
+    for (UINTN Type = 0; Type < SMBIOS_TYPES; Type++) {
+        UINT32 TypeCount = Next[Type];
+        Next[Type] = Start;
+        Start += TypeCount;
+    }
+
+    UINT32 Placed = 0;
+    for (Offset = 0; Placed < Total && (Size = SmbiosStructureSize(Table, Offset)) != 0; Offset += Size) {
+        PXS_SMBIOS_STRUCTURE *Structure = &Structures[Next[Base[Offset]]++];
+        Structure->Address = Table->Address + Offset;
+        Structure->Size = Size;
+        Structure->Type = Base[Offset];
+        Structure->Length = Base[Offset + 1];
+        CopyMem(&Structure->Handle, Base + Offset + 2, sizeof(UINT16));
+        Placed++;
+    }
+    return EFI_SUCCESS;
+}
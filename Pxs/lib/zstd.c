@@ -0,0 +1,929 @@
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <decompress.h>
+
+// Zstandard decoder (RFC 8878), single-threaded and dictionary-less.
+
+#define ZSTD_MAGIC               0xFD2FB528
+#define ZSTD_BLOCK_MAX           (128 * 1024)
+#define ZSTD_WINDOW_LOG_MIN      10
+
+#define ZSTD_BLOCK_RAW           0
+#define ZSTD_BLOCK_RLE           1
+#define ZSTD_BLOCK_COMPRESSED    2
+
+#define ZSTD_LIT_RAW             0
+#define ZSTD_LIT_RLE             1
+#define ZSTD_LIT_COMPRESSED      2
+#define ZSTD_LIT_TREELESS        3
+
+#define ZSTD_MODE_PREDEFINED     0
+#define ZSTD_MODE_RLE            1
+#define ZSTD_MODE_FSE            2
+#define ZSTD_MODE_REPEAT         3
+
+#define ZSTD_HUF_MAX_BITS        11
+#define ZSTD_FSE_MAX_LOG         9
+
+#define ZSTD_LL_MAX_SYMBOL       35
+#define ZSTD_ML_MAX_SYMBOL       52
+#define ZSTD_OF_MAX_SYMBOL       31
+#define ZSTD_LL_MAX_LOG          9
+#define ZSTD_ML_MAX_LOG          9
+#define ZSTD_OF_MAX_LOG          8
+
+#define ZSTD_FHD_CHECKSUM        0x04
+#define ZSTD_FHD_SINGLE_SEGMENT  0x20
+#define ZSTD_FHD_RESERVED        0x08
+
+typedef struct {
+    UINT8  Symbol;
+    UINT8  NumBits;
+    UINT16 NewState;
+} ZSTD_FSE_ENTRY;
+
+typedef struct {
+    UINT8  Symbol;
+    UINT8  NumBits;
+} ZSTD_HUF_ENTRY;
+
+typedef struct {
+    ZSTD_FSE_ENTRY Entries[1 << ZSTD_FSE_MAX_LOG];
+    UINT32         Log;
+    BOOLEAN        Valid;
+} ZSTD_FSE_TABLE;
+
+typedef struct {
+    UINT32          Rep[3];
+    BOOLEAN         LastBlock;
+    BOOLEAN         HufValid;
+    UINT32          HufMaxBits;
+    ZSTD_HUF_ENTRY  Huf[1 << ZSTD_HUF_MAX_BITS];
+    ZSTD_FSE_TABLE  LlTable;
+    ZSTD_FSE_TABLE  OfTable;
+    ZSTD_FSE_TABLE  MlTable;
+    ZSTD_FSE_TABLE  LlDefault;
+    ZSTD_FSE_TABLE  OfDefault;
+    ZSTD_FSE_TABLE  MlDefault;
+    ZSTD_FSE_TABLE  Scratch;  // Huffman weight decoding
+    UINT8           Literals[ZSTD_BLOCK_MAX];
+} ZSTD_CONTEXT;
+
+// Predefined distributions (RFC 8878 3.1.1.3.2.2)
+STATIC CONST INT16 mLlDefaultNorm[ZSTD_LL_MAX_SYMBOL + 1] = {
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+   -1,-1,-1,-1
+};
+STATIC CONST INT16 mMlDefaultNorm[ZSTD_ML_MAX_SYMBOL + 1] = {
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,-1,-1,
+   -1,-1,-1,-1,-1
+};
+STATIC CONST INT16 mOfDefaultNorm[29] = {
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,-1,-1,-1,-1,-1
+};
+
+STATIC CONST UINT32 mLlBase[ZSTD_LL_MAX_SYMBOL + 1] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+    8192, 16384, 32768, 65536
+};
+STATIC CONST UINT8 mLlBits[ZSTD_LL_MAX_SYMBOL + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+    13, 14, 15, 16
+};
+STATIC CONST UINT32 mMlBase[ZSTD_ML_MAX_SYMBOL + 1] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+    19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+    35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+    4099, 8195, 16387, 32771, 65539
+};
+STATIC CONST UINT8 mMlBits[ZSTD_ML_MAX_SYMBOL + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+    12, 13, 14, 15, 16
+};
+
+STATIC UINT32 HighBit32(UINT32 Value) {
+    return 31 - (UINT32)__builtin_clz(Value);
+}
+
+STATIC UINT64 ReadLe(CONST UINT8 *P, UINTN Bytes) {
+    UINT64 Value = 0;
+    for (UINTN i = 0; i < Bytes; i++) {
+        Value |= (UINT64)P[i] << (8 * i);
+    }
+    return Value;
+}
+
+// --------------------------------------------------------------------------
+// Backward bit stream: read from the last byte towards the first, high bits
+// first. Bits are numbered LSB-first across the buffer; Position counts the
+// bits still unread. Reads past the start yield zeros and drive Position
+// negative, which is how FSE detects the end of a stream.
+// --------------------------------------------------------------------------
+
+typedef struct {
+    CONST UINT8 *Data;
+    UINTN       Size;
+    INT64       Position;
+} ZSTD_BITS;
+
+STATIC EFI_STATUS BitsInit(ZSTD_BITS *Bits, CONST UINT8 *Data, UINTN Size) {
+    if (Size == 0 || Data[Size - 1] == 0) return EFI_VOLUME_CORRUPTED;
+    Bits->Data = Data;
+    Bits->Size = Size;
+    // Skip the zero padding and the terminating 1 bit
+    Bits->Position = (INT64)(Size - 1) * 8 + HighBit32(Data[Size - 1]);
+    return EFI_SUCCESS;
+}
+
+STATIC UINT64 BitsPeek(CONST ZSTD_BITS *Bits, UINT32 Count) {
+    if (Count == 0) return 0;
+
+    INT64 Start = Bits->Position - Count;
+    if (Start >= 0 && (UINT64)(Start >> 3) + 8 <= Bits->Size) {
+        UINT64 Word;
+        __builtin_memcpy(&Word, Bits->Data + (Start >> 3), sizeof(Word));
+        return (Word >> (Start & 7)) & ((1ULL << Count) - 1);
+    }
+
+    // Slow path near either end of the buffer
+    UINT64 Value = 0;
+    for (INT64 Bit = Bits->Position - 1; Bit >= Start; Bit--) {
+        Value <<= 1;
+        if (Bit >= 0) {
+            Value |= (Bits->Data[Bit >> 3] >> (Bit & 7)) & 1;
+        }
+    }
+    return Value;
+}
+
+STATIC UINT64 BitsRead(ZSTD_BITS *Bits, UINT32 Count) {
+    UINT64 Value = BitsPeek(Bits, Count);
+    Bits->Position -= Count;
+    return Value;
+}
+
+// --------------------------------------------------------------------------
+// FSE tables
+// --------------------------------------------------------------------------
+
+STATIC EFI_STATUS FseBuildTable(ZSTD_FSE_TABLE *Table, CONST INT16 *Norm, UINT32 MaxSymbol, UINT32 Log) {
+    UINT32 TableSize = 1U << Log;
+    UINT32 High = TableSize - 1;
+    UINT16 SymbolNext[256];
+
+    for (UINT32 s = 0; s <= MaxSymbol; s++) {
+        if (Norm[s] == -1) {
+            Table->Entries[High--].Symbol = (UINT8)s;
+            SymbolNext[s] = 1;
+        } else {
+            SymbolNext[s] = (UINT16)Norm[s];
+        }
+    }
+
+    UINT32 Mask = TableSize - 1;
+    UINT32 Step = (TableSize >> 1) + (TableSize >> 3) + 3;
+    UINT32 Position = 0;
+    for (UINT32 s = 0; s <= MaxSymbol; s++) {
+        for (INT32 i = 0; i < Norm[s]; i++) {
+            Table->Entries[Position].Symbol = (UINT8)s;
+            do {
+                Position = (Position + Step) & Mask;
+            } while (Position > High);
+        }
+    }
+    if (Position != 0) return EFI_VOLUME_CORRUPTED;
+
+    for (UINT32 u = 0; u < TableSize; u++) {
+        ZSTD_FSE_ENTRY *Entry = &Table->Entries[u];
+        UINT32 Next = SymbolNext[Entry->Symbol]++;
+        if (Next == 0) return EFI_VOLUME_CORRUPTED;
+        UINT32 NumBits = Log - HighBit32(Next);
+        Entry->NumBits = (UINT8)NumBits;
+        Entry->NewState = (UINT16)((Next << NumBits) - TableSize);
+    }
+
+    Table->Log = Log;
+    Table->Valid = TRUE;
+    return EFI_SUCCESS;
+}
+
+STATIC VOID FseBuildRle(ZSTD_FSE_TABLE *Table, UINT8 Symbol) {
+    Table->Entries[0].Symbol = Symbol;
+    Table->Entries[0].NumBits = 0;
+    Table->Entries[0].NewState = 0;
+    Table->Log = 0;
+    Table->Valid = TRUE;
+}
+
+// Forward LSB-first read of up to 16 bits; bytes past the end read as zero
+STATIC UINT32 ForwardPeek(CONST UINT8 *In, UINTN InSize, UINT64 BitPos, UINT32 Count) {
+    UINTN Byte = (UINTN)(BitPos >> 3);
+    if (Byte >= InSize) return 0;
+    UINT32 Word = (UINT32)ReadLe(In + Byte, MIN(InSize - Byte, 4));
+    return (Word >> (BitPos & 7)) & ((1U << Count) - 1);
+}
+
+// Parse an FSE table description (forward, LSB-first bit stream)
+STATIC EFI_STATUS FseReadTable(
+    ZSTD_FSE_TABLE *Table,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT32 MaxSymbol,
+    UINT32 MaxLog,
+    UINTN *Used
+) {
+    INT16 Norm[256];
+    UINT64 BitPos = 0;
+    UINT64 BitLimit = (UINT64)InSize * 8;
+
+    if (InSize == 0) return EFI_VOLUME_CORRUPTED;
+
+    UINT32 Log = ForwardPeek(In, InSize, BitPos, 4) + 5;
+    BitPos += 4;
+    if (Log > MaxLog) return EFI_VOLUME_CORRUPTED;
+
+    INT32 Remaining = (1 << Log) + 1;
+    INT32 Threshold = 1 << Log;
+    UINT32 NumBits = Log + 1;
+    UINT32 Symbol = 0;
+
+    while (Remaining > 1) {
+        if (Symbol > MaxSymbol) return EFI_VOLUME_CORRUPTED;
+
+        INT32 Max = (2 * Threshold - 1) - Remaining;
+        INT32 Count = (INT32)ForwardPeek(In, InSize, BitPos, NumBits - 1);
+        if (Count < Max) {
+            BitPos += NumBits - 1;
+        } else {
+            Count = (INT32)ForwardPeek(In, InSize, BitPos, NumBits);
+            if (Count >= Threshold) Count -= Max;
+            BitPos += NumBits;
+        }
+        Count--; // -1 marks a "less than one" probability
+
+        Remaining -= (Count < 0) ? -Count : Count;
+        Norm[Symbol++] = (INT16)Count;
+
+        if (Count == 0) {
+            // Run of zero-probability symbols, 2 bits at a time
+            UINT32 Repeat;
+            do {
+                Repeat = ForwardPeek(In, InSize, BitPos, 2);
+                BitPos += 2;
+                for (UINT32 i = 0; i < Repeat; i++) {
+                    if (Symbol > MaxSymbol) return EFI_VOLUME_CORRUPTED;
+                    Norm[Symbol++] = 0;
+                }
+            } while (Repeat == 3);
+        }
+
+        while (Remaining < Threshold && Threshold > 1) {
+            NumBits--;
+            Threshold >>= 1;
+        }
+        if (BitPos > BitLimit) return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (Remaining != 1) return EFI_VOLUME_CORRUPTED;
+
+    *Used = (UINTN)((BitPos + 7) >> 3);
+    return FseBuildTable(Table, Norm, Symbol - 1, Log);
+}
+
+// --------------------------------------------------------------------------
+// Huffman literals
+// --------------------------------------------------------------------------
+
+STATIC EFI_STATUS HufReadTree(ZSTD_CONTEXT *Ctx, CONST UINT8 *In, UINTN InSize, UINTN *Used) {
+    UINT8 Weights[256];
+    UINTN NumWeights = 0;
+    EFI_STATUS Status;
+
+    if (InSize < 1) return EFI_VOLUME_CORRUPTED;
+    UINT8 Header = In[0];
+
+    if (Header >= 128) {
+        // Weights stored directly, 4 bits each
+        NumWeights = Header - 127;
+        UINTN Bytes = (NumWeights + 1) / 2;
+        if (InSize < 1 + Bytes) return EFI_VOLUME_CORRUPTED;
+        for (UINTN i = 0; i < NumWeights; i++) {
+            UINT8 Byte = In[1 + i / 2];
+            Weights[i] = (i & 1) ? (Byte & 15) : (Byte >> 4);
+        }
+        *Used = 1 + Bytes;
+    } else {
+        // FSE-compressed weights decoded with two interleaved states
+        UINTN TableSize;
+        if (Header == 0 || InSize < 1 + (UINTN)Header) return EFI_VOLUME_CORRUPTED;
+        Status = FseReadTable(&Ctx->Scratch, In + 1, Header, 15, 6, &TableSize);
+        if (EFI_ERROR(Status)) return Status;
+        if (TableSize >= Header) return EFI_VOLUME_CORRUPTED;
+
+        ZSTD_BITS Bits;
+        Status = BitsInit(&Bits, In + 1 + TableSize, Header - TableSize);
+        if (EFI_ERROR(Status)) return Status;
+
+        ZSTD_FSE_ENTRY *T = Ctx->Scratch.Entries;
+        UINT32 State1 = (UINT32)BitsRead(&Bits, Ctx->Scratch.Log);
+        UINT32 State2 = (UINT32)BitsRead(&Bits, Ctx->Scratch.Log);
+        for (;;) {
+            if (NumWeights >= 255) return EFI_VOLUME_CORRUPTED;
+            Weights[NumWeights++] = T[State1].Symbol;
+            State1 = T[State1].NewState + (UINT32)BitsRead(&Bits, T[State1].NumBits);
+            if (Bits.Position < 0) {
+                Weights[NumWeights++] = T[State2].Symbol;
+                break;
+            }
+            if (NumWeights >= 255) return EFI_VOLUME_CORRUPTED;
+            Weights[NumWeights++] = T[State2].Symbol;
+            State2 = T[State2].NewState + (UINT32)BitsRead(&Bits, T[State2].NumBits);
+            if (Bits.Position < 0) {
+                Weights[NumWeights++] = T[State1].Symbol;
+                break;
+            }
+        }
+        *Used = 1 + Header;
+    }
+
+    // The last weight is implied by completing the power of two
+    UINT32 Total = 0;
+    for (UINTN i = 0; i < NumWeights; i++) {
+        if (Weights[i] > ZSTD_HUF_MAX_BITS) return EFI_VOLUME_CORRUPTED;
+        if (Weights[i] > 0) Total += 1U << (Weights[i] - 1);
+    }
+    if (Total == 0 || NumWeights >= 256) return EFI_VOLUME_CORRUPTED;
+
+    UINT32 MaxBits = HighBit32(Total) + 1;
+    UINT32 Left = (1U << MaxBits) - Total;
+    if (MaxBits > ZSTD_HUF_MAX_BITS || (Left & (Left - 1)) != 0) return EFI_VOLUME_CORRUPTED;
+    Weights[NumWeights++] = (UINT8)(HighBit32(Left) + 1);
+
+    // Lay symbols out by increasing weight: low weights get the long codes
+    UINT32 RankStart[ZSTD_HUF_MAX_BITS + 2];
+    UINT32 RankCount[ZSTD_HUF_MAX_BITS + 2];
+    SetMem(RankCount, sizeof(RankCount), 0);
+    for (UINTN i = 0; i < NumWeights; i++) {
+        RankCount[Weights[i]]++;
+    }
+    UINT32 Next = 0;
+    for (UINT32 w = 1; w <= MaxBits; w++) {
+        RankStart[w] = Next;
+        Next += RankCount[w] << (w - 1);
+    }
+    for (UINTN s = 0; s < NumWeights; s++) {
+        UINT32 w = Weights[s];
+        if (w == 0) continue;
+        UINT32 Span = 1U << (w - 1);
+        for (UINT32 i = 0; i < Span; i++) {
+            Ctx->Huf[RankStart[w] + i].Symbol = (UINT8)s;
+            Ctx->Huf[RankStart[w] + i].NumBits = (UINT8)(MaxBits + 1 - w);
+        }
+        RankStart[w] += Span;
+    }
+
+    Ctx->HufMaxBits = MaxBits;
+    Ctx->HufValid = TRUE;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS HufDecodeStream(ZSTD_CONTEXT *Ctx, CONST UINT8 *In, UINTN InSize, UINT8 *Out, UINTN Count) {
+    ZSTD_BITS Bits;
+    EFI_STATUS Status = BitsInit(&Bits, In, InSize);
+    if (EFI_ERROR(Status)) return Status;
+
+    UINT32 MaxBits = Ctx->HufMaxBits;
+    for (UINTN i = 0; i < Count; i++) {
+        ZSTD_HUF_ENTRY Entry = Ctx->Huf[BitsPeek(&Bits, MaxBits)];
+        Out[i] = Entry.Symbol;
+        Bits.Position -= Entry.NumBits;
+    }
+    return (Bits.Position == 0) ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+}
+
+STATIC EFI_STATUS ZstdDecodeLiterals(
+    ZSTD_CONTEXT *Ctx,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINTN *Used,
+    CONST UINT8 **Literals,
+    UINTN *LiteralsSize
+) {
+    EFI_STATUS Status;
+
+    if (InSize < 1) return EFI_VOLUME_CORRUPTED;
+    UINT32 Type = In[0] & 3;
+    UINT32 SizeFormat = (In[0] >> 2) & 3;
+
+    if (Type == ZSTD_LIT_RAW || Type == ZSTD_LIT_RLE) {
+        UINTN HeaderSize;
+        UINTN Regenerated;
+        switch (SizeFormat) {
+            case 1:
+                HeaderSize = 2;
+                if (InSize < HeaderSize) return EFI_VOLUME_CORRUPTED;
+                Regenerated = (In[0] >> 4) + ((UINTN)In[1] << 4);
+                break;
+            case 3:
+                HeaderSize = 3;
+                if (InSize < HeaderSize) return EFI_VOLUME_CORRUPTED;
+                Regenerated = (In[0] >> 4) + ((UINTN)In[1] << 4) + ((UINTN)In[2] << 12);
+                break;
+            default:
+                HeaderSize = 1;
+                Regenerated = In[0] >> 3;
+                break;
+        }
+        if (Regenerated > ZSTD_BLOCK_MAX) return EFI_VOLUME_CORRUPTED;
+
+        if (Type == ZSTD_LIT_RAW) {
+            if (InSize - HeaderSize < Regenerated) return EFI_VOLUME_CORRUPTED;
+            *Literals = In + HeaderSize;
+            *Used = HeaderSize + Regenerated;
+        } else {
+            if (InSize - HeaderSize < 1) return EFI_VOLUME_CORRUPTED;
+            SetMem(Ctx->Literals, Regenerated, In[HeaderSize]);
+            *Literals = Ctx->Literals;
+            *Used = HeaderSize + 1;
+        }
+        *LiteralsSize = Regenerated;
+        return EFI_SUCCESS;
+    }
+
+    // Huffman-coded literals
+    UINTN HeaderSize;
+    UINT32 FieldBits;
+    BOOLEAN FourStreams = (SizeFormat != 0);
+    switch (SizeFormat) {
+        case 0:
+        case 1:  HeaderSize = 3; FieldBits = 10; break;
+        case 2:  HeaderSize = 4; FieldBits = 14; break;
+        default: HeaderSize = 5; FieldBits = 18; break;
+    }
+    if (InSize < HeaderSize) return EFI_VOLUME_CORRUPTED;
+    UINT64 Header = ReadLe(In, HeaderSize);
+    UINTN Regenerated = (UINTN)((Header >> 4) & ((1U << FieldBits) - 1));
+    UINTN Compressed = (UINTN)((Header >> (4 + FieldBits)) & ((1U << FieldBits) - 1));
+    if (Regenerated > ZSTD_BLOCK_MAX || InSize - HeaderSize < Compressed) {
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    CONST UINT8 *Stream = In + HeaderSize;
+    UINTN StreamSize = Compressed;
+    if (Type == ZSTD_LIT_COMPRESSED) {
+        UINTN TreeSize;
+        Status = HufReadTree(Ctx, Stream, StreamSize, &TreeSize);
+        if (EFI_ERROR(Status)) return Status;
+        if (TreeSize > StreamSize) return EFI_VOLUME_CORRUPTED;
+        Stream += TreeSize;
+        StreamSize -= TreeSize;
+    } else if (!Ctx->HufValid) {
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (!FourStreams) {
+        Status = HufDecodeStream(Ctx, Stream, StreamSize, Ctx->Literals, Regenerated);
+        if (EFI_ERROR(Status)) return Status;
+    } else {
+        if (StreamSize < 6) return EFI_VOLUME_CORRUPTED;
+        UINTN Sizes[4];
+        Sizes[0] = (UINTN)ReadLe(Stream, 2);
+        Sizes[1] = (UINTN)ReadLe(Stream + 2, 2);
+        Sizes[2] = (UINTN)ReadLe(Stream + 4, 2);
+        if (Sizes[0] + Sizes[1] + Sizes[2] > StreamSize - 6) return EFI_VOLUME_CORRUPTED;
+        Sizes[3] = StreamSize - 6 - Sizes[0] - Sizes[1] - Sizes[2];
+
+        UINTN Segment = (Regenerated + 3) / 4;
+        if (Segment * 3 > Regenerated) return EFI_VOLUME_CORRUPTED;
+        CONST UINT8 *Part = Stream + 6;
+        UINT8 *Out = Ctx->Literals;
+        for (UINTN i = 0; i < 4; i++) {
+            UINTN Count = (i < 3) ? Segment : Regenerated - 3 * Segment;
+            Status = HufDecodeStream(Ctx, Part, Sizes[i], Out, Count);
+            if (EFI_ERROR(Status)) return Status;
+            Part += Sizes[i];
+            Out += Count;
+        }
+    }
+
+    *Literals = Ctx->Literals;
+    *LiteralsSize = Regenerated;
+    *Used = HeaderSize + Compressed;
+    return EFI_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// Sequences
+// --------------------------------------------------------------------------
+
+STATIC EFI_STATUS ZstdSelectTable(
+    ZSTD_FSE_TABLE *Table,
+    CONST ZSTD_FSE_TABLE *Default,
+    UINT32 Mode,
+    UINT32 MaxSymbol,
+    UINT32 MaxLog,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINTN *Used
+) {
+    *Used = 0;
+    switch (Mode) {
+        case ZSTD_MODE_PREDEFINED:
+            CopyMem(Table, Default, sizeof(*Table));
+            return EFI_SUCCESS;
+        case ZSTD_MODE_RLE:
+            if (InSize < 1 || In[0] > MaxSymbol) return EFI_VOLUME_CORRUPTED;
+            FseBuildRle(Table, In[0]);
+            *Used = 1;
+            return EFI_SUCCESS;
+        case ZSTD_MODE_FSE:
+            return FseReadTable(Table, In, InSize, MaxSymbol, MaxLog, Used);
+        default:
+            return Table->Valid ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+    }
+}
+
+STATIC EFI_STATUS ZstdDecodeBlock(
+    ZSTD_CONTEXT *Ctx,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT8 *Out,
+    UINTN OutPos,
+    UINTN OutCap,
+    UINTN *Produced
+) {
+    EFI_STATUS Status;
+    CONST UINT8 *Literals;
+    UINTN LiteralsSize;
+    UINTN Used;
+
+    Status = ZstdDecodeLiterals(Ctx, In, InSize, &Used, &Literals, &LiteralsSize);
+    if (EFI_ERROR(Status)) return Status;
+    In += Used;
+    InSize -= Used;
+
+    // Number of sequences
+    if (InSize < 1) return EFI_VOLUME_CORRUPTED;
+    UINTN NumSequences = In[0];
+    if (NumSequences < 128) {
+        Used = 1;
+    } else if (NumSequences < 255) {
+        if (InSize < 2) return EFI_VOLUME_CORRUPTED;
+        NumSequences = ((NumSequences - 128) << 8) + In[1];
+        Used = 2;
+    } else {
+        if (InSize < 3) return EFI_VOLUME_CORRUPTED;
+        NumSequences = In[1] + ((UINTN)In[2] << 8) + 0x7F00;
+        Used = 3;
+    }
+    In += Used;
+    InSize -= Used;
+
+    UINT8 *Op = Out + OutPos;
+    UINT8 *OEnd = Out + OutCap;
+    CONST UINT8 *Lit = Literals;
+    CONST UINT8 *LitEnd = Literals + LiteralsSize;
+
+    if (NumSequences > 0) {
+        if (InSize < 1) return EFI_VOLUME_CORRUPTED;
+        UINT8 Modes = In[0];
+        if (Modes & 3) return EFI_VOLUME_CORRUPTED;
+        In++;
+        InSize--;
+
+        Status = ZstdSelectTable(&Ctx->LlTable, &Ctx->LlDefault, Modes >> 6, ZSTD_LL_MAX_SYMBOL, ZSTD_LL_MAX_LOG, In, InSize, &Used);
+        if (EFI_ERROR(Status)) return Status;
+        In += Used; InSize -= Used;
+        Status = ZstdSelectTable(&Ctx->OfTable, &Ctx->OfDefault, (Modes >> 4) & 3, ZSTD_OF_MAX_SYMBOL, ZSTD_OF_MAX_LOG, In, InSize, &Used);
+        if (EFI_ERROR(Status)) return Status;
+        In += Used; InSize -= Used;
+        Status = ZstdSelectTable(&Ctx->MlTable, &Ctx->MlDefault, (Modes >> 2) & 3, ZSTD_ML_MAX_SYMBOL, ZSTD_ML_MAX_LOG, In, InSize, &Used);
+        if (EFI_ERROR(Status)) return Status;
+        In += Used; InSize -= Used;
+
+        ZSTD_BITS Bits;
+        Status = BitsInit(&Bits, In, InSize);
+        if (EFI_ERROR(Status)) return Status;
+
+        CONST ZSTD_FSE_ENTRY *Ll = Ctx->LlTable.Entries;
+        CONST ZSTD_FSE_ENTRY *Of = Ctx->OfTable.Entries;
+        CONST ZSTD_FSE_ENTRY *Ml = Ctx->MlTable.Entries;
+        UINT32 LlState = (UINT32)BitsRead(&Bits, Ctx->LlTable.Log);
+        UINT32 OfState = (UINT32)BitsRead(&Bits, Ctx->OfTable.Log);
+        UINT32 MlState = (UINT32)BitsRead(&Bits, Ctx->MlTable.Log);
+
+        for (UINTN n = 0; n < NumSequences; n++) {
+            UINT32 OfCode = Of[OfState].Symbol;
+            UINT32 LlCode = Ll[LlState].Symbol;
+            UINT32 MlCode = Ml[MlState].Symbol;
+            if (OfCode > ZSTD_OF_MAX_SYMBOL || LlCode > ZSTD_LL_MAX_SYMBOL || MlCode > ZSTD_ML_MAX_SYMBOL) {
+                return EFI_VOLUME_CORRUPTED;
+            }
+
+            // Extra bits come in offset, match length, literal length order
+            UINT64 OffsetValue = (1ULL << OfCode) + BitsRead(&Bits, OfCode);
+            UINTN MatchLength = mMlBase[MlCode] + (UINTN)BitsRead(&Bits, mMlBits[MlCode]);
+            UINTN LiteralLength = mLlBase[LlCode] + (UINTN)BitsRead(&Bits, mLlBits[LlCode]);
+
+            UINT64 Offset;
+            if (OffsetValue > 3) {
+                Offset = OffsetValue - 3;
+                Ctx->Rep[2] = Ctx->Rep[1];
+                Ctx->Rep[1] = Ctx->Rep[0];
+                Ctx->Rep[0] = (UINT32)Offset;
+            } else {
+                UINT32 Index = (UINT32)OffsetValue - 1 + (LiteralLength == 0 ? 1 : 0);
+                if (Index == 0) {
+                    Offset = Ctx->Rep[0];
+                } else {
+                    Offset = (Index == 3) ? Ctx->Rep[0] - 1 : Ctx->Rep[Index];
+                    if (Index > 1) Ctx->Rep[2] = Ctx->Rep[1];
+                    Ctx->Rep[1] = Ctx->Rep[0];
+                    Ctx->Rep[0] = (UINT32)Offset;
+                }
+            }
+
+            if (LiteralLength > (UINTN)(LitEnd - Lit) ||
+                LiteralLength + MatchLength > (UINTN)(OEnd - Op)) {
+                return EFI_VOLUME_CORRUPTED;
+            }
+            CopyMem(Op, Lit, LiteralLength);
+            Op += LiteralLength;
+            Lit += LiteralLength;
+
+            if (Offset == 0 || Offset > (UINT64)(Op - Out)) return EFI_VOLUME_CORRUPTED;
+            DecompressCopyMatch(Op, (UINTN)Offset, MatchLength);
+            Op += MatchLength;
+
+            if (n + 1 < NumSequences) {
+                LlState = Ll[LlState].NewState + (UINT32)BitsRead(&Bits, Ll[LlState].NumBits);
+                MlState = Ml[MlState].NewState + (UINT32)BitsRead(&Bits, Ml[MlState].NumBits);
+                OfState = Of[OfState].NewState + (UINT32)BitsRead(&Bits, Of[OfState].NumBits);
+            }
+        }
+        if (Bits.Position != 0) return EFI_VOLUME_CORRUPTED;
+    }
+
+    // Trailing literals
+    UINTN Rest = LitEnd - Lit;
+    if (Rest > (UINTN)(OEnd - Op)) return EFI_VOLUME_CORRUPTED;
+    CopyMem(Op, Lit, Rest);
+    Op += Rest;
+
+    *Produced = Op - (Out + OutPos);
+    return EFI_SUCCESS;
+}
+
+// --------------------------------------------------------------------------
+// Frames
+// --------------------------------------------------------------------------
+
+EFI_STATUS ZstdInit(PXS_DECOMPRESSOR *Dec) {
+    ZSTD_CONTEXT *Ctx = AllocatePool(sizeof(ZSTD_CONTEXT));
+    if (!Ctx) return EFI_OUT_OF_RESOURCES;
+    SetMem(Ctx, sizeof(ZSTD_CONTEXT) - ZSTD_BLOCK_MAX, 0);
+
+    FseBuildTable(&Ctx->LlDefault, mLlDefaultNorm, ZSTD_LL_MAX_SYMBOL, 6);
+    FseBuildTable(&Ctx->MlDefault, mMlDefaultNorm, ZSTD_ML_MAX_SYMBOL, 6);
+    FseBuildTable(&Ctx->OfDefault, mOfDefaultNorm, ARRAY_SIZE(mOfDefaultNorm) - 1, 5);
+
+    Dec->Context = Ctx;
+    return EFI_SUCCESS;
+}
+
+VOID ZstdFree(PXS_DECOMPRESSOR *Dec) {
+    if (Dec->Context) {
+        FreePool(Dec->Context);
+        Dec->Context = NULL;
+    }
+}
+
+typedef struct {
+    UINTN   Size;
+    UINT8   Descriptor;
+    UINT64  ContentSize;       // PXS_DECOMPRESS_UNKNOWN_SIZE when not declared
+    UINT64  WindowSize;
+} ZSTD_FRAME_HEADER;
+
+STATIC EFI_STATUS ZstdReadFrameHeader(CONST UINT8 *In, UINTN InSize, ZSTD_FRAME_HEADER *Header, UINTN *Needed) {
+    STATIC CONST UINT8 DictIdSize[4] = { 0, 1, 2, 4 };
+
+    if (ReadLe(In, 4) != ZSTD_MAGIC) return EFI_VOLUME_CORRUPTED;
+    if (InSize < 5) {
+        *Needed = 5;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+
+    UINT8 Descriptor = In[4];
+    UINT32 FcsFlag = Descriptor >> 6;
+    BOOLEAN SingleSegment = (Descriptor & ZSTD_FHD_SINGLE_SEGMENT) != 0;
+    if (Descriptor & ZSTD_FHD_RESERVED) return EFI_VOLUME_CORRUPTED;
+
+    UINTN FcsSize = (FcsFlag == 0) ? (SingleSegment ? 1 : 0) : (1U << FcsFlag);
+    UINTN HeaderSize = 5 + (SingleSegment ? 0 : 1) + DictIdSize[Descriptor & 3] + FcsSize;
+    if (InSize < HeaderSize) {
+        *Needed = HeaderSize;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+
+    CONST UINT8 *P = In + 5;
+    UINT64 WindowSize = 0;
+    if (!SingleSegment) {
+        UINT32 Exponent = P[0] >> 3;
+        UINT32 Mantissa = P[0] & 7;
+        UINT64 Base = 1ULL << (ZSTD_WINDOW_LOG_MIN + Exponent);
+        WindowSize = Base + (Base / 8) * Mantissa;
+        P++;
+    }
+    if (ReadLe(P, DictIdSize[Descriptor & 3]) != 0) return EFI_UNSUPPORTED;
+    P += DictIdSize[Descriptor & 3];
+
+    Header->ContentSize = PXS_DECOMPRESS_UNKNOWN_SIZE;
+    if (FcsSize != 0) {
+        Header->ContentSize = ReadLe(P, FcsSize) + ((FcsSize == 2) ? 256 : 0);
+    }
+    if (SingleSegment) {
+        WindowSize = Header->ContentSize;
+    }
+    if (WindowSize > MAX_UINTN / 2) return EFI_UNSUPPORTED;
+
+    Header->Size = HeaderSize;
+    Header->Descriptor = Descriptor;
+    Header->WindowSize = WindowSize;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS ZstdFrameHeader(PXS_DECOMPRESSOR *Dec, CONST UINT8 *In, UINTN InSize, UINTN *InUsed, UINTN *Needed) {
+    ZSTD_CONTEXT *Ctx = Dec->Context;
+    ZSTD_FRAME_HEADER Header;
+
+    EFI_STATUS Status = ZstdReadFrameHeader(In, InSize, &Header, Needed);
+    if (EFI_ERROR(Status)) return Status;
+
+    Dec->FrameContentSize = Header.ContentSize;
+    Dec->WindowSize = (UINTN)Header.WindowSize;
+    Dec->MaxBlockSize = (Header.WindowSize < ZSTD_BLOCK_MAX) ? (UINTN)Header.WindowSize : ZSTD_BLOCK_MAX;
+    Dec->Flags = Header.Descriptor;
+    Dec->Phase = PXS_DECOMPRESS_PHASE_BLOCK;
+
+    Ctx->Rep[0] = 1;
+    Ctx->Rep[1] = 4;
+    Ctx->Rep[2] = 8;
+    Ctx->LastBlock = FALSE;
+    Ctx->HufValid = FALSE;
+    Ctx->LlTable.Valid = FALSE;
+    Ctx->OfTable.Valid = FALSE;
+    Ctx->MlTable.Valid = FALSE;
+
+    *InUsed = Header.Size;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS ZstdStep(
+    PXS_DECOMPRESSOR *Dec,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINTN *InUsed,
+    UINT8 *Out,
+    UINTN OutPos,
+    UINTN OutCap,
+    UINTN *OutUsed,
+    UINTN *Needed
+) {
+    ZSTD_CONTEXT *Ctx = Dec->Context;
+    EFI_STATUS Status;
+
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_FRAME) {
+        return ZstdFrameHeader(Dec, In, InSize, InUsed, Needed);
+    }
+
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_TRAILER) {
+        // xxHash64 content checksum, not verified
+        if (InSize < 4) {
+            *Needed = 4;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        *InUsed = 4;
+        Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+        return EFI_SUCCESS;
+    }
+
+    if (InSize < 3) {
+        *Needed = 3;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    UINT32 Header = (UINT32)ReadLe(In, 3);
+    BOOLEAN Last = Header & 1;
+    UINT32 Type = (Header >> 1) & 3;
+    UINTN BlockSize = Header >> 3;
+
+    UINTN UnitSize = 3 + ((Type == ZSTD_BLOCK_RLE) ? 1 : BlockSize);
+    if (InSize < UnitSize) {
+        *Needed = UnitSize;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    if (BlockSize > ZSTD_BLOCK_MAX || (Type == ZSTD_BLOCK_RAW && BlockSize > OutCap - OutPos)) {
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    switch (Type) {
+        case ZSTD_BLOCK_RAW:
+            CopyMem(Out + OutPos, In + 3, BlockSize);
+            *OutUsed = BlockSize;
+            break;
+        case ZSTD_BLOCK_RLE:
+            if (BlockSize > OutCap - OutPos) return EFI_VOLUME_CORRUPTED;
+            SetMem(Out + OutPos, BlockSize, In[3]);
+            *OutUsed = BlockSize;
+            break;
+        case ZSTD_BLOCK_COMPRESSED: {
+            UINTN Cap = (OutCap - OutPos > ZSTD_BLOCK_MAX) ? OutPos + ZSTD_BLOCK_MAX : OutCap;
+            Status = ZstdDecodeBlock(Ctx, In + 3, BlockSize, Out, OutPos, Cap, OutUsed);
+            if (EFI_ERROR(Status)) return Status;
+            break;
+        }
+        default:
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    *InUsed = UnitSize;
+    if (Last) {
+        Dec->Phase = (Dec->Flags & ZSTD_FHD_CHECKSUM) ? PXS_DECOMPRESS_PHASE_TRAILER : PXS_DECOMPRESS_PHASE_FRAME;
+    }
+    return EFI_SUCCESS;
+}
+
+// A frame is one unit; its blocks share entropy tables and history. Only
+// frames that declare their content size can be placed before decoding.
+EFI_STATUS ZstdNextUnit(
+    PXS_DECOMPRESSOR *Dec,
+    CONST UINT8 *In,
+    UINTN InSize,
+    UINT64 Remaining,
+    UINTN *Pos,
+    PXS_DECOMPRESS_UNIT *Unit,
+    UINTN *Needed
+) {
+    ZSTD_FRAME_HEADER Header;
+    UINTN Start = *Pos;
+
+    if (Dec->Phase == PXS_DECOMPRESS_PHASE_TRAILER) {
+        if (InSize - Start < 4) {
+            if (Remaining - Start < 4) return EFI_VOLUME_CORRUPTED;
+            *Needed = Start + 4;
+            return EFI_BUFFER_TOO_SMALL;
+        }
+        *Pos = Start + 4;
+        Dec->Phase = PXS_DECOMPRESS_PHASE_FRAME;
+        return EFI_NOT_FOUND;
+    }
+    if (Dec->Phase != PXS_DECOMPRESS_PHASE_FRAME) return EFI_UNSUPPORTED;
+
+    EFI_STATUS Status = ZstdReadFrameHeader(In + Start, InSize - Start, &Header, Needed);
+    if (Status == EFI_BUFFER_TOO_SMALL) *Needed += Start;
+    if (EFI_ERROR(Status)) return Status;
+    if (Header.ContentSize == PXS_DECOMPRESS_UNKNOWN_SIZE) return EFI_UNSUPPORTED;
+
+    Unit->Kind = PXS_DECOMPRESS_UNIT_FRAME;
+    Unit->Format = PXS_COMPRESSION_ZSTD;
+    Unit->InOffset = Start;
+    Unit->OutSize = Header.ContentSize;
+
+    UINTN P = Start + Header.Size;
+    for (;;) {
+        if (InSize - P < 3) goto Short;
+        UINT32 Block = (UINT32)ReadLe(In + P, 3);
+        UINT32 Type = (Block >> 1) & 3;
+        UINTN BlockSize = Block >> 3;
+        if (Type == 3 || BlockSize > ZSTD_BLOCK_MAX) return EFI_VOLUME_CORRUPTED;
+
+        UINTN UnitSize = 3 + ((Type == ZSTD_BLOCK_RLE) ? 1 : BlockSize);
+        if (InSize - P < UnitSize) goto Short;
+        P += UnitSize;
+        if (Block & 1) break;
+    }
+    if (Header.Descriptor & ZSTD_FHD_CHECKSUM) {
+        if (InSize - P < 4) goto Short;
+        P += 4;
+    }
+
+    Unit->InSize = P - Start;
+    *Pos = P;
+    return EFI_SUCCESS;
+
+Short:
+    // Worst case: every block raw, plus the checksum
+    return DecompressNeedFrame(Start, Header.ContentSize,
+                               Header.Size + (Header.ContentSize / ZSTD_BLOCK_MAX + 1) * 3 + 4,
+                               InSize, Remaining, Needed);
+}
@@ -0,0 +1,282 @@
+#!/bin/bash
+# Boot latency benchmark: boot a stub kernel (stub.cpp) under OVMF RUNS times,
+# headless, and report time to kernel entry as JSON on stdout.
+#
+#   bench/boot-latency.sh [-b] [-n RUNS] [-k SIZE] [-i SIZE] [-x] [-l LEVEL] [-K] [-o FILE]
+#
+#   -b          build the loader first (EDK2 'build' in $WORKSPACE, default ..)
+#   -t TARGET   DEBUG or RELEASE (default DEBUG, as compile.sh)
+#   -e FILE     loader image (default build/<TARGET>_GCC5/X64/Pxs.efi)
+#   -f FILE     OVMF firmware (default $OVMF, else the path run.sh uses)
+#   -n RUNS     boots to time (default 10)
+#   -k SIZE     kernel image size, with K/M/G suffix (default 1M)
+#   -i SIZE     initrd size, 0 for none (default 0)
+#   -x          boot with KASLR=0
+#   -l LEVEL    LOG= level: quiet, normal or verbose (default normal)
+#   -K          use KVM instead of TCG
+#   -m SIZE     guest memory (default 1G)
+#   -T SECONDS  per-boot timeout (default 60)
+#   -o FILE     write the JSON to FILE instead of stdout
+#   -w DIR      build the ESP and keep logs in DIR instead of a temporary one
+#
+# Time comes from two clocks. wall_ms is QEMU start to exit, as seen by this
+# script. The *_ms TSC metrics are converted at the loader's measured TSC rate
+# and count from guest reset: firmware_ms ends at loader entry, loader_ms is
+# loader entry to the jump, kernel_entry_ms is reset to the stub's first
+# instruction. stage_*_ms are the loader's PXS_BOOT_TIMING stages.
+
+set -eu -o pipefail
+
+REPO=$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)
+
+BUILD=0
+TARGET=DEBUG
+EFI=
+FIRMWARE=${OVMF:-/usr/share/edk2/x64/OVMF.4m.fd}
+RUNS=10
+KERNEL_SIZE=1M
+INITRD_SIZE=0
+KASLR=1
+LOG=normal
+ACCEL=tcg
+MEMORY=1G
+TIMEOUT=60
+OUTPUT=
+WORK=
+
+usage() {
+    sed -n '2,/^$/s/^# \{0,1\}//p' "${BASH_SOURCE[0]}" >&2
+    exit 2
+}
+
+die() {
+    echo "boot-latency: $*" >&2
+    exit 1
+}
+
+# 16M -> 16777216
+bytes() {
+    local Value=${1%[KkMmGg]}
+    case $1 in
+        *[Kk]) echo $((Value << 10)) ;;
+        *[Mm]) echo $((Value << 20)) ;;
+        *[Gg]) echo $((Value << 30)) ;;
+        *) echo "$Value" ;;
+    esac
+}
+
+while getopts "bt:e:f:n:k:i:xl:Km:T:o:w:h" Option; do
+    case $Option in
+        b) BUILD=1 ;;
+        t) TARGET=$OPTARG ;;
+        e) EFI=$OPTARG ;;
+        f) FIRMWARE=$OPTARG ;;
+        n) RUNS=$OPTARG ;;
+        k) KERNEL_SIZE=$OPTARG ;;
+        i) INITRD_SIZE=$OPTARG ;;
+        x) KASLR=0 ;;
+        l) LOG=$OPTARG ;;
+        K) ACCEL=kvm ;;
+        m) MEMORY=$OPTARG ;;
+        T) TIMEOUT=$OPTARG ;;
+        o) OUTPUT=$OPTARG ;;
+        w) WORK=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+
+KERNEL_BYTES=$(bytes "$KERNEL_SIZE")
+INITRD_BYTES=$(bytes "$INITRD_SIZE")
+EFI=${EFI:-$REPO/build/${TARGET}_GCC5/X64/Pxs.efi}
+[[ $RUNS =~ ^[1-9][0-9]*$ ]] || die "bad run count '$RUNS'"
+[[ $LOG =~ ^(quiet|normal|verbose)$ ]] || die "bad log level '$LOG'"
+
+for Tool in qemu-system-x86_64 g++ objcopy timeout; do
+    command -v "$Tool" >/dev/null || die "$Tool not found"
+done
+
+if [ "$BUILD" = 1 ]; then
+    (cd "${WORKSPACE:-$REPO/..}" && build -a X64 -t GCC5 -p PxsPkg/PxsPkg.dsc -b "$TARGET") >&2
+fi
+[ -f "$EFI" ] || die "no loader at $EFI (build it, or pass -b or -e)"
+[ -f "$FIRMWARE" ] || die "no OVMF at $FIRMWARE (set OVMF or pass -f)"
+
+if [ -z "$WORK" ]; then
+    WORK=$(mktemp -d)
+    trap 'rm -rf "$WORK"' EXIT
+fi
+ESP=$WORK/esp
+rm -rf "$ESP"
+mkdir -p "$ESP/EFI/BOOT"
+
+# --------------------------------------------------------------------------
+# IMAGES
+# --------------------------------------------------------------------------
+
+# Stub kernel, padded with random bytes to about KERNEL_BYTES
+head -c "$((KERNEL_BYTES > 8192 ? KERNEL_BYTES - 8192 : 0))" /dev/urandom > "$WORK/pad.bin"
+objcopy -I binary -O elf64-x86-64 -B i386:x86-64 \
+    --rename-section .data=.pad,alloc,load,readonly,data,contents "$WORK/pad.bin" "$WORK/pad.o"
+g++ -std=c++17 -O2 -ffreestanding -fno-exceptions -fno-rtti -fno-asynchronous-unwind-tables \
+    -fpie -mno-red-zone -mgeneral-regs-only -fno-stack-protector \
+    -nostdlib -static -no-pie -Wl,--build-id=none -Wl,-z,noexecstack \
+    -T "$REPO/bench/stub.ld" -o "$ESP/kernel.elf" "$REPO/bench/stub.cpp" "$WORK/pad.o"
+
+# newc archive holding one random file, so the loader also builds its index
+write_initrd() {
+    local Size=$1 Out=$2 Name=blob
+    local NameSize=$((${#Name} + 1))
+    {
+        printf '070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X' \
+            1 $((0100644)) 0 0 1 0 "$Size" 0 0 0 0 "$NameSize" 0
+        printf '%s\0' "$Name"
+        head -c $(((4 - (110 + NameSize) % 4) % 4)) /dev/zero
+        head -c "$Size" /dev/urandom
+        head -c $(((4 - Size % 4) % 4)) /dev/zero
+        printf '070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X' \
+            0 0 0 0 1 0 0 0 0 0 0 11 0
+        printf 'TRAILER!!!\0'
+        head -c 3 /dev/zero
+    } > "$Out"
+}
+
+cp "$EFI" "$ESP/EFI/BOOT/BOOTX64.EFI"
+{
+    echo "TIMEOUT=0"
+    echo "KERNEL=kernel.elf"
+    echo "KASLR=$KASLR"
+    echo "LOG=$LOG"
+    if [ "$INITRD_BYTES" -gt 0 ]; then
+        echo "INITRD=initrd.img"
+    fi
+} > "$ESP/pxs.cfg"
+if [ "$INITRD_BYTES" -gt 0 ]; then
+    write_initrd "$INITRD_BYTES" "$ESP/initrd.img"
+fi
+
+# --------------------------------------------------------------------------
+# BOOTS
+# --------------------------------------------------------------------------
+
+ACCEL_ARGS=(-accel tcg)
+if [ "$ACCEL" = kvm ]; then
+    ACCEL_ARGS=(-accel kvm -cpu host)
+fi
+
+# Value of Name= in a PXS-STUB line
+field() {
+    sed -n "s/.* $2=\([^ ]*\).*/\1/p" <<< "$1"
+}
+
+# One line per boot: wall_ns tsc_entry tsc_loader tsc_jump tsc_hz stages
+SAMPLES=$WORK/samples.tsv
+: > "$SAMPLES"
+FAILED=0
+for ((Run = 1; Run <= RUNS; Run++)); do
+    Log=$WORK/serial-$Run.log
+    Start=$(date +%s%N)
+    Status=0
+    timeout "$TIMEOUT" qemu-system-x86_64 \
+        -bios "$FIRMWARE" \
+        -m "$MEMORY" \
+        "${ACCEL_ARGS[@]}" \
+        -drive format=raw,file=fat:"$ESP" \
+        -net none \
+        -display none \
+        -monitor none \
+        -serial file:"$Log" \
+        -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+        -no-reboot </dev/null >/dev/null 2>&1 || Status=$?
+    End=$(date +%s%N)
+
+    # stub.cpp exits with 0x10, which QEMU reports as 33
+    Line=$(tr -d '\r' < "$Log" | grep -a '^PXS-STUB' | tail -n 1 || true)
+    if [ "$Status" != 33 ] || [ -z "$Line" ]; then
+        echo "boot-latency: run $Run failed (exit $Status), see $Log" >&2
+        FAILED=$((FAILED + 1))
+        continue
+    fi
+    printf '%s\t%s\t%s\t%s\t%s\t%s\n' "$((End - Start))" "$(field "$Line" tsc_entry)" \
+        "$(field "$Line" tsc_loader)" "$(field "$Line" tsc_jump)" "$(field "$Line" tsc_hz)" \
+        "$(field "$Line" stages)" >> "$SAMPLES"
+    echo "boot-latency: run $Run/$RUNS $(((End - Start) / 1000000)) ms" >&2
+done
+
+[ -s "$SAMPLES" ] || die "no successful boots"
+
+# --------------------------------------------------------------------------
+# REPORT
+# --------------------------------------------------------------------------
+
+# "metric value" pairs, one per sample and metric
+metric_values() {
+    awk -F'\t' '
+    BEGIN {
+        split("volume_open config initrd kernel graphics system_tables timeout memory_map exit_boot_services modules paging smp clocks", Names, " ")
+    }
+    {
+        printf "wall_ms %.3f\n", $1 / 1e6
+        if ($5 == 0) next
+        Ms = 1000 / $5
+        printf "kernel_entry_ms %.3f\n", $2 * Ms
+        printf "firmware_ms %.3f\n", $3 * Ms
+        printf "loader_ms %.3f\n", ($4 - $3) * Ms
+        n = split($6, Stages, ",")
+        for (i = 1; i <= n; i++) {
+            split(Stages[i], Pair, ":")
+            Name = (Pair[1] in Names) ? Names[Pair[1]] : Pair[1]
+            Total[Name] += Pair[2] * Ms
+        }
+        for (Name in Total) printf "stage_%s_ms %.3f\n", Name, Total[Name]
+        delete Total
+    }' "$SAMPLES"
+}
+
+# Nearest-rank percentiles over the sorted values of each metric
+metric_stats() {
+    awk '
+    function Flush(    i, Sum) {
+        if (Count == 0) return
+        for (i = 1; i <= Count; i++) Sum += V[i]
+        printf "%s    \"%s\": { \"n\": %d, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f }", \
+            Sep, Name, Count, V[1], V[Rank(50)], V[Rank(90)], V[Rank(99)], V[Count], Sum / Count
+        Sep = ",\n"
+        Count = 0
+    }
+    function Rank(P,    r) {
+        r = int((P * Count + 99) / 100)
+        return (r < 1) ? 1 : r
+    }
+    $1 != Name { Flush(); Name = $1 }
+    { V[++Count] = $2 }
+    END { Flush(); printf "\n" }'
+}
+
+report() {
+    local Loader Revision
+    Loader=$(sha256sum "$EFI" | cut -d' ' -f1)
+    Revision=$(git -C "$REPO" describe --always --dirty 2>/dev/null || echo unknown)
+    echo "{"
+    echo "  \"schema\": 1,"
+    echo "  \"revision\": \"$Revision\","
+    echo "  \"loader_sha256\": \"$Loader\","
+    echo "  \"target\": \"$TARGET\","
+    echo "  \"accel\": \"$ACCEL\","
+    echo "  \"memory\": \"$MEMORY\","
+    echo "  \"kernel_bytes\": $(stat -c %s "$ESP/kernel.elf"),"
+    echo "  \"initrd_bytes\": $([ -f "$ESP/initrd.img" ] && stat -c %s "$ESP/initrd.img" || echo 0),"
+    echo "  \"kaslr\": $([ "$KASLR" = 1 ] && echo true || echo false),"
+    echo "  \"log\": \"$LOG\","
+    echo "  \"runs\": $RUNS,"
+    echo "  \"failed\": $FAILED,"
+    echo "  \"metrics\": {"
+    metric_values | LC_ALL=C sort -k1,1 -k2,2g | metric_stats
+    echo "  }"
+    echo "}"
+}
+
+if [ -n "$OUTPUT" ]; then
+    report > "$OUTPUT"
+else
+    report
+fi
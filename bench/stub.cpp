@@ -0,0 +1,81 @@
+// Boot latency stub kernel. On entry it reads the TSC, writes one line of
+// timestamps to COM1 and stops QEMU through isa-debug-exit:
+//
+//   PXS-STUB tsc_entry=<n> tsc_loader=<n> tsc_jump=<n> tsc_hz=<n> stages=<id>:<tsc>,...
+//
+// tsc_loader and tsc_jump are the loader's own stamps (PXS_BOOT_TIMING) and
+// stages the TSC spent in each of its timed stages. Built by boot-latency.sh
+// as position-independent code with no relocations, so it runs wherever KASLR
+// places it.
+
+#include "../protocol.h"
+
+#define COM1             0x3F8
+#define COM1_LSR         (COM1 + 5)
+#define LSR_THR_EMPTY    0x20
+#define DEBUG_EXIT_PORT  0xF4
+#define DEBUG_EXIT_CODE  0x10   // QEMU exits with (0x10 << 1) | 1 = 33
+
+static inline void OutByte(uint16_t Port, uint8_t Value) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(Value), "Nd"(Port));
+}
+
+static inline uint8_t InByte(uint16_t Port) {
+    uint8_t Value;
+    __asm__ __volatile__("inb %1, %0" : "=a"(Value) : "Nd"(Port));
+    return Value;
+}
+
+static void PutChar(char Char) {
+    for (int Spin = 0; Spin < 100000 && !(InByte(COM1_LSR) & LSR_THR_EMPTY); Spin++) {
+    }
+    OutByte(COM1, (uint8_t)Char);
+}
+
+static void PutString(const char *String) {
+    while (*String) PutChar(*String++);
+}
+
+static void PutDecimal(uint64_t Value) {
+    char Digits[21];
+    int Length = 0;
+    do {
+        Digits[Length++] = (char)('0' + Value % 10);
+        Value /= 10;
+    } while (Value != 0);
+    while (Length > 0) PutChar(Digits[--Length]);
+}
+
+static void PutField(const char *Name, uint64_t Value) {
+    PutChar(' ');
+    PutString(Name);
+    PutChar('=');
+    PutDecimal(Value);
+}
+
+extern "C" __attribute__((sysv_abi, noreturn, section(".text.entry")))
+void _start(PXS_BOOT_INFO *BootInfo) {
+    uint64_t EntryTsc = __builtin_ia32_rdtsc();
+    const PXS_BOOT_TIMING *Timing =
+        (BootInfo && BootInfo->Magic == PXS_MAGIC && BootInfo->Version >= 2) ? BootInfo->Timing : nullptr;
+
+    PutString("PXS-STUB");
+    PutField("tsc_entry", EntryTsc);
+    PutField("tsc_loader", Timing ? Timing->TscLoaderEntry : 0);
+    PutField("tsc_jump", Timing ? Timing->TscKernelEntry : 0);
+    PutField("tsc_hz", Timing ? Timing->TscFrequency : 0);
+    PutString(" stages=");
+    for (uint32_t i = 0; Timing && i < Timing->EntryCount && i < PXS_TIMING_MAX_ENTRIES; i++) {
+        const PXS_TIMING_ENTRY *Entry = &Timing->Entries[i];
+        if (i > 0) PutChar(',');
+        PutDecimal(Entry->Stage);
+        PutChar(':');
+        PutDecimal(Entry->TscEnd - Entry->TscStart);
+    }
+    PutString("\r\n");
+
+    OutByte(DEBUG_EXIT_PORT, DEBUG_EXIT_CODE);
+    for (;;) {
+        __asm__ __volatile__("cli; hlt");
+    }
+}
@@ -0,0 +1,1048 @@
+// Loader micro-benchmarks on the host: config parsing, ELF loading, image
+// loading from files and partitions, LZ4 decoding on one and several CPUs,
+// relocation, memory map normalization, firmware table and SRAT indexing, KASLR
+// placement, entropy mixing and log recording over synthetic inputs.
+//
+//   make -C host bench                  run every case
+//   host/build/bench elf                run the cases whose name contains "elf"
+//
+// Each case runs for about PXS_BENCH_MS milliseconds (default 200), split into
+// five timed rounds; the fastest round is reported. Where a case has a result
+// to get wrong (the parsed config, the loaded image, the KASLR slot) it is
+// checked once before timing, and the bench exits on a mismatch.
+
+// The config, stream and segment types are private to Pxs.c, so the
+// benchmarks are compiled into the same translation unit as the loader
+#include "arch/x64/efi/Pxs.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+#define BENCH_ROUNDS      5
+#define BENCH_DEFAULT_MS  200
+#define BENCH_ELF_BASE    0x10000000ULL   // Linked address of the synthetic kernels
+
+typedef VOID (*BENCH_FUNCTION)(IN VOID *Context);
+
+STATIC UINT64 mBenchNanoseconds = BENCH_DEFAULT_MS * 1000000ULL;
+STATIC CONST CHAR8 *mBenchFilter = NULL;
+STATIC volatile UINT64 mSink;
+
+// --------------------------------------------------------------------------
+// HARNESS
+// --------------------------------------------------------------------------
+
+STATIC UINT64 BenchTime(IN BENCH_FUNCTION Function, IN VOID *Context, IN UINT64 Iterations) {
+    UINT64 Start = HostNanoseconds();
+    for (UINT64 i = 0; i < Iterations; i++) {
+        Function(Context);
+    }
+    return HostNanoseconds() - Start;
+}
+
+// Bytes is the input consumed per call, 0 when throughput means nothing
+STATIC VOID BenchRun(IN CONST CHAR8 *Name, IN BENCH_FUNCTION Function, IN VOID *Context, IN UINT64 Bytes) {
+    UINT64 Iterations = 1;
+    UINT64 Elapsed;
+
+    if (mBenchFilter && !strstr(Name, mBenchFilter)) return;
+
+    Function(Context);  // Warm caches and the allocator
+    for (;;) {
+        Elapsed = BenchTime(Function, Context, Iterations);
+        if (Elapsed >= mBenchNanoseconds / 8 || Iterations >= (1ULL << 40)) break;
+        Iterations *= 2;
+    }
+    Iterations = MAX(1, Iterations * (mBenchNanoseconds / BENCH_ROUNDS) / MAX(Elapsed, 1));
+
+    UINT64 Best = MAX_UINT64;
+    for (UINTN Round = 0; Round < BENCH_ROUNDS; Round++) {
+        Best = MIN(Best, BenchTime(Function, Context, Iterations));
+    }
+
+    double NsPerOp = (double)Best / (double)Iterations;
+    printf("%-32s %12.1f ns/op", Name, NsPerOp);
+    if (Bytes != 0) {
+        printf(" %10.1f MB/s", (double)Bytes * 1e3 / NsPerOp);
+    }
+    printf(" %12llu iters\n", (unsigned long long)Iterations);
+    fflush(stdout);
+}
+
+STATIC VOID *BenchAlloc(IN UINTN Size) {
+    VOID *Buffer = calloc(1, Size);
+    if (!Buffer) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(1);
+    }
+    return Buffer;
+}
+
+// --------------------------------------------------------------------------
+// CONFIG
+// --------------------------------------------------------------------------
+
+typedef struct {
+    CHAR8 *Text;
+    UINTN Size;
+} CONFIG_CASE;
+
+STATIC PXS_CONFIG mConfig;
+
+// Global keys, then Entries [entry] sections of Keys lines each. The default
+// is the last entry, so applying it walks the whole file.
+STATIC VOID BuildConfig(IN UINTN Entries, IN UINTN Keys, OUT CONFIG_CASE *Case) {
+    UINTN Capacity = 1024 + Entries * (Keys + 2) * 128;
+    CHAR8 *Text = BenchAlloc(Capacity);
+    UINTN Size = 0;
+
+#define APPEND(...) Size += (UINTN)snprintf(Text + Size, Capacity - Size, __VA_ARGS__)
+
+    APPEND("# synthetic config\nTIMEOUT=0\nKASLR=1\nPAGING=1\nKVBASE=0xffffffff80000000\n");
+    APPEND("CMDLINE=console=ttyS0,115200 loglevel=7 root=/dev/ram0\n");
+    APPEND("DEFAULT=entry-%zu\n\n", Entries - 1);
+    for (UINTN i = 0; i < Entries; i++) {
+        APPEND("[entry]\nTITLE=entry-%zu\nKERNEL=boot\\kernel-%zu.elf\nINITRD=boot\\initrd-%zu.img\n", i, i, i);
+        for (UINTN k = 3; k < Keys; k++) {
+            if (k % 4 == 0) APPEND("MODULE=boot\\module-%zu-%zu.bin,mod%zu,align=2M\n", i, k, k);
+            else if (k % 4 == 1) APPEND("# option %zu of entry %zu\n", k, i);
+            else APPEND("CMDLINE=console=ttyS0,115200 quiet init=/sbin/init-%zu-%zu\n", i, k);
+        }
+        APPEND("\n");
+    }
+
+#undef APPEND
+
+    Case->Text = Text;
+    Case->Size = Size;
+}
+
+// Parse, then apply the default entry, which also wipes and frees the text
+STATIC VOID BenchConfig(IN VOID *Context) {
+    CONFIG_CASE *Case = Context;
+    CHAR8 *Text = AllocatePool(Case->Size);
+
+    CopyMem(Text, Case->Text, Case->Size);
+    ConfigDefaults(&mConfig);
+    ParseConfig(Text, Case->Size, &mConfig);
+    ApplyConfigEntry(&mConfig, mConfig.DefaultEntry);
+    mSink += mConfig.ModuleCount;
+}
+
+// Path as the config parser widens it from ASCII
+STATIC BOOLEAN BenchPathIs(IN CONST CHAR16 *Path, IN CONST CHAR8 *Expected) {
+    UINTN i = 0;
+    for (; Expected[i] != '\0'; i++) {
+        if (Path[i] != (CHAR16)Expected[i]) return FALSE;
+    }
+    return Path[i] == L'\0';
+}
+
+// Parse once and compare the default entry with what BuildConfig wrote
+STATIC VOID CheckConfig(IN CONST CHAR8 *Name, IN CONFIG_CASE *Case, IN UINTN Entries, IN UINTN Keys) {
+    CHAR8 Expected[256];
+    CHAR8 Module[PXS_MODULE_NAME_SIZE];
+    UINTN Modules = 0;
+    UINTN Entry = Entries - 1;
+    BOOLEAN Same;
+
+    BenchConfig(Case);
+    snprintf(Expected, sizeof(Expected), "boot\\kernel-%zu.elf", Entry);
+    Same = BenchPathIs(mConfig.KernelPath, Expected);
+    snprintf(Expected, sizeof(Expected), "console=ttyS0,115200 quiet init=/sbin/init-%zu-%zu", Entry, Keys - 1);
+    Same = Same && (Keys < 4 || strcmp(mConfig.CmdLine, Expected) == 0);
+    for (UINTN k = 4; k < Keys && Modules < PXS_MAX_MODULES; k += 4, Modules++) {
+        snprintf(Expected, sizeof(Expected), "boot\\module-%zu-%zu.bin", Entry, k);
+        snprintf(Module, sizeof(Module), "mod%zu", k);
+        Same = Same && BenchPathIs(mConfig.Modules[Modules].Path, Expected) &&
+               strcmp(mConfig.Modules[Modules].Name, Module) == 0 && mConfig.Modules[Modules].Alignment == SIZE_2MB;
+    }
+    if (!Same || mConfig.ModuleCount != Modules) {
+        fprintf(stderr, "bench: %s parsed wrong\n", Name);
+        exit(1);
+    }
+}
+
+STATIC VOID RunConfigBenchmarks(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Name;
+        UINTN Entries;
+        UINTN Keys;
+    } Cases[] = {
+        { "config/1x4",     1,  4 },
+        { "config/4x16",    4,  16 },
+        { "config/16x64",   16, 64 },
+        { "config/16x512",  16, 512 },
+    };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        CONFIG_CASE Case;
+        BuildConfig(Cases[i].Entries, Cases[i].Keys, &Case);
+        CheckConfig(Cases[i].Name, &Case, Cases[i].Entries, Cases[i].Keys);
+        BenchRun(Cases[i].Name, BenchConfig, &Case, Case.Size);
+        free(Case.Text);
+    }
+}
+
+// --------------------------------------------------------------------------
+// ELF
+// --------------------------------------------------------------------------
+
+typedef struct {
+    UINT8   *Image;
+    UINT64  Size;
+    UINT64  TotalPages;   // Pages LoadElfKernel allocates
+    BOOLEAN Digest;
+} ELF_CASE;
+
+STATIC UINT8 mDigest[PXS_SHA256_DIGEST_SIZE];
+
+// Segments PT_LOAD headers of SegmentSize file bytes, each followed in memory
+// by a quarter of that in BSS, linked at BENCH_ELF_BASE
+STATIC VOID BuildElf(IN UINTN Segments, IN UINT64 SegmentSize, OUT ELF_CASE *Case) {
+    UINT64 HeaderSize = ALIGN_VALUE(sizeof(Elf64_Ehdr) + Segments * sizeof(Elf64_Phdr), EFI_PAGE_SIZE);
+    UINT64 MemorySize = ALIGN_VALUE(SegmentSize + SegmentSize / 4, EFI_PAGE_SIZE);
+    UINT64 Size = HeaderSize + Segments * SegmentSize;
+    UINT8 *Image = BenchAlloc(Size);
+
+    Elf64_Ehdr *Ehdr = (Elf64_Ehdr *)Image;
+    Ehdr->e_ident[EI_MAG0] = ELFMAG0;
+    Ehdr->e_ident[EI_MAG1] = ELFMAG1;
+    Ehdr->e_ident[EI_MAG2] = ELFMAG2;
+    Ehdr->e_ident[EI_MAG3] = ELFMAG3;
+    Ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+    Ehdr->e_type = ET_EXEC;
+    Ehdr->e_machine = EM_X86_64;
+    Ehdr->e_entry = BENCH_ELF_BASE;
+    Ehdr->e_phoff = sizeof(Elf64_Ehdr);
+    Ehdr->e_phentsize = sizeof(Elf64_Phdr);
+    Ehdr->e_phnum = (Elf64_Half)Segments;
+
+    Elf64_Phdr *Phdr = (Elf64_Phdr *)(Image + Ehdr->e_phoff);
+    for (UINTN i = 0; i < Segments; i++) {
+        Phdr[i].p_type = PT_LOAD;
+        Phdr[i].p_flags = (i == 0) ? (PF_R | PF_X) : (PF_R | PF_W);
+        Phdr[i].p_offset = HeaderSize + i * SegmentSize;
+        Phdr[i].p_vaddr = BENCH_ELF_BASE + i * MemorySize;
+        Phdr[i].p_paddr = Phdr[i].p_vaddr;
+        Phdr[i].p_filesz = SegmentSize;
+        Phdr[i].p_memsz = SegmentSize + SegmentSize / 4;
+        Phdr[i].p_align = EFI_PAGE_SIZE;
+    }
+    for (UINT64 Offset = HeaderSize; Offset < Size; Offset++) {
+        Image[Offset] = (UINT8)(Offset * 131);
+    }
+
+    Case->Image = Image;
+    Case->Size = Size;
+    Case->TotalPages = EFI_SIZE_TO_PAGES(Segments * MemorySize);
+}
+
+STATIC VOID BenchElf(IN VOID *Context) {
+    ELF_CASE *Case = Context;
+    EFI_PHYSICAL_ADDRESS Entry;
+    UINT64 Base, Size, Slide;
+    PXS_KERNEL_SEGMENT *Segments;
+    UINTN SegmentCount;
+
+    EFI_STATUS Status = LoadElfKernel(HostRootDir(), &mConfig, &Entry, &Base, &Size, &Slide,
+                                      &Segments, &SegmentCount, Case->Digest ? mDigest : NULL);
+    if (EFI_ERROR(Status)) {
+        fprintf(stderr, "bench: LoadElfKernel failed (0x%llx)\n", (unsigned long long)Status);
+        exit(1);
+    }
+    gBS->FreePages(Base, Case->TotalPages);
+    FreePool(Segments);
+    mSink += Entry;
+}
+
+// Load once and compare every segment with the file, its BSS with zeros
+STATIC VOID CheckElf(IN CONST CHAR8 *Name, IN ELF_CASE *Case) {
+    CONST Elf64_Ehdr *Ehdr = (CONST Elf64_Ehdr *)Case->Image;
+    CONST Elf64_Phdr *Phdr = (CONST Elf64_Phdr *)(Case->Image + Ehdr->e_phoff);
+    EFI_PHYSICAL_ADDRESS Entry;
+    UINT64 Base, Size, Slide;
+    PXS_KERNEL_SEGMENT *Segments;
+    UINTN SegmentCount;
+
+    EFI_STATUS Status = LoadElfKernel(HostRootDir(), &mConfig, &Entry, &Base, &Size, &Slide,
+                                      &Segments, &SegmentCount, NULL);
+    BOOLEAN Same = !EFI_ERROR(Status) && Base == BENCH_ELF_BASE && Slide == 0 && Entry == Ehdr->e_entry &&
+                   SegmentCount == Ehdr->e_phnum;
+    for (UINTN i = 0; Same && i < SegmentCount; i++) {
+        CONST UINT8 *Loaded = (CONST UINT8 *)(UINTN)Segments[i].PhysicalAddress;
+        Same = Segments[i].VirtualAddress == Phdr[i].p_vaddr && Segments[i].PhysicalAddress == Phdr[i].p_paddr &&
+               Segments[i].MemorySize >= Phdr[i].p_memsz && Segments[i].Flags == Phdr[i].p_flags &&
+               memcmp(Loaded, Case->Image + Phdr[i].p_offset, Phdr[i].p_filesz) == 0;
+        for (UINT64 Offset = Phdr[i].p_filesz; Same && Offset < Phdr[i].p_memsz; Offset++) {
+            Same = Loaded[Offset] == 0;
+        }
+    }
+    if (!EFI_ERROR(Status)) {
+        gBS->FreePages(Base, Case->TotalPages);
+        FreePool(Segments);
+    }
+    if (!Same) {
+        fprintf(stderr, "bench: %s loaded wrong (0x%llx)\n", Name, (unsigned long long)Status);
+        exit(1);
+    }
+}
+
+STATIC VOID RunElfBenchmarks(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Name;
+        UINTN Segments;
+        UINT64 SegmentSize;
+        BOOLEAN Digest;
+    } Cases[] = {
+        { "elf/2x64K",          2,  SIZE_64KB, FALSE },
+        { "elf/4x1M",           4,  SIZE_1MB,  FALSE },
+        { "elf/64x64K",         64, SIZE_64KB, FALSE },
+        { "elf/4x8M",           4,  SIZE_8MB,  FALSE },
+        { "elf/4x8M+sha256",    4,  SIZE_8MB,  TRUE },
+    };
+
+    // Fixed placement, so every run loads at the linked address
+    ConfigDefaults(&mConfig);
+    mConfig.KaslrEnabled = FALSE;
+    StrCpyS(mConfig.KernelPath, 256, L"bench.elf");
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        ELF_CASE Case;
+        BuildElf(Cases[i].Segments, Cases[i].SegmentSize, &Case);
+        Case.Digest = Cases[i].Digest;
+        HostAddFile(L"bench.elf", Case.Image, Case.Size);
+        CheckElf(Cases[i].Name, &Case);
+        BenchRun(Cases[i].Name, BenchElf, &Case, Case.Size);
+        HostAddFile(L"bench.elf", NULL, 0);
+        free(Case.Image);
+    }
+}
+
+// --------------------------------------------------------------------------
+// IMAGE SOURCES
+// --------------------------------------------------------------------------
+
+#define BENCH_PARTITION_GUID    { 0x5d2f4e71, 0x8a3c, 0x4b19, { 0x9e, 0x60, 0x2b, 0x7d, 0x41, 0xc8, 0x0f, 0x93 } }
+#define BENCH_PARTITION         L"part:5d2f4e71-8a3c-4b19-9e60-2b7d41c80f93"
+#define BENCH_EXTENT_AT         SIZE_1MB
+
+typedef struct {
+    CONST CHAR16 *Path;
+    CONST UINT8  *Image;
+    UINT64       Size;
+} LOAD_CASE;
+
+STATIC VOID BenchLoad(IN VOID *Context) {
+    LOAD_CASE *Case = Context;
+    VOID *Buffer;
+    UINT64 Size;
+
+    EFI_STATUS Status = LoadImageFile(HostRootDir(), (CHAR16 *)Case->Path, EFI_PAGE_SIZE, EfiLoaderData, &Buffer, &Size, NULL);
+    if (EFI_ERROR(Status) || Size != Case->Size) {
+        fprintf(stderr, "bench: LoadImageFile failed (0x%llx)\n", (unsigned long long)Status);
+        exit(1);
+    }
+    gBS->FreePages((EFI_PHYSICAL_ADDRESS)Buffer, EFI_SIZE_TO_PAGES(Size));
+    mSink += Size;
+}
+
+// Load once and compare, so a fast wrong answer is not reported
+STATIC VOID CheckLoad(IN CONST CHAR8 *Name, IN LOAD_CASE *Case) {
+    VOID *Buffer;
+    UINT64 Size;
+
+    EFI_STATUS Status = LoadImageFile(HostRootDir(), (CHAR16 *)Case->Path, EFI_PAGE_SIZE, EfiLoaderData, &Buffer, &Size, NULL);
+    if (EFI_ERROR(Status) || Size != Case->Size || memcmp(Buffer, Case->Image, Size) != 0) {
+        fprintf(stderr, "bench: %s loaded wrong (0x%llx)\n", Name, (unsigned long long)Status);
+        exit(1);
+    }
+    gBS->FreePages((EFI_PHYSICAL_ADDRESS)Buffer, EFI_SIZE_TO_PAGES(Size));
+}
+
+// A 32M image as a file, as a whole raw partition, and as an extent at 1M into
+// one: block-aligned, and not, which sends every byte through the bounce buffer
+STATIC VOID RunLoadBenchmarks(VOID) {
+    STATIC CONST EFI_GUID Guid = BENCH_PARTITION_GUID;
+    STATIC CONST struct {
+        CONST CHAR8  *Name;
+        CONST CHAR16 *Path;
+        UINT64       DataOffset;    // From the extent header, 0 without one
+    } Cases[] = {
+        { "load/file-32M",             L"bench.img",           0 },
+        { "load/part-32M",             BENCH_PARTITION,        0 },
+        { "load/extent-32M",           BENCH_PARTITION L":1M", EFI_PAGE_SIZE },
+        { "load/extent-32M-unaligned", BENCH_PARTITION L":1M", sizeof(PXS_EXTENT_HEADER) },
+    };
+    UINT64 Size = SIZE_32MB;
+    UINT8 *Disk = BenchAlloc(BENCH_EXTENT_AT + EFI_PAGE_SIZE + Size);
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        LOAD_CASE Case = { Cases[i].Path, Disk, Size };
+        UINT64 DiskSize = Size;
+
+        if (Cases[i].DataOffset != 0) {
+            PXS_EXTENT_HEADER Header = { .Version = PXS_EXTENT_VERSION, .HeaderSize = sizeof(PXS_EXTENT_HEADER),
+                                         .DataOffset = Cases[i].DataOffset, .DataSize = Size };
+            CopyMem(Header.Magic, PXS_EXTENT_MAGIC, sizeof(Header.Magic));
+            CopyMem(Disk + BENCH_EXTENT_AT, &Header, sizeof(Header));
+            Case.Image = Disk + BENCH_EXTENT_AT + Cases[i].DataOffset;
+            DiskSize = ALIGN_VALUE(BENCH_EXTENT_AT + Cases[i].DataOffset + Size, 512);
+        }
+        for (UINT64 Offset = 0; Offset < Size; Offset++) {
+            ((UINT8 *)Case.Image)[Offset] = (UINT8)(Offset * 131);
+        }
+
+        HostAddFile(L"bench.img", Disk, Size);
+        HostAddPartition(&Guid, Disk, DiskSize, 512);
+        CheckLoad(Cases[i].Name, &Case);
+        BenchRun(Cases[i].Name, BenchLoad, &Case, Size);
+    }
+    HostAddFile(L"bench.img", NULL, 0);
+    HostAddPartition(&Guid, NULL, 0, 512);
+    free(Disk);
+}
+
+// --------------------------------------------------------------------------
+// DECOMPRESSION
+// --------------------------------------------------------------------------
+
+#define BENCH_LZ4_LEGACY_MAGIC  0x184C2102
+#define BENCH_LZ4_LEGACY_BLOCK  SIZE_8MB
+
+// LZ4 length continuation: 255s, then the remainder
+STATIC UINT8 *BenchLz4Length(IN UINT8 *P, IN UINT64 Length) {
+    for (; Length >= 255; Length -= 255) *P++ = 255;
+    *P++ = (UINT8)Length;
+    return P;
+}
+
+// A legacy LZ4 image of Size bytes whose 8 MB blocks each repeat their own
+// 64-byte pattern: 64 literals, one long match at distance 64, and the 12
+// literals the format requires at the end of a block. Every block decodes on
+// its own, so the loader splits the image across CPUs.
+STATIC VOID BuildLz4Legacy(IN UINT64 Size, OUT LOAD_CASE *Case, OUT UINT8 **Packed, OUT UINT64 *PackedSize) {
+    UINT8 *Plain = BenchAlloc(Size);
+    UINT8 *Out = BenchAlloc(4 + Size / 64 + 64 * (Size / BENCH_LZ4_LEGACY_BLOCK + 1));
+    UINT8 *P = Out + 4;
+    UINT32 Magic = BENCH_LZ4_LEGACY_MAGIC;
+
+    CopyMem(Out, &Magic, sizeof(Magic));
+    for (UINT64 Start = 0; Start < Size; Start += BENCH_LZ4_LEGACY_BLOCK) {
+        UINT64 Length = MIN(BENCH_LZ4_LEGACY_BLOCK, Size - Start);
+        UINT8 *Block = P + 4;
+        UINT8 *Q = Block;
+
+        for (UINT64 i = 0; i < Length; i++) {
+            Plain[Start + i] = (UINT8)((Start / 64 + i % 64) * 131);
+        }
+        *Q++ = 0xFF;
+        Q = BenchLz4Length(Q, 64 - 15);
+        CopyMem(Q, Plain + Start, 64);
+        Q += 64;
+        *Q++ = 64;
+        *Q++ = 0;
+        Q = BenchLz4Length(Q, Length - 64 - 12 - 4 - 15);
+        *Q++ = 12 << 4;
+        CopyMem(Q, Plain + Start + Length - 12, 12);
+        Q += 12;
+
+        UINT32 BlockSize = (UINT32)(Q - Block);
+        CopyMem(P, &BlockSize, sizeof(BlockSize));
+        P = Q;
+    }
+
+    Case->Path = L"bench.lz4";
+    Case->Image = Plain;
+    Case->Size = Size;
+    *Packed = Out;
+    *PackedSize = (UINT64)(P - Out);
+}
+
+// Units the stream decoded across CPUs, so a case that silently went serial
+// is not reported as a parallel one
+STATIC VOID CheckDecodeSplit(IN CONST CHAR8 *Name, IN LOAD_CASE *Case, IN UINTN Units) {
+    PXS_STREAM Stream;
+    VOID *Buffer;
+    UINT64 Size;
+
+    EFI_STATUS Status = StreamOpen(HostRootDir(), (CHAR16 *)Case->Path, &Stream);
+    if (!EFI_ERROR(Status)) {
+        Status = StreamLoadPages(&Stream, EFI_PAGE_SIZE, EfiLoaderData, &Buffer, &Size);
+        if (!EFI_ERROR(Status)) gBS->FreePages((EFI_PHYSICAL_ADDRESS)Buffer, EFI_SIZE_TO_PAGES(Size));
+        if (Stream.Parallel != Units) Status = EFI_UNSUPPORTED;
+        StreamClose(&Stream);
+    }
+    if (EFI_ERROR(Status)) {
+        fprintf(stderr, "bench: %s did not decode %zu units in parallel (0x%llx)\n", Name, (size_t)Units,
+                (unsigned long long)Status);
+        exit(1);
+    }
+}
+
+// The same 32M image decoded by the BSP alone and by four CPUs, whose APs
+// are threads on the host
+STATIC VOID RunDecodeBenchmarks(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Name;
+        UINTN Cpus;
+    } Cases[] = {
+        { "decode/lz4-legacy-32M",      1 },
+        { "decode/lz4-legacy-32M-mp4",  4 },
+    };
+    LOAD_CASE Case;
+    UINT8 *Packed;
+    UINT64 PackedSize;
+
+    BuildLz4Legacy(SIZE_32MB, &Case, &Packed, &PackedSize);
+    HostAddFile(Case.Path, Packed, PackedSize);
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        HostSetProcessors(Cases[i].Cpus);
+        WorkPoolInit(&gWorkPool);
+        if (gWorkPool.Enabled != Cases[i].Cpus) {
+            fprintf(stderr, "bench: %s has %zu CPUs\n", Cases[i].Name, (size_t)gWorkPool.Enabled);
+            exit(1);
+        }
+        CheckLoad(Cases[i].Name, &Case);
+        CheckDecodeSplit(Cases[i].Name, &Case, Cases[i].Cpus > 1 ? Case.Size / BENCH_LZ4_LEGACY_BLOCK : 0);
+        BenchRun(Cases[i].Name, BenchLoad, &Case, Case.Size);
+    }
+    HostSetProcessors(1);
+    WorkPoolInit(&gWorkPool);
+    HostAddFile(Case.Path, NULL, 0);
+    free((VOID *)Case.Image);
+    free(Packed);
+}
+
+// --------------------------------------------------------------------------
+// RELOCATION
+// --------------------------------------------------------------------------
+
+typedef struct {
+    UINT8  *Image;
+    UINT64 Size;
+    UINT64 TableSize;
+} RELOC_CASE;
+
+#define BENCH_RELOC_TABLE EFI_PAGE_SIZE   // Dynamic section first, then the table
+
+// An image linked at 0 with Words pointers, one every Stride words after the
+// table, described by a DT_RELA or a DT_RELR table
+STATIC VOID BuildReloc(IN UINTN Words, IN UINTN Stride, IN BOOLEAN Relr, OUT RELOC_CASE *Case) {
+    UINT64 RelaSize = Words * sizeof(Elf64_Rela);
+    UINT64 Data = ALIGN_VALUE(BENCH_RELOC_TABLE + RelaSize, EFI_PAGE_SIZE);
+    UINT64 Size = Data + Words * Stride * sizeof(UINT64);
+    UINT8 *Image = BenchAlloc(Size);
+    UINT64 TableSize = 0;
+
+    if (!Relr) {
+        Elf64_Rela *Rela = (Elf64_Rela *)(Image + BENCH_RELOC_TABLE);
+        for (UINTN i = 0; i < Words; i++) {
+            Rela[i].r_offset = Data + i * Stride * sizeof(UINT64);
+            Rela[i].r_info = R_X86_64_RELATIVE;
+            Rela[i].r_addend = (INT64)(i * 64);
+        }
+        TableSize = RelaSize;
+    } else {
+        // The encoding lld and ld.bfd emit for -z pack-relative-relocs
+        UINT64 *Relr = (UINT64 *)(Image + BENCH_RELOC_TABLE);
+        UINTN Count = 0;
+        UINTN i = 0;
+        while (i < Words) {
+            UINT64 Base = Data + i * Stride * sizeof(UINT64);
+            Relr[Count++] = Base;
+            Base += sizeof(UINT64);
+            i++;
+            for (;;) {
+                UINT64 Bitmap = 0;
+                while (i < Words && Data + i * Stride * sizeof(UINT64) - Base < 63 * sizeof(UINT64)) {
+                    Bitmap |= 1ULL << ((Data + i * Stride * sizeof(UINT64) - Base) / sizeof(UINT64));
+                    i++;
+                }
+                if (Bitmap == 0) break;
+                Relr[Count++] = (Bitmap << 1) | 1;
+                Base += 63 * sizeof(UINT64);
+            }
+        }
+        TableSize = Count * sizeof(UINT64);
+    }
+
+    Elf64_Dyn *Dynamic = (Elf64_Dyn *)Image;
+    Dynamic[0].d_tag = Relr ? DT_RELR : DT_RELA;
+    Dynamic[0].d_val = BENCH_RELOC_TABLE;
+    Dynamic[1].d_tag = Relr ? DT_RELRSZ : DT_RELASZ;
+    Dynamic[1].d_val = TableSize;
+    Dynamic[2].d_tag = Relr ? DT_RELRENT : DT_RELAENT;
+    Dynamic[2].d_val = Relr ? sizeof(UINT64) : sizeof(Elf64_Rela);
+    Dynamic[3].d_tag = DT_NULL;
+
+    Case->Image = Image;
+    Case->Size = Size;
+    Case->TableSize = TableSize;
+}
+
+STATIC VOID BenchReloc(IN VOID *Context) {
+    RELOC_CASE *Case = Context;
+    UINTN Count;
+
+    if (EFI_ERROR(ElfRelocate(Case->Image, Case->Size, 0, 0, 4 * sizeof(Elf64_Dyn), SIZE_2MB, &Count))) {
+        fprintf(stderr, "bench: ElfRelocate failed\n");
+        exit(1);
+    }
+    mSink += Count;
+}
+
+// Throughput is over the relocation table, the part the loader has to read
+STATIC VOID RunRelocBenchmarks(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Name;
+        UINTN Words;
+        UINTN Stride;
+        BOOLEAN Relr;
+    } Cases[] = {
+        { "reloc/rela-64K",          SIZE_64KB, 1, FALSE },
+        { "reloc/relr-64K",          SIZE_64KB, 1, TRUE },
+        { "reloc/rela-64K-sparse",   SIZE_64KB, 4, FALSE },
+        { "reloc/relr-64K-sparse",   SIZE_64KB, 4, TRUE },
+    };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        RELOC_CASE Case;
+        BuildReloc(Cases[i].Words, Cases[i].Stride, Cases[i].Relr, &Case);
+        BenchRun(Cases[i].Name, BenchReloc, &Case, Case.TableSize);
+        free(Case.Image);
+    }
+}
+
+// --------------------------------------------------------------------------
+// MEMORY MAP
+// --------------------------------------------------------------------------
+
+typedef struct {
+    EFI_MEMORY_DESCRIPTOR *Map;
+    UINTN                 Count;
+    PXS_MEMORY_RANGE      *Entries;
+} MEMMAP_CASE;
+
+// A firmware-like map: runs of same-type descriptors that merge, interleaved
+// with ones that do not, optionally in shuffled order
+STATIC VOID BuildMemoryMap(IN UINTN Count, IN BOOLEAN Shuffle, OUT MEMMAP_CASE *Case) {
+    STATIC CONST UINT32 Types[] = {
+        EfiConventionalMemory, EfiConventionalMemory, EfiBootServicesData, EfiBootServicesCode,
+        EfiLoaderData, EfiACPIReclaimMemory, EfiConventionalMemory, EfiRuntimeServicesData,
+    };
+    EFI_MEMORY_DESCRIPTOR *Map = BenchAlloc(Count * sizeof(EFI_MEMORY_DESCRIPTOR));
+    EFI_PHYSICAL_ADDRESS Address = SIZE_1MB;
+    UINT64 Seed = 0x9E3779B97F4A7C15ULL;
+
+    for (UINTN i = 0; i < Count; i++) {
+        Seed = Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        Map[i].Type = Types[(Seed >> 33) % ARRAY_SIZE(Types)];
+        Map[i].PhysicalStart = Address;
+        Map[i].NumberOfPages = 1 + ((Seed >> 40) & 0xFF);
+        Map[i].Attribute = EFI_MEMORY_WB;
+        Address += EFI_PAGES_TO_SIZE(Map[i].NumberOfPages);
+    }
+    if (Shuffle) {
+        for (UINTN i = Count - 1; i > 0; i--) {
+            Seed = Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            UINTN j = (Seed >> 33) % (i + 1);
+            EFI_MEMORY_DESCRIPTOR Tmp = Map[i];
+            Map[i] = Map[j];
+            Map[j] = Tmp;
+        }
+    }
+
+    Case->Map = Map;
+    Case->Count = Count;
+    Case->Entries = BenchAlloc(Count * sizeof(PXS_MEMORY_RANGE));
+}
+
+STATIC VOID BenchMemoryMap(IN VOID *Context) {
+    MEMMAP_CASE *Case = Context;
+    UINTN Count;
+
+    MemoryMapNormalize(Case->Map, Case->Count * sizeof(EFI_MEMORY_DESCRIPTOR), sizeof(EFI_MEMORY_DESCRIPTOR),
+                       Case->Entries, Case->Count, &Count);
+    mSink += Count;
+}
+
+STATIC VOID RunMemoryMapBenchmarks(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Name;
+        UINTN Count;
+        BOOLEAN Shuffle;
+    } Cases[] = {
+        { "memmap/64",            64,   FALSE },
+        { "memmap/512",           512,  FALSE },
+        { "memmap/4096",          4096, FALSE },
+        { "memmap/4096-shuffled", 4096, TRUE },
+    };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        MEMMAP_CASE Case;
+        BuildMemoryMap(Cases[i].Count, Cases[i].Shuffle, &Case);
+        BenchRun(Cases[i].Name, BenchMemoryMap, &Case, Case.Count * sizeof(EFI_MEMORY_DESCRIPTOR));
+        free(Case.Map);
+        free(Case.Entries);
+    }
+}
+
+// --------------------------------------------------------------------------
+// FIRMWARE TABLES
+// --------------------------------------------------------------------------
+
+typedef struct {
+    UINT8                *Memory;
+    UINT64               Bytes;        // Everything the index reads
+    UINT32               Count;
+    PXS_ACPI_TABLE       *Tables;
+    PXS_SMBIOS_TABLE     Smbios;
+    PXS_SMBIOS_STRUCTURE *Structures;
+    PXS_NUMA             Numa;         // Buffers and their room
+    UINT8                *Slit;
+} FIRMWARE_CASE;
+
+// Header and filler body; BenchAcpiChecksum() once the fields are in
+STATIC VOID BenchAcpiTable(IN UINT8 *Table, IN CONST CHAR8 *Signature, IN UINT32 Length) {
+    CopyMem(Table, Signature, 4);
+    CopyMem(Table + 4, &Length, sizeof(Length));
+    Table[8] = 2;
+    for (UINT32 i = 36; i < Length; i++) Table[i] = (UINT8)(i * 7);
+}
+
+STATIC VOID BenchAcpiChecksum(IN UINT8 *Table, IN UINT32 Length, IN UINT32 ChecksumOffset) {
+    UINT8 Sum = 0;
+    Table[ChecksumOffset] = 0;
+    for (UINT32 i = 0; i < Length; i++) Sum += Table[i];
+    Table[ChecksumOffset] = (UINT8)(0 - Sum);
+}
+
+// An RSDP and XSDT listing a FADT (with a DSDT of DsdtSize and a FACS) and
+// Tables SSDTs of TableSize, as a server firmware might
+STATIC VOID BuildAcpi(IN UINT32 Tables, IN UINT32 TableSize, IN UINT32 DsdtSize, OUT FIRMWARE_CASE *Case) {
+    UINT32 XsdtSize = 36 + 8 * (Tables + 1);
+    UINT64 Size = 64 + XsdtSize + 256 + 64 + DsdtSize + (UINT64)Tables * TableSize;
+    UINT8 *Memory = BenchAlloc(Size);
+    UINT8 *Rsdp = Memory, *Xsdt = Memory + 64, *Fadt = Xsdt + XsdtSize, *Facs = Fadt + 256;
+    UINT8 *Dsdt = Facs + 64, *Ssdt = Dsdt + DsdtSize;
+    UINT64 Address;
+    UINT32 Length = 36;
+
+    CopyMem(Rsdp, "RSD PTR ", 8);
+    Rsdp[15] = 2;
+    CopyMem(Rsdp + 20, &Length, sizeof(Length));
+    Address = (UINT64)(UINTN)Xsdt;
+    CopyMem(Rsdp + 24, &Address, sizeof(Address));
+    BenchAcpiChecksum(Rsdp, 20, 8);
+    BenchAcpiChecksum(Rsdp, 36, 32);
+
+    CopyMem(Facs, "FACS", 4);
+    Length = 64;
+    CopyMem(Facs + 4, &Length, sizeof(Length));
+    BenchAcpiTable(Dsdt, "DSDT", DsdtSize);
+    BenchAcpiChecksum(Dsdt, DsdtSize, 9);
+    BenchAcpiTable(Fadt, "FACP", 256);
+    Address = (UINT64)(UINTN)Facs;
+    CopyMem(Fadt + 132, &Address, sizeof(Address));
+    Address = (UINT64)(UINTN)Dsdt;
+    CopyMem(Fadt + 140, &Address, sizeof(Address));
+    BenchAcpiChecksum(Fadt, 256, 9);
+
+    BenchAcpiTable(Xsdt, "XSDT", XsdtSize);
+    Address = (UINT64)(UINTN)Fadt;
+    CopyMem(Xsdt + 36, &Address, sizeof(Address));
+    for (UINT32 i = 0; i < Tables; i++) {
+        UINT8 *Table = Ssdt + (UINT64)i * TableSize;
+        BenchAcpiTable(Table, "SSDT", TableSize);
+        BenchAcpiChecksum(Table, TableSize, 9);
+        Address = (UINT64)(UINTN)Table;
+        CopyMem(Xsdt + 36 + 8 * (i + 1), &Address, sizeof(Address));
+    }
+    BenchAcpiChecksum(Xsdt, XsdtSize, 9);
+
+    Case->Memory = Memory;
+    Case->Bytes = Size;
+    AcpiBuildIndex(Rsdp, NULL, 0, &Case->Count);
+    Case->Tables = BenchAlloc(Case->Count * sizeof(PXS_ACPI_TABLE));
+}
+
+STATIC VOID BenchAcpi(IN VOID *Context) {
+    FIRMWARE_CASE *Case = Context;
+    UINT32 Count;
+
+    AcpiBuildIndex(Case->Memory, Case->Tables, Case->Count, &Count);
+    mSink += Count;
+}
+
+// An SMBIOS 3 table of Count structures, each with a few strings, spread
+// over the usual handful of types
+STATIC VOID BuildSmbios(IN UINT32 Count, OUT FIRMWARE_CASE *Case) {
+    STATIC CONST UINT8 Types[] = { 17, 17, 17, 17, 4, 7, 7, 9, 19, 20, 1, 2, 3, 0, 32, 41 };
+    UINT32 StructureSize = 0x28 + 3 * 16 + 1;
+    UINT32 Size = Count * StructureSize + 8;
+    UINT8 *Memory = BenchAlloc(32 + Size);
+    UINT8 *Entry = Memory, *Table = Memory + 32, *P = Table;
+
+    for (UINT32 i = 0; i < Count; i++) {
+        P[0] = Types[i % ARRAY_SIZE(Types)];
+        P[1] = 0x28;
+        P[2] = (UINT8)i;
+        P[3] = (UINT8)(i >> 8);
+        P += 0x28;
+        for (UINT32 j = 0; j < 3; j++) {
+            CopyMem(P, "String value 01", 15);
+            P += 16;
+        }
+        *P++ = 0;
+    }
+    P[0] = 127;
+    P[1] = 4;
+
+    CopyMem(Entry, "_SM3_", 5);
+    Entry[6] = 0x18;
+    Entry[7] = 3;
+    Entry[8] = 4;
+    CopyMem(Entry + 12, &Size, sizeof(Size));
+    UINT64 Address = (UINT64)(UINTN)Table;
+    CopyMem(Entry + 16, &Address, sizeof(Address));
+    UINT8 Sum = 0;
+    for (UINTN i = 0; i < 0x18; i++) Sum += Entry[i];
+    Entry[5] = (UINT8)(0 - Sum);
+
+    Case->Memory = Memory;
+    Case->Bytes = Size;
+    SmbiosParseEntryPoint(Entry, &Case->Smbios);
+    SmbiosBuildIndex(&Case->Smbios, NULL, 0, &Case->Count);
+    Case->Structures = BenchAlloc(Case->Count * sizeof(PXS_SMBIOS_STRUCTURE));
+}
+
+STATIC VOID BenchSmbios(IN VOID *Context) {
+    FIRMWARE_CASE *Case = Context;
+    UINT32 Count;
+
+    SmbiosBuildIndex(&Case->Smbios, Case->Structures, Case->Count, &Count);
+    mSink += Count;
+}
+
+// An SRAT with CpusPerNode x2APIC entries and two 16 GiB ranges per node,
+// CPUs listed round-robin over the nodes as firmware often does, and a SLIT
+STATIC VOID BuildSrat(IN UINT32 Nodes, IN UINT32 CpusPerNode, OUT FIRMWARE_CASE *Case) {
+    UINT32 SratSize = 48 + Nodes * (CpusPerNode * 24 + 2 * 40);
+    UINT32 SlitSize = 44 + Nodes * Nodes;
+    UINT8 *Memory = BenchAlloc(SratSize + SlitSize);
+    UINT8 *Srat = Memory, *Slit = Memory + SratSize, *P = Srat + 48;
+    UINT32 Enabled = 1;
+    UINT64 Localities = Nodes;
+
+    BenchAcpiTable(Srat, "SRAT", SratSize);
+    Srat[8] = 3;
+    for (UINT32 Cpu = 0; Cpu < Nodes * CpusPerNode; Cpu++, P += 24) {
+        UINT32 Domain = Cpu % Nodes;
+        SetMem(P, 24, 0);
+        P[0] = 2;
+        P[1] = 24;
+        CopyMem(P + 4, &Domain, sizeof(Domain));
+        CopyMem(P + 8, &Cpu, sizeof(Cpu));
+        CopyMem(P + 12, &Enabled, sizeof(Enabled));
+    }
+    for (UINT32 Range = 0; Range < 2 * Nodes; Range++, P += 40) {
+        UINT32 Domain = Range % Nodes;
+        UINT64 Base = SIZE_4GB + Range * (16ULL << 30);
+        UINT64 Length = 16ULL << 30;
+        SetMem(P, 40, 0);
+        P[0] = 1;
+        P[1] = 40;
+        CopyMem(P + 2, &Domain, sizeof(Domain));
+        CopyMem(P + 8, &Base, sizeof(Base));
+        CopyMem(P + 16, &Length, sizeof(Length));
+        CopyMem(P + 28, &Enabled, sizeof(Enabled));
+    }
+    BenchAcpiChecksum(Srat, SratSize, 9);
+
+    BenchAcpiTable(Slit, "SLIT", SlitSize);
+    CopyMem(Slit + 36, &Localities, sizeof(Localities));
+    for (UINT32 i = 0; i < Nodes * Nodes; i++) Slit[44 + i] = (i / Nodes == i % Nodes) ? 10 : 21;
+    BenchAcpiChecksum(Slit, SlitSize, 9);
+
+    Case->Memory = Memory;
+    Case->Bytes = SratSize + SlitSize;
+    Case->Slit = Slit;
+    SetMem(&Case->Numa, sizeof(Case->Numa), 0);
+    NumaBuildTable(Srat, 0, &Case->Numa);
+    Case->Numa.Nodes = BenchAlloc(Case->Numa.NodeCount * sizeof(PXS_NUMA_NODE));
+    Case->Numa.Ranges = BenchAlloc(Case->Numa.RangeCount * sizeof(PXS_NUMA_RANGE));
+    Case->Numa.Distances = BenchAlloc(Nodes * Nodes);
+}
+
+STATIC VOID BenchSrat(IN VOID *Context) {
+    FIRMWARE_CASE *Case = Context;
+    PXS_NUMA Numa = Case->Numa;
+
+    NumaBuildTable(Case->Memory, 0, &Numa);
+    NumaReadDistances(Case->Slit, &Numa);
+    mSink += Numa.NodeCount + Numa.BspNode;
+}
+
+STATIC VOID FreeSrat(IN FIRMWARE_CASE *Case) {
+    free(Case->Memory);
+    free(Case->Numa.Nodes);
+    free(Case->Numa.Ranges);
+    free(Case->Numa.Distances);
+}
+
+STATIC VOID RunFirmwareTableBenchmarks(VOID) {
+    FIRMWARE_CASE Case;
+
+    BuildAcpi(8, SIZE_4KB, SIZE_64KB, &Case);
+    BenchRun("tables/acpi-8+dsdt-64K", BenchAcpi, &Case, Case.Bytes);
+    free(Case.Memory);
+    free(Case.Tables);
+
+    BuildAcpi(64, SIZE_4KB, SIZE_256KB, &Case);
+    BenchRun("tables/acpi-64+dsdt-256K", BenchAcpi, &Case, Case.Bytes);
+    free(Case.Memory);
+    free(Case.Tables);
+
+    BuildSmbios(128, &Case);
+    BenchRun("tables/smbios-128", BenchSmbios, &Case, Case.Bytes);
+    free(Case.Memory);
+    free(Case.Structures);
+
+    BuildSmbios(2048, &Case);
+    BenchRun("tables/smbios-2048", BenchSmbios, &Case, Case.Bytes);
+    free(Case.Memory);
+    free(Case.Structures);
+
+    BuildSrat(2, 128, &Case);
+    BenchRun("tables/srat-2x128", BenchSrat, &Case, Case.Bytes);
+    FreeSrat(&Case);
+
+    BuildSrat(8, 64, &Case);
+    BenchRun("tables/srat-8x64", BenchSrat, &Case, Case.Bytes);
+    FreeSrat(&Case);
+}
+
+// --------------------------------------------------------------------------
+// KASLR AND ENTROPY
+// --------------------------------------------------------------------------
+
+// Free memory the slot search sees on the host: a few runs in an otherwise
+// unused part of the user address space, so AllocateAddress can mmap() them
+#define BENCH_KASLR_WINDOW 0x500000000000ULL
+#define BENCH_KASLR_RUNS   8
+
+STATIC VOID BuildKaslrMemoryMap(VOID) {
+    EFI_MEMORY_DESCRIPTOR Map[BENCH_KASLR_RUNS * 2];
+
+    SetMem(Map, sizeof(Map), 0);
+    for (UINTN i = 0; i < ARRAY_SIZE(Map); i++) {
+        Map[i].Type = (i & 1) ? EfiBootServicesData : EfiConventionalMemory;
+        Map[i].PhysicalStart = BENCH_KASLR_WINDOW + i * SIZE_256MB;
+        Map[i].NumberOfPages = EFI_SIZE_TO_PAGES(SIZE_256MB);
+    }
+    HostSetMemoryMap(Map, ARRAY_SIZE(Map));
+}
+
+// Slot choice and allocation of a 16 MB kernel. On the host the allocation is
+// an mmap(), so this bounds the loader's share rather than the firmware's.
+STATIC VOID BenchKaslr(IN VOID *Context) {
+    EFI_PHYSICAL_ADDRESS Base;
+    UINT64 Size = SIZE_8MB * 2;
+
+    mConfig.KaslrEnabled = TRUE;
+    if (!EFI_ERROR(AllocateKernelPages(&mConfig, BENCH_ELF_BASE, Size, FALSE, &Base))) {
+        gBS->FreePages(Base, EFI_SIZE_TO_PAGES(Size));
+        mSink += Base;
+    }
+}
+
+// Every slot drawn keeps the linked address's 2 MB phase and lies wholly in
+// one of the free runs, never at the linked address the loader falls back to
+STATIC VOID CheckKaslr(VOID) {
+    UINT64 Size = SIZE_8MB * 2;
+
+    mConfig.KaslrEnabled = TRUE;
+    for (UINTN Draw = 0; Draw < 64; Draw++) {
+        EFI_PHYSICAL_ADDRESS Base;
+        EFI_STATUS Status = AllocateKernelPages(&mConfig, BENCH_ELF_BASE, Size, FALSE, &Base);
+        UINT64 Run = (Base - BENCH_KASLR_WINDOW) / SIZE_256MB;
+        BOOLEAN Good = !EFI_ERROR(Status) && Base >= BENCH_KASLR_WINDOW && Run < BENCH_KASLR_RUNS * 2 &&
+                       (Run & 1) == 0 && Base + Size <= BENCH_KASLR_WINDOW + (Run + 1) * SIZE_256MB &&
+                       (Base & (KASLR_ALIGN - 1)) == (BENCH_ELF_BASE & (KASLR_ALIGN - 1));
+        if (!EFI_ERROR(Status)) gBS->FreePages(Base, EFI_SIZE_TO_PAGES(Size));
+        if (!Good) {
+            fprintf(stderr, "bench: KASLR chose 0x%llx (0x%llx)\n", (unsigned long long)Base, (unsigned long long)Status);
+            exit(1);
+        }
+    }
+}
+
+STATIC VOID BenchBestEntropy(IN VOID *Context) {
+    mSink += GetBestEntropy();
+}
+
+STATIC VOID BenchMixEntropy(IN VOID *Context) {
+    STATIC EFI_TIME Time = { .Year = 2026, .Month = 10, .Day = 17, .Hour = 12, .Nanosecond = 123456789 };
+    Time.Nanosecond++;
+    mSink += MixTimeEntropy(__builtin_ia32_rdtsc(), &Time);
+}
+
+STATIC VOID RunKaslrBenchmarks(VOID) {
+    ConfigDefaults(&mConfig);
+    BuildKaslrMemoryMap();
+    CheckKaslr();
+    BenchRun("kaslr/allocate-16M", BenchKaslr, NULL, 0);
+    HostSetMemoryMap(NULL, 0);
+    BenchRun("kaslr/entropy-best", BenchBestEntropy, NULL, 0);
+    BenchRun("kaslr/entropy-mix", BenchMixEntropy, NULL, 0);
+}
+
+// --------------------------------------------------------------------------
+// LOG
+// --------------------------------------------------------------------------
+
+// A typical progress line recorded under LOG=quiet: formatting plus the ring
+// write, which is all a quiet boot pays per message
+STATIC VOID BenchLogQuiet(IN VOID *Context) {
+    LogPrint(PXS_LOG_INFO, L"Module '%a' @ 0x%lx (Size: %ld bytes, Align: 0x%lx)", "initrd", 0x7F000000ULL, (UINT64)SIZE_8MB, (UINT64)SIZE_4KB);
+}
+
+STATIC VOID RunLogBenchmarks(VOID) {
+    LogInit();
+    LogSetLevel(PXS_LOG_ERROR);
+    BenchRun("log/record-quiet", BenchLogQuiet, NULL, 0);
+    mSink += gLog ? gLog->Written : 0;
+}
+
+// --------------------------------------------------------------------------
+// MAIN
+// --------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+    CONST CHAR16 *MemOpsName;
+    CONST CHAR8 *Milliseconds = getenv("PXS_BENCH_MS");
+
+    HostInit();
+    MemOpsInit(&MemOpsName);
+    if (Milliseconds && atoi(Milliseconds) > 0) {
+        mBenchNanoseconds = (UINT64)atoi(Milliseconds) * 1000000ULL;
+    }
+    if (argc > 1) {
+        mBenchFilter = argv[1];
+    }
+
+    RunConfigBenchmarks();
+    RunElfBenchmarks();
+    RunLoadBenchmarks();
+    RunDecodeBenchmarks();
+    RunRelocBenchmarks();
+    RunMemoryMapBenchmarks();
+    RunFirmwareTableBenchmarks();
+    RunKaslrBenchmarks();
+    RunLogBenchmarks();
+    return 0;
+}
@@ -0,0 +1,672 @@
+#define _GNU_SOURCE
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/MpService.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+
+EFI_GUID gEfiAcpi10TableGuid              = { 0xeb9d2d30, 0x2d88, 0x11d3, { 0x9a, 0x16, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+EFI_GUID gEfiAcpi20TableGuid              = { 0x8868e871, 0xe4f1, 0x11d3, { 0xbc, 0x22, 0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81 } };
+EFI_GUID gEfiSmbiosTableGuid              = { 0xeb9d2d31, 0x2d88, 0x11d3, { 0x9a, 0x16, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+EFI_GUID gEfiSmbios3TableGuid             = { 0xf2fd1544, 0x9794, 0x4a2c, { 0x99, 0x2e, 0xe5, 0xbb, 0xcf, 0x20, 0xe3, 0x94 } };
+EFI_GUID gEfiFileInfoGuid                 = { 0x09576e92, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiBlockIoProtocolGuid          = { 0x964e5b21, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiDevicePathProtocolGuid       = { 0x09576e91, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiGraphicsOutputProtocolGuid   = { 0x9042a9de, 0x23dc, 0x4a38, { 0x96, 0xfb, 0x7a, 0xde, 0xd0, 0x80, 0x51, 0x6a } };
+EFI_GUID gEfiLoadedImageProtocolGuid      = { 0x5b1b31a1, 0x9562, 0x11d2, { 0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID gEfiMpServiceProtocolGuid        = { 0x3fdda605, 0xa76e, 0x4f46, { 0xad, 0x29, 0x12, 0xf4, 0x53, 0x1b, 0x3d, 0x08 } };
+EFI_GUID gEfiRngProtocolGuid              = { 0x3152bca5, 0xeade, 0x433d, { 0x86, 0x2e, 0xc0, 0x1c, 0xdc, 0x29, 0x1f, 0x44 } };
+EFI_GUID gEfiSimpleFileSystemProtocolGuid = { 0x964e5b22, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+
+STATIC BOOLEAN mVerbose = FALSE;
+STATIC EFI_MEMORY_DESCRIPTOR *mMemoryMap = NULL;
+STATIC UINTN mMemoryMapCount = 0;
+
+// --------------------------------------------------------------------------
+// CONSOLE
+// --------------------------------------------------------------------------
+
+// The subset of the EDK2 PrintLib format the loader uses: %s %a %c %r %g %p
+// and %d %u %x %X with flags, width and an optional l
+STATIC VOID FormatUnicode(OUT CHAR8 *Out, IN UINTN Size, IN CONST CHAR16 *Format, IN va_list Args) {
+    UINTN Pos = 0;
+
+#define EMIT(Char) do { if (Pos + 1 < Size) Out[Pos++] = (CHAR8)(Char); } while (0)
+
+    for (; *Format != L'\0'; Format++) {
+        if (*Format != L'%') {
+            EMIT(*Format);
+            continue;
+        }
+        Format++;
+
+        CHAR8 Spec[16] = "%";
+        UINTN SpecLength = 1;
+        while ((*Format == L'-' || *Format == L'0' || *Format == L'.' ||
+                (*Format >= L'1' && *Format <= L'9')) && SpecLength < 8) {
+            Spec[SpecLength++] = (CHAR8)*Format++;
+        }
+        BOOLEAN Long = FALSE;
+        if (*Format == L'l') {
+            Long = TRUE;
+            Format++;
+        }
+
+        CHAR8 Number[64];
+        CONST CHAR8 *Text = Number;
+        Number[0] = '\0';
+        switch (*Format) {
+        case L's': {
+            CONST CHAR16 *String = va_arg(Args, CONST CHAR16 *);
+            for (; String && *String; String++) EMIT(*String);
+            continue;
+        }
+        case L'a':
+            Text = va_arg(Args, CONST CHAR8 *);
+            if (!Text) Text = "(null)";
+            break;
+        case L'c':
+            EMIT(va_arg(Args, int));
+            continue;
+        case L'r':
+            snprintf(Number, sizeof(Number), "Status(0x%llx)", (unsigned long long)va_arg(Args, EFI_STATUS));
+            break;
+        case L'g': {
+            CONST EFI_GUID *Guid = va_arg(Args, CONST EFI_GUID *);
+            snprintf(Number, sizeof(Number), "%08x-%04x-%04x-...", Guid->Data1, Guid->Data2, Guid->Data3);
+            break;
+        }
+        case L'p':
+            snprintf(Number, sizeof(Number), "%p", va_arg(Args, VOID *));
+            break;
+        case L'd':
+        case L'u':
+        case L'x':
+        case L'X': {
+            // As in PrintLib, the argument is 64-bit with l and an int without
+            Spec[SpecLength++] = 'l';
+            Spec[SpecLength++] = 'l';
+            Spec[SpecLength++] = (CHAR8)*Format;
+            Spec[SpecLength] = '\0';
+            if (*Format == L'd') {
+                INT64 Value = Long ? va_arg(Args, INT64) : va_arg(Args, INT32);
+                snprintf(Number, sizeof(Number), Spec, (long long)Value);
+            } else {
+                UINT64 Value = Long ? va_arg(Args, UINT64) : va_arg(Args, UINT32);
+                snprintf(Number, sizeof(Number), Spec, (unsigned long long)Value);
+            }
+            break;
+        }
+        case L'%':
+            EMIT('%');
+            continue;
+        default:
+            EMIT('?');
+            continue;
+        }
+        for (; *Text; Text++) EMIT(*Text);
+    }
+    Out[Pos] = '\0';
+
+#undef EMIT
+}
+
+UINTN EFIAPI AsciiVSPrintUnicodeFormat(OUT CHAR8 *StartOfBuffer, IN UINTN BufferSize, IN CONST CHAR16 *FormatString, IN VA_LIST Marker) {
+    if (BufferSize == 0) return 0;
+    FormatUnicode(StartOfBuffer, BufferSize, FormatString, Marker);
+    return strlen(StartOfBuffer);
+}
+
+UINTN EFIAPI Print(IN CONST CHAR16 *Format, ...) {
+    CHAR8 Buffer[1024];
+    va_list Args;
+
+    if (!mVerbose) return 0;
+    va_start(Args, Format);
+    FormatUnicode(Buffer, sizeof(Buffer), Format, Args);
+    va_end(Args);
+    fputs(Buffer, stderr);
+    return strlen(Buffer);
+}
+
+// --------------------------------------------------------------------------
+// BASE LIBRARIES
+// --------------------------------------------------------------------------
+
+UINTN EFIAPI StrLen(IN CONST CHAR16 *String) {
+    UINTN Length = 0;
+    while (String[Length] != L'\0') Length++;
+    return Length;
+}
+
+UINTN EFIAPI AsciiStrLen(IN CONST CHAR8 *String) {
+    return strlen(String);
+}
+
+UINTN EFIAPI AsciiStrSize(IN CONST CHAR8 *String) {
+    return strlen(String) + 1;
+}
+
+EFI_STATUS EFIAPI StrCpyS(OUT CHAR16 *Destination, IN UINTN DestMax, IN CONST CHAR16 *Source) {
+    UINTN Length = StrLen(Source);
+    if (Length >= DestMax) return EFI_BUFFER_TOO_SMALL;
+    memcpy(Destination, Source, (Length + 1) * sizeof(CHAR16));
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI AsciiStrCpyS(OUT CHAR8 *Destination, IN UINTN DestMax, IN CONST CHAR8 *Source) {
+    UINTN Length = strlen(Source);
+    if (Length >= DestMax) return EFI_BUFFER_TOO_SMALL;
+    memcpy(Destination, Source, Length + 1);
+    return EFI_SUCCESS;
+}
+
+INTN EFIAPI StrCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString) {
+    while (*FirstString != L'\0' && *FirstString == *SecondString) {
+        FirstString++;
+        SecondString++;
+    }
+    return (INTN)*FirstString - (INTN)*SecondString;
+}
+
+INTN EFIAPI AsciiStrCmp(IN CONST CHAR8 *FirstString, IN CONST CHAR8 *SecondString) {
+    return strcmp(FirstString, SecondString);
+}
+
+INTN EFIAPI AsciiStrnCmp(IN CONST CHAR8 *FirstString, IN CONST CHAR8 *SecondString, IN UINTN Length) {
+    return strncmp(FirstString, SecondString, Length);
+}
+
+VOID *EFIAPI CopyMem(OUT VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length) {
+    return memmove(DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *EFIAPI SetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value) {
+    return memset(Buffer, Value, Length);
+}
+
+VOID *EFIAPI ZeroMem(OUT VOID *Buffer, IN UINTN Length) {
+    return memset(Buffer, 0, Length);
+}
+
+INTN EFIAPI CompareMem(IN CONST VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length) {
+    return memcmp(DestinationBuffer, SourceBuffer, Length);
+}
+
+BOOLEAN EFIAPI CompareGuid(IN CONST EFI_GUID *Guid1, IN CONST EFI_GUID *Guid2) {
+    return memcmp(Guid1, Guid2, sizeof(EFI_GUID)) == 0;
+}
+
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize) {
+    return malloc(AllocationSize ? AllocationSize : 1);
+}
+
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize) {
+    return calloc(1, AllocationSize ? AllocationSize : 1);
+}
+
+VOID EFIAPI FreePool(IN VOID *Buffer) {
+    free(Buffer);
+}
+
+UINT8 EFIAPI DevicePathType(IN CONST VOID *Node) {
+    return ((CONST EFI_DEVICE_PATH_PROTOCOL *)Node)->Type;
+}
+
+UINT8 EFIAPI DevicePathSubType(IN CONST VOID *Node) {
+    return ((CONST EFI_DEVICE_PATH_PROTOCOL *)Node)->SubType;
+}
+
+BOOLEAN EFIAPI IsDevicePathEnd(IN CONST VOID *Node) {
+    return DevicePathType(Node) == END_DEVICE_PATH_TYPE && DevicePathSubType(Node) == END_ENTIRE_DEVICE_PATH_SUBTYPE;
+}
+
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI NextDevicePathNode(IN CONST VOID *Node) {
+    CONST EFI_DEVICE_PATH_PROTOCOL *Header = Node;
+    return (EFI_DEVICE_PATH_PROTOCOL *)((UINT8 *)Node + (Header->Length[0] | (Header->Length[1] << 8)));
+}
+
+// --------------------------------------------------------------------------
+// CPU
+// --------------------------------------------------------------------------
+
+// CPUID and XGETBV are unprivileged and report the real CPU. Control registers
+// and MSRs are not: they read as zero and writes are dropped, which leaves
+// paging on its 4-level path and PAT untouched.
+
+UINT32 EFIAPI AsmCpuidEx(IN UINT32 Index, IN UINT32 SubIndex, OUT UINT32 *Eax, OUT UINT32 *Ebx, OUT UINT32 *Ecx, OUT UINT32 *Edx) {
+    UINT32 A, B, C, D;
+    __asm__ __volatile__("cpuid" : "=a"(A), "=b"(B), "=c"(C), "=d"(D) : "a"(Index), "c"(SubIndex));
+    if (Eax) *Eax = A;
+    if (Ebx) *Ebx = B;
+    if (Ecx) *Ecx = C;
+    if (Edx) *Edx = D;
+    return Index;
+}
+
+UINT32 EFIAPI AsmCpuid(IN UINT32 Index, OUT UINT32 *Eax, OUT UINT32 *Ebx, OUT UINT32 *Ecx, OUT UINT32 *Edx) {
+    return AsmCpuidEx(Index, 0, Eax, Ebx, Ecx, Edx);
+}
+
+UINT64 EFIAPI AsmXGetBv(IN UINT32 Index) {
+    UINT32 Low, High;
+    __asm__ __volatile__("xgetbv" : "=a"(Low), "=d"(High) : "c"(Index));
+    return ((UINT64)High << 32) | Low;
+}
+
+UINT64 EFIAPI AsmReadTsc(VOID) {
+    return __builtin_ia32_rdtsc();
+}
+
+UINT64 EFIAPI AsmReadMsr64(IN UINT32 Index) {
+    return 0;
+}
+
+UINT64 EFIAPI AsmWriteMsr64(IN UINT32 Index, IN UINT64 Value) {
+    return Value;
+}
+
+UINTN EFIAPI AsmReadCr0(VOID) {
+    return 0;
+}
+
+UINTN EFIAPI AsmReadCr3(VOID) {
+    return 0;
+}
+
+UINTN EFIAPI AsmReadCr4(VOID) {
+    return 0;
+}
+
+UINTN EFIAPI AsmWriteCr3(IN UINTN Cr3) {
+    return Cr3;
+}
+
+UINTN EFIAPI AsmWriteCr4(IN UINTN Cr4) {
+    return Cr4;
+}
+
+VOID EFIAPI AsmWbinvd(VOID) {
+}
+
+VOID EFIAPI CpuPause(VOID) {
+    __builtin_ia32_pause();
+}
+
+VOID EFIAPI DisableInterrupts(VOID) {
+}
+
+VOID EFIAPI EnableInterrupts(VOID) {
+}
+
+UINT32 EFIAPI InterlockedCompareExchange32(IN OUT volatile UINT32 *Value, IN UINT32 CompareValue, IN UINT32 ExchangeValue) {
+    return __sync_val_compare_and_swap(Value, CompareValue, ExchangeValue);
+}
+
+UINT32 EFIAPI InterlockedIncrement(IN volatile UINT32 *Value) {
+    return __sync_add_and_fetch(Value, 1);
+}
+
+// --------------------------------------------------------------------------
+// BOOT SERVICES
+// --------------------------------------------------------------------------
+
+STATIC EFI_STATUS EFIAPI HostAllocatePages(
+    IN EFI_ALLOCATE_TYPE Type,
+    IN EFI_MEMORY_TYPE MemoryType,
+    IN UINTN Pages,
+    IN OUT EFI_PHYSICAL_ADDRESS *Memory
+) {
+    UINTN Size = EFI_PAGES_TO_SIZE(Pages);
+    VOID *Address;
+
+    if (Pages == 0) return EFI_INVALID_PARAMETER;
+    if (Type == AllocateAddress) {
+        if (*Memory & EFI_PAGE_MASK) return EFI_NOT_FOUND;
+        Address = mmap((VOID *)*Memory, Size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (Address == MAP_FAILED) return EFI_NOT_FOUND;
+        if ((EFI_PHYSICAL_ADDRESS)Address != *Memory) {
+            // Kernels before 4.17 treat the flag as a hint
+            munmap(Address, Size);
+            return EFI_NOT_FOUND;
+        }
+        return EFI_SUCCESS;
+    }
+
+    Address = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (Address == MAP_FAILED) return EFI_OUT_OF_RESOURCES;
+    if (Type == AllocateMaxAddress && (EFI_PHYSICAL_ADDRESS)Address + Size - 1 > *Memory) {
+        munmap(Address, Size);
+        return EFI_NOT_FOUND;
+    }
+    *Memory = (EFI_PHYSICAL_ADDRESS)Address;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostFreePages(IN EFI_PHYSICAL_ADDRESS Memory, IN UINTN Pages) {
+    return munmap((VOID *)Memory, EFI_PAGES_TO_SIZE(Pages)) == 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+STATIC EFI_STATUS EFIAPI HostGetMemoryMap(
+    IN OUT UINTN *MemoryMapSize,
+    OUT EFI_MEMORY_DESCRIPTOR *MemoryMap,
+    OUT UINTN *MapKey,
+    OUT UINTN *DescriptorSize,
+    OUT UINT32 *DescriptorVersion
+) {
+    UINTN Needed = mMemoryMapCount * sizeof(EFI_MEMORY_DESCRIPTOR);
+
+    *DescriptorSize = sizeof(EFI_MEMORY_DESCRIPTOR);
+    if (DescriptorVersion) *DescriptorVersion = 1;
+    if (*MemoryMapSize < Needed) {
+        *MemoryMapSize = Needed;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    if (Needed > 0) memcpy(MemoryMap, mMemoryMap, Needed);
+    *MemoryMapSize = Needed;
+    if (MapKey) *MapKey = 1;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostAllocatePool(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size, OUT VOID **Buffer) {
+    *Buffer = AllocatePool(Size);
+    return *Buffer ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+STATIC EFI_STATUS EFIAPI HostFreePool(IN VOID *Buffer) {
+    FreePool(Buffer);
+    return EFI_SUCCESS;
+}
+
+// Events exist so the loader's timer and key waits have something to hold.
+// Only the completion event of StartupAllAPs() is ever signalled: the host
+// has no keyboard and no async I/O.
+STATIC UINT8 mEvents[64];
+
+// --------------------------------------------------------------------------
+// MP services: each AP is a thread for the length of one StartupAllAPs() call
+// --------------------------------------------------------------------------
+
+STATIC UINTN mProcessors = 0;
+STATIC __thread UINTN mProcessorNumber = 0;  // 0 is the BSP, the main thread
+
+typedef struct {
+    EFI_AP_PROCEDURE Procedure;
+    VOID             *Argument;
+    UINTN            Number;
+    pthread_t        Thread;
+} HOST_AP;
+
+STATIC HOST_AP *mAps = NULL;
+STATIC UINTN mApsRunning = 0;
+STATIC EFI_EVENT mApsDone = NULL;
+
+STATIC VOID *HostApThread(VOID *Argument) {
+    HOST_AP *Ap = Argument;
+    mProcessorNumber = Ap->Number;
+    Ap->Procedure(Ap->Argument);
+    return NULL;
+}
+
+STATIC VOID HostJoinAps(VOID) {
+    for (UINTN i = 0; i < mApsRunning; i++) {
+        pthread_join(mAps[i].Thread, NULL);
+    }
+    mApsRunning = 0;
+    mApsDone = NULL;
+}
+
+STATIC EFI_STATUS EFIAPI HostGetNumberOfProcessors(IN EFI_MP_SERVICES_PROTOCOL *This, OUT UINTN *Total, OUT UINTN *Enabled) {
+    *Total = mProcessors;
+    *Enabled = mProcessors;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostGetProcessorInfo(IN EFI_MP_SERVICES_PROTOCOL *This, IN UINTN Number, OUT EFI_PROCESSOR_INFORMATION *Info) {
+    if (Number >= mProcessors) return EFI_NOT_FOUND;
+    memset(Info, 0, sizeof(*Info));
+    Info->ProcessorId = Number;
+    Info->StatusFlag = PROCESSOR_ENABLED_BIT | PROCESSOR_HEALTH_STATUS_BIT | (Number == 0 ? PROCESSOR_AS_BSP_BIT : 0);
+    Info->Location.Core = (UINT32)Number;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostStartupAllAPs(
+    IN EFI_MP_SERVICES_PROTOCOL *This,
+    IN EFI_AP_PROCEDURE Procedure,
+    IN BOOLEAN SingleThread,
+    IN EFI_EVENT WaitEvent,
+    IN UINTN Timeout,
+    IN VOID *Argument,
+    OUT UINTN **FailedCpuList
+) {
+    if (mProcessorNumber != 0) return EFI_DEVICE_ERROR;
+    if (mApsRunning > 0) return EFI_NOT_READY;
+    if (FailedCpuList) *FailedCpuList = NULL;
+
+    for (UINTN i = 0; i + 1 < mProcessors; i++) {
+        HOST_AP *Ap = &mAps[i];
+        Ap->Procedure = Procedure;
+        Ap->Argument = Argument;
+        Ap->Number = i + 1;
+        if (pthread_create(&Ap->Thread, NULL, HostApThread, Ap) != 0) break;
+        mApsRunning++;
+        if (SingleThread) {
+            HostJoinAps();
+        }
+    }
+
+    // Non-blocking callers collect the threads in WaitForEvent()
+    if (WaitEvent) {
+        mApsDone = WaitEvent;
+    } else {
+        HostJoinAps();
+    }
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostStartupThisAP(
+    IN EFI_MP_SERVICES_PROTOCOL *This,
+    IN EFI_AP_PROCEDURE Procedure,
+    IN UINTN Number,
+    IN EFI_EVENT WaitEvent,
+    IN UINTN Timeout,
+    IN VOID *Argument,
+    OUT BOOLEAN *Finished
+) {
+    return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI HostWhoAmI(IN EFI_MP_SERVICES_PROTOCOL *This, OUT UINTN *Number) {
+    *Number = mProcessorNumber;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_MP_SERVICES_PROTOCOL mMpServices = {
+    .GetNumberOfProcessors = HostGetNumberOfProcessors,
+    .GetProcessorInfo      = HostGetProcessorInfo,
+    .StartupAllAPs         = HostStartupAllAPs,
+    .StartupThisAP         = HostStartupThisAP,
+    .WhoAmI                = HostWhoAmI,
+};
+
+VOID HostSetProcessors(IN UINTN Count) {
+    HostJoinAps();
+    free(mAps);
+    mAps = NULL;
+    mProcessors = 0;
+    if (Count < 2) return;
+
+    mAps = calloc(Count - 1, sizeof(HOST_AP));
+    if (!mAps) return;
+    mProcessors = Count;
+}
+
+STATIC EFI_STATUS EFIAPI HostCreateEvent(
+    IN UINT32 Type,
+    IN EFI_TPL NotifyTpl,
+    IN EFI_EVENT_NOTIFY NotifyFunction,
+    IN VOID *NotifyContext,
+    OUT EFI_EVENT *Event
+) {
+    for (UINTN i = 0; i < ARRAY_SIZE(mEvents); i++) {
+        if (!mEvents[i]) {
+            mEvents[i] = 1;
+            *Event = &mEvents[i];
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_OUT_OF_RESOURCES;
+}
+
+STATIC EFI_STATUS EFIAPI HostCloseEvent(IN EFI_EVENT Event) {
+    if (Event == mApsDone) HostJoinAps();
+    *(UINT8 *)Event = 0;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostSetTimer(IN EFI_EVENT Event, IN EFI_TIMER_DELAY Type, IN UINT64 TriggerTime) {
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostCheckEvent(IN EFI_EVENT Event) {
+    return EFI_NOT_READY;
+}
+
+// Waiting on the APs' completion event joins them; otherwise the first event
+// is the one that fires, as a timer would
+STATIC EFI_STATUS EFIAPI HostWaitForEvent(IN UINTN NumberOfEvents, IN EFI_EVENT *Event, OUT UINTN *Index) {
+    *Index = 0;
+    for (UINTN i = 0; i < NumberOfEvents; i++) {
+        if (mApsDone && Event[i] == mApsDone) {
+            HostJoinAps();
+            *Index = i;
+            break;
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostStall(IN UINTN Microseconds) {
+    usleep(Microseconds);
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostLocateProtocol(IN EFI_GUID *Protocol, IN VOID *Registration, OUT VOID **Interface) {
+    if (mProcessors > 1 && CompareGuid(Protocol, &gEfiMpServiceProtocolGuid)) {
+        *Interface = &mMpServices;
+        return EFI_SUCCESS;
+    }
+    return EFI_NOT_FOUND;
+}
+
+// The only handles are the partitions of host/file.c
+STATIC EFI_STATUS EFIAPI HostHandleProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface) {
+    return HostPartitionProtocol(Handle, Protocol, Interface);
+}
+
+STATIC EFI_STATUS EFIAPI HostLocateHandleBuffer(
+    IN EFI_LOCATE_SEARCH_TYPE SearchType,
+    IN EFI_GUID *Protocol,
+    IN VOID *SearchKey,
+    OUT UINTN *NoHandles,
+    OUT EFI_HANDLE **Buffer
+) {
+    if (SearchType != ByProtocol) return EFI_UNSUPPORTED;
+    return HostPartitionHandles(Protocol, NoHandles, Buffer);
+}
+
+STATIC EFI_STATUS EFIAPI HostGetTime(OUT EFI_TIME *Time, OUT VOID *Capabilities) {
+    struct timespec Now;
+    struct tm Calendar;
+
+    clock_gettime(CLOCK_REALTIME, &Now);
+    gmtime_r(&Now.tv_sec, &Calendar);
+    memset(Time, 0, sizeof(EFI_TIME));
+    Time->Year = (UINT16)(Calendar.tm_year + 1900);
+    Time->Month = (UINT8)(Calendar.tm_mon + 1);
+    Time->Day = (UINT8)Calendar.tm_mday;
+    Time->Hour = (UINT8)Calendar.tm_hour;
+    Time->Minute = (UINT8)Calendar.tm_min;
+    Time->Second = (UINT8)Calendar.tm_sec;
+    Time->Nanosecond = (UINT32)Now.tv_nsec;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_BOOT_SERVICES mBootServices = {
+    .AllocatePages      = HostAllocatePages,
+    .FreePages          = HostFreePages,
+    .GetMemoryMap       = HostGetMemoryMap,
+    .AllocatePool       = HostAllocatePool,
+    .FreePool           = HostFreePool,
+    .CreateEvent        = HostCreateEvent,
+    .SetTimer           = HostSetTimer,
+    .WaitForEvent       = HostWaitForEvent,
+    .CloseEvent         = HostCloseEvent,
+    .CheckEvent         = HostCheckEvent,
+    .HandleProtocol     = HostHandleProtocol,
+    .Stall              = HostStall,
+    .LocateProtocol     = HostLocateProtocol,
+    .LocateHandleBuffer = HostLocateHandleBuffer,
+};
+
+STATIC EFI_RUNTIME_SERVICES mRuntimeServices = {
+    .GetTime = HostGetTime,
+};
+
+STATIC EFI_SYSTEM_TABLE mSystemTable = {
+    .RuntimeServices = &mRuntimeServices,
+    .BootServices    = &mBootServices,
+};
+
+EFI_HANDLE        gImageHandle = NULL;
+EFI_SYSTEM_TABLE  *gST = &mSystemTable;
+EFI_BOOT_SERVICES *gBS = &mBootServices;
+EFI_DXE_SERVICES  *gDS = NULL;
+
+// --------------------------------------------------------------------------
+// HOST INTERFACE
+// --------------------------------------------------------------------------
+
+VOID HostInit(VOID) {
+    gST = &mSystemTable;
+    gBS = &mBootServices;
+    mVerbose = getenv("PXS_HOST_VERBOSE") != NULL;
+}
+
+VOID HostSetMemoryMap(IN CONST EFI_MEMORY_DESCRIPTOR *Map, IN UINTN Count) {
+    free(mMemoryMap);
+    mMemoryMap = NULL;
+    mMemoryMapCount = 0;
+    if (Count == 0) return;
+
+    mMemoryMap = malloc(Count * sizeof(EFI_MEMORY_DESCRIPTOR));
+    if (!mMemoryMap) return;
+    memcpy(mMemoryMap, Map, Count * sizeof(EFI_MEMORY_DESCRIPTOR));
+    mMemoryMapCount = Count;
+}
+
+UINT64 HostNanoseconds(VOID) {
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (UINT64)Now.tv_sec * 1000000000ULL + (UINT64)Now.tv_nsec;
+}
@@ -0,0 +1,276 @@
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/SimpleFileSystem.h>
+#include <Guid/FileInfo.h>
+
+#include "host.h"
+
+#define HOST_MAX_FILES     32
+#define HOST_MAX_NAME_SIZE 256
+#define HOST_MAX_PARTITIONS 4
+#define HOST_IO_ALIGN      4       // Dword, as NVMe controllers want
+
+typedef struct {
+    CHAR16     Name[HOST_MAX_NAME_SIZE];
+    CONST UINT8 *Data;
+    UINT64     Size;
+} HOST_FILE_ENTRY;
+
+// An open handle. The protocol comes first so the two pointers convert.
+typedef struct {
+    EFI_FILE_PROTOCOL     Protocol;
+    CONST HOST_FILE_ENTRY *Entry;   ///< NULL for the root directory
+    UINT64                Position;
+    UINTN                 MaxReadEx;
+} HOST_FILE;
+
+STATIC HOST_FILE_ENTRY mFiles[HOST_MAX_FILES];
+STATIC UINTN mFileCount = 0;
+STATIC UINTN mMaxReadEx = 0;        // Non-zero opens revision 2 files
+
+STATIC EFI_STATUS EFIAPI HostFileOpen(
+    IN EFI_FILE_PROTOCOL *This,
+    OUT EFI_FILE_PROTOCOL **NewHandle,
+    IN CHAR16 *FileName,
+    IN UINT64 OpenMode,
+    IN UINT64 Attributes
+);
+
+STATIC EFI_STATUS EFIAPI HostFileClose(IN EFI_FILE_PROTOCOL *This) {
+    HOST_FILE *File = (HOST_FILE *)This;
+    if (File->Entry) FreePool(File);
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostFileRead(IN EFI_FILE_PROTOCOL *This, IN OUT UINTN *BufferSize, OUT VOID *Buffer) {
+    HOST_FILE *File = (HOST_FILE *)This;
+    UINT64 Remaining;
+
+    if (!File->Entry) return EFI_UNSUPPORTED;
+    Remaining = (File->Position < File->Entry->Size) ? File->Entry->Size - File->Position : 0;
+    if (*BufferSize > Remaining) *BufferSize = (UINTN)Remaining;
+    CopyMem(Buffer, File->Entry->Data + File->Position, *BufferSize);
+    File->Position += *BufferSize;
+    return EFI_SUCCESS;
+}
+
+// Completes before returning, which the token's event need not say: the host
+// WaitForEvent() returns at once. Reads stop after MaxReadEx bytes, so the
+// loader has to finish the rest itself.
+STATIC EFI_STATUS EFIAPI HostFileReadEx(IN EFI_FILE_PROTOCOL *This, IN OUT EFI_FILE_IO_TOKEN *Token) {
+    HOST_FILE *File = (HOST_FILE *)This;
+
+    if (Token->BufferSize > File->MaxReadEx) Token->BufferSize = File->MaxReadEx;
+    Token->Status = HostFileRead(This, &Token->BufferSize, Token->Buffer);
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostFileGetPosition(IN EFI_FILE_PROTOCOL *This, OUT UINT64 *Position) {
+    *Position = ((HOST_FILE *)This)->Position;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostFileSetPosition(IN EFI_FILE_PROTOCOL *This, IN UINT64 Position) {
+    HOST_FILE *File = (HOST_FILE *)This;
+
+    if (!File->Entry) return EFI_UNSUPPORTED;
+    File->Position = (Position == MAX_UINT64) ? File->Entry->Size : Position;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostFileGetInfo(
+    IN EFI_FILE_PROTOCOL *This,
+    IN EFI_GUID *InformationType,
+    IN OUT UINTN *BufferSize,
+    OUT VOID *Buffer
+) {
+    HOST_FILE *File = (HOST_FILE *)This;
+    EFI_FILE_INFO *Info = Buffer;
+
+    if (!CompareGuid(InformationType, &gEfiFileInfoGuid)) return EFI_UNSUPPORTED;
+    if (*BufferSize < sizeof(EFI_FILE_INFO)) {
+        *BufferSize = sizeof(EFI_FILE_INFO);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    SetMem(Info, sizeof(EFI_FILE_INFO), 0);
+    Info->Size = sizeof(EFI_FILE_INFO);
+    if (File->Entry) {
+        Info->FileSize = File->Entry->Size;
+        Info->PhysicalSize = File->Entry->Size;
+    }
+    *BufferSize = sizeof(EFI_FILE_INFO);
+    return EFI_SUCCESS;
+}
+
+STATIC CONST EFI_FILE_PROTOCOL mFileProtocol = {
+    .Revision    = EFI_FILE_PROTOCOL_REVISION,
+    .Open        = HostFileOpen,
+    .Close       = HostFileClose,
+    .Read        = HostFileRead,
+    .GetPosition = HostFileGetPosition,
+    .SetPosition = HostFileSetPosition,
+    .GetInfo     = HostFileGetInfo,
+};
+
+STATIC HOST_FILE mRoot;
+
+STATIC EFI_STATUS EFIAPI HostFileOpen(
+    IN EFI_FILE_PROTOCOL *This,
+    OUT EFI_FILE_PROTOCOL **NewHandle,
+    IN CHAR16 *FileName,
+    IN UINT64 OpenMode,
+    IN UINT64 Attributes
+) {
+    if (OpenMode != EFI_FILE_MODE_READ) return EFI_ACCESS_DENIED;
+
+    for (UINTN i = 0; i < mFileCount; i++) {
+        if (StrCmp(mFiles[i].Name, FileName) != 0) continue;
+
+        HOST_FILE *File = AllocatePool(sizeof(HOST_FILE));
+        if (!File) return EFI_OUT_OF_RESOURCES;
+        File->Protocol = mFileProtocol;
+        if (mMaxReadEx != 0) {
+            File->Protocol.Revision = EFI_FILE_PROTOCOL_REVISION2;
+            File->Protocol.ReadEx = HostFileReadEx;
+        }
+        File->Entry = &mFiles[i];
+        File->Position = 0;
+        File->MaxReadEx = mMaxReadEx;
+        *NewHandle = &File->Protocol;
+        return EFI_SUCCESS;
+    }
+    return EFI_NOT_FOUND;
+}
+
+VOID HostAddFile(IN CONST CHAR16 *Name, IN CONST VOID *Data, IN UINT64 Size) {
+    UINTN i;
+
+    for (i = 0; i < mFileCount; i++) {
+        if (StrCmp(mFiles[i].Name, Name) == 0) break;
+    }
+    if (i == mFileCount) {
+        if (mFileCount == HOST_MAX_FILES) return;
+        mFileCount++;
+    }
+    StrCpyS(mFiles[i].Name, HOST_MAX_NAME_SIZE, Name);
+    mFiles[i].Data = Data;
+    mFiles[i].Size = Size;
+}
+
+VOID HostSetReadEx(IN UINTN MaxReadEx) {
+    mMaxReadEx = MaxReadEx;
+}
+
+EFI_FILE_PROTOCOL *HostRootDir(VOID) {
+    mRoot.Protocol = mFileProtocol;
+    mRoot.Entry = NULL;
+    mRoot.Position = 0;
+    mRoot.MaxReadEx = 0;
+    return &mRoot.Protocol;
+}
+
+// A partition handle: block I/O over memory, named by a GPT hard drive node.
+// The protocol comes first so the two pointers convert.
+typedef struct {
+    EFI_BLOCK_IO_PROTOCOL BlockIo;
+    EFI_BLOCK_IO_MEDIA    Media;
+    struct {
+        HARDDRIVE_DEVICE_PATH    HardDrive;
+        EFI_DEVICE_PATH_PROTOCOL End;
+    } __attribute__((packed)) DevicePath;
+    CONST UINT8           *Data;
+} HOST_PARTITION;
+
+STATIC HOST_PARTITION mPartitions[HOST_MAX_PARTITIONS];
+STATIC UINTN mPartitionCount = 0;
+
+// As strict as firmware drivers are about size, range and alignment
+STATIC EFI_STATUS EFIAPI HostReadBlocks(
+    IN EFI_BLOCK_IO_PROTOCOL *This,
+    IN UINT32 MediaId,
+    IN EFI_LBA Lba,
+    IN UINTN BufferSize,
+    OUT VOID *Buffer
+) {
+    HOST_PARTITION *Partition = (HOST_PARTITION *)This;
+    EFI_BLOCK_IO_MEDIA *Media = &Partition->Media;
+
+    if (MediaId != Media->MediaId) return EFI_MEDIA_CHANGED;
+    if (BufferSize % Media->BlockSize != 0) return EFI_BAD_BUFFER_SIZE;
+    if (((UINTN)Buffer & (Media->IoAlign - 1)) != 0) return EFI_INVALID_PARAMETER;
+    if (Lba > Media->LastBlock || BufferSize / Media->BlockSize > Media->LastBlock - Lba + 1) return EFI_INVALID_PARAMETER;
+    CopyMem(Buffer, Partition->Data + Lba * Media->BlockSize, BufferSize);
+    return EFI_SUCCESS;
+}
+
+VOID HostAddPartition(IN CONST EFI_GUID *Guid, IN CONST VOID *Data, IN UINT64 Size, IN UINT32 BlockSize) {
+    UINTN i;
+
+    for (i = 0; i < mPartitionCount; i++) {
+        if (CompareMem(mPartitions[i].DevicePath.HardDrive.Signature, Guid, sizeof(EFI_GUID)) == 0) break;
+    }
+    if (!Data || Size < BlockSize) {
+        if (i < mPartitionCount) mPartitions[i] = mPartitions[--mPartitionCount];
+        return;
+    }
+    if (i == mPartitionCount) {
+        if (mPartitionCount == HOST_MAX_PARTITIONS) return;
+        mPartitionCount++;
+    }
+
+    HOST_PARTITION *Partition = &mPartitions[i];
+    SetMem(Partition, sizeof(*Partition), 0);
+    Partition->Data = Data;
+    Partition->Media.MediaId = 1;
+    Partition->Media.MediaPresent = TRUE;
+    Partition->Media.LogicalPartition = TRUE;
+    Partition->Media.ReadOnly = TRUE;
+    Partition->Media.BlockSize = BlockSize;
+    Partition->Media.IoAlign = HOST_IO_ALIGN;
+    Partition->Media.LastBlock = Size / BlockSize - 1;
+    Partition->BlockIo.Media = &Partition->Media;
+    Partition->BlockIo.ReadBlocks = HostReadBlocks;
+
+    HARDDRIVE_DEVICE_PATH *HardDrive = &Partition->DevicePath.HardDrive;
+    HardDrive->Header.Type = MEDIA_DEVICE_PATH;
+    HardDrive->Header.SubType = MEDIA_HARDDRIVE_DP;
+    HardDrive->Header.Length[0] = sizeof(HARDDRIVE_DEVICE_PATH);
+    HardDrive->PartitionNumber = (UINT32)i + 1;
+    HardDrive->PartitionSize = Size / BlockSize;
+    CopyMem(HardDrive->Signature, Guid, sizeof(EFI_GUID));
+    HardDrive->MBRType = MBR_TYPE_EFI_PARTITION_TABLE_HEADER;
+    HardDrive->SignatureType = SIGNATURE_TYPE_GUID;
+    Partition->DevicePath.End.Type = END_DEVICE_PATH_TYPE;
+    Partition->DevicePath.End.SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+    Partition->DevicePath.End.Length[0] = sizeof(EFI_DEVICE_PATH_PROTOCOL);
+}
+
+EFI_STATUS HostPartitionProtocol(IN EFI_HANDLE Handle, IN CONST EFI_GUID *Protocol, OUT VOID **Interface) {
+    for (UINTN i = 0; i < mPartitionCount; i++) {
+        if (Handle != &mPartitions[i]) continue;
+        if (CompareGuid(Protocol, &gEfiBlockIoProtocolGuid)) {
+            *Interface = &mPartitions[i].BlockIo;
+            return EFI_SUCCESS;
+        }
+        if (CompareGuid(Protocol, &gEfiDevicePathProtocolGuid)) {
+            *Interface = &mPartitions[i].DevicePath;
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS HostPartitionHandles(IN CONST EFI_GUID *Protocol, OUT UINTN *Count, OUT EFI_HANDLE **Handles) {
+    if (mPartitionCount == 0 || (!CompareGuid(Protocol, &gEfiBlockIoProtocolGuid) && !CompareGuid(Protocol, &gEfiDevicePathProtocolGuid))) {
+        return EFI_NOT_FOUND;
+    }
+    *Handles = AllocatePool(mPartitionCount * sizeof(EFI_HANDLE));
+    if (!*Handles) return EFI_OUT_OF_RESOURCES;
+    for (UINTN i = 0; i < mPartitionCount; i++) (*Handles)[i] = &mPartitions[i];
+    *Count = mPartitionCount;
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file host.h
+ * @brief Linux host environment for the loader core
+ *
+ * host/efi.c provides the boot services, runtime services and library calls
+ * the loader sources link against; host/file.c an in-memory volume. Pages are
+ * anonymous mappings at the address the loader asks for, pool is malloc().
+ * There is no RNG or GOP instance, and files implement revision 1 of
+ * EFI_FILE_PROTOCOL unless HostSetReadEx() asks for revision 2, so the loader
+ * takes its synchronous read paths by default. MP services exist once
+ * HostSetProcessors() asks for them, with APs run as threads. Partitions are
+ * memory-backed EFI_BLOCK_IO_PROTOCOL handles.
+ */
+#pragma once
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+/**
+ * Point gST/gBS at the host tables. Print() output goes to stderr when the
+ * PXS_HOST_VERBOSE environment variable is set and is dropped otherwise.
+ */
+VOID HostInit(VOID);
+
+/**
+ * Publish EFI_MP_SERVICES_PROTOCOL with Count processors, the calling thread
+ * being the BSP; StartupAllAPs() runs each AP as a thread. Below 2 the
+ * protocol is withdrawn. Takes effect at the loader's next LocateProtocol().
+ */
+VOID HostSetProcessors(IN UINTN Count);
+
+/**
+ * Returned by GetMemoryMap() from now on. Map is copied; Count may be 0.
+ */
+VOID HostSetMemoryMap(IN CONST EFI_MEMORY_DESCRIPTOR *Map, IN UINTN Count);
+
+/**
+ * Add or replace a file in the root directory of the host volume. Data is
+ * referenced, not copied, and must outlive every handle opened on it.
+ */
+VOID HostAddFile(IN CONST CHAR16 *Name, IN CONST VOID *Data, IN UINT64 Size);
+
+/**
+ * Files opened from now on implement revision 2 of EFI_FILE_PROTOCOL when
+ * MaxReadEx is not 0. ReadEx() completes before it returns, with at most
+ * MaxReadEx bytes, as a driver that stops at an extent boundary does; MAX_UINTN
+ * for whole reads. 0 goes back to revision 1.
+ */
+VOID HostSetReadEx(IN UINTN MaxReadEx);
+
+/**
+ * Add or replace the GPT partition with unique GUID Guid, as block I/O over
+ * Data with BlockSize-byte blocks; Size is rounded down to whole blocks. Data
+ * is referenced, not copied. NULL Data removes the partition.
+ */
+VOID HostAddPartition(IN CONST EFI_GUID *Guid, IN CONST VOID *Data, IN UINT64 Size, IN UINT32 BlockSize);
+
+/**
+ * HandleProtocol() and LocateHandleBuffer(ByProtocol) over the partitions
+ */
+EFI_STATUS HostPartitionProtocol(IN EFI_HANDLE Handle, IN CONST EFI_GUID *Protocol, OUT VOID **Interface);
+EFI_STATUS HostPartitionHandles(IN CONST EFI_GUID *Protocol, OUT UINTN *Count, OUT EFI_HANDLE **Handles);
+
+/**
+ * Root directory of the host volume, as OpenVolume() would return it.
+ */
+EFI_FILE_PROTOCOL *HostRootDir(VOID);
+
+/**
+ * Monotonic clock in nanoseconds.
+ */
+UINT64 HostNanoseconds(VOID);
@@ -0,0 +1,10 @@
+/**
+ * @file Acpi.h
+ * @brief ACPI configuration table GUIDs
+ */
+#pragma once
+
+#include <Uefi.h>
+
+extern EFI_GUID gEfiAcpi10TableGuid;
+extern EFI_GUID gEfiAcpi20TableGuid;
@@ -0,0 +1,20 @@
+/**
+ * @file FileInfo.h
+ * @brief EFI_FILE_INFO
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef struct {
+    UINT64   Size;
+    UINT64   FileSize;
+    UINT64   PhysicalSize;
+    EFI_TIME CreateTime;
+    EFI_TIME LastAccessTime;
+    EFI_TIME ModificationTime;
+    UINT64   Attribute;
+    CHAR16   FileName[1];
+} EFI_FILE_INFO;
+
+extern EFI_GUID gEfiFileInfoGuid;
@@ -0,0 +1,10 @@
+/**
+ * @file SmBios.h
+ * @brief SMBIOS configuration table GUIDs
+ */
+#pragma once
+
+#include <Uefi.h>
+
+extern EFI_GUID gEfiSmbiosTableGuid;
+extern EFI_GUID gEfiSmbios3TableGuid;
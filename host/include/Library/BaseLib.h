@@ -0,0 +1,34 @@
+/**
+ * @file BaseLib.h
+ * @brief String, arithmetic and CPU helpers from MdePkg BaseLib (host/efi.c)
+ */
+#pragma once
+
+#include <Uefi.h>
+
+UINTN      EFIAPI StrLen(IN CONST CHAR16 *String);
+UINTN      EFIAPI AsciiStrLen(IN CONST CHAR8 *String);
+UINTN      EFIAPI AsciiStrSize(IN CONST CHAR8 *String);
+EFI_STATUS EFIAPI StrCpyS(OUT CHAR16 *Destination, IN UINTN DestMax, IN CONST CHAR16 *Source);
+EFI_STATUS EFIAPI AsciiStrCpyS(OUT CHAR8 *Destination, IN UINTN DestMax, IN CONST CHAR8 *Source);
+INTN       EFIAPI StrCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString);
+INTN       EFIAPI AsciiStrCmp(IN CONST CHAR8 *FirstString, IN CONST CHAR8 *SecondString);
+INTN       EFIAPI AsciiStrnCmp(IN CONST CHAR8 *FirstString, IN CONST CHAR8 *SecondString, IN UINTN Length);
+
+UINT32     EFIAPI AsmCpuid(IN UINT32 Index, OUT UINT32 *Eax, OUT UINT32 *Ebx, OUT UINT32 *Ecx, OUT UINT32 *Edx);
+UINT32     EFIAPI AsmCpuidEx(IN UINT32 Index, IN UINT32 SubIndex, OUT UINT32 *Eax, OUT UINT32 *Ebx, OUT UINT32 *Ecx, OUT UINT32 *Edx);
+UINT64     EFIAPI AsmXGetBv(IN UINT32 Index);
+UINT64     EFIAPI AsmReadTsc(VOID);
+UINT64     EFIAPI AsmReadMsr64(IN UINT32 Index);
+UINT64     EFIAPI AsmWriteMsr64(IN UINT32 Index, IN UINT64 Value);
+UINTN      EFIAPI AsmReadCr0(VOID);
+UINTN      EFIAPI AsmReadCr3(VOID);
+UINTN      EFIAPI AsmReadCr4(VOID);
+UINTN      EFIAPI AsmWriteCr3(IN UINTN Cr3);
+UINTN      EFIAPI AsmWriteCr4(IN UINTN Cr4);
+VOID       EFIAPI AsmWbinvd(VOID);
+VOID       EFIAPI CpuPause(VOID);
+VOID       EFIAPI DisableInterrupts(VOID);
+VOID       EFIAPI EnableInterrupts(VOID);
+UINT32     EFIAPI InterlockedCompareExchange32(IN OUT volatile UINT32 *Value, IN UINT32 CompareValue, IN UINT32 ExchangeValue);
+UINT32     EFIAPI InterlockedIncrement(IN volatile UINT32 *Value);
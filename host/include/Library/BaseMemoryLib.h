@@ -0,0 +1,13 @@
+/**
+ * @file BaseMemoryLib.h
+ * @brief Memory helpers from MdePkg BaseMemoryLib (host/efi.c)
+ */
+#pragma once
+
+#include <Uefi.h>
+
+VOID   *EFIAPI CopyMem(OUT VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length);
+VOID   *EFIAPI SetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value);
+VOID   *EFIAPI ZeroMem(OUT VOID *Buffer, IN UINTN Length);
+INTN    EFIAPI CompareMem(IN CONST VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length);
+BOOLEAN EFIAPI CompareGuid(IN CONST EFI_GUID *Guid1, IN CONST EFI_GUID *Guid2);
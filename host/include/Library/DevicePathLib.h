@@ -0,0 +1,12 @@
+/**
+ * @file DevicePathLib.h
+ * @brief Node walking from MdePkg DevicePathLib (host/efi.c)
+ */
+#pragma once
+
+#include <Protocol/DevicePath.h>
+
+UINT8                    EFIAPI DevicePathType(IN CONST VOID *Node);
+UINT8                    EFIAPI DevicePathSubType(IN CONST VOID *Node);
+BOOLEAN                  EFIAPI IsDevicePathEnd(IN CONST VOID *Node);
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI NextDevicePathNode(IN CONST VOID *Node);
@@ -0,0 +1,41 @@
+/**
+ * @file DxeServicesTableLib.h
+ * @brief gDS and the GCD memory space calls the loader makes. gDS is NULL on
+ *        the host, as on firmware without PI DXE services.
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef enum {
+    EfiGcdMemoryTypeNonExistent,
+    EfiGcdMemoryTypeReserved,
+    EfiGcdMemoryTypeSystemMemory,
+    EfiGcdMemoryTypeMemoryMappedIo,
+    EfiGcdMemoryTypePersistent,
+    EfiGcdMemoryTypeMoreReliable,
+    EfiGcdMemoryTypeUnaccepted,
+    EfiGcdMemoryTypeMaximum
+} EFI_GCD_MEMORY_TYPE;
+
+typedef struct {
+    EFI_PHYSICAL_ADDRESS BaseAddress;
+    UINT64               Length;
+    UINT64               Capabilities;
+    UINT64               Attributes;
+    EFI_GCD_MEMORY_TYPE  GcdMemoryType;
+    EFI_HANDLE           ImageHandle;
+    EFI_HANDLE           DeviceHandle;
+} EFI_GCD_MEMORY_SPACE_DESCRIPTOR;
+
+typedef struct {
+    EFI_TABLE_HEADER Hdr;
+    VOID       *AddMemorySpace;
+    VOID       *AllocateMemorySpace;
+    VOID       *FreeMemorySpace;
+    VOID       *RemoveMemorySpace;
+    EFI_STATUS (EFIAPI *GetMemorySpaceDescriptor)(IN EFI_PHYSICAL_ADDRESS BaseAddress, OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR *Descriptor);
+    EFI_STATUS (EFIAPI *SetMemorySpaceAttributes)(IN EFI_PHYSICAL_ADDRESS BaseAddress, IN UINT64 Length, IN UINT64 Attributes);
+} EFI_DXE_SERVICES;
+
+extern EFI_DXE_SERVICES *gDS;
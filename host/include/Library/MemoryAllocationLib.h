@@ -0,0 +1,11 @@
+/**
+ * @file MemoryAllocationLib.h
+ * @brief Pool helpers from MdePkg MemoryAllocationLib (host/efi.c)
+ */
+#pragma once
+
+#include <Uefi.h>
+
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize);
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize);
+VOID  EFIAPI FreePool(IN VOID *Buffer);
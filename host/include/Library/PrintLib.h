@@ -0,0 +1,9 @@
+/**
+ * @file PrintLib.h
+ * @brief Formatting from MdePkg PrintLib (host/efi.c), the same subset Print() takes
+ */
+#pragma once
+
+#include <Uefi.h>
+
+UINTN EFIAPI AsciiVSPrintUnicodeFormat(OUT CHAR8 *StartOfBuffer, IN UINTN BufferSize, IN CONST CHAR16 *FormatString, IN VA_LIST Marker);
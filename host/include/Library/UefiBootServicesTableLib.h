@@ -0,0 +1,11 @@
+/**
+ * @file UefiBootServicesTableLib.h
+ * @brief Table pointers, filled in by HostInit() (host/efi.c)
+ */
+#pragma once
+
+#include <Uefi.h>
+
+extern EFI_HANDLE        gImageHandle;
+extern EFI_SYSTEM_TABLE  *gST;
+extern EFI_BOOT_SERVICES *gBS;
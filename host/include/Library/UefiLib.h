@@ -0,0 +1,10 @@
+/**
+ * @file UefiLib.h
+ * @brief Console output. On the host it goes to stderr only when PXS_HOST_VERBOSE
+ *        is set, so benchmarks do not time the terminal.
+ */
+#pragma once
+
+#include <Uefi.h>
+
+UINTN EFIAPI Print(IN CONST CHAR16 *Format, ...);
@@ -0,0 +1,32 @@
+/**
+ * @file BlockIo.h
+ * @brief EFI_BLOCK_IO_PROTOCOL, read side. host/file.c installs one per
+ *        partition added with HostAddPartition().
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef struct {
+    UINT32  MediaId;
+    BOOLEAN RemovableMedia;
+    BOOLEAN MediaPresent;
+    BOOLEAN LogicalPartition;
+    BOOLEAN ReadOnly;
+    BOOLEAN WriteCaching;
+    UINT32  BlockSize;
+    UINT32  IoAlign;
+    EFI_LBA LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+typedef struct _EFI_BLOCK_IO_PROTOCOL EFI_BLOCK_IO_PROTOCOL;
+struct _EFI_BLOCK_IO_PROTOCOL {
+    UINT64             Revision;
+    EFI_BLOCK_IO_MEDIA *Media;
+    VOID               *Reset;
+    EFI_STATUS (EFIAPI *ReadBlocks)(EFI_BLOCK_IO_PROTOCOL *This, UINT32 MediaId, EFI_LBA Lba, UINTN BufferSize, VOID *Buffer);
+    VOID               *WriteBlocks;
+    VOID               *FlushBlocks;
+};
+
+extern EFI_GUID gEfiBlockIoProtocolGuid;
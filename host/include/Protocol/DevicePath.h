@@ -0,0 +1,33 @@
+/**
+ * @file DevicePath.h
+ * @brief EFI_DEVICE_PATH_PROTOCOL and the hard drive media node
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef struct {
+    UINT8 Type;
+    UINT8 SubType;
+    UINT8 Length[2];
+} EFI_DEVICE_PATH_PROTOCOL;
+
+#define MEDIA_DEVICE_PATH                   0x04
+#define MEDIA_HARDDRIVE_DP                  0x01
+#define END_DEVICE_PATH_TYPE                0x7F
+#define END_ENTIRE_DEVICE_PATH_SUBTYPE      0xFF
+
+#define MBR_TYPE_EFI_PARTITION_TABLE_HEADER 0x02
+#define SIGNATURE_TYPE_GUID                 0x02
+
+typedef struct {
+    EFI_DEVICE_PATH_PROTOCOL Header;
+    UINT32                   PartitionNumber;
+    UINT64                   PartitionStart;
+    UINT64                   PartitionSize;
+    UINT8                    Signature[16];
+    UINT8                    MBRType;
+    UINT8                    SignatureType;
+} __attribute__((packed)) HARDDRIVE_DEVICE_PATH;
+
+extern EFI_GUID gEfiDevicePathProtocolGuid;
@@ -0,0 +1,25 @@
+/**
+ * @file LoadedImage.h
+ * @brief EFI_LOADED_IMAGE_PROTOCOL
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef struct {
+    UINT32           Revision;
+    EFI_HANDLE       ParentHandle;
+    EFI_SYSTEM_TABLE *SystemTable;
+    EFI_HANDLE       DeviceHandle;
+    VOID             *FilePath;
+    VOID             *Reserved;
+    UINT32           LoadOptionsSize;
+    VOID             *LoadOptions;
+    VOID             *ImageBase;
+    UINT64           ImageSize;
+    EFI_MEMORY_TYPE  ImageCodeType;
+    EFI_MEMORY_TYPE  ImageDataType;
+    VOID             *Unload;
+} EFI_LOADED_IMAGE_PROTOCOL;
+
+extern EFI_GUID gEfiLoadedImageProtocolGuid;
@@ -0,0 +1,17 @@
+/**
+ * @file Rng.h
+ * @brief EFI_RNG_PROTOCOL. Never installed on the host.
+ */
+#pragma once
+
+#include <Uefi.h>
+
+typedef EFI_GUID EFI_RNG_ALGORITHM;
+
+typedef struct _EFI_RNG_PROTOCOL EFI_RNG_PROTOCOL;
+struct _EFI_RNG_PROTOCOL {
+    VOID       *GetInfo;
+    EFI_STATUS (EFIAPI *GetRNG)(EFI_RNG_PROTOCOL *This, EFI_RNG_ALGORITHM *RNGAlgorithm, UINTN RNGValueLength, UINT8 *RNGValue);
+};
+
+extern EFI_GUID gEfiRngProtocolGuid;
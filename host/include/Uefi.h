@@ -0,0 +1,355 @@
+/**
+ * @file Uefi.h
+ * @brief The subset of the EDK2 base types and tables the loader uses, for
+ *        building it as a Linux host library (see host/Makefile)
+ *
+ * Layouts match the UEFI specification where the loader reads a structure;
+ * members it never touches are kept as opaque pointers so offsets still line up.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t  UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int8_t   INT8;
+typedef int16_t  INT16;
+typedef int32_t  INT32;
+typedef int64_t  INT64;
+typedef uint64_t UINTN;
+typedef int64_t  INTN;
+typedef char     CHAR8;
+typedef uint16_t CHAR16;  ///< Requires -fshort-wchar for L"" literals
+typedef uint8_t  BOOLEAN;
+typedef void     VOID;
+
+typedef UINTN  EFI_STATUS;
+typedef VOID  *EFI_HANDLE;
+typedef VOID  *EFI_EVENT;
+typedef UINTN  EFI_TPL;
+typedef UINT64 EFI_LBA;
+typedef UINT64 EFI_PHYSICAL_ADDRESS;
+typedef UINT64 EFI_VIRTUAL_ADDRESS;
+
+typedef struct {
+    UINT32 Data1;
+    UINT16 Data2;
+    UINT16 Data3;
+    UINT8  Data4[8];
+} EFI_GUID;
+
+#define TRUE     ((BOOLEAN)1)
+#define FALSE    ((BOOLEAN)0)
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST    const
+#define STATIC   static
+#define EFIAPI
+
+#define VA_LIST  __builtin_va_list
+#define VA_START __builtin_va_start
+#define VA_ARG   __builtin_va_arg
+#define VA_END   __builtin_va_end
+
+#define MAX_BIT             0x8000000000000000ULL
+#define ENCODE_ERROR(Code)  ((EFI_STATUS)(MAX_BIT | (Code)))
+#define ENCODE_WARNING(Code) ((EFI_STATUS)(Code))
+#define EFI_ERROR(Status)   (((INTN)(EFI_STATUS)(Status)) < 0)
+
+#define EFI_SUCCESS            0
+#define EFI_LOAD_ERROR         ENCODE_ERROR(1)
+#define EFI_INVALID_PARAMETER  ENCODE_ERROR(2)
+#define EFI_UNSUPPORTED        ENCODE_ERROR(3)
+#define EFI_BAD_BUFFER_SIZE    ENCODE_ERROR(4)
+#define EFI_BUFFER_TOO_SMALL   ENCODE_ERROR(5)
+#define EFI_NOT_READY          ENCODE_ERROR(6)
+#define EFI_DEVICE_ERROR       ENCODE_ERROR(7)
+#define EFI_OUT_OF_RESOURCES   ENCODE_ERROR(9)
+#define EFI_VOLUME_CORRUPTED   ENCODE_ERROR(10)
+#define EFI_WRITE_PROTECTED    ENCODE_ERROR(8)
+#define EFI_NO_MEDIA           ENCODE_ERROR(12)
+#define EFI_MEDIA_CHANGED      ENCODE_ERROR(13)
+#define EFI_NOT_FOUND          ENCODE_ERROR(14)
+#define EFI_ACCESS_DENIED      ENCODE_ERROR(15)
+#define EFI_TIMEOUT            ENCODE_ERROR(18)
+#define EFI_NOT_STARTED        ENCODE_ERROR(19)
+#define EFI_ALREADY_STARTED    ENCODE_ERROR(20)
+#define EFI_ABORTED            ENCODE_ERROR(21)
+#define EFI_SECURITY_VIOLATION ENCODE_ERROR(26)
+#define EFI_CRC_ERROR          ENCODE_ERROR(27)
+#define EFI_END_OF_FILE        ENCODE_ERROR(31)
+#define EFI_COMPROMISED_DATA   ENCODE_ERROR(33)
+
+#define EFI_WARN_DELETE_FAILURE ENCODE_WARNING(2)
+
+#define EFI_PAGE_SIZE            0x1000
+#define EFI_PAGE_MASK            0xFFF
+#define EFI_PAGE_SHIFT           12
+#define EFI_SIZE_TO_PAGES(Size)  (((Size) >> EFI_PAGE_SHIFT) + (((Size) & EFI_PAGE_MASK) ? 1 : 0))
+#define EFI_PAGES_TO_SIZE(Pages) ((Pages) << EFI_PAGE_SHIFT)
+
+#define ARRAY_SIZE(Array)             (sizeof(Array) / sizeof((Array)[0]))
+#define OFFSET_OF(Type, Field)        __builtin_offsetof(Type, Field)
+#define STATIC_ASSERT                 _Static_assert
+#define ALIGN_VALUE(Value, Alignment) ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1)))
+#define MIN(a, b)                     (((a) < (b)) ? (a) : (b))
+#define MAX(a, b)                     (((a) > (b)) ? (a) : (b))
+#define SIGNATURE_32(A, B, C, D)      ((A) | ((B) << 8) | ((C) << 16) | ((D) << 24))
+
+#define MAX_UINT32 0xFFFFFFFFU
+#define MAX_UINT64 0xFFFFFFFFFFFFFFFFULL
+#define MAX_UINTN  MAX_UINT64
+
+#define SIZE_1KB   0x00000400
+#define SIZE_2KB   0x00000800
+#define SIZE_4KB   0x00001000
+#define SIZE_64KB  0x00010000
+#define SIZE_128KB 0x00020000
+#define SIZE_256KB 0x00040000
+#define SIZE_512KB 0x00080000
+#define SIZE_1MB   0x00100000
+#define SIZE_2MB   0x00200000
+#define SIZE_4MB   0x00400000
+#define SIZE_8MB   0x00800000
+#define SIZE_16MB  0x01000000
+#define SIZE_32MB  0x02000000
+#define SIZE_64MB  0x04000000
+#define SIZE_256MB 0x10000000
+#define SIZE_1GB   0x40000000
+#define SIZE_4GB   0x0000000100000000ULL
+#define BASE_2MB   SIZE_2MB
+#define BASE_1GB   SIZE_1GB
+#define BASE_4GB   SIZE_4GB
+
+#define TPL_APPLICATION   4
+#define TPL_CALLBACK      8
+#define TPL_NOTIFY        16
+
+#define EVT_TIMER         0x80000000
+#define EVT_NOTIFY_WAIT   0x00000100
+#define EVT_NOTIFY_SIGNAL 0x00000200
+
+typedef enum {
+    AllocateAnyPages,
+    AllocateMaxAddress,
+    AllocateAddress,
+    MaxAllocateType
+} EFI_ALLOCATE_TYPE;
+
+typedef enum {
+    EfiReservedMemoryType,
+    EfiLoaderCode,
+    EfiLoaderData,
+    EfiBootServicesCode,
+    EfiBootServicesData,
+    EfiRuntimeServicesCode,
+    EfiRuntimeServicesData,
+    EfiConventionalMemory,
+    EfiUnusableMemory,
+    EfiACPIReclaimMemory,
+    EfiACPIMemoryNVS,
+    EfiMemoryMappedIO,
+    EfiMemoryMappedIOPortSpace,
+    EfiPalCode,
+    EfiPersistentMemory,
+    EfiUnacceptedMemoryType,
+    EfiMaxMemoryType
+} EFI_MEMORY_TYPE;
+
+typedef enum {
+    TimerCancel,
+    TimerPeriodic,
+    TimerRelative
+} EFI_TIMER_DELAY;
+
+typedef enum {
+    EfiResetCold,
+    EfiResetWarm,
+    EfiResetShutdown,
+    EfiResetPlatformSpecific
+} EFI_RESET_TYPE;
+
+typedef enum {
+    AllHandles,
+    ByRegisterNotify,
+    ByProtocol
+} EFI_LOCATE_SEARCH_TYPE;
+
+#define EFI_MEMORY_UC      0x0000000000000001ULL
+#define EFI_MEMORY_WC      0x0000000000000002ULL
+#define EFI_MEMORY_WT      0x0000000000000004ULL
+#define EFI_MEMORY_WB      0x0000000000000008ULL
+#define EFI_MEMORY_UCE     0x0000000000000010ULL
+#define EFI_MEMORY_WP      0x0000000000001000ULL
+#define EFI_MEMORY_RP      0x0000000000002000ULL
+#define EFI_MEMORY_XP      0x0000000000004000ULL
+#define EFI_MEMORY_NV      0x0000000000008000ULL
+#define EFI_MEMORY_MORE_RELIABLE 0x0000000000010000ULL
+#define EFI_MEMORY_RO      0x0000000000020000ULL
+#define EFI_MEMORY_SP      0x0000000000040000ULL
+#define EFI_MEMORY_RUNTIME 0x8000000000000000ULL
+
+typedef struct {
+    UINT32               Type;
+    EFI_PHYSICAL_ADDRESS PhysicalStart;
+    EFI_VIRTUAL_ADDRESS  VirtualStart;
+    UINT64               NumberOfPages;
+    UINT64               Attribute;
+} EFI_MEMORY_DESCRIPTOR;
+
+typedef struct {
+    UINT16 Year;
+    UINT8  Month;
+    UINT8  Day;
+    UINT8  Hour;
+    UINT8  Minute;
+    UINT8  Second;
+    UINT8  Pad1;
+    UINT32 Nanosecond;
+    INT16  TimeZone;
+    UINT8  Daylight;
+    UINT8  Pad2;
+} EFI_TIME;
+
+typedef struct {
+    UINT64 Signature;
+    UINT32 Revision;
+    UINT32 HeaderSize;
+    UINT32 CRC32;
+    UINT32 Reserved;
+} EFI_TABLE_HEADER;
+
+// Console
+
+typedef struct {
+    UINT16 ScanCode;
+    CHAR16 UnicodeChar;
+} EFI_INPUT_KEY;
+
+#define SCAN_NULL            0x00
+#define SCAN_UP              0x01
+#define SCAN_DOWN            0x02
+#define SCAN_ESC             0x17
+#define CHAR_CARRIAGE_RETURN 0x0D
+
+typedef struct _EFI_SIMPLE_TEXT_INPUT_PROTOCOL EFI_SIMPLE_TEXT_INPUT_PROTOCOL;
+struct _EFI_SIMPLE_TEXT_INPUT_PROTOCOL {
+    EFI_STATUS (EFIAPI *Reset)(EFI_SIMPLE_TEXT_INPUT_PROTOCOL *This, BOOLEAN ExtendedVerification);
+    EFI_STATUS (EFIAPI *ReadKeyStroke)(EFI_SIMPLE_TEXT_INPUT_PROTOCOL *This, EFI_INPUT_KEY *Key);
+    EFI_EVENT  WaitForKey;
+};
+
+typedef struct {
+    INT32   MaxMode;
+    INT32   Mode;
+    INT32   Attribute;
+    INT32   CursorColumn;
+    INT32   CursorRow;
+    BOOLEAN CursorVisible;
+} EFI_SIMPLE_TEXT_OUTPUT_MODE;
+
+typedef struct _EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL;
+struct _EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL {
+    VOID       *Reset;
+    EFI_STATUS (EFIAPI *OutputString)(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, CHAR16 *String);
+    VOID       *TestString;
+    VOID       *QueryMode;
+    VOID       *SetMode;
+    VOID       *SetAttribute;
+    EFI_STATUS (EFIAPI *ClearScreen)(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This);
+    EFI_STATUS (EFIAPI *SetCursorPosition)(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, UINTN Column, UINTN Row);
+    VOID       *EnableCursor;
+    EFI_SIMPLE_TEXT_OUTPUT_MODE *Mode;
+};
+
+// Services
+
+typedef VOID (EFIAPI *EFI_EVENT_NOTIFY)(EFI_EVENT Event, VOID *Context);
+
+typedef struct {
+    EFI_TABLE_HEADER Hdr;
+    VOID       *RaiseTPL;
+    VOID       *RestoreTPL;
+    EFI_STATUS (EFIAPI *AllocatePages)(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType, UINTN Pages, EFI_PHYSICAL_ADDRESS *Memory);
+    EFI_STATUS (EFIAPI *FreePages)(EFI_PHYSICAL_ADDRESS Memory, UINTN Pages);
+    EFI_STATUS (EFIAPI *GetMemoryMap)(UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap, UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion);
+    EFI_STATUS (EFIAPI *AllocatePool)(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer);
+    EFI_STATUS (EFIAPI *FreePool)(VOID *Buffer);
+    EFI_STATUS (EFIAPI *CreateEvent)(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, EFI_EVENT *Event);
+    EFI_STATUS (EFIAPI *SetTimer)(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime);
+    EFI_STATUS (EFIAPI *WaitForEvent)(UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index);
+    EFI_STATUS (EFIAPI *SignalEvent)(EFI_EVENT Event);
+    EFI_STATUS (EFIAPI *CloseEvent)(EFI_EVENT Event);
+    EFI_STATUS (EFIAPI *CheckEvent)(EFI_EVENT Event);
+    VOID       *InstallProtocolInterface;
+    VOID       *ReinstallProtocolInterface;
+    VOID       *UninstallProtocolInterface;
+    EFI_STATUS (EFIAPI *HandleProtocol)(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface);
+    VOID       *Reserved;
+    VOID       *RegisterProtocolNotify;
+    EFI_STATUS (EFIAPI *LocateHandle)(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol, VOID *SearchKey, UINTN *BufferSize, EFI_HANDLE *Buffer);
+    VOID       *LocateDevicePath;
+    VOID       *InstallConfigurationTable;
+    VOID       *LoadImage;
+    VOID       *StartImage;
+    VOID       *Exit;
+    VOID       *UnloadImage;
+    EFI_STATUS (EFIAPI *ExitBootServices)(EFI_HANDLE ImageHandle, UINTN MapKey);
+    VOID       *GetNextMonotonicCount;
+    EFI_STATUS (EFIAPI *Stall)(UINTN Microseconds);
+    EFI_STATUS (EFIAPI *SetWatchdogTimer)(UINTN Timeout, UINT64 WatchdogCode, UINTN DataSize, CHAR16 *WatchdogData);
+    VOID       *ConnectController;
+    VOID       *DisconnectController;
+    VOID       *OpenProtocol;
+    VOID       *CloseProtocol;
+    VOID       *OpenProtocolInformation;
+    VOID       *ProtocolsPerHandle;
+    EFI_STATUS (EFIAPI *LocateHandleBuffer)(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol, VOID *SearchKey, UINTN *NoHandles, EFI_HANDLE **Buffer);
+    EFI_STATUS (EFIAPI *LocateProtocol)(EFI_GUID *Protocol, VOID *Registration, VOID **Interface);
+    VOID       *InstallMultipleProtocolInterfaces;
+    VOID       *UninstallMultipleProtocolInterfaces;
+    VOID       *CalculateCrc32;
+    VOID       *CopyMem;
+    VOID       *SetMem;
+    VOID       *CreateEventEx;
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+    EFI_TABLE_HEADER Hdr;
+    EFI_STATUS (EFIAPI *GetTime)(EFI_TIME *Time, VOID *Capabilities);
+    VOID       *SetTime;
+    VOID       *GetWakeupTime;
+    VOID       *SetWakeupTime;
+    VOID       *SetVirtualAddressMap;
+    VOID       *ConvertPointer;
+    VOID       *GetVariable;
+    VOID       *GetNextVariableName;
+    VOID       *SetVariable;
+    VOID       *GetNextHighMonotonicCount;
+    VOID       (EFIAPI *ResetSystem)(EFI_RESET_TYPE ResetType, EFI_STATUS ResetStatus, UINTN DataSize, VOID *ResetData);
+} EFI_RUNTIME_SERVICES;
+
+typedef struct {
+    EFI_GUID VendorGuid;
+    VOID     *VendorTable;
+} EFI_CONFIGURATION_TABLE;
+
+typedef struct {
+    EFI_TABLE_HEADER                Hdr;
+    CHAR16                          *FirmwareVendor;
+    UINT32                          FirmwareRevision;
+    EFI_HANDLE                      ConsoleInHandle;
+    EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *ConIn;
+    EFI_HANDLE                      ConsoleOutHandle;
+    EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *ConOut;
+    EFI_HANDLE                      StandardErrorHandle;
+    EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *StdErr;
+    EFI_RUNTIME_SERVICES            *RuntimeServices;
+    EFI_BOOT_SERVICES               *BootServices;
+    UINTN                           NumberOfTableEntries;
+    EFI_CONFIGURATION_TABLE         *ConfigurationTable;
+} EFI_SYSTEM_TABLE;
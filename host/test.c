@@ -0,0 +1,1545 @@
+// Loader correctness tests on the host: the LZ4 and zstd decoders against
+// reference tool output, serially and across CPUs; the file reader over
+// ReadEx requests that complete short; SHA-256 known answers for
+// the portable and SHA extension block functions; the initrd cpio index; RELR
+// and RELA relocation of a position independent kernel; the ACPI and SMBIOS
+// indexes over synthetic firmware tables; part: source parsing; memory map
+// normalization; the NUMA node table from the SRAT and SLIT; and page table
+// construction, splitting large pages and the loader's own page tables.
+//
+//   make -C host test                   run every case
+//   host/build/test zstd                run the cases whose name contains "zstd"
+//
+// Reference streams are made by the lz4 and zstd tools in PATH (or the LZ4 and
+// ZSTD environment variables); without them those cases are reported skipped.
+
+// The stream and config types are private to Pxs.c, so the tests are compiled
+// into the same translation unit as the loader, as the benchmarks are
+#include "arch/x64/efi/Pxs.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+#define TEST_CPUS  4    // Processors for the cases that run across CPUs
+
+STATIC CONST CHAR8 *mTestFilter = NULL;
+STATIC CONST CHAR8 *mTestName = NULL;
+STATIC UINTN mFailed = 0;
+STATIC UINTN mSkipped = 0;
+STATIC UINTN mPassed = 0;
+STATIC CHAR8 mTempDir[] = "/tmp/pxs-test-XXXXXX";
+
+// --------------------------------------------------------------------------
+// HARNESS
+// --------------------------------------------------------------------------
+
+// Record a failed check of the current case and carry on with the next one
+#define CHECK(Cond)                                                             \
+    do {                                                                        \
+        if (!(Cond)) {                                                          \
+            fprintf(stderr, "FAIL %s: %s (line %d)\n", mTestName, #Cond, __LINE__); \
+            mFailed++;                                                          \
+            return;                                                             \
+        }                                                                       \
+    } while (0)
+
+STATIC BOOLEAN TestSelected(IN CONST CHAR8 *Name) {
+    if (mTestFilter && !strstr(Name, mTestFilter)) return FALSE;
+    mTestName = Name;
+    return TRUE;
+}
+
+STATIC VOID TestPassed(VOID) {
+    printf("ok   %s\n", mTestName);
+    mPassed++;
+}
+
+STATIC VOID TestSkipped(IN CONST CHAR8 *Why) {
+    printf("skip %s: %s\n", mTestName, Why);
+    mSkipped++;
+}
+
+STATIC VOID *TestAlloc(IN UINTN Size) {
+    VOID *Buffer = calloc(1, MAX(Size, 1));
+    if (!Buffer) {
+        fprintf(stderr, "test: out of memory\n");
+        exit(1);
+    }
+    return Buffer;
+}
+
+STATIC VOID TestWriteFile(IN CONST CHAR8 *Path, IN CONST VOID *Data, IN UINTN Size) {
+    FILE *File = fopen(Path, "wb");
+    if (!File || fwrite(Data, 1, Size, File) != Size || fclose(File) != 0) {
+        fprintf(stderr, "test: cannot write %s\n", Path);
+        exit(1);
+    }
+}
+
+// NULL when the file cannot be read
+STATIC UINT8 *TestReadFile(IN CONST CHAR8 *Path, OUT UINTN *Size) {
+    FILE *File = fopen(Path, "rb");
+    if (!File) return NULL;
+    fseek(File, 0, SEEK_END);
+    *Size = (UINTN)ftell(File);
+    fseek(File, 0, SEEK_SET);
+    UINT8 *Data = TestAlloc(*Size);
+    if (fread(Data, 1, *Size, File) != *Size) {
+        free(Data);
+        Data = NULL;
+    }
+    fclose(File);
+    return Data;
+}
+
+STATIC VOID TestSha256(IN CONST VOID *Data, IN UINTN Size, IN PXS_SHA256_BLOCKS Blocks, OUT UINT8 *Digest) {
+    PXS_SHA256 Ctx;
+    Sha256Init(&Ctx, Blocks);
+    Sha256Update(&Ctx, Data, Size);
+    Sha256Final(&Ctx, Digest);
+}
+
+// Publish Cpus processors and let the loader's work pool pick them up
+STATIC VOID TestSetCpus(IN UINTN Cpus) {
+    HostSetProcessors(Cpus);
+    WorkPoolInit(&gWorkPool);
+}
+
+// --------------------------------------------------------------------------
+// DECOMPRESSION
+// --------------------------------------------------------------------------
+
+#define TEST_CORPUS_SIZE  (12 * 1000 * 1000)  // Spans two 8MB legacy LZ4 blocks
+#define TEST_PART_SIZE    "1000000"           // Input per frame of the multi-frame cases
+
+// A skippable frame, as zstd and lz4 both define it, with a 4-byte payload
+#define TEST_SKIPPABLE    "printf '\\120\\052\\115\\030\\004\\000\\000\\000pxs!'"
+
+typedef struct {
+    CONST CHAR8 *Name;
+    CONST CHAR8 *Tool;      // "lz4" or "zstd", for the skip message
+    CONST CHAR8 *Command;   // sh script: $IN to $OUT, scratch in $DIR
+    BOOLEAN     Splits;     // Decodes across CPUs when it can
+} STREAM_CASE;
+
+// Runs of text-like records, zeroes, noise and a repeating binary structure,
+// so encoders use literals, matches, RLE and stored blocks
+STATIC UINT8 *BuildCorpus(IN UINTN Size) {
+    STATIC CONST CHAR8 *Words[] = {
+        "kernel", "initrd", "module", "segment", "page", "frame", "block", "entry", "the", "of",
+        "boot", "loader", "memory", "map", "table", "node", "cpu", "vector", "0x", "=", "\n",
+    };
+    UINT8 *Data = TestAlloc(Size);
+    UINT64 Seed = 0x9e3779b97f4a7c15ULL;
+    UINTN Pos = 0;
+
+    while (Pos < Size) {
+        Seed ^= Seed << 13;
+        Seed ^= Seed >> 7;
+        Seed ^= Seed << 17;
+        UINTN Run = MIN(Size - Pos, 4096 + (Seed >> 40) % 60000);
+        UINTN End = Pos + Run;
+
+        switch (Seed % 10) {
+            case 0:
+                SetMem(Data + Pos, Run, 0);
+                Pos = End;
+                break;
+            case 1:
+                for (; Pos < End; Pos++) {
+                    Seed ^= Seed << 13;
+                    Seed ^= Seed >> 7;
+                    Seed ^= Seed << 17;
+                    Data[Pos] = (UINT8)Seed;
+                }
+                break;
+            case 2:
+            case 3:
+                for (; Pos < End; Pos++) {
+                    Data[Pos] = (UINT8)((Pos % 48) < 8 ? Pos / 48 : (Pos % 48) * 5);
+                }
+                break;
+            default:
+                while (Pos < End) {
+                    Seed ^= Seed << 13;
+                    Seed ^= Seed >> 7;
+                    Seed ^= Seed << 17;
+                    CONST CHAR8 *Word = Words[Seed % ARRAY_SIZE(Words)];
+                    UINTN Length = MIN(strlen(Word), End - Pos);
+                    CopyMem(Data + Pos, Word, Length);
+                    Pos += Length;
+                    if (Pos < End) Data[Pos++] = ' ';
+                }
+                break;
+        }
+    }
+    return Data;
+}
+
+// Compress the corpus with a reference tool; NULL if it is not there
+STATIC UINT8 *RunTool(IN CONST STREAM_CASE *Case, OUT UINTN *Size) {
+    CHAR8 Script[1024];
+
+    snprintf(Script, sizeof(Script),
+             "DIR=%s; IN=$DIR/corpus; OUT=$DIR/out; LZ4=${LZ4:-lz4}; ZSTD=${ZSTD:-zstd}; "
+             "command -v \"$%s\" >/dev/null || exit 127; rm -f \"$OUT\"; ( %s ) 2>/dev/null",
+             mTempDir, strcmp(Case->Tool, "lz4") == 0 ? "LZ4" : "ZSTD", Case->Command);
+    if (system(Script) != 0) return NULL;
+
+    CHAR8 Path[256];
+    snprintf(Path, sizeof(Path), "%s/out", mTempDir);
+    return TestReadFile(Path, Size);
+}
+
+// Whole-image load as for an initrd or module, with the digest of the file
+STATIC VOID CheckStreamLoad(IN CONST UINT8 *Plain, IN UINTN PlainSize, IN CONST UINT8 *Packed, IN UINTN PackedSize) {
+    UINT8 Expected[PXS_SHA256_DIGEST_SIZE];
+    UINT8 Digest[PXS_SHA256_DIGEST_SIZE];
+    VOID *Buffer;
+    UINT64 Size;
+
+    EFI_STATUS Status = LoadImageFile(HostRootDir(), L"image", EFI_PAGE_SIZE, EfiLoaderData, &Buffer, &Size, Digest);
+    CHECK(!EFI_ERROR(Status));
+    BOOLEAN Same = (Size == PlainSize && memcmp(Buffer, Plain, PlainSize) == 0);
+    gBS->FreePages((EFI_PHYSICAL_ADDRESS)Buffer, EFI_SIZE_TO_PAGES(Size));
+    CHECK(Same);
+
+    TestSha256(Packed, PackedSize, NULL, Expected);
+    CHECK(memcmp(Digest, Expected, sizeof(Digest)) == 0);
+}
+
+// Reads of assorted sizes in increasing order, as the ELF loader makes them,
+// then one behind the decoder, which restarts it
+STATIC VOID CheckStreamReads(IN CONST STREAM_CASE *Case, IN UINTN Cpus, IN CONST UINT8 *Plain, IN UINTN PlainSize) {
+    STATIC CONST UINT64 Sizes[] = { 64, 4032, 3 * SIZE_1MB + 7, 100, 5 * SIZE_1MB, 1, 0 };
+    PXS_STREAM Stream;
+    UINT8 *Buffer = TestAlloc(PlainSize);
+    UINT64 Offset = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    CHECK(!EFI_ERROR(StreamOpen(HostRootDir(), L"image", &Stream)));
+    for (UINTN i = 0; i < ARRAY_SIZE(Sizes) && !EFI_ERROR(Status); i++) {
+        UINT64 Size = (Sizes[i] == 0) ? PlainSize - Offset : MIN(Sizes[i], PlainSize - Offset);
+        Status = StreamReadAt(&Stream, Offset, Buffer + Offset, Size);
+        Offset += Size;
+    }
+    if (!EFI_ERROR(Status)) {
+        Status = StreamReadAt(&Stream, PlainSize / 3, Buffer, 4096);
+    }
+    UINTN Parallel = Stream.Parallel;
+    UINTN InCap = Stream.InCap;
+    StreamClose(&Stream);
+
+    BOOLEAN Same = (memcmp(Buffer + 4096, Plain + 4096, PlainSize - 4096) == 0 &&
+                    memcmp(Buffer, Plain + PlainSize / 3, 4096) == 0);
+    free(Buffer);
+    CHECK(!EFI_ERROR(Status));
+    CHECK(Same);
+
+    // Images that do not split are never read ahead further than a unit
+    CHECK((Parallel > 0) == (Case->Splits && Cpus > 1));
+    CHECK(Parallel > 0 || InCap <= 5 * SIZE_1MB);
+}
+
+STATIC VOID CheckStreamCase(IN CONST STREAM_CASE *Case, IN CONST UINT8 *Plain, IN UINTN PlainSize) {
+    UINTN PackedSize;
+    UINT8 *Packed = RunTool(Case, &PackedSize);
+
+    if (!Packed) {
+        TestSkipped(Case->Tool);
+        return;
+    }
+    HostAddFile(L"image", Packed, PackedSize);
+
+    UINTN Failed = mFailed;
+    for (UINTN Cpus = 1; Cpus <= TEST_CPUS && mFailed == Failed; Cpus += TEST_CPUS - 1) {
+        TestSetCpus(Cpus);
+        CheckStreamLoad(Plain, PlainSize, Packed, PackedSize);
+        if (mFailed == Failed) CheckStreamReads(Case, Cpus, Plain, PlainSize);
+    }
+    TestSetCpus(1);
+    HostAddFile(L"image", NULL, 0);
+    free(Packed);
+    if (mFailed == Failed) TestPassed();
+}
+
+// Blocks of an independent-block frame are taken to be full until the end
+// mark; one that is not makes the loader fall back to decoding in order
+STATIC VOID CheckShortBlock(IN CONST UINT8 *Plain) {
+    STATIC CONST STREAM_CASE Case = {
+        "lz4/short-block", "lz4",
+        "head -c 100000 \"$IN\" > \"$DIR/a\" && \"$LZ4\" -q -c -B4 --no-frame-crc \"$DIR/a\" > \"$DIR/a.lz4\" && "
+        "\"$LZ4\" -q -c -B4 --no-frame-crc \"$IN\" > \"$DIR/b.lz4\" && "
+        "a=$(wc -c < \"$DIR/a.lz4\") && { head -c $((a - 4)) \"$DIR/a.lz4\"; tail -c +8 \"$DIR/b.lz4\"; } > \"$OUT\"",
+        TRUE
+    };
+    UINTN PlainSize = 100000 + TEST_CORPUS_SIZE;
+    UINT8 *Spliced;
+    UINTN PackedSize;
+    UINT8 *Packed;
+    PXS_STREAM Stream;
+
+    if (!TestSelected(Case.Name)) return;
+    Spliced = TestAlloc(PlainSize);
+    Packed = RunTool(&Case, &PackedSize);
+    if (!Packed) {
+        free(Spliced);
+        TestSkipped(Case.Tool);
+        return;
+    }
+    CopyMem(Spliced, Plain, 100000);
+    CopyMem(Spliced + 100000, Plain, TEST_CORPUS_SIZE);
+    HostAddFile(L"image", Packed, PackedSize);
+    TestSetCpus(TEST_CPUS);
+
+    UINTN Failed = mFailed;
+    CheckStreamLoad(Spliced, PlainSize, Packed, PackedSize);
+    if (mFailed == Failed && !EFI_ERROR(StreamOpen(HostRootDir(), L"image", &Stream))) {
+        UINT8 *Buffer = TestAlloc(PlainSize);
+        EFI_STATUS Status = StreamReadAt(&Stream, 0, Buffer, PlainSize);
+        BOOLEAN Serial = Stream.Serial;
+        StreamClose(&Stream);
+        if (EFI_ERROR(Status) || !Serial || memcmp(Buffer, Spliced, PlainSize) != 0) {
+            fprintf(stderr, "FAIL %s: spliced stream read wrong\n", mTestName);
+            mFailed++;
+        }
+        free(Buffer);
+    }
+
+    TestSetCpus(1);
+    HostAddFile(L"image", NULL, 0);
+    free(Packed);
+    free(Spliced);
+    if (mFailed == Failed) TestPassed();
+}
+
+STATIC VOID RunDecompressTests(VOID) {
+    STATIC CONST STREAM_CASE Cases[] = {
+        // One frame with its size: decoded in order, overlapping the reads
+        { "zstd/frame",            "zstd", "\"$ZSTD\" -q -c -3 \"$IN\" > \"$OUT\"",                         FALSE },
+        { "zstd/frame-nocheck",    "zstd", "\"$ZSTD\" -q -c -12 --no-check \"$IN\" > \"$OUT\"",             FALSE },
+        { "zstd/frame-nosize",     "zstd", "\"$ZSTD\" -q -c -1 < \"$IN\" > \"$OUT\"",                       FALSE },
+        // Frames of 1MB each, with a skippable frame between every two
+        { "zstd/frames",           "zstd",
+          "split -b " TEST_PART_SIZE " \"$IN\" \"$DIR/part.\" && for p in \"$DIR\"/part.*; do "
+          "\"$ZSTD\" -q -c -3 \"$p\" && " TEST_SKIPPABLE "; done > \"$OUT\"; rm -f \"$DIR\"/part.*", TRUE },
+        { "zstd/frames-nosize",    "zstd",
+          "split -b " TEST_PART_SIZE " \"$IN\" \"$DIR/part.\" && for p in \"$DIR\"/part.*; do "
+          "\"$ZSTD\" -q -c -3 < \"$p\"; done > \"$OUT\"; rm -f \"$DIR\"/part.*",                           FALSE },
+        { "lz4/blocks-64K",        "lz4",  "\"$LZ4\" -q -c -B4 \"$IN\" > \"$OUT\"",                         TRUE },
+        { "lz4/blocks-1M-sized",   "lz4",  "\"$LZ4\" -q -c -9 -B6 -BX --content-size \"$IN\" > \"$OUT\"",    TRUE },
+        { "lz4/linked",            "lz4",  "\"$LZ4\" -q -c -B5 -BD \"$IN\" > \"$OUT\"",                     FALSE },
+        { "lz4/linked-sized",      "lz4",  "\"$LZ4\" -q -c -B5 -BD --content-size \"$IN\" > \"$OUT\"",      FALSE },
+        { "lz4/linked-frames",     "lz4",
+          "split -b " TEST_PART_SIZE " \"$IN\" \"$DIR/part.\" && for p in \"$DIR\"/part.*; do "
+          "\"$LZ4\" -q -c -B4 -BD --content-size \"$p\"; done > \"$OUT\"; rm -f \"$DIR\"/part.*",           TRUE },
+        // 8MB legacy blocks: split for a whole-image load, larger than any read
+        { "lz4/legacy",            "lz4",  "\"$LZ4\" -q -c -l \"$IN\" > \"$OUT\"",                          FALSE },
+    };
+    UINT8 *Plain = BuildCorpus(TEST_CORPUS_SIZE);
+    CHAR8 Path[256];
+
+    snprintf(Path, sizeof(Path), "%s/corpus", mTempDir);
+    TestWriteFile(Path, Plain, TEST_CORPUS_SIZE);
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        if (TestSelected(Cases[i].Name)) CheckStreamCase(&Cases[i], Plain, TEST_CORPUS_SIZE);
+    }
+    CheckShortBlock(Plain);
+
+    unlink(Path);
+    free(Plain);
+}
+
+// --------------------------------------------------------------------------
+// FILE READER
+// --------------------------------------------------------------------------
+
+#define TEST_READ_CHUNKS  4
+#define TEST_READ_SIZE    ((TEST_READ_CHUNKS - 1) * READ_CHUNK + READ_CHUNK / 2 + 7)
+#define TEST_READ_SHORT   (READ_CHUNK / 3 + 1)   // What ReadEx completes of each chunk
+
+// ReadEx stops short on every chunk. A scan stops partway into its first
+// chunk before the digest drains the rest, then the whole file is read in
+// place: each chunk is finished once, hashed once and accounted as the
+// ReadEx plus the one Read() that completes it.
+STATIC VOID CheckReaderShortReadEx(VOID) {
+    UINT8 Expected[PXS_SHA256_DIGEST_SIZE];
+    UINT8 Digest[PXS_SHA256_DIGEST_SIZE];
+    PXS_TIMING_ENTRY Stage;
+    PXS_READER Reader;
+    PXS_SHA256 Ctx;
+    EFI_FILE_HANDLE File;
+    UINT8 *Data = BuildCorpus(TEST_READ_SIZE);
+    UINT8 *Buffer = TestAlloc(TEST_READ_SIZE);
+
+    HostAddFile(L"reader", Data, TEST_READ_SIZE);
+    HostSetReadEx(TEST_READ_SHORT);
+    EFI_STATUS Status = HostRootDir()->Open(HostRootDir(), &File, L"reader", EFI_FILE_MODE_READ, 0);
+    HostSetReadEx(0);
+    CHECK(!EFI_ERROR(Status));
+
+    SetMem(&Stage, sizeof(Stage), 0);
+    gActiveStage = &Stage;
+    ReaderOpen(File, TEST_READ_SIZE, &Reader);
+    BOOLEAN Async = Reader.Async;
+    ReaderStartHash(&Reader, &Ctx);
+    EFI_STATUS NextStatus = ReaderReadNext(&Reader, 0, Buffer, SIZE_4KB);
+    BOOLEAN NextSame = (memcmp(Buffer, Data, SIZE_4KB) == 0);
+    EFI_STATUS HashStatus = ReaderFinishHash(&Reader, Digest);
+    PXS_TIMING_ENTRY Scan = Stage;
+
+    EFI_STATUS ReadStatus = ReaderReadAt(&Reader, 0, Buffer, TEST_READ_SIZE);
+    BOOLEAN ReadSame = (memcmp(Buffer, Data, TEST_READ_SIZE) == 0);
+    gActiveStage = NULL;
+    ReaderClose(&Reader);
+    File->Close(File);
+    TestSha256(Data, TEST_READ_SIZE, NULL, Expected);
+    HostAddFile(L"reader", NULL, 0);
+    free(Buffer);
+    free(Data);
+
+    CHECK(Async);
+    CHECK(!EFI_ERROR(NextStatus) && NextSame);
+    CHECK(!EFI_ERROR(HashStatus));
+    CHECK(memcmp(Digest, Expected, sizeof(Digest)) == 0);
+    CHECK(Scan.BytesRead == TEST_READ_SIZE && Scan.ReadCalls == 2 * TEST_READ_CHUNKS);
+    CHECK(!EFI_ERROR(ReadStatus) && ReadSame);
+    CHECK(Stage.BytesRead == 2 * TEST_READ_SIZE && Stage.ReadCalls == 4 * TEST_READ_CHUNKS);
+    TestPassed();
+}
+
+STATIC VOID RunReaderTests(VOID) {
+    if (TestSelected("reader/short-readex")) CheckReaderShortReadEx();
+}
+
+// --------------------------------------------------------------------------
+// INITRD INDEX
+// --------------------------------------------------------------------------
+
+#define TEST_CPIO_SIZE  SIZE_4KB
+
+// Append a newc member; Magic is "070701" or "070702" (with checksum)
+STATIC VOID TestCpioMember(IN OUT UINT8 *Archive, IN OUT UINTN *Offset, IN CONST CHAR8 *Magic,
+                           IN CONST CHAR8 *Name, IN UINT32 Mode, IN CONST CHAR8 *Data) {
+    UINTN NameSize = strlen(Name) + 1;
+    UINTN DataSize = strlen(Data);
+    CHAR8 *Header = (CHAR8 *)Archive + *Offset;
+
+    // magic ino mode uid gid nlink mtime filesize devmajor devminor rdevmajor rdevminor namesize check
+    snprintf(Header, 111, "%s%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+             Magic, (UINT32)*Offset, Mode, 0, 0, 1, 0x5f5e1000, (UINT32)DataSize, 0, 0, 0, 0, (UINT32)NameSize, 0);
+    *Offset += 110;
+    CopyMem(Archive + *Offset, Name, NameSize);
+    *Offset = ALIGN_VALUE(*Offset + NameSize, 4);
+    CopyMem(Archive + *Offset, Data, DataSize);
+    *Offset = ALIGN_VALUE(*Offset + DataSize, 4);
+}
+
+// Two concatenated archives, the second after zero padding and followed by
+// junk, with "./" and "/" prefixes and paths given twice
+STATIC VOID CheckCpioIndex(VOID) {
+    STATIC CONST struct {
+        CONST CHAR8 *Path;
+        UINT32      Mode;
+        CONST CHAR8 *Data;
+    } Expected[] = {
+        { "bin",          PXS_INITRD_S_IFDIR | 0755,     "" },
+        { "bin/sh",       PXS_INITRD_S_IFLNK | 0777, "busybox" },
+        { "bin/sh.static", PXS_INITRD_S_IFREG | 0755,   "\x7f" "ELF" },
+        { "etc/hostname", PXS_INITRD_S_IFREG | 0644,    "pxs-2\n" },
+        { "init",         PXS_INITRD_S_IFREG | 0755,    "#!/bin/sh\nexec /sbin/init\n" },
+        { "lib/modules",  PXS_INITRD_S_IFDIR | 0755,     "" },
+    };
+    UINT8 *Archive = TestAlloc(TEST_CPIO_SIZE);
+    PXS_INITRD_FILE Entries[16];
+    UINTN Size = 0;
+    UINT32 Count;
+
+    TestCpioMember(Archive, &Size, "070701", ".", PXS_INITRD_S_IFDIR | 0755, "");
+    TestCpioMember(Archive, &Size, "070701", "./init", PXS_INITRD_S_IFREG | 0755, "#!/bin/sh\n");
+    TestCpioMember(Archive, &Size, "070701", "bin", PXS_INITRD_S_IFDIR | 0755, "");
+    TestCpioMember(Archive, &Size, "070701", "bin/sh.static", PXS_INITRD_S_IFREG | 0755, "\x7f" "ELF");
+    TestCpioMember(Archive, &Size, "070701", "bin/sh", PXS_INITRD_S_IFLNK | 0777, "busybox");
+    TestCpioMember(Archive, &Size, "070701", "/etc/hostname", PXS_INITRD_S_IFREG | 0644, "pxs\n");
+    TestCpioMember(Archive, &Size, "070701", "TRAILER!!!", 0, "");
+    Size = ALIGN_VALUE(Size, 512);
+    TestCpioMember(Archive, &Size, "070702", "./etc/hostname", PXS_INITRD_S_IFREG | 0644, "pxs-2\n");
+    TestCpioMember(Archive, &Size, "070702", "lib/modules", PXS_INITRD_S_IFDIR | 0755, "");
+    TestCpioMember(Archive, &Size, "070702", "init", PXS_INITRD_S_IFREG | 0755, "#!/bin/sh\nexec /sbin/init\n");
+    TestCpioMember(Archive, &Size, "070702", "TRAILER!!!", 0, "");
+    CopyMem(Archive + Size, "junk", 4);
+    Size += 4;
+
+    EFI_STATUS Status = CpioBuildIndex(Archive, Size, NULL, 0, &Count);
+    CHECK(Status == EFI_SUCCESS && Count >= ARRAY_SIZE(Expected) && Count <= ARRAY_SIZE(Entries));
+    CHECK(CpioBuildIndex(Archive, Size, Entries, ARRAY_SIZE(Entries), &Count) == EFI_SUCCESS);
+    CHECK(Count == ARRAY_SIZE(Expected));
+    for (UINTN i = 0; i < Count; i++) {
+        CONST CHAR8 *Path = (CONST CHAR8 *)Archive + Entries[i].PathOffset;
+        CHECK(Entries[i].PathLength == strlen(Expected[i].Path) && strcmp(Path, Expected[i].Path) == 0);
+        CHECK(Entries[i].Mode == Expected[i].Mode);
+        CHECK(Entries[i].DataSize == strlen(Expected[i].Data) && (Entries[i].DataOffset & 3) == 0);
+        CHECK(memcmp(Archive + Entries[i].DataOffset, Expected[i].Data, Entries[i].DataSize) == 0);
+    }
+
+    // Before deduplication there are more entries than Capacity
+    CHECK(CpioBuildIndex(Archive, Size, Entries, ARRAY_SIZE(Expected), &Count) == EFI_BUFFER_TOO_SMALL);
+    // Cut inside the name of the second member, which starts at 112
+    CHECK(CpioBuildIndex(Archive, 112 + 110 + 3, Entries, ARRAY_SIZE(Entries), &Count) == EFI_VOLUME_CORRUPTED);
+    CHECK(CpioBuildIndex(Archive + 4, Size - 4, Entries, ARRAY_SIZE(Entries), &Count) == EFI_UNSUPPORTED);
+    free(Archive);
+    TestPassed();
+}
+
+STATIC VOID RunInitrdTests(VOID) {
+    if (TestSelected("initrd/cpio-index")) CheckCpioIndex();
+}
+
+// --------------------------------------------------------------------------
+// SHA-256
+// --------------------------------------------------------------------------
+
+typedef struct {
+    CONST CHAR8 *Message;
+    UINTN       Repeat;     // Copies of Message hashed
+    CONST CHAR8 *Digest;    // Hex, from FIPS 180-2 and NIST's example vectors
+} SHA256_VECTOR;
+
+STATIC BOOLEAN TestHexIs(IN CONST UINT8 *Digest, IN CONST CHAR8 *Hex) {
+    CHAR8 Text[2 * PXS_SHA256_DIGEST_SIZE + 1];
+    for (UINTN i = 0; i < PXS_SHA256_DIGEST_SIZE; i++) {
+        snprintf(Text + 2 * i, 3, "%02x", Digest[i]);
+    }
+    return strcmp(Text, Hex) == 0;
+}
+
+// Known answers in one update and a byte at a time, then a stream of awkward
+// update sizes against the portable function, which the vectors pin down
+STATIC VOID CheckSha256(IN PXS_SHA256_BLOCKS Blocks) {
+    STATIC CONST SHA256_VECTOR Vectors[] = {
+        { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+          "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+        { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    };
+    PXS_SHA256 Ctx;
+    UINT8 Digest[PXS_SHA256_DIGEST_SIZE];
+    UINT8 Expected[PXS_SHA256_DIGEST_SIZE];
+
+    for (UINTN v = 0; v < ARRAY_SIZE(Vectors); v++) {
+        UINTN Length = strlen(Vectors[v].Message);
+        UINTN Size = Length * Vectors[v].Repeat;
+        UINT8 *Message = TestAlloc(Size);
+        for (UINTN r = 0; r < Vectors[v].Repeat; r++) CopyMem(Message + r * Length, Vectors[v].Message, Length);
+
+        TestSha256(Message, Size, Blocks, Digest);
+        BOOLEAN Whole = TestHexIs(Digest, Vectors[v].Digest);
+        Sha256Init(&Ctx, Blocks);
+        for (UINTN i = 0; i < Size; i++) Sha256Update(&Ctx, Message + i, 1);
+        Sha256Final(&Ctx, Digest);
+        BOOLEAN Bytewise = TestHexIs(Digest, Vectors[v].Digest);
+        free(Message);
+        CHECK(Whole);
+        CHECK(Bytewise);
+    }
+
+    // Every length across several blocks, so each padding case is hit
+    UINT8 *Data = BuildCorpus(SIZE_64KB);
+    BOOLEAN Lengths = TRUE;
+    for (UINTN Size = 0; Lengths && Size <= 3 * PXS_SHA256_BLOCK_SIZE; Size++) {
+        TestSha256(Data, Size, Blocks, Digest);
+        TestSha256(Data, Size, Sha256BlocksGeneric, Expected);
+        Lengths = memcmp(Digest, Expected, sizeof(Digest)) == 0;
+    }
+    Sha256Init(&Ctx, Blocks);
+    for (UINTN Pos = 0, Step = 1; Pos < SIZE_64KB; Pos += Step, Step = Step * 7 % 1031) {
+        Sha256Update(&Ctx, Data + Pos, MIN(Step, SIZE_64KB - Pos));
+    }
+    Sha256Final(&Ctx, Digest);
+    TestSha256(Data, SIZE_64KB, Sha256BlocksGeneric, Expected);
+    free(Data);
+    CHECK(Lengths);
+    CHECK(memcmp(Digest, Expected, sizeof(Digest)) == 0);
+    TestPassed();
+}
+
+STATIC VOID RunSha256Tests(VOID) {
+    CONST CHAR16 *Name;
+    PXS_SHA256_BLOCKS Selected = Sha256SelectBlocks(&Name);
+
+    if (TestSelected("sha256/generic")) CheckSha256(Sha256BlocksGeneric);
+    if (TestSelected("sha256/sha-ni")) {
+        if (Selected == Sha256BlocksGeneric) TestSkipped("no SHA extensions on this CPU");
+        else CheckSha256(Selected);
+    }
+}
+
+// --------------------------------------------------------------------------
+// RELOCATION
+// --------------------------------------------------------------------------
+
+// Free memory for the slot search, in an unused part of the address space
+#define TEST_KASLR_WINDOW  0x600000000000ULL
+
+#define TEST_DYN_DATA      0x1000   // Link address (and file offset) of the pointer words
+#define TEST_DYN_WORDS     256
+#define TEST_DYN_FILE      (TEST_DYN_DATA + TEST_DYN_WORDS * 8)
+#define TEST_DYN_MEMORY    (TEST_DYN_FILE + 0x1800)
+#define TEST_DYN_ENTRY     0x1010
+
+// A position independent kernel linked at 0: headers, a dynamic section and
+// RELA and RELR tables in the first page, then words that point at themselves
+// where a relocation names them and hold a marker elsewhere. The RELR table
+// has an address entry, a bitmap reaching bit 63, an empty bitmap that only
+// skips 63 words, and a second address entry.
+STATIC UINT8 *BuildDyn(OUT BOOLEAN *Relr, OUT UINT64 *Rela) {
+    STATIC CONST UINT64 RelrTable[] = {
+        TEST_DYN_DATA,                                                  // Word 0
+        (((1ULL << 0) | (1ULL << 1) | (1ULL << 3) | (1ULL << 62)) << 1) | 1, // Words 1, 2, 4 and 63
+        1,                                                              // Skip words 64..126
+        (((1ULL << 0) | (1ULL << 62)) << 1) | 1,                        // Words 127 and 189
+        TEST_DYN_DATA + 200 * 8,                                        // Word 200
+        ((1ULL << 0) << 1) | 1,                                         // Word 201
+    };
+    STATIC CONST UINTN Marked[] = { 0, 1, 2, 4, 63, 127, 189, 200, 201 };
+    UINT8 *Image = TestAlloc(TEST_DYN_FILE);
+    Elf64_Ehdr *Ehdr = (Elf64_Ehdr *)Image;
+    Elf64_Phdr *Phdr = (Elf64_Phdr *)(Ehdr + 1);
+    Elf64_Dyn *Dynamic = (Elf64_Dyn *)(Image + 0x200);
+    Elf64_Rela *RelaTable = (Elf64_Rela *)(Image + 0x300);
+    UINT64 *Words = (UINT64 *)(Image + TEST_DYN_DATA);
+
+    Ehdr->e_ident[EI_MAG0] = ELFMAG0;
+    Ehdr->e_ident[EI_MAG1] = ELFMAG1;
+    Ehdr->e_ident[EI_MAG2] = ELFMAG2;
+    Ehdr->e_ident[EI_MAG3] = ELFMAG3;
+    Ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+    Ehdr->e_type = ET_DYN;
+    Ehdr->e_machine = EM_X86_64;
+    Ehdr->e_entry = TEST_DYN_ENTRY;
+    Ehdr->e_phoff = sizeof(Elf64_Ehdr);
+    Ehdr->e_phentsize = sizeof(Elf64_Phdr);
+    Ehdr->e_phnum = 2;
+
+    Phdr[0].p_type = PT_LOAD;
+    Phdr[0].p_flags = PF_R | PF_W | PF_X;
+    Phdr[0].p_filesz = TEST_DYN_FILE;
+    Phdr[0].p_memsz = TEST_DYN_MEMORY;
+    Phdr[0].p_align = SIZE_2MB;
+    Phdr[1].p_type = PT_DYNAMIC;
+    Phdr[1].p_flags = PF_R;
+    Phdr[1].p_offset = Phdr[1].p_vaddr = Phdr[1].p_paddr = 0x200;
+    Phdr[1].p_filesz = Phdr[1].p_memsz = 7 * sizeof(Elf64_Dyn);
+
+    Dynamic[0] = (Elf64_Dyn){ DT_RELA, 0x300 };
+    Dynamic[1] = (Elf64_Dyn){ DT_RELASZ, 2 * sizeof(Elf64_Rela) };
+    Dynamic[2] = (Elf64_Dyn){ DT_RELAENT, sizeof(Elf64_Rela) };
+    Dynamic[3] = (Elf64_Dyn){ DT_RELR, 0x400 };
+    Dynamic[4] = (Elf64_Dyn){ DT_RELRSZ, sizeof(RelrTable) };
+    Dynamic[5] = (Elf64_Dyn){ DT_RELRENT, sizeof(UINT64) };
+    Dynamic[6] = (Elf64_Dyn){ DT_NULL, 0 };
+    CopyMem(Image + 0x400, RelrTable, sizeof(RelrTable));
+    RelaTable[0] = (Elf64_Rela){ TEST_DYN_DATA + 210 * 8, R_X86_64_RELATIVE, TEST_DYN_ENTRY };
+    RelaTable[1] = (Elf64_Rela){ TEST_DYN_DATA + 211 * 8, R_X86_64_RELATIVE, TEST_DYN_FILE };
+
+    SetMem(Relr, TEST_DYN_WORDS * sizeof(BOOLEAN), 0);
+    SetMem(Rela, TEST_DYN_WORDS * sizeof(UINT64), 0);
+    for (UINTN i = 0; i < TEST_DYN_WORDS; i++) Words[i] = 0xA5A5A5A5A5A50000ULL + i;
+    for (UINTN i = 0; i < ARRAY_SIZE(Marked); i++) {
+        Words[Marked[i]] = TEST_DYN_DATA + Marked[i] * 8;
+        Relr[Marked[i]] = TRUE;
+    }
+    Rela[210] = TEST_DYN_ENTRY;
+    Rela[211] = TEST_DYN_FILE;
+    return Image;
+}
+
+// Load it as the kernel, identity mapped and then under loader page tables
+// with a random virtual base, and check every word
+STATIC VOID CheckRelrKernel(VOID) {
+    BOOLEAN Relr[TEST_DYN_WORDS];
+    UINT64 Rela[TEST_DYN_WORDS];
+    UINT8 *Image = BuildDyn(Relr, Rela);
+    EFI_MEMORY_DESCRIPTOR Map = { EfiConventionalMemory, TEST_KASLR_WINDOW, 0, EFI_SIZE_TO_PAGES(SIZE_64MB), EFI_MEMORY_WB };
+    PXS_CONFIG *Config = TestAlloc(sizeof(PXS_CONFIG));
+    UINTN Failed = mFailed;
+
+    ConfigDefaults(Config);
+    StrCpyS(Config->KernelPath, 256, L"kernel.elf");
+    HostAddFile(L"kernel.elf", Image, TEST_DYN_FILE);
+    HostSetMemoryMap(&Map, 1);
+
+    for (UINTN Paging = 0; Paging < 2 && mFailed == Failed; Paging++) {
+        EFI_PHYSICAL_ADDRESS Entry;
+        UINT64 Base, Size, RunBase;
+        PXS_KERNEL_SEGMENT *Segments;
+        UINTN SegmentCount;
+
+        Config->PagingEnabled = (BOOLEAN)Paging;
+        EFI_STATUS Status = LoadElfKernel(HostRootDir(), Config, &Entry, &Base, &Size, &RunBase,
+                                          &Segments, &SegmentCount, NULL);
+        if (EFI_ERROR(Status)) {
+            fprintf(stderr, "FAIL %s: LoadElfKernel (0x%llx)\n", mTestName, (unsigned long long)Status);
+            mFailed++;
+            break;
+        }
+
+        CONST UINT64 *Words = (CONST UINT64 *)(Base + TEST_DYN_DATA);
+        BOOLEAN Same = Base >= TEST_KASLR_WINDOW && Base + TEST_DYN_MEMORY <= TEST_KASLR_WINDOW + SIZE_64MB &&
+                       (Base & (SIZE_2MB - 1)) == 0 && Entry == RunBase + TEST_DYN_ENTRY && SegmentCount == 1 &&
+                       Segments[0].VirtualAddress == RunBase && Segments[0].PhysicalAddress == Base;
+        Same = Same && (Paging ? (RunBase >= KASLR_VIRT_MIN && RunBase + TEST_DYN_MEMORY <= KASLR_VIRT_MAX &&
+                                  (RunBase & (SIZE_2MB - 1)) == 0)
+                               : RunBase == Base);
+        for (UINTN i = 0; Same && i < TEST_DYN_WORDS; i++) {
+            if (Relr[i]) Same = Words[i] == RunBase + TEST_DYN_DATA + i * 8;
+            else if (Rela[i]) Same = Words[i] == RunBase + Rela[i];
+            else Same = Words[i] == 0xA5A5A5A5A5A50000ULL + i;
+        }
+        for (UINT64 Offset = TEST_DYN_FILE; Same && Offset < TEST_DYN_MEMORY; Offset++) {
+            Same = ((CONST UINT8 *)(UINTN)Base)[Offset] == 0;
+        }
+        gBS->FreePages(Base, EFI_SIZE_TO_PAGES(TEST_DYN_MEMORY));
+        FreePool(Segments);
+        if (!Same) {
+            fprintf(stderr, "FAIL %s: wrong image %s loader paging\n", mTestName, Paging ? "with" : "without");
+            mFailed++;
+        }
+    }
+
+    HostSetMemoryMap(NULL, 0);
+    HostAddFile(L"kernel.elf", NULL, 0);
+    free(Config);
+    free(Image);
+    if (mFailed == Failed) TestPassed();
+}
+
+STATIC VOID RunRelocationTests(VOID) {
+    if (TestSelected("elf/relr-kernel")) CheckRelrKernel();
+}
+
+// --------------------------------------------------------------------------
+// FIRMWARE TABLES
+// --------------------------------------------------------------------------
+
+// Below 4 GiB, so the 32-bit RSDT and SMBIOS 2 pointers can reach it
+STATIC UINT8 *TestAllocLow(IN UINTN Size) {
+    VOID *Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (Memory == MAP_FAILED) {
+        fprintf(stderr, "test: cannot map low memory\n");
+        exit(1);
+    }
+    return Memory;
+}
+
+STATIC VOID TestChecksum(IN UINT8 *Data, IN UINTN Length, IN UINTN Field) {
+    UINT8 Sum = 0;
+    Data[Field] = 0;
+    for (UINTN i = 0; i < Length; i++) Sum += Data[i];
+    Data[Field] = (UINT8)(0 - Sum);
+}
+
+STATIC UINT8 *TestAcpiTable(IN UINT8 *Memory, IN OUT UINTN *Offset, IN CONST CHAR8 *Signature, IN UINT32 Length,
+                            IN UINT8 Revision) {
+    UINT8 *Table = Memory + *Offset;
+    CopyMem(Table, Signature, 4);
+    CopyMem(Table + 4, &Length, sizeof(Length));
+    Table[8] = Revision;
+    for (UINT32 i = 36; i < Length; i++) Table[i] = (UINT8)(i * 13 + Revision);
+    *Offset += ALIGN_VALUE(Length, 16);
+    return Table;
+}
+
+typedef struct {
+    UINT8  *Table;
+    UINT16 Instance;
+    UINT8  Flags;
+} ACPI_EXPECTED;
+
+// An RSDP pointing at both an XSDT and an RSDT listing an APIC, two SSDTs
+// (one with a bad checksum), a FADT with a DSDT and FACS, and an HPET.
+// Without ExtendedChecksum the RSDP's 2.0 part is invalid, leaving the RSDT.
+STATIC VOID CheckAcpiIndex(IN BOOLEAN ExtendedChecksum) {
+    UINT8 *Memory = TestAllocLow(SIZE_64KB);
+    UINTN Offset = 64;
+    UINT8 *Rsdp = Memory;
+    UINT8 *Listed[5];
+    PXS_ACPI_TABLE Tables[16];
+    UINT32 Count;
+
+    UINT8 *Facs = TestAcpiTable(Memory, &Offset, "FACS", 64, 0);
+    Facs[32] = 2;
+    UINT8 *Dsdt = TestAcpiTable(Memory, &Offset, "DSDT", 1000, 2);
+    TestChecksum(Dsdt, 1000, 9);
+    Listed[0] = TestAcpiTable(Memory, &Offset, "APIC", 300, 5);
+    Listed[1] = TestAcpiTable(Memory, &Offset, "SSDT", 400, 2);
+    Listed[2] = TestAcpiTable(Memory, &Offset, "FACP", 276, 6);
+    Listed[3] = TestAcpiTable(Memory, &Offset, "SSDT", 500, 2);
+    Listed[4] = TestAcpiTable(Memory, &Offset, "HPET", 56, 1);
+    UINT64 Address = (UINT64)(UINTN)Facs;
+    CopyMem(Listed[2] + 132, &Address, sizeof(Address));
+    UINT32 Address32 = (UINT32)(UINTN)Dsdt;
+    CopyMem(Listed[2] + 40, &Address32, sizeof(Address32));
+    SetMem(Listed[2] + 140, 8, 0);  // No X_DSDT: the 32-bit field is used
+    for (UINTN i = 0; i < 5; i++) TestChecksum(Listed[i], *(UINT32 *)(Listed[i] + 4), 9);
+    Listed[3][100] ^= 0xFF;
+
+    UINT8 *Xsdt = TestAcpiTable(Memory, &Offset, "XSDT", 36 + 5 * 8, 1);
+    UINT8 *Rsdt = TestAcpiTable(Memory, &Offset, "RSDT", 36 + 5 * 4, 1);
+    for (UINTN i = 0; i < 5; i++) {
+        Address = (UINT64)(UINTN)Listed[i];
+        Address32 = (UINT32)Address;
+        CopyMem(Xsdt + 36 + i * 8, &Address, sizeof(Address));
+        CopyMem(Rsdt + 36 + i * 4, &Address32, sizeof(Address32));
+    }
+    TestChecksum(Xsdt, 36 + 5 * 8, 9);
+    TestChecksum(Rsdt, 36 + 5 * 4, 9);
+
+    UINT32 Length = 36;
+    CopyMem(Rsdp, "RSD PTR ", 8);
+    Rsdp[15] = 2;
+    Address32 = (UINT32)(UINTN)Rsdt;
+    CopyMem(Rsdp + 16, &Address32, sizeof(Address32));
+    CopyMem(Rsdp + 20, &Length, sizeof(Length));
+    Address = (UINT64)(UINTN)Xsdt;
+    CopyMem(Rsdp + 24, &Address, sizeof(Address));
+    TestChecksum(Rsdp, 20, 8);
+    TestChecksum(Rsdp, 36, 32);
+    if (!ExtendedChecksum) Rsdp[32]++;
+
+    // Signatures compare as little-endian numbers, so last character first:
+    // APIC FACP FACS DSDT RSDT SSDT SSDT XSDT HPET
+    ACPI_EXPECTED Expected[8] = {
+        { Listed[0], 0, 0 }, { Listed[2], 0, 0 }, { Facs, 0, PXS_ACPI_TABLE_NO_CHECKSUM }, { Dsdt, 0, 0 },
+    };
+    UINTN Next = 4;
+    if (!ExtendedChecksum) Expected[Next++] = (ACPI_EXPECTED){ Rsdt, 0, 0 };
+    Expected[Next++] = (ACPI_EXPECTED){ Listed[1], 0, 0 };
+    Expected[Next++] = (ACPI_EXPECTED){ Listed[3], 1, PXS_ACPI_TABLE_BAD_CHECKSUM };
+    if (ExtendedChecksum) Expected[Next++] = (ACPI_EXPECTED){ Xsdt, 0, 0 };
+    Expected[Next++] = (ACPI_EXPECTED){ Listed[4], 0, 0 };
+
+    EFI_STATUS Status = AcpiBuildIndex(Rsdp, NULL, 0, &Count);
+    if (Status == EFI_SUCCESS && Count == ARRAY_SIZE(Expected)) {
+        Status = AcpiBuildIndex(Rsdp, Tables, ARRAY_SIZE(Tables), &Count);
+    }
+    BOOLEAN Same = Status == EFI_SUCCESS && Count == ARRAY_SIZE(Expected);
+    for (UINT32 i = 0; Same && i < Count; i++) {
+        UINT8 *Table = Expected[i].Table;
+        Same = Tables[i].Address == (UINT64)(UINTN)Table && Tables[i].Signature == *(UINT32 *)Table &&
+               Tables[i].Length == *(UINT32 *)(Table + 4) && Tables[i].Instance == Expected[i].Instance &&
+               Tables[i].Flags == Expected[i].Flags && Tables[i].Revision == (Table == Facs ? 2 : Table[8]);
+        Same = Same && (i == 0 || Tables[i - 1].Signature <= Tables[i].Signature);
+    }
+    BOOLEAN Small = AcpiBuildIndex(Rsdp, Tables, Count - 1, &Count) == EFI_BUFFER_TOO_SMALL;
+    Rsdp[9]++;
+    BOOLEAN Rejected = AcpiBuildIndex(Rsdp, Tables, ARRAY_SIZE(Tables), &Count) == EFI_NOT_FOUND;
+    munmap(Memory, SIZE_64KB);
+    CHECK(Same);
+    CHECK(Small);
+    CHECK(Rejected);
+    TestPassed();
+}
+
+// Structure of Type with Length bytes of formatted area and then the string
+// set, StringsSize bytes through its double NUL; 0 writes the empty set
+STATIC UINT8 *TestSmbiosStructure(IN OUT UINT8 *P, IN UINT8 Type, IN UINT8 Length, IN UINT16 Handle,
+                                  IN CONST CHAR8 *Strings, IN UINTN StringsSize) {
+    P[0] = Type;
+    P[1] = Length;
+    CopyMem(P + 2, &Handle, sizeof(Handle));
+    for (UINT8 i = 4; i < Length; i++) P[i] = (UINT8)(i + Type);
+    P += Length;
+    if (StringsSize == 0) {
+        *P++ = 0;
+        *P++ = 0;
+    } else {
+        CopyMem(P, Strings, StringsSize);
+        P += StringsSize;
+    }
+    return P;
+}
+
+// A structure table with an end-of-table structure followed by one that must
+// not be indexed, through a 3.x entry point and then a 2.x one whose count
+// stops the walk early
+STATIC VOID CheckSmbiosIndex(VOID) {
+    STATIC CONST struct {
+        UINT8       Type;
+        UINT8       Length;
+        CONST CHAR8 *Strings;
+        UINTN       StringsSize;    // Through the second NUL of the pair; 0 for none
+    } Layout[] = {
+        { 0,  0x1A, "Vendor\0" "1.0\0\0", 12 },
+        { 17, 0x28, "DIMM 0\0\0", 8 },
+        { 4,  0x30, "CPU 0\0Intel\0\0", 13 },
+        { 17, 0x28, "", 0 },
+        { 1,  0x1B, "Product\0\0", 9 },
+        { 17, 0x28, "DIMM 2\0\0", 8 },
+        { 4,  0x30, "CPU 1\0\0", 7 },
+    };
+    STATIC CONST UINTN Order[] = { 0, 4, 2, 6, 1, 3, 5 };  // By type, table order within one
+    UINT8 *Memory = TestAllocLow(SIZE_4KB);
+    UINT8 *Table = Memory + 64, *P = Table;
+    UINT8 *Start[ARRAY_SIZE(Layout)];
+    PXS_SMBIOS_STRUCTURE Structures[16];
+    PXS_SMBIOS_TABLE Smbios;
+    UINT32 Count;
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Layout); i++) {
+        Start[i] = P;
+        P = TestSmbiosStructure(P, Layout[i].Type, Layout[i].Length, (UINT16)(0x100 + i),
+                                Layout[i].Strings, Layout[i].StringsSize);
+    }
+    P = TestSmbiosStructure(P, 127, 4, 0xFEFF, "", 0);
+    P = TestSmbiosStructure(P, 2, 8, 0x200, "Board\0\0", 7);
+    UINT32 Size = (UINT32)(P - Table);
+
+    UINT8 *Entry = Memory;
+    UINT64 Address = (UINT64)(UINTN)Table;
+    CopyMem(Entry, "_SM3_", 5);
+    Entry[6] = 0x18;
+    Entry[7] = 3;
+    Entry[8] = 6;
+    CopyMem(Entry + 12, &Size, sizeof(Size));
+    CopyMem(Entry + 16, &Address, sizeof(Address));
+    TestChecksum(Entry, 0x18, 5);
+
+    CHECK(SmbiosParseEntryPoint(Entry, &Smbios) && Smbios.Major == 3 && Smbios.Minor == 6);
+    CHECK(SmbiosBuildIndex(&Smbios, NULL, 0, &Count) == EFI_SUCCESS && Count == ARRAY_SIZE(Layout));
+    CHECK(SmbiosBuildIndex(&Smbios, Structures, ARRAY_SIZE(Structures), &Count) == EFI_SUCCESS);
+    CHECK(Count == ARRAY_SIZE(Layout));
+    for (UINTN i = 0; i < Count; i++) {
+        UINTN n = Order[i];
+        UINT32 StructureSize = Layout[n].Length + (Layout[n].StringsSize == 0 ? 2 : (UINT32)Layout[n].StringsSize);
+        CHECK(Structures[i].Address == (UINT64)(UINTN)Start[n] && Structures[i].Size == StructureSize);
+        CHECK(Structures[i].Type == Layout[n].Type && Structures[i].Length == Layout[n].Length);
+        CHECK(Structures[i].Handle == 0x100 + n);
+    }
+    CHECK(SmbiosBuildIndex(&Smbios, Structures, Count - 1, &Count) == EFI_BUFFER_TOO_SMALL);
+
+    // 2.x: 16-bit length, 32-bit address and a structure count of 3
+    UINT16 Length16 = (UINT16)Size, Structures16 = 3;
+    UINT32 Address32 = (UINT32)Address;
+    SetMem(Entry, 64, 0);
+    CopyMem(Entry, "_SM_", 4);
+    Entry[5] = 0x1F;
+    Entry[6] = 2;
+    Entry[7] = 8;
+    CopyMem(Entry + 0x10, "_DMI_", 5);
+    CopyMem(Entry + 22, &Length16, sizeof(Length16));
+    CopyMem(Entry + 24, &Address32, sizeof(Address32));
+    CopyMem(Entry + 28, &Structures16, sizeof(Structures16));
+    TestChecksum(Entry + 0x10, 0x0F, 5);
+    TestChecksum(Entry, 0x1F, 4);
+
+    CHECK(SmbiosParseEntryPoint(Entry, &Smbios) && Smbios.Major == 2 && Smbios.MaxStructures == 3);
+    CHECK(SmbiosBuildIndex(&Smbios, Structures, ARRAY_SIZE(Structures), &Count) == EFI_SUCCESS && Count == 3);
+    CHECK(Structures[0].Type == 0 && Structures[1].Type == 4 && Structures[2].Type == 17);
+    Entry[4]++;
+    CHECK(!SmbiosParseEntryPoint(Entry, &Smbios));
+    munmap(Memory, SIZE_4KB);
+    TestPassed();
+}
+
+STATIC VOID RunFirmwareTableTests(VOID) {
+    if (TestSelected("tables/acpi-xsdt")) CheckAcpiIndex(TRUE);
+    if (TestSelected("tables/acpi-rsdt")) CheckAcpiIndex(FALSE);
+    if (TestSelected("tables/smbios")) CheckSmbiosIndex();
+}
+
+// --------------------------------------------------------------------------
+// PARTITION SOURCES
+// --------------------------------------------------------------------------
+
+#define TEST_PART_GUID  L"part:01234567-89ab-CDEF-0123-456789abcdef"
+
+typedef struct {
+    CONST CHAR16 *Path;
+    BOOLEAN      Valid;
+    UINT64       Offset;
+} PART_SOURCE_CASE;
+
+// Every well-formed path names the same GUID; the offsets cover each unit and
+// the edges of 64 bits
+STATIC VOID CheckPartitionSource(VOID) {
+    STATIC CONST PART_SOURCE_CASE Cases[] = {
+        { TEST_PART_GUID,                             TRUE,  0 },
+        { TEST_PART_GUID L":4096",                    TRUE,  4096 },
+        { TEST_PART_GUID L":64K",                     TRUE,  SIZE_64KB },
+        { TEST_PART_GUID L":1m",                      TRUE,  SIZE_1MB },
+        { TEST_PART_GUID L":3G",                      TRUE,  3ULL << 30 },
+        { TEST_PART_GUID L":0x1F000",                 TRUE,  0x1F000 },
+        { TEST_PART_GUID L":0xffffffffffffffff",      TRUE,  MAX_UINT64 },
+        { TEST_PART_GUID L":18446744073709551615",    TRUE,  MAX_UINT64 },
+        { TEST_PART_GUID L":",                        FALSE, 0 },
+        { TEST_PART_GUID L":0x",                      FALSE, 0 },
+        { TEST_PART_GUID L":12q",                     FALSE, 0 },
+        { TEST_PART_GUID L":4K4",                     FALSE, 0 },
+        { TEST_PART_GUID L":0x10000000000000000",     FALSE, 0 },
+        { TEST_PART_GUID L":18446744073709551616",    FALSE, 0 },
+        { TEST_PART_GUID L":17179869184G",            FALSE, 0 },
+        { TEST_PART_GUID L"0",                        FALSE, 0 },
+        { L"part:01234567-89ab-cdef-0123-456789abcdeg", FALSE, 0 },
+        { L"part:01234567-89ab-cdef-0123-456789abcde",  FALSE, 0 },
+        { L"part:0123456789ab-cdef-0123-456789abcdef0", FALSE, 0 },
+        { L"PART:01234567-89ab-cdef-0123-456789abcdef", FALSE, 0 },
+        { L"\\EFI\\pxs\\part:01234567-89ab-cdef-0123-456789abcdef", FALSE, 0 },
+    };
+    STATIC CONST EFI_GUID Expected = {
+        0x01234567, 0x89ab, 0xcdef, { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef }
+    };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        EFI_GUID Guid;
+        UINT64 Offset = 1;
+        BOOLEAN Valid = PartitionParseSource(Cases[i].Path, &Guid, &Offset);
+        CHECK(Valid == Cases[i].Valid);
+        if (!Valid) continue;
+        CHECK(CompareGuid(&Guid, &Expected));
+        CHECK(Offset == Cases[i].Offset);
+    }
+    CHECK(PartitionIsSource(TEST_PART_GUID) && !PartitionIsSource(L"\\EFI\\pxs\\vmlinuz"));
+    TestPassed();
+}
+
+typedef struct {
+    CONST CHAR8 *Magic;
+    UINT32      Version;
+    UINT32      HeaderSize;
+    UINT64      DataOffset;
+    UINT64      DataSize;
+    UINT64      Room;
+    EFI_STATUS  Status;
+} EXTENT_CASE;
+
+STATIC VOID CheckPartitionExtent(VOID) {
+    STATIC CONST EXTENT_CASE Cases[] = {
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 4096, 8192,       16384,      EFI_SUCCESS },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 32,   16352,      16384,      EFI_SUCCESS },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 64, 4096, 0,          4096,       EFI_SUCCESS },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 4096, 8192,       31,         EFI_NOT_FOUND },
+        { "PXSEXTNX",       PXS_EXTENT_VERSION, 32, 4096, 8192,       16384,      EFI_NOT_FOUND },
+        { PXS_EXTENT_MAGIC, 2,                  32, 4096, 8192,       16384,      EFI_UNSUPPORTED },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 16, 4096, 8192,       16384,      EFI_VOLUME_CORRUPTED },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 64, 48,   8192,       16384,      EFI_VOLUME_CORRUPTED },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 4096, 12289,      16384,      EFI_VOLUME_CORRUPTED },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 16385, 0,         16384,      EFI_VOLUME_CORRUPTED },
+        { PXS_EXTENT_MAGIC, PXS_EXTENT_VERSION, 32, 4096, MAX_UINT64, MAX_UINT64, EFI_VOLUME_CORRUPTED },
+    };
+    STATIC_ASSERT(sizeof(PXS_EXTENT_HEADER) == 32, "extent header cases assume 32 bytes");
+
+    for (UINTN i = 0; i < ARRAY_SIZE(Cases); i++) {
+        PXS_EXTENT_HEADER Header = { .Version = Cases[i].Version, .HeaderSize = Cases[i].HeaderSize,
+                                     .DataOffset = Cases[i].DataOffset, .DataSize = Cases[i].DataSize };
+        UINT64 DataOffset = 0, DataSize = 0;
+        CopyMem(Header.Magic, Cases[i].Magic, sizeof(Header.Magic));
+
+        EFI_STATUS Status = PartitionParseExtent(&Header, Cases[i].Room, &DataOffset, &DataSize);
+        CHECK(Status == Cases[i].Status);
+        if (Status == EFI_SUCCESS) CHECK(DataOffset == Cases[i].DataOffset && DataSize == Cases[i].DataSize);
+    }
+    TestPassed();
+}
+
+STATIC VOID RunPartitionTests(VOID) {
+    if (TestSelected("partition/source")) CheckPartitionSource();
+    if (TestSelected("partition/extent")) CheckPartitionExtent();
+}
+
+// --------------------------------------------------------------------------
+// MEMORY MAP
+// --------------------------------------------------------------------------
+
+#define TEST_DESCRIPTOR_SIZE  48    // What firmware reports: larger than the struct
+
+typedef struct {
+    UINT32 Type;
+    UINT64 Base;
+    UINT64 Pages;
+    UINT64 Attribute;
+} TEST_DESCRIPTOR;
+
+// An unsorted map with the usual defects: empty, overlapping and contained
+// descriptors, runs of one type split in two, and types the kernel does not
+// know. Descriptors are TEST_DESCRIPTOR_SIZE apart, as firmware spaces them.
+STATIC VOID CheckMemoryMapNormalize(VOID) {
+    STATIC CONST TEST_DESCRIPTOR Map[] = {
+        { EfiConventionalMemory,   0x100000,   16,  0 },
+        { EfiBootServicesCode,     0x0,        1,   0 },
+        { EfiBootServicesData,     0x1000,     15,  0 },
+        { EfiLoaderData,           0x110000,   0,   0 },                    // Empty
+        { EfiMemoryMappedIO,       0xFEC00000, 1,   EFI_MEMORY_RUNTIME },
+        { EfiRuntimeServicesData,  0x10000,    2,   EFI_MEMORY_RUNTIME },
+        { EfiReservedMemoryType,   0x12000,    2,   0 },                    // Same type, other flags
+        { EfiConventionalMemory,   0x108000,   16,  0 },                    // Overlaps the first
+        { EfiACPIReclaimMemory,    0x104000,   2,   0 },                    // Inside the first
+        { PXS_EFI_MEMORY_KERNEL,   0x200000,   512, 0 },
+        { 0x70000000,              0x400000,   1,   0 },                    // OEM
+    };
+    STATIC CONST PXS_MEMORY_RANGE Expected[] = {
+        { 0x0,        0x10000,  PXS_MEMORY_RECLAIMABLE, 0 },
+        { 0x10000,    0x2000,   PXS_MEMORY_RESERVED,    PXS_MEMORY_FLAG_RUNTIME },
+        { 0x12000,    0x2000,   PXS_MEMORY_RESERVED,    0 },
+        { 0x100000,   0x18000,  PXS_MEMORY_USABLE,      0 },
+        { 0x200000,   0x200000, PXS_MEMORY_KERNEL,      0 },
+        { 0x400000,   0x1000,   PXS_MEMORY_RESERVED,    0 },
+        { 0xFEC00000, 0x1000,   PXS_MEMORY_MMIO,        PXS_MEMORY_FLAG_RUNTIME },
+    };
+    UINT8 Descriptors[ARRAY_SIZE(Map) * TEST_DESCRIPTOR_SIZE];
+    PXS_MEMORY_RANGE Entries[ARRAY_SIZE(Map)];
+    UINTN Count;
+
+    SetMem(Descriptors, sizeof(Descriptors), 0xA5);
+    for (UINTN i = 0; i < ARRAY_SIZE(Map); i++) {
+        EFI_MEMORY_DESCRIPTOR Desc = { .Type = Map[i].Type, .PhysicalStart = Map[i].Base,
+                                       .NumberOfPages = Map[i].Pages, .Attribute = Map[i].Attribute };
+        CopyMem(Descriptors + i * TEST_DESCRIPTOR_SIZE, &Desc, sizeof(Desc));
+    }
+
+    EFI_STATUS Status = MemoryMapNormalize((EFI_MEMORY_DESCRIPTOR *)Descriptors, sizeof(Descriptors),
+                                           TEST_DESCRIPTOR_SIZE, Entries, ARRAY_SIZE(Entries), &Count);
+    CHECK(Status == EFI_SUCCESS);
+    CHECK(Count == ARRAY_SIZE(Expected));
+    for (UINTN i = 0; i < Count; i++) {
+        CHECK(Entries[i].Base == Expected[i].Base && Entries[i].Length == Expected[i].Length);
+        CHECK(Entries[i].Type == Expected[i].Type && Entries[i].Flags == Expected[i].Flags);
+    }
+
+    // Room is counted in non-empty descriptors, before merging
+    Status = MemoryMapNormalize((EFI_MEMORY_DESCRIPTOR *)Descriptors, sizeof(Descriptors),
+                                TEST_DESCRIPTOR_SIZE, Entries, ARRAY_SIZE(Map) - 2, &Count);
+    CHECK(Status == EFI_BUFFER_TOO_SMALL);
+    Status = MemoryMapNormalize((EFI_MEMORY_DESCRIPTOR *)Descriptors, sizeof(Descriptors),
+                                TEST_DESCRIPTOR_SIZE, Entries, ARRAY_SIZE(Map) - 1, &Count);
+    CHECK(Status == EFI_SUCCESS && Count == ARRAY_SIZE(Expected));
+
+    // A trailing partial descriptor is not read
+    Status = MemoryMapNormalize((EFI_MEMORY_DESCRIPTOR *)Descriptors, TEST_DESCRIPTOR_SIZE - 1,
+                                TEST_DESCRIPTOR_SIZE, Entries, ARRAY_SIZE(Entries), &Count);
+    CHECK(Status == EFI_SUCCESS && Count == 0);
+    TestPassed();
+}
+
+STATIC VOID RunMemoryMapTests(VOID) {
+    if (TestSelected("memmap/normalize")) CheckMemoryMapNormalize();
+}
+
+// --------------------------------------------------------------------------
+// NUMA
+// --------------------------------------------------------------------------
+
+#define TEST_SRAT_SIZE  512
+
+// Append an SRAT affinity structure: 0 local APIC, 1 memory, 2 x2APIC, and
+// anything else as a 16-byte structure of that type
+STATIC VOID TestSratEntry(IN UINT8 *Srat, IN OUT UINTN *Offset, IN UINT8 Type, IN UINT32 Domain, IN UINT32 ApicId,
+                          IN UINT64 Base, IN UINT64 Length, IN UINT32 Flags) {
+    UINT8 *P = Srat + *Offset;
+    P[0] = Type;
+    switch (Type) {
+    case 0:
+        P[1] = 16;
+        P[2] = (UINT8)Domain;
+        P[3] = (UINT8)ApicId;
+        CopyMem(P + 4, &Flags, 4);
+        P[9] = (UINT8)(Domain >> 8);
+        P[10] = (UINT8)(Domain >> 16);
+        P[11] = (UINT8)(Domain >> 24);
+        break;
+    case 1:
+        P[1] = 40;
+        CopyMem(P + 2, &Domain, 4);
+        CopyMem(P + 8, &Base, 8);
+        CopyMem(P + 16, &Length, 8);
+        CopyMem(P + 28, &Flags, 4);
+        break;
+    case 2:
+        P[1] = 24;
+        CopyMem(P + 4, &Domain, 4);
+        CopyMem(P + 8, &ApicId, 4);
+        CopyMem(P + 12, &Flags, 4);
+        break;
+    default:
+        P[1] = 16;
+        break;
+    }
+    *Offset += P[1];
+}
+
+// Nodes in domain order whatever the SRAT order, disabled and empty entries
+// dropped, ranges grouped by node, and 32-bit domains only from revision 2 on
+STATIC VOID CheckNumaTable(VOID) {
+    UINT8 Srat[TEST_SRAT_SIZE];
+    PXS_NUMA_NODE Nodes[8];
+    PXS_NUMA_RANGE Ranges[8];
+    PXS_NUMA Numa;
+    UINTN Offset = 48;
+
+    SetMem(Srat, sizeof(Srat), 0);
+    TestSratEntry(Srat, &Offset, 2, 2,          0x100, 0,             0,          0x01);
+    TestSratEntry(Srat, &Offset, 0, 0,          0,     0,             0,          0x01);
+    TestSratEntry(Srat, &Offset, 0, 2,          5,     0,             0,          0x00);   // Disabled
+    TestSratEntry(Srat, &Offset, 1, 2,          0,     0x100000000,   0x80000000, 0x03);   // Hot-pluggable
+    TestSratEntry(Srat, &Offset, 1, 0,          0,     0x100000,      0x7FF00000, 0x01);
+    TestSratEntry(Srat, &Offset, 5, 0,          0,     0,             0,          0x00);   // Unknown type
+    TestSratEntry(Srat, &Offset, 1, 2,          0,     0x180000000,   0x40000000, 0x05);   // Non-volatile
+    TestSratEntry(Srat, &Offset, 1, 7,          0,     0x300000000,   0,          0x01);   // Empty
+    TestSratEntry(Srat, &Offset, 1, 5,          0,     0x400000000,   0x1000,     0x00);   // Disabled
+    TestSratEntry(Srat, &Offset, 1, 0x01000001, 0,     0x200000000,   0x1000,     0x01);
+    CopyMem(Srat, "SRAT", 4);
+    UINT32 Length = (UINT32)Offset;
+    CopyMem(Srat + 4, &Length, sizeof(Length));
+    Srat[8] = 3;
+
+    // Counting gives bounds: one node per enabled entry
+    SetMem(&Numa, sizeof(Numa), 0);
+    CHECK(NumaBuildTable(Srat, 0x100, &Numa) == EFI_SUCCESS);
+    CHECK(Numa.NodeCount == 6 && Numa.RangeCount == 4);
+
+    Numa.Nodes = Nodes;
+    Numa.Ranges = Ranges;
+    Numa.NodeCount = 2;
+    CHECK(NumaBuildTable(Srat, 0x100, &Numa) == EFI_BUFFER_TOO_SMALL);
+
+    Numa.NodeCount = ARRAY_SIZE(Nodes);
+    Numa.RangeCount = ARRAY_SIZE(Ranges);
+    CHECK(NumaBuildTable(Srat, 0x100, &Numa) == EFI_SUCCESS);
+    CHECK(Numa.Version == PXS_NUMA_VERSION && Numa.NodeCount == 3 && Numa.RangeCount == 4 && Numa.BspNode == 1);
+    CHECK(Nodes[0].Domain == 0 && Nodes[0].CpuCount == 1 && Nodes[0].FirstRange == 0 && Nodes[0].RangeCount == 1);
+    CHECK(Nodes[1].Domain == 2 && Nodes[1].CpuCount == 1 && Nodes[1].FirstRange == 1 && Nodes[1].RangeCount == 2);
+    CHECK(Nodes[2].Domain == 0x01000001 && Nodes[2].CpuCount == 0 && Nodes[2].FirstRange == 3 && Nodes[2].RangeCount == 1);
+    CHECK(Ranges[0].Base == 0x100000 && Ranges[0].Length == 0x7FF00000 && Ranges[0].Node == 0 && Ranges[0].Flags == 0);
+    CHECK(Ranges[1].Base == 0x100000000 && Ranges[1].Node == 1 && Ranges[1].Flags == PXS_NUMA_RANGE_HOTPLUG);
+    CHECK(Ranges[2].Base == 0x180000000 && Ranges[2].Node == 1 && Ranges[2].Flags == PXS_NUMA_RANGE_NONVOLATILE);
+    CHECK(Ranges[3].Base == 0x200000000 && Ranges[3].Node == 2);
+
+    // The boot CPU need not be listed
+    Numa.NodeCount = ARRAY_SIZE(Nodes);
+    Numa.RangeCount = ARRAY_SIZE(Ranges);
+    CHECK(NumaBuildTable(Srat, 7, &Numa) == EFI_SUCCESS && Numa.BspNode == PXS_NUMA_NO_NODE);
+
+    // ACPI 2.0 memory domains are 8 bits wide
+    Srat[8] = 1;
+    Numa.NodeCount = ARRAY_SIZE(Nodes);
+    Numa.RangeCount = ARRAY_SIZE(Ranges);
+    CHECK(NumaBuildTable(Srat, 0x100, &Numa) == EFI_SUCCESS);
+    CHECK(Numa.NodeCount == 3 && Nodes[1].Domain == 1 && Nodes[2].Domain == 2 && Numa.BspNode == 2);
+
+    CopyMem(Srat, "SRAX", 4);
+    CHECK(NumaBuildTable(Srat, 0x100, &Numa) == EFI_NOT_FOUND);
+    TestPassed();
+}
+
+// Distances follow the nodes' domains into the matrix; domains past its size
+// get 0
+STATIC VOID CheckNumaDistances(VOID) {
+    STATIC CONST UINT8 Matrix[3][3] = { { 10, 20, 30 }, { 21, 10, 22 }, { 31, 23, 10 } };
+    PXS_NUMA_NODE Nodes[3] = { { .Domain = 0 }, { .Domain = 2 }, { .Domain = 0x01000001 } };
+    UINT8 Distances[3 * 3];
+    UINT8 Slit[44 + sizeof(Matrix)];
+    PXS_NUMA Numa = { .NodeCount = 3, .Nodes = Nodes, .Distances = Distances };
+    UINT64 Localities = 3;
+
+    SetMem(Slit, sizeof(Slit), 0);
+    CopyMem(Slit, "SLIT", 4);
+    UINT32 Length = sizeof(Slit);
+    CopyMem(Slit + 4, &Length, sizeof(Length));
+    CopyMem(Slit + 36, &Localities, sizeof(Localities));
+    CopyMem(Slit + 44, Matrix, sizeof(Matrix));
+
+    SetMem(Distances, sizeof(Distances), 0xFF);
+    CHECK(NumaReadDistances(Slit, &Numa) == EFI_SUCCESS);
+    STATIC CONST UINT8 Expected[3 * 3] = { 10, 30, 0, 31, 10, 0, 0, 0, 0 };
+    CHECK(CompareMem(Distances, Expected, sizeof(Expected)) == 0);
+
+    // A matrix that does not fit the table is not read
+    Length = sizeof(Slit) - 1;
+    CopyMem(Slit + 4, &Length, sizeof(Length));
+    CHECK(NumaReadDistances(Slit, &Numa) == EFI_NOT_FOUND);
+    Length = sizeof(Slit);
+    CopyMem(Slit + 4, &Length, sizeof(Length));
+    Localities = 0x100000000ULL;
+    CopyMem(Slit + 36, &Localities, sizeof(Localities));
+    CHECK(NumaReadDistances(Slit, &Numa) == EFI_NOT_FOUND);
+    TestPassed();
+}
+
+STATIC VOID RunNumaTests(VOID) {
+    if (TestSelected("numa/srat")) CheckNumaTable();
+    if (TestSelected("numa/slit")) CheckNumaDistances();
+}
+
+// --------------------------------------------------------------------------
+// PAGE TABLES
+// --------------------------------------------------------------------------
+
+#define TEST_TABLE_BATCHES  64
+
+#define TEST_PAGING_VIRT    0x7F0040000000ULL   // 1 GiB aligned
+#define TEST_PAGING_PHYS    0x0080000000ULL     // 1 GiB aligned
+
+STATIC EFI_PHYSICAL_ADDRESS mTableBatches[TEST_TABLE_BATCHES];
+STATIC UINTN mTableBatchPages[TEST_TABLE_BATCHES];
+STATIC UINTN mTableBatchCount = 0;
+
+// Table batches from boot services, kept so the case can free them
+STATIC EFI_STATUS TestTableBatch(IN UINTN Pages, OUT EFI_PHYSICAL_ADDRESS *Address) {
+    if (mTableBatchCount == TEST_TABLE_BATCHES) return EFI_OUT_OF_RESOURCES;
+    EFI_STATUS Status = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData, Pages, Address);
+    if (EFI_ERROR(Status)) return Status;
+    mTableBatches[mTableBatchCount] = *Address;
+    mTableBatchPages[mTableBatchCount++] = Pages;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS TestNoTables(IN UINTN Pages, OUT EFI_PHYSICAL_ADDRESS *Address) {
+    return EFI_OUT_OF_RESOURCES;
+}
+
+STATIC VOID TestFreeTables(VOID) {
+    for (UINTN i = 0; i < mTableBatchCount; i++) gBS->FreePages(mTableBatches[i], mTableBatchPages[i]);
+    mTableBatchCount = 0;
+}
+
+// Entry that maps Virt and its level (1 for 4K, 2 for 2M, 3 for 1G), or
+// NULL when Virt is not mapped
+STATIC UINT64 *TestLookup(IN CONST PXS_PAGE_TABLES *Tables, IN UINT64 Virt, OUT UINT32 *Level) {
+    UINT64 *Table = (UINT64 *)(UINTN)Tables->Root;
+    for (UINT32 L = Tables->Levels; L > 0; L--) {
+        UINT64 *Entry = &Table[(Virt >> (12 + 9 * (L - 1))) & 511];
+        if (!(*Entry & PXS_PTE_PRESENT)) return NULL;
+        if (L == 1 || (*Entry & PXS_PTE_LARGE)) {
+            *Level = L;
+            return Entry;
+        }
+        Table = (UINT64 *)(UINTN)(*Entry & PXS_PTE_ADDRESS);
+    }
+    return NULL;
+}
+
+// Flag bits of a leaf entry at Level, with the PAT bit of a large page
+STATIC UINT64 TestFlags(IN UINT64 Entry, IN UINT32 Level) {
+    return Entry & ~(PXS_PTE_ADDRESS & ~(Level > 1 ? PXS_PTE_PAT_LARGE : 0));
+}
+
+// Physical address Virt translates to, MAX_UINT64 when it is not mapped
+STATIC UINT64 TestTranslate(IN CONST PXS_PAGE_TABLES *Tables, IN UINT64 Virt) {
+    UINT32 Level;
+    UINT64 *Entry = TestLookup(Tables, Virt, &Level);
+    if (!Entry) return MAX_UINT64;
+    UINT64 Mask = (1ULL << (12 + 9 * (Level - 1))) - 1;
+    UINT64 Base = *Entry & PXS_PTE_ADDRESS & ~(Level > 1 ? PXS_PTE_PAT_LARGE : 0);
+    return Base + (Virt & Mask);
+}
+
+// A write-combining 1 GiB page split by a 4K mapping inside it: the 1 GiB
+// page becomes 2M pages and the one holding the 4K page becomes 4K pages,
+// all keeping their addresses and flags with PAT moved to the 4K bit
+STATIC VOID CheckPagingSplit(VOID) {
+    PXS_PAGE_TABLES Tables;
+    UINT32 Level;
+    UINT64 *Entry;
+    UINT64 Inner = TEST_PAGING_VIRT + PXS_SIZE_2M + EFI_PAGE_SIZE;
+
+    CHECK(PagingInit(&Tables, TestTableBatch) == EFI_SUCCESS);
+    Tables.Huge1G = TRUE;
+    Tables.NxSupported = TRUE;
+    Tables.PatSupported = TRUE;
+    CHECK(PagingMap(&Tables, TEST_PAGING_VIRT, TEST_PAGING_PHYS, PXS_SIZE_1G, PXS_MAP_WRITE | PXS_MAP_WC) == EFI_SUCCESS);
+    CHECK(Tables.UsesWc);
+    Entry = TestLookup(&Tables, TEST_PAGING_VIRT, &Level);
+    CHECK(Entry && Level == 3);
+    CHECK((*Entry & (PXS_PTE_WRITE | PXS_PTE_NX | PXS_PTE_PWT | PXS_PTE_PAT_LARGE)) ==
+          (PXS_PTE_WRITE | PXS_PTE_NX | PXS_PTE_PWT | PXS_PTE_PAT_LARGE));
+    CHECK(!(*Entry & PXS_PTE_PCD));
+    UINTN TablePages = Tables.TablePages;
+
+    CHECK(PagingMap(&Tables, Inner, 0x1000, EFI_PAGE_SIZE, PXS_MAP_EXEC | PXS_MAP_GLOBAL) == EFI_SUCCESS);
+    CHECK(Tables.TablePages == TablePages + 2);
+    Entry = TestLookup(&Tables, Inner, &Level);
+    CHECK(Entry && Level == 1 && TestTranslate(&Tables, Inner + 0x123) == 0x1123);
+    CHECK(TestFlags(*Entry, Level) == (PXS_PTE_PRESENT | PXS_PTE_GLOBAL));
+
+    for (UINT64 Offset = PXS_SIZE_2M; Offset < 2 * PXS_SIZE_2M; Offset += EFI_PAGE_SIZE) {
+        if (TEST_PAGING_VIRT + Offset == Inner) continue;
+        Entry = TestLookup(&Tables, TEST_PAGING_VIRT + Offset, &Level);
+        CHECK(Entry && Level == 1 && TestTranslate(&Tables, TEST_PAGING_VIRT + Offset) == TEST_PAGING_PHYS + Offset);
+        CHECK(TestFlags(*Entry, Level) == (PXS_PTE_PRESENT | PXS_PTE_WRITE | PXS_PTE_PWT | PXS_PTE_PAT_4K | PXS_PTE_NX));
+    }
+    for (UINT64 Offset = 0; Offset < PXS_SIZE_1G; Offset += PXS_SIZE_2M) {
+        if (Offset == PXS_SIZE_2M) continue;
+        UINT64 Virt = TEST_PAGING_VIRT + Offset + 0x5000;
+        Entry = TestLookup(&Tables, Virt, &Level);
+        CHECK(Entry && Level == 2 && TestTranslate(&Tables, Virt) == TEST_PAGING_PHYS + Offset + 0x5000);
+        CHECK(TestFlags(*Entry, Level) ==
+              (PXS_PTE_PRESENT | PXS_PTE_WRITE | PXS_PTE_LARGE | PXS_PTE_PWT | PXS_PTE_PAT_LARGE | PXS_PTE_NX));
+    }
+    CHECK(TestTranslate(&Tables, TEST_PAGING_VIRT - EFI_PAGE_SIZE) == MAX_UINT64);
+    CHECK(TestTranslate(&Tables, TEST_PAGING_VIRT + PXS_SIZE_1G) == MAX_UINT64);
+    TestFreeTables();
+    TestPassed();
+}
+
+// The page size follows the alignment of both addresses, NO_LARGE and the
+// CPU's 1 GiB support; UC is PCD + PWT; running out of tables is reported
+STATIC VOID CheckPagingSizes(VOID) {
+    PXS_PAGE_TABLES Tables;
+    UINT32 Level;
+    UINT64 *Entry;
+
+    CHECK(PagingInit(&Tables, TestTableBatch) == EFI_SUCCESS);
+    Tables.Huge1G = FALSE;
+    Tables.NxSupported = FALSE;
+    CHECK(PagingMap(&Tables, TEST_PAGING_VIRT, TEST_PAGING_PHYS, PXS_SIZE_1G, PXS_MAP_WRITE | PXS_MAP_UC) == EFI_SUCCESS);
+    Entry = TestLookup(&Tables, TEST_PAGING_VIRT + PXS_SIZE_1G - 1, &Level);
+    CHECK(Entry && Level == 2);
+    CHECK(TestTranslate(&Tables, TEST_PAGING_VIRT + PXS_SIZE_1G - 1) == TEST_PAGING_PHYS + PXS_SIZE_1G - 1);
+    CHECK(TestFlags(*Entry, Level) == (PXS_PTE_PRESENT | PXS_PTE_WRITE | PXS_PTE_LARGE | PXS_PTE_PCD | PXS_PTE_PWT));
+
+    // Virtually 2M aligned but physically not, and the range is rounded to pages
+    UINT64 Virt = TEST_PAGING_VIRT + PXS_SIZE_1G;
+    CHECK(PagingMap(&Tables, Virt + 0x10, TEST_PAGING_PHYS + EFI_PAGE_SIZE, PXS_SIZE_2M, 0) == EFI_SUCCESS);
+    Entry = TestLookup(&Tables, Virt, &Level);
+    CHECK(Entry && Level == 1 && TestFlags(*Entry, Level) == PXS_PTE_PRESENT);
+    CHECK(TestTranslate(&Tables, Virt + PXS_SIZE_2M) == TEST_PAGING_PHYS + EFI_PAGE_SIZE + PXS_SIZE_2M);
+    CHECK(TestTranslate(&Tables, Virt + PXS_SIZE_2M + EFI_PAGE_SIZE) == MAX_UINT64);
+
+    CHECK(PagingMap(&Tables, Virt + PXS_SIZE_1G, TEST_PAGING_PHYS, PXS_SIZE_2M, PXS_MAP_NO_LARGE) == EFI_SUCCESS);
+    Entry = TestLookup(&Tables, Virt + PXS_SIZE_1G + PXS_SIZE_2M - 1, &Level);
+    CHECK(Entry && Level == 1);
+    CHECK(TestTranslate(&Tables, Virt + PXS_SIZE_1G + PXS_SIZE_2M - 1) == TEST_PAGING_PHYS + PXS_SIZE_2M - 1);
+
+    // Once the batch is used up, a mapping that needs a table fails
+    Tables.Allocate = TestNoTables;
+    Tables.PoolPages = 0;
+    CHECK(PagingMap(&Tables, Virt + 2 * PXS_SIZE_1G, TEST_PAGING_PHYS, PXS_SIZE_2M, 0) == EFI_OUT_OF_RESOURCES);
+    CHECK(PagingMap(&Tables, TEST_PAGING_VIRT, TEST_PAGING_PHYS, PXS_SIZE_2M, PXS_MAP_WRITE) == EFI_SUCCESS);
+    TestFreeTables();
+    TestPassed();
+}
+
+// The loader page tables over a map with RAM, a reserved hole that is not
+// write-back capable and MMIO: RAM is write-back, the rest uncached, all of
+// it no-execute but the loader image; kernel segments are mapped at their
+// link addresses, and one that lands in the identity range elsewhere than its
+// pages is refused
+STATIC VOID CheckPageTablesBuild(VOID) {
+    STATIC CONST EFI_MEMORY_DESCRIPTOR Map[] = {
+        { EfiConventionalMemory, 0x0,        0, 0x9F,  EFI_MEMORY_WB },
+        { EfiReservedMemoryType, 0x9F000,    0, 0x61,  EFI_MEMORY_UC },
+        { EfiLoaderCode,         0x100000,   0, 0x100, EFI_MEMORY_WB },
+        { EfiConventionalMemory, 0x200000,   0, 0x7FE00, EFI_MEMORY_WB },
+        { EfiMemoryMappedIO,     0xFEC00000, 0, 1,     EFI_MEMORY_UC },
+    };
+    PXS_KERNEL_SEGMENT Segment = { .VirtualAddress = 0xFFFFFFFF80000000ULL, .PhysicalAddress = 0x1000000,
+                                   .MemorySize = 0x5000, .Flags = PF_R | PF_X };
+    EFI_LOADED_IMAGE_PROTOCOL Image = { .ImageBase = (VOID *)0x140000, .ImageSize = 0x3000 };
+    PXS_BOOT_INFO *BootInfo = TestAlloc(sizeof(PXS_BOOT_INFO));
+    PXS_PAGE_TABLES Tables;
+    UINT32 Level;
+    UINT64 *Entry;
+
+    HostSetMemoryMap(Map, ARRAY_SIZE(Map));
+    EFI_STATUS Status = BuildPageTables(&Segment, 1, &Image, BootInfo, &Tables);
+    HostSetMemoryMap(NULL, 0);
+    CHECK(Status == EFI_SUCCESS);
+    UINT64 Nx = Tables.NxSupported ? PXS_PTE_NX : 0;
+    UINT64 Caching = PXS_PTE_PCD | PXS_PTE_PWT;
+    CHECK(BootInfo->PageTableRoot == Tables.Root && BootInfo->DirectMapSize == SIZE_4GB);
+
+    STATIC CONST struct { UINT64 Address; BOOLEAN WriteBack; BOOLEAN Exec; } Expected[] = {
+        { 0x0,                     TRUE,  FALSE },
+        { 0x9E000,                 TRUE,  FALSE },
+        { 0x9F000,                 FALSE, FALSE },
+        { 0xFF000,                 FALSE, FALSE },
+        { 0x100000,                TRUE,  FALSE },
+        { 0x140000,                TRUE,  TRUE },
+        { 0x142000,                TRUE,  TRUE },
+        { 0x143000,                TRUE,  FALSE },
+        { 0x200000,                TRUE,  FALSE },
+        { 0x7FFFF000,              TRUE,  FALSE },
+        { 0x80000000,              FALSE, FALSE },
+        { 0xFEC00000,              FALSE, FALSE },
+        { SIZE_4GB - EFI_PAGE_SIZE, FALSE, FALSE },
+    };
+    for (UINTN i = 0; i < ARRAY_SIZE(Expected); i++) {
+        UINT64 Caches = Expected[i].WriteBack ? 0 : Caching;
+        Entry = TestLookup(&Tables, Expected[i].Address, &Level);
+        CHECK(Entry && TestTranslate(&Tables, Expected[i].Address) == Expected[i].Address);
+        CHECK((*Entry & (Caching | PXS_PTE_NX | PXS_PTE_GLOBAL)) == (Caches | (Expected[i].Exec ? 0 : Nx)));
+        Entry = TestLookup(&Tables, BootInfo->DirectMapBase + Expected[i].Address, &Level);
+        CHECK(Entry && TestTranslate(&Tables, BootInfo->DirectMapBase + Expected[i].Address) == Expected[i].Address);
+        CHECK((*Entry & (Caching | PXS_PTE_NX | PXS_PTE_GLOBAL)) == (Caches | Nx | PXS_PTE_GLOBAL));
+    }
+    CHECK(TestTranslate(&Tables, SIZE_4GB) == MAX_UINT64);
+
+    Entry = TestLookup(&Tables, Segment.VirtualAddress + 0x4000, &Level);
+    CHECK(Entry && TestTranslate(&Tables, Segment.VirtualAddress + 0x4000) == Segment.PhysicalAddress + 0x4000);
+    CHECK((*Entry & (PXS_PTE_WRITE | PXS_PTE_NX | PXS_PTE_GLOBAL)) == PXS_PTE_GLOBAL);
+
+    // The identity map itself may hold an ET_EXEC kernel loaded where it was linked
+    Segment.VirtualAddress = Segment.PhysicalAddress;
+    HostSetMemoryMap(Map, ARRAY_SIZE(Map));
+    Status = BuildPageTables(&Segment, 1, &Image, BootInfo, &Tables);
+    CHECK(Status == EFI_SUCCESS);
+    Segment.PhysicalAddress += PXS_SIZE_2M;
+    Status = BuildPageTables(&Segment, 1, &Image, BootInfo, &Tables);
+    HostSetMemoryMap(NULL, 0);
+    CHECK(Status == EFI_UNSUPPORTED);
+    free(BootInfo);
+    TestPassed();
+}
+
+STATIC VOID RunPagingTests(VOID) {
+    if (TestSelected("paging/split")) CheckPagingSplit();
+    if (TestSelected("paging/sizes")) CheckPagingSizes();
+    if (TestSelected("paging/build")) CheckPageTablesBuild();
+}
+
+// --------------------------------------------------------------------------
+// MAIN
+// --------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+    CONST CHAR16 *MemOpsName;
+
+    HostInit();
+    MemOpsInit(&MemOpsName);
+    if (argc > 1) {
+        mTestFilter = argv[1];
+    }
+    if (!mkdtemp(mTempDir)) {
+        fprintf(stderr, "test: cannot create a scratch directory\n");
+        return 1;
+    }
+
+    RunDecompressTests();
+    RunReaderTests();
+    RunInitrdTests();
+    RunSha256Tests();
+    RunRelocationTests();
+    RunFirmwareTableTests();
+    RunPartitionTests();
+    RunMemoryMapTests();
+    RunNumaTests();
+    RunPagingTests();
+
+    CHAR8 Script[128];
+    snprintf(Script, sizeof(Script), "rm -rf %s", mTempDir);
+    if (system(Script) != 0) {
+        fprintf(stderr, "test: cannot remove %s\n", mTempDir);
+    }
+
+    printf("%zu passed, %zu failed, %zu skipped\n", (size_t)mPassed, (size_t)mFailed, (size_t)mSkipped);
+    return mFailed == 0 ? 0 : 1;
+}
@@ -11,7 +11,131 @@
 #include <stdint.h>
 
 #define PXS_MAGIC 0x28082012
-#define PXS_PROTOCOL_VERSION 1
+#define PXS_PROTOCOL_VERSION 14
+
+// Boot stages recorded in PXS_BOOT_TIMING
+#define PXS_STAGE_VOLUME_OPEN        1
+#define PXS_STAGE_CONFIG             2
+#define PXS_STAGE_INITRD             3
+#define PXS_STAGE_KERNEL             4
+#define PXS_STAGE_GRAPHICS           5
+#define PXS_STAGE_SYSTEM_TABLES      6
+#define PXS_STAGE_TIMEOUT            7
+#define PXS_STAGE_MEMORY_MAP         8
+#define PXS_STAGE_EXIT_BOOT_SERVICES 9
+#define PXS_STAGE_MODULES            10
+#define PXS_STAGE_PAGING             11
+#define PXS_STAGE_SMP                12
+#define PXS_STAGE_CLOCKS             13
+
+// PXS_BOOT_INFO.Flags
+#define PXS_FLAG_PAGING        0x00000001  ///< Entered on loader-built page tables
+#define PXS_FLAG_KERNEL_SHA256 0x00000002  ///< KernelSha256 matched KERNEL_SHA256=
+#define PXS_FLAG_INITRD_SHA256 0x00000004  ///< InitrdSha256 matched INITRD_SHA256=
+
+#define PXS_TIMING_VERSION     1
+#define PXS_TIMING_MAX_ENTRIES 32
+
+#define PXS_INITRD_INDEX_VERSION 1
+
+#define PXS_MODULE_TABLE_VERSION 1
+#define PXS_MODULE_NAME_SIZE     64
+
+#define PXS_MEMORY_MAP_VERSION 1
+
+#define PXS_LOG_VERSION   1
+#define PXS_LOG_CAPACITY  256  ///< Records the loader keeps; older ones are overwritten
+#define PXS_LOG_TEXT_SIZE 116
+
+// PXS_LOG_RECORD.Level
+#define PXS_LOG_ERROR   1
+#define PXS_LOG_WARNING 2
+#define PXS_LOG_INFO    3
+#define PXS_LOG_VERBOSE 4
+
+// PXS_LOG_RECORD.Flags
+#define PXS_LOG_FLAG_CONSOLE   0x01  ///< Also written to the firmware console
+#define PXS_LOG_FLAG_TRUNCATED 0x02  ///< The message did not fit in Text
+
+#define PXS_CPU_TABLE_VERSION 1
+
+// PXS_CPU.Flags
+#define PXS_CPU_FLAG_BSP     0x00000001  ///< Runs the kernel entry point
+#define PXS_CPU_FLAG_ENABLED 0x00000002  ///< Enabled and healthy as the firmware reports it
+#define PXS_CPU_FLAG_PARKED  0x00000004  ///< Waiting on its mailbox
+
+// PXS_CPU_MAILBOX.State, written by the AP
+#define PXS_AP_STATE_STARTING 0
+#define PXS_AP_STATE_PARKED   1
+#define PXS_AP_STATE_RUNNING  2  ///< Took EntryPoint
+
+#define PXS_FIRMWARE_TABLES_VERSION 1
+
+// PXS_ACPI_TABLE.Flags
+#define PXS_ACPI_TABLE_BAD_CHECKSUM 0x01  ///< Bytes do not sum to 0; listed anyway
+#define PXS_ACPI_TABLE_NO_CHECKSUM  0x02  ///< FACS, which has none
+
+// PXS_ACPI_TABLE.Signature of a four-character ACPI signature
+#define PXS_ACPI_SIGNATURE(A, B, C, D) \
+    ((uint32_t)(A) | ((uint32_t)(B) << 8) | ((uint32_t)(C) << 16) | ((uint32_t)(D) << 24))
+
+#define PXS_NUMA_VERSION 1
+#define PXS_NUMA_NO_NODE 0xFFFFFFFF
+
+// PXS_NUMA_RANGE.Flags, from the SRAT memory affinity entry
+#define PXS_NUMA_RANGE_HOTPLUG     0x01
+#define PXS_NUMA_RANGE_NONVOLATILE 0x02
+
+#define PXS_CLOCKS_VERSION 1
+
+// PXS_CLOCKS.TscSource, best first
+#define PXS_CLOCK_SOURCE_NONE       0
+#define PXS_CLOCK_SOURCE_HYPERVISOR 1  ///< CPUID 0x40000010 timing leaf (kHz)
+#define PXS_CLOCK_SOURCE_CPUID      2  ///< CPUID 0x15 crystal and TSC ratio
+#define PXS_CLOCK_SOURCE_CPUID_BASE 3  ///< CPUID 0x15 ratio, crystal from the 0x16 base frequency (MHz)
+#define PXS_CLOCK_SOURCE_PM_TIMER   4  ///< Measured against the ACPI PM timer
+#define PXS_CLOCK_SOURCE_STALL      5  ///< Measured against the firmware's Stall()
+
+// PXS_CLOCKS.Flags, from CPUID
+#define PXS_CLOCK_INVARIANT_TSC 0x01  ///< Constant rate in every P-, C- and T-state
+#define PXS_CLOCK_TSC_DEADLINE  0x02  ///< LAPIC timer has TSC-deadline mode
+#define PXS_CLOCK_APIC_ARAT     0x04  ///< LAPIC timer keeps running in deep C-states
+
+// PXS_MEMORY_RANGE.Type
+#define PXS_MEMORY_USABLE           1
+#define PXS_MEMORY_RECLAIMABLE      2  ///< Firmware boot services; holds the entry stack
+#define PXS_MEMORY_LOADER           3  ///< Loader image, pool and page tables
+#define PXS_MEMORY_RESERVED         4
+#define PXS_MEMORY_ACPI_RECLAIMABLE 5
+#define PXS_MEMORY_ACPI_NVS         6
+#define PXS_MEMORY_MMIO             7
+#define PXS_MEMORY_KERNEL           8  ///< Kernel segments
+#define PXS_MEMORY_MODULE           9  ///< Initrd and MODULE= files
+#define PXS_MEMORY_HANDOFF          10 ///< Boot info arena, see PXS_BOOT_INFO.HandoffBase
+#define PXS_MEMORY_AP_PARK          11 ///< Parked AP code and mailboxes, see PXS_CPU_TABLE
+
+// EFI memory types of the loader's own allocations, from the range UEFI sets
+// aside for OS loaders. They appear in PXS_BOOT_INFO.MemoryMap as is.
+#define PXS_EFI_MEMORY_KERNEL  0x80000001
+#define PXS_EFI_MEMORY_MODULE  0x80000002
+#define PXS_EFI_MEMORY_HANDOFF 0x80000003
+#define PXS_EFI_MEMORY_AP_PARK 0x80000004
+
+// PXS_MEMORY_RANGE.Flags
+#define PXS_MEMORY_FLAG_RUNTIME 0x00000001  ///< Used by runtime services
+
+// PXS_FRAMEBUFFER_INFO.CacheType (Version >= 9; 0 before)
+#define PXS_FRAMEBUFFER_CACHE_UNKNOWN 0
+#define PXS_FRAMEBUFFER_CACHE_UC      1
+#define PXS_FRAMEBUFFER_CACHE_WC      2  ///< See PXS_BOOT_INFO.Framebuffer
+#define PXS_FRAMEBUFFER_CACHE_WT      3
+#define PXS_FRAMEBUFFER_CACHE_WB      4
+
+// File type bits of PXS_INITRD_FILE.Mode (as in st_mode)
+#define PXS_INITRD_S_IFMT  0170000
+#define PXS_INITRD_S_IFDIR 0040000
+#define PXS_INITRD_S_IFREG 0100000
+#define PXS_INITRD_S_IFLNK 0120000
 
 typedef uint64_t EFI_PHYSICAL_ADDRESS;
 typedef uint64_t EFI_VIRTUAL_ADDRESS;
@@ -57,15 +181,211 @@ typedef struct {
     uint8_t  BlueFieldPosition;
     uint8_t  ReservedMaskSize;
     uint8_t  ReservedFieldPosition;
+    uint8_t  CacheType;              ///< PXS_FRAMEBUFFER_CACHE_*
+    uint8_t  Reserved[3];
 } PXS_FRAMEBUFFER_INFO;
 
+typedef struct {
+    uint32_t Stage;           ///< PXS_STAGE_*
+    uint32_t ReadCalls;       ///< File Read() calls issued during the stage
+    uint64_t TscStart;
+    uint64_t TscEnd;
+    uint64_t BytesRead;
+    uint64_t BytesPerSecond;  ///< Effective read throughput, 0 if unknown
+} PXS_TIMING_ENTRY;
+
+typedef struct {
+    uint32_t         Version;        ///< PXS_TIMING_VERSION
+    uint32_t         EntryCount;
+    uint64_t         TscFrequency;   ///< Hz, 0 if unknown
+    uint64_t         TscLoaderEntry; ///< TSC on entry to the loader
+    uint64_t         TscKernelEntry; ///< TSC just before the jump to the kernel
+    PXS_TIMING_ENTRY Entries[PXS_TIMING_MAX_ENTRIES];
+} PXS_BOOT_TIMING;
+
+typedef struct {
+    uint64_t PathOffset;  ///< Offset of the NUL-terminated path from InitrdAddress, no leading "./" or "/"
+    uint64_t DataOffset;  ///< Offset of the file contents (symlink target for links) from InitrdAddress
+    uint64_t DataSize;
+    uint32_t PathLength;  ///< Excluding the NUL
+    uint32_t Mode;        ///< st_mode: type and permission bits
+} PXS_INITRD_FILE;
+
+// Entries are sorted by path (bytewise, shorter first on a common prefix).
+// When an archive lists a path twice, only the last occurrence is kept.
+typedef struct {
+    uint32_t         Version;     ///< PXS_INITRD_INDEX_VERSION
+    uint32_t         EntryCount;
+    PXS_INITRD_FILE *Entries;
+} PXS_INITRD_INDEX;
+
+typedef struct {
+    uint64_t Address;                    ///< Physical address, a multiple of Alignment
+    uint64_t Size;                       ///< Module bytes (decompressed); the tail up to Alignment is zeroed
+    uint64_t Alignment;                  ///< 4K by default, or as requested by MODULE=...,align=
+    char     Name[PXS_MODULE_NAME_SIZE]; ///< NUL-terminated
+} PXS_MODULE;
+
+typedef struct {
+    uint32_t    Version;      ///< PXS_MODULE_TABLE_VERSION
+    uint32_t    ModuleCount;
+    PXS_MODULE *Modules;      ///< In config order
+} PXS_MODULE_TABLE;
+
+typedef struct {
+    uint64_t Base;
+    uint64_t Length;
+    uint32_t Type;    ///< PXS_MEMORY_*
+    uint32_t Flags;   ///< PXS_MEMORY_FLAG_*
+} PXS_MEMORY_RANGE;
+
+// Sorted by Base, non-overlapping, with adjacent ranges of equal Type and Flags merged
+typedef struct {
+    uint32_t         Version;     ///< PXS_MEMORY_MAP_VERSION
+    uint32_t         EntryCount;
+    PXS_MEMORY_RANGE *Entries;
+} PXS_MEMORY_MAP;
+
+typedef struct {
+    uint64_t Tsc;                      ///< rdtsc when logged; PXS_BOOT_TIMING.TscFrequency converts
+    uint16_t Length;                   ///< Bytes of Text before the NUL
+    uint8_t  Level;                    ///< PXS_LOG_*
+    uint8_t  Flags;                    ///< PXS_LOG_FLAG_*
+    char     Text[PXS_LOG_TEXT_SIZE];  ///< One line, NUL-terminated, no newline
+} PXS_LOG_RECORD;
+
+// Ring of the loader's messages. Record i (counting from 0 over the whole
+// boot) is Records[i % Capacity]; the last min(Written, Capacity) are valid.
+typedef struct {
+    uint32_t       Version;     ///< PXS_LOG_VERSION
+    uint32_t       Capacity;
+    uint64_t       Written;     ///< Records logged, including overwritten ones
+    PXS_LOG_RECORD *Records;
+} PXS_LOG;
+
+// One per parked AP, each in its own 64-byte line, which the AP watches with
+// MONITOR/MWAIT where the CPU has them (otherwise it spins with PAUSE). To
+// start it, write StackPointer, Argument and PageTable, then EntryPoint. The
+// AP loads CR3 from PageTable unless it is 0, sets RSP to StackPointer, pushes
+// a 0 return address and jumps to EntryPoint in 64-bit mode with interrupts
+// off, RDI = Argument and RSI = its APIC ID. PageTable must map the first
+// page of PXS_CPU_TABLE.ParkBase to itself and must map the stack. The park
+// page tables only identity map the first 2 MiB.
+typedef struct {
+    volatile uint64_t EntryPoint;
+    volatile uint64_t StackPointer;
+    volatile uint64_t Argument;
+    volatile uint64_t PageTable;
+    uint32_t          ApicId;
+    volatile uint32_t State;      ///< PXS_AP_STATE_*
+    uint64_t          Reserved[3];
+} PXS_CPU_MAILBOX;
+
+typedef struct {
+    uint32_t ApicId;     ///< Initial (x2)APIC ID
+    uint32_t Flags;      ///< PXS_CPU_FLAG_*
+    uint32_t Package;
+    uint32_t Core;       ///< Within the package
+    uint32_t Thread;     ///< Within the core
+    uint32_t Reserved;
+    uint64_t Mailbox;    ///< Physical address of its PXS_CPU_MAILBOX, 0 if none
+} PXS_CPU;
+
+// Every CPU the firmware reported, in its processor number order
+typedef struct {
+    uint32_t  Version;   ///< PXS_CPU_TABLE_VERSION
+    uint32_t  CpuCount;
+    uint64_t  ParkBase;  ///< PXS_MEMORY_AP_PARK block: park code, its page tables, mailboxes
+    uint64_t  ParkSize;  ///< Reclaimable once every parked AP has left it
+    PXS_CPU *Cpus;
+} PXS_CPU_TABLE;
+
+// An ACPI table: the XSDT (or RSDT), every table it lists, and the DSDT and
+// FACS of the FADT
+typedef struct {
+    uint32_t Signature;  ///< Header signature as a little-endian number, see PXS_ACPI_SIGNATURE
+    uint32_t Length;     ///< Header Length
+    uint64_t Address;
+    uint8_t  Revision;   ///< Header Revision (FACS: Version)
+    uint8_t  Flags;      ///< PXS_ACPI_TABLE_*
+    uint16_t Instance;   ///< Among tables with this signature, in root table order (SSDTs repeat)
+    uint32_t Reserved;
+} PXS_ACPI_TABLE;
+
+// An SMBIOS structure
+typedef struct {
+    uint64_t Address;  ///< Formatted area, starting with the Type/Length/Handle header
+    uint32_t Size;     ///< Formatted area and string set, up to and including its double NUL
+    uint16_t Handle;
+    uint8_t  Type;
+    uint8_t  Length;   ///< Formatted area (header Length)
+} PXS_SMBIOS_STRUCTURE;
+
+// ACPI tables and SMBIOS structures indexed once at load time, so the kernel
+// can look them up without walking firmware memory. Addresses are physical.
+typedef struct {
+    uint32_t             Version;           ///< PXS_FIRMWARE_TABLES_VERSION
+    uint32_t             AcpiCount;
+    PXS_ACPI_TABLE       *Acpi;             ///< Sorted by Signature (as a number), then Instance
+    uint8_t              SmbiosMajor;       ///< Version of the entry point walked, 0 without SMBIOS
+    uint8_t              SmbiosMinor;
+    uint16_t             Reserved;
+    uint32_t             SmbiosCount;
+    PXS_SMBIOS_STRUCTURE *Smbios;           ///< Sorted by Type, then table order; no end-of-table entry
+    uint64_t             SmbiosEntryPoint;  ///< The "_SM3_" (preferred) or "_SM_" entry point walked
+} PXS_FIRMWARE_TABLES;
+
+// Memory the SRAT assigns to a node. This is affinity only; the memory map
+// says which parts of it are RAM
+typedef struct {
+    uint64_t Base;
+    uint64_t Length;
+    uint32_t Node;   ///< Index into PXS_NUMA.Nodes
+    uint32_t Flags;  ///< PXS_NUMA_RANGE_*
+} PXS_NUMA_RANGE;
+
+typedef struct {
+    uint32_t Domain;      ///< ACPI proximity domain
+    uint32_t CpuCount;    ///< Enabled SRAT processor entries
+    uint32_t FirstRange;  ///< Its ranges are Ranges[FirstRange, FirstRange + RangeCount)
+    uint32_t RangeCount;
+} PXS_NUMA_NODE;
+
+// Proximity domains from the SRAT and the SLIT distances between them. The
+// loader places what it loads and hands over in BspNode's memory when it can.
+typedef struct {
+    uint32_t       Version;     ///< PXS_NUMA_VERSION
+    uint32_t       NodeCount;
+    uint32_t       RangeCount;
+    uint32_t       BspNode;     ///< Node of the boot CPU, PXS_NUMA_NO_NODE if the SRAT does not list it
+    PXS_NUMA_NODE  *Nodes;      ///< Sorted by Domain
+    PXS_NUMA_RANGE *Ranges;     ///< Sorted by Node, then Base
+    uint8_t        *Distances;  ///< SLIT distance From -> To at [From * NodeCount + To], 0 where the
+                                ///< SLIT has no entry; NULL without a SLIT
+} PXS_NUMA;
+
+// Clock rates the loader measured or read while it had boot services, so
+// the kernel need not calibrate against the PIT or HPET
+typedef struct {
+    uint32_t Version;             ///< PXS_CLOCKS_VERSION
+    uint32_t Flags;               ///< PXS_CLOCK_*
+    uint64_t TscFrequency;        ///< Hz, 0 if unknown
+    uint32_t TscSource;           ///< PXS_CLOCK_SOURCE_*
+    uint32_t TscErrorPpm;         ///< Bound on the error of TscFrequency in ppm, counting the crystal tolerance
+    uint64_t CrystalFrequency;    ///< Hz of the core crystal clock (CPUID 0x15), 0 if unknown
+    uint64_t ApicTimerFrequency;  ///< Hz the LAPIC timer counts at with divide-by-1, 0 if unknown
+} PXS_CLOCKS;
+
 typedef struct {
     // Header
     uint32_t                Magic;           ///< "PXS!" (0x21535850)
     uint32_t                Version;         ///< Protocol Version
     uint32_t                Flags;           ///< Boot Flags
 
-    // Framebuffer
+    // Framebuffer. BaseAddress is 0 when there is none (headless boot). With
+    // CacheType WC the firmware made it write-combining (MTRRs, on every CPU),
+    // or, with PXS_FLAG_PAGING, the loader page tables map it through IA32_PAT
+    // entry 5, which the loader sets to WC on the boot CPU and parked APs.
     PXS_FRAMEBUFFER_INFO    Framebuffer;
     // Memory Map
     EFI_MEMORY_DESCRIPTOR   *MemoryMap;
@@ -91,4 +411,56 @@ typedef struct {
 
     // Security Verification
     uint64_t                SecurityCanary;
+
+    // Boot Timing (Version >= 2)
+    PXS_BOOT_TIMING         *Timing;
+
+    // Initrd cpio index (Version >= 3), NULL if the initrd is not a newc archive
+    PXS_INITRD_INDEX        *InitrdIndex;
+
+    // Modules from MODULE= lines (Version >= 4), NULL if none
+    PXS_MODULE_TABLE        *ModuleTable;
+
+    // Loader page tables (Version >= 5), valid when Flags has PXS_FLAG_PAGING.
+    // Physical memory below DirectMapSize is mapped both at DirectMapBase and
+    // by identity, no-execute (only the loader image is executable in the
+    // identity map), RAM write-back and the rest uncached.
+    uint64_t                PageTableRoot;   ///< Physical address loaded into CR3
+    uint64_t                DirectMapBase;   ///< Virtual address of physical 0
+    uint64_t                DirectMapSize;   ///< Bytes of physical memory in the direct map
+    uint32_t                PagingLevels;    ///< 4 or 5
+
+    // Normalized memory map (Version >= 6), NULL if it could not be built
+    PXS_MEMORY_MAP          *NormalizedMemoryMap;
+
+    // SHA-256 of the kernel and initrd files as stored (Version >= 7), valid
+    // when Flags has PXS_FLAG_KERNEL_SHA256 / PXS_FLAG_INITRD_SHA256
+    uint8_t                 KernelSha256[32];
+    uint8_t                 InitrdSha256[32];
+
+    // Handoff arena (Version >= 8). This structure sits at HandoffBase, and every
+    // pointer in it except Rsdp, Smbios and RuntimeServicesPtr points inside
+    // [HandoffBase, HandoffBase + HandoffSize), so Pointer - HandoffBase is a
+    // stable offset if the kernel moves or remaps the block. The pages have
+    // type PXS_EFI_MEMORY_HANDOFF and can be reclaimed in one piece once read.
+    uint64_t                HandoffBase;
+    uint64_t                HandoffSize;
+
+    // Loader messages (Version >= 10), all of them whatever LOG= let through to
+    // the console. NULL if the ring could not be allocated
+    PXS_LOG                 *Log;
+
+    // CPUs and parked APs (Version >= 11), NULL without MP services or with SMP=0
+    PXS_CPU_TABLE           *CpuTable;
+
+    // ACPI table and SMBIOS structure directory (Version >= 12), NULL when the
+    // firmware has neither
+    PXS_FIRMWARE_TABLES     *FirmwareTables;
+
+    // SRAT proximity domains and SLIT distances (Version >= 13), NULL without
+    // an SRAT
+    PXS_NUMA                *Numa;
+
+    // TSC and timer rates (Version >= 14), NULL if the allocation failed
+    PXS_CLOCKS              *Clocks;
 } PXS_BOOT_INFO;
@@ -0,0 +1,708 @@
+// SPDX License identifier: GPL-2.0-or-later
+/**
+ * @file protocol.hpp
+ * @brief Header-only C++ views over the PXS boot protocol
+ *
+ * Freestanding and allocation free: every view is a pointer and a length into
+ * the handoff data, and every accessor is inline. Accessors for fields added
+ * after version 1 return an empty view when the loader is older.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace pxs {
+
+// --------------------------------------------------------------------------
+// LAYOUT
+// --------------------------------------------------------------------------
+
+// The loader builds PXS_BOOT_INFO from Pxs/include/protocol.h, which asserts
+// the same numbers. A field added to only one copy fails one of the builds.
+namespace layout {
+
+static_assert(sizeof(void *) == 8, "The boot protocol is defined for 64-bit kernels");
+
+static_assert(sizeof(EFI_MEMORY_DESCRIPTOR) == 40, "EFI_MEMORY_DESCRIPTOR size");
+static_assert(sizeof(PXS_FRAMEBUFFER_INFO) == 40, "PXS_FRAMEBUFFER_INFO size");
+static_assert(offsetof(PXS_FRAMEBUFFER_INFO, CacheType) == 36, "CacheType");
+static_assert(sizeof(PXS_TIMING_ENTRY) == 40, "PXS_TIMING_ENTRY size");
+static_assert(sizeof(PXS_BOOT_TIMING) == 32 + 40 * PXS_TIMING_MAX_ENTRIES, "PXS_BOOT_TIMING size");
+static_assert(sizeof(PXS_INITRD_FILE) == 32, "PXS_INITRD_FILE size");
+static_assert(sizeof(PXS_INITRD_INDEX) == 16, "PXS_INITRD_INDEX size");
+static_assert(sizeof(PXS_MODULE) == 24 + PXS_MODULE_NAME_SIZE, "PXS_MODULE size");
+static_assert(sizeof(PXS_MODULE_TABLE) == 16, "PXS_MODULE_TABLE size");
+static_assert(sizeof(PXS_MEMORY_RANGE) == 24, "PXS_MEMORY_RANGE size");
+static_assert(sizeof(PXS_MEMORY_MAP) == 16, "PXS_MEMORY_MAP size");
+static_assert(sizeof(PXS_LOG_RECORD) == 128, "PXS_LOG_RECORD size");
+static_assert(sizeof(PXS_LOG) == 24, "PXS_LOG size");
+static_assert(sizeof(PXS_CPU_MAILBOX) == 64, "PXS_CPU_MAILBOX size");
+static_assert(sizeof(PXS_CPU) == 32, "PXS_CPU size");
+static_assert(sizeof(PXS_CPU_TABLE) == 32, "PXS_CPU_TABLE size");
+static_assert(sizeof(PXS_ACPI_TABLE) == 24, "PXS_ACPI_TABLE size");
+static_assert(sizeof(PXS_SMBIOS_STRUCTURE) == 16, "PXS_SMBIOS_STRUCTURE size");
+static_assert(sizeof(PXS_FIRMWARE_TABLES) == 40, "PXS_FIRMWARE_TABLES size");
+static_assert(sizeof(PXS_NUMA_RANGE) == 24, "PXS_NUMA_RANGE size");
+static_assert(sizeof(PXS_NUMA_NODE) == 16, "PXS_NUMA_NODE size");
+static_assert(sizeof(PXS_NUMA) == 40, "PXS_NUMA size");
+static_assert(sizeof(PXS_CLOCKS) == 40, "PXS_CLOCKS size");
+static_assert(sizeof(PXS_BOOT_INFO) == 360, "PXS_BOOT_INFO size");
+
+static_assert(offsetof(PXS_BOOT_INFO, Magic) == 0, "Magic");
+static_assert(offsetof(PXS_BOOT_INFO, Version) == 4, "Version");
+static_assert(offsetof(PXS_BOOT_INFO, Flags) == 8, "Flags");
+static_assert(offsetof(PXS_BOOT_INFO, Framebuffer) == 16, "Framebuffer");
+static_assert(offsetof(PXS_BOOT_INFO, MemoryMap) == 56, "MemoryMap");
+static_assert(offsetof(PXS_BOOT_INFO, MemoryMapSize) == 64, "MemoryMapSize");
+static_assert(offsetof(PXS_BOOT_INFO, MapKey) == 72, "MapKey");
+static_assert(offsetof(PXS_BOOT_INFO, DescriptorSize) == 80, "DescriptorSize");
+static_assert(offsetof(PXS_BOOT_INFO, DescriptorVersion) == 88, "DescriptorVersion");
+static_assert(offsetof(PXS_BOOT_INFO, Rsdp) == 96, "Rsdp");
+static_assert(offsetof(PXS_BOOT_INFO, Smbios) == 104, "Smbios");
+static_assert(offsetof(PXS_BOOT_INFO, RuntimeServicesPtr) == 112, "RuntimeServicesPtr");
+static_assert(offsetof(PXS_BOOT_INFO, KernelPhysicalBase) == 120, "KernelPhysicalBase");
+static_assert(offsetof(PXS_BOOT_INFO, KernelFileSize) == 128, "KernelFileSize");
+static_assert(offsetof(PXS_BOOT_INFO, KernelVirtualBase) == 136, "KernelVirtualBase");
+static_assert(offsetof(PXS_BOOT_INFO, InitrdAddress) == 144, "InitrdAddress");
+static_assert(offsetof(PXS_BOOT_INFO, InitrdSize) == 152, "InitrdSize");
+static_assert(offsetof(PXS_BOOT_INFO, CommandLine) == 160, "CommandLine");
+static_assert(offsetof(PXS_BOOT_INFO, SecurityCanary) == 168, "SecurityCanary");
+static_assert(offsetof(PXS_BOOT_INFO, Timing) == 176, "Timing");
+static_assert(offsetof(PXS_BOOT_INFO, InitrdIndex) == 184, "InitrdIndex");
+static_assert(offsetof(PXS_BOOT_INFO, ModuleTable) == 192, "ModuleTable");
+static_assert(offsetof(PXS_BOOT_INFO, PageTableRoot) == 200, "PageTableRoot");
+static_assert(offsetof(PXS_BOOT_INFO, DirectMapBase) == 208, "DirectMapBase");
+static_assert(offsetof(PXS_BOOT_INFO, DirectMapSize) == 216, "DirectMapSize");
+static_assert(offsetof(PXS_BOOT_INFO, PagingLevels) == 224, "PagingLevels");
+static_assert(offsetof(PXS_BOOT_INFO, NormalizedMemoryMap) == 232, "NormalizedMemoryMap");
+static_assert(offsetof(PXS_BOOT_INFO, KernelSha256) == 240, "KernelSha256");
+static_assert(offsetof(PXS_BOOT_INFO, InitrdSha256) == 272, "InitrdSha256");
+static_assert(offsetof(PXS_BOOT_INFO, HandoffBase) == 304, "HandoffBase");
+static_assert(offsetof(PXS_BOOT_INFO, HandoffSize) == 312, "HandoffSize");
+static_assert(offsetof(PXS_BOOT_INFO, Log) == 320, "Log");
+static_assert(offsetof(PXS_BOOT_INFO, CpuTable) == 328, "CpuTable");
+static_assert(offsetof(PXS_BOOT_INFO, FirmwareTables) == 336, "FirmwareTables");
+static_assert(offsetof(PXS_BOOT_INFO, Numa) == 344, "Numa");
+static_assert(offsetof(PXS_BOOT_INFO, Clocks) == 352, "Clocks");
+
+} // namespace layout
+
+// --------------------------------------------------------------------------
+// SPAN
+// --------------------------------------------------------------------------
+
+// Contiguous, non-owning view; <span> is not part of a freestanding library
+template <typename T>
+class Span {
+public:
+    constexpr Span() = default;
+    constexpr Span(T *Data, std::size_t Size) : m_Data(Data), m_Size(Data ? Size : 0) {}
+
+    constexpr T *data() const { return m_Data; }
+    constexpr std::size_t size() const { return m_Size; }
+    constexpr bool empty() const { return m_Size == 0; }
+    constexpr T *begin() const { return m_Data; }
+    constexpr T *end() const { return m_Data + m_Size; }
+    constexpr T &operator[](std::size_t Index) const { return m_Data[Index]; }
+
+    constexpr Span Subspan(std::size_t Offset, std::size_t Count) const {
+        if (Offset > m_Size) return Span();
+        return Span(m_Data + Offset, Count < m_Size - Offset ? Count : m_Size - Offset);
+    }
+
+private:
+    T *m_Data = nullptr;
+    std::size_t m_Size = 0;
+};
+
+using Bytes = Span<const std::uint8_t>;
+using Chars = Span<const char>;
+
+inline constexpr bool Equal(Chars A, Chars B) {
+    if (A.size() != B.size()) return false;
+    for (std::size_t i = 0; i < A.size(); i++) {
+        if (A[i] != B[i]) return false;
+    }
+    return true;
+}
+
+// Bytewise order, shorter first on a common prefix (as the initrd index is sorted)
+inline constexpr int Compare(Chars A, Chars B) {
+    std::size_t Common = A.size() < B.size() ? A.size() : B.size();
+    for (std::size_t i = 0; i < Common; i++) {
+        auto X = static_cast<unsigned char>(A[i]);
+        auto Y = static_cast<unsigned char>(B[i]);
+        if (X != Y) return X < Y ? -1 : 1;
+    }
+    if (A.size() == B.size()) return 0;
+    return A.size() < B.size() ? -1 : 1;
+}
+
+inline constexpr Chars CString(const char *Text) {
+    std::size_t Length = 0;
+    if (Text) {
+        while (Text[Length] != '\0') Length++;
+    }
+    return Chars(Text, Length);
+}
+
+// --------------------------------------------------------------------------
+// MEMORY MAP
+// --------------------------------------------------------------------------
+
+// Firmware descriptors are DescriptorSize apart, which may exceed
+// sizeof(EFI_MEMORY_DESCRIPTOR); plain pointer arithmetic would be wrong.
+class DescriptorIterator {
+public:
+    using value_type = EFI_MEMORY_DESCRIPTOR;
+    using difference_type = std::ptrdiff_t;
+    using reference = const EFI_MEMORY_DESCRIPTOR &;
+    using pointer = const EFI_MEMORY_DESCRIPTOR *;
+
+    constexpr DescriptorIterator() = default;
+    constexpr DescriptorIterator(const std::uint8_t *Position, std::size_t Stride)
+        : m_Position(Position), m_Stride(Stride) {}
+
+    reference operator*() const { return *reinterpret_cast<pointer>(m_Position); }
+    pointer operator->() const { return reinterpret_cast<pointer>(m_Position); }
+    reference operator[](difference_type N) const { return *(*this + N); }
+
+    DescriptorIterator &operator++() { m_Position += m_Stride; return *this; }
+    DescriptorIterator &operator--() { m_Position -= m_Stride; return *this; }
+    DescriptorIterator operator++(int) { auto Old = *this; ++*this; return Old; }
+    DescriptorIterator operator--(int) { auto Old = *this; --*this; return Old; }
+    DescriptorIterator &operator+=(difference_type N) { m_Position += N * static_cast<difference_type>(m_Stride); return *this; }
+    DescriptorIterator &operator-=(difference_type N) { return *this += -N; }
+
+    friend DescriptorIterator operator+(DescriptorIterator I, difference_type N) { return I += N; }
+    friend DescriptorIterator operator+(difference_type N, DescriptorIterator I) { return I += N; }
+    friend DescriptorIterator operator-(DescriptorIterator I, difference_type N) { return I -= N; }
+    friend difference_type operator-(DescriptorIterator A, DescriptorIterator B) {
+        return (A.m_Position - B.m_Position) / static_cast<difference_type>(A.m_Stride);
+    }
+
+    friend bool operator==(DescriptorIterator A, DescriptorIterator B) { return A.m_Position == B.m_Position; }
+    friend bool operator!=(DescriptorIterator A, DescriptorIterator B) { return A.m_Position != B.m_Position; }
+    friend bool operator<(DescriptorIterator A, DescriptorIterator B) { return A.m_Position < B.m_Position; }
+    friend bool operator>(DescriptorIterator A, DescriptorIterator B) { return A.m_Position > B.m_Position; }
+    friend bool operator<=(DescriptorIterator A, DescriptorIterator B) { return A.m_Position <= B.m_Position; }
+    friend bool operator>=(DescriptorIterator A, DescriptorIterator B) { return A.m_Position >= B.m_Position; }
+
+private:
+    const std::uint8_t *m_Position = nullptr;
+    std::size_t m_Stride = sizeof(EFI_MEMORY_DESCRIPTOR);
+};
+
+// The firmware memory map as returned by the last GetMemoryMap
+class MemoryMap {
+public:
+    constexpr MemoryMap() = default;
+    MemoryMap(const EFI_MEMORY_DESCRIPTOR *Map, std::uint64_t MapSize, std::uint64_t DescriptorSize)
+        : m_Map(reinterpret_cast<const std::uint8_t *>(Map)), m_Stride(DescriptorSize) {
+        // A stride below the structure size means a corrupt handoff; show nothing
+        m_Count = (Map && DescriptorSize >= sizeof(EFI_MEMORY_DESCRIPTOR)) ? MapSize / DescriptorSize : 0;
+    }
+
+    std::size_t size() const { return m_Count; }
+    bool empty() const { return m_Count == 0; }
+    DescriptorIterator begin() const { return DescriptorIterator(m_Map, m_Stride); }
+    DescriptorIterator end() const { return begin() + static_cast<std::ptrdiff_t>(m_Count); }
+    const EFI_MEMORY_DESCRIPTOR &operator[](std::size_t Index) const { return begin()[static_cast<std::ptrdiff_t>(Index)]; }
+
+private:
+    const std::uint8_t *m_Map = nullptr;
+    std::size_t m_Stride = sizeof(EFI_MEMORY_DESCRIPTOR);
+    std::size_t m_Count = 0;
+};
+
+inline constexpr std::uint64_t DescriptorEnd(const EFI_MEMORY_DESCRIPTOR &Desc) {
+    return Desc.PhysicalStart + Desc.NumberOfPages * 4096;
+}
+
+// --------------------------------------------------------------------------
+// COMMAND LINE
+// --------------------------------------------------------------------------
+
+class CommandLine {
+public:
+    // Walks space-separated arguments; quoting is left to the kernel
+    class Iterator {
+    public:
+        constexpr Iterator(Chars Text, std::size_t Position) : m_Text(Text), m_Start(Skip(Text, Position)) {
+            m_End = m_Start;
+            while (m_End < m_Text.size() && m_Text[m_End] != ' ') m_End++;
+        }
+
+        constexpr Chars operator*() const { return m_Text.Subspan(m_Start, m_End - m_Start); }
+        constexpr Iterator &operator++() { return *this = Iterator(m_Text, m_End); }
+        constexpr bool operator==(const Iterator &Other) const { return m_Start == Other.m_Start; }
+        constexpr bool operator!=(const Iterator &Other) const { return m_Start != Other.m_Start; }
+
+    private:
+        static constexpr std::size_t Skip(Chars Text, std::size_t Position) {
+            while (Position < Text.size() && Text[Position] == ' ') Position++;
+            return Position;
+        }
+
+        Chars m_Text;
+        std::size_t m_Start;
+        std::size_t m_End = 0;
+    };
+
+    constexpr CommandLine() = default;
+    constexpr explicit CommandLine(Chars Text) : m_Text(Text) {}
+
+    constexpr Chars Text() const { return m_Text; }
+    constexpr bool empty() const { return m_Text.empty(); }
+    constexpr Iterator begin() const { return Iterator(m_Text, 0); }
+    constexpr Iterator end() const { return Iterator(m_Text, m_Text.size()); }
+
+    // True if Key appears bare or as Key=...
+    constexpr bool Has(Chars Key) const {
+        for (Chars Arg : *this) {
+            if (Equal(Arg, Key) || (Arg.size() > Key.size() && Arg[Key.size()] == '=' && Equal(Arg.Subspan(0, Key.size()), Key))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Value of the last Key=Value argument, empty if there is none
+    constexpr Chars Value(Chars Key) const {
+        Chars Found;
+        for (Chars Arg : *this) {
+            if (Arg.size() > Key.size() && Arg[Key.size()] == '=' && Equal(Arg.Subspan(0, Key.size()), Key)) {
+                Found = Arg.Subspan(Key.size() + 1, Arg.size());
+            }
+        }
+        return Found;
+    }
+
+private:
+    Chars m_Text;
+};
+
+// --------------------------------------------------------------------------
+// INITRD
+// --------------------------------------------------------------------------
+
+class InitrdFile {
+public:
+    constexpr InitrdFile() = default;
+    constexpr InitrdFile(const std::uint8_t *Initrd, const PXS_INITRD_FILE *File) : m_Initrd(Initrd), m_File(File) {}
+
+    constexpr explicit operator bool() const { return m_File != nullptr; }
+    constexpr const PXS_INITRD_FILE *Raw() const { return m_File; }
+
+    Chars Path() const {
+        return Chars(reinterpret_cast<const char *>(m_Initrd + m_File->PathOffset), m_File->PathLength);
+    }
+    // File contents, or the target of a symlink
+    Bytes Data() const { return Bytes(m_Initrd + m_File->DataOffset, m_File->DataSize); }
+
+    constexpr std::uint32_t Type() const { return m_File->Mode & PXS_INITRD_S_IFMT; }
+    constexpr bool IsFile() const { return Type() == PXS_INITRD_S_IFREG; }
+    constexpr bool IsDirectory() const { return Type() == PXS_INITRD_S_IFDIR; }
+    constexpr bool IsSymlink() const { return Type() == PXS_INITRD_S_IFLNK; }
+
+private:
+    const std::uint8_t *m_Initrd = nullptr;
+    const PXS_INITRD_FILE *m_File = nullptr;
+};
+
+class Initrd {
+public:
+    constexpr Initrd() = default;
+    constexpr Initrd(Bytes Image, Span<const PXS_INITRD_FILE> Files) : m_Image(Image), m_Files(Files) {}
+
+    constexpr Bytes Image() const { return m_Image; }
+    // Index entries, empty when the initrd is not a newc archive
+    constexpr Span<const PXS_INITRD_FILE> Files() const { return m_Files; }
+
+    // Binary search of the index; Path has no leading "./" or "/"
+    InitrdFile Find(Chars Path) const {
+        std::size_t Low = 0, High = m_Files.size();
+        while (Low < High) {
+            std::size_t Mid = Low + (High - Low) / 2;
+            InitrdFile File(m_Image.data(), &m_Files[Mid]);
+            int Order = Compare(File.Path(), Path);
+            if (Order == 0) return File;
+            if (Order < 0) Low = Mid + 1;
+            else High = Mid;
+        }
+        return InitrdFile();
+    }
+
+private:
+    Bytes m_Image;
+    Span<const PXS_INITRD_FILE> m_Files;
+};
+
+// --------------------------------------------------------------------------
+// FRAMEBUFFER
+// --------------------------------------------------------------------------
+
+enum class PixelFormat {
+    Rgbx8,    ///< Red in the low byte (PixelRedGreenBlueReserved8BitPerColor)
+    Bgrx8,    ///< Blue in the low byte (PixelBlueGreenRedReserved8BitPerColor)
+    Bitmask,  ///< Anything else: positions and sizes come from PXS_FRAMEBUFFER_INFO
+};
+
+// Packing of an 8-bit-per-channel colour into one 32-bit pixel
+template <PixelFormat Format>
+struct PixelPacker;
+
+template <>
+struct PixelPacker<PixelFormat::Rgbx8> {
+    explicit constexpr PixelPacker(const PXS_FRAMEBUFFER_INFO &) {}
+    constexpr std::uint32_t operator()(std::uint8_t R, std::uint8_t G, std::uint8_t B) const {
+        return static_cast<std::uint32_t>(R) | (static_cast<std::uint32_t>(G) << 8) | (static_cast<std::uint32_t>(B) << 16);
+    }
+};
+
+template <>
+struct PixelPacker<PixelFormat::Bgrx8> {
+    explicit constexpr PixelPacker(const PXS_FRAMEBUFFER_INFO &) {}
+    constexpr std::uint32_t operator()(std::uint8_t R, std::uint8_t G, std::uint8_t B) const {
+        return static_cast<std::uint32_t>(B) | (static_cast<std::uint32_t>(G) << 8) | (static_cast<std::uint32_t>(R) << 16);
+    }
+};
+
+template <>
+struct PixelPacker<PixelFormat::Bitmask> {
+    explicit constexpr PixelPacker(const PXS_FRAMEBUFFER_INFO &Info) : m_Info(Info) {}
+    constexpr std::uint32_t operator()(std::uint8_t R, std::uint8_t G, std::uint8_t B) const {
+        return Channel(R, m_Info.RedMaskSize, m_Info.RedFieldPosition) |
+               Channel(G, m_Info.GreenMaskSize, m_Info.GreenFieldPosition) |
+               Channel(B, m_Info.BlueMaskSize, m_Info.BlueFieldPosition);
+    }
+
+private:
+    // Keep the top Size bits of the 8-bit value
+    static constexpr std::uint32_t Channel(std::uint8_t Value, std::uint8_t Size, std::uint8_t Position) {
+        if (Size == 0 || Position >= 32) return 0;
+        std::uint32_t Scaled = Size >= 8 ? static_cast<std::uint32_t>(Value) << (Size - 8) : Value >> (8 - Size);
+        return Scaled << Position;
+    }
+
+    PXS_FRAMEBUFFER_INFO m_Info;
+};
+
+template <PixelFormat Format>
+class Framebuffer {
+public:
+    explicit Framebuffer(const PXS_FRAMEBUFFER_INFO &Info)
+        : m_Pixels(reinterpret_cast<volatile std::uint32_t *>(static_cast<std::uintptr_t>(Info.BaseAddress))),
+          m_Width(Info.Width), m_Height(Info.Height), m_Pitch(Info.PixelsPerScanLine), m_Pack(Info) {}
+
+    std::uint32_t Width() const { return m_Width; }
+    std::uint32_t Height() const { return m_Height; }
+    constexpr std::uint32_t Pack(std::uint8_t R, std::uint8_t G, std::uint8_t B) const { return m_Pack(R, G, B); }
+
+    void Put(std::uint32_t X, std::uint32_t Y, std::uint32_t Pixel) const {
+        if (X < m_Width && Y < m_Height) m_Pixels[static_cast<std::size_t>(Y) * m_Pitch + X] = Pixel;
+    }
+
+    void Fill(std::uint32_t X, std::uint32_t Y, std::uint32_t Width, std::uint32_t Height, std::uint32_t Pixel) const {
+        if (X >= m_Width || Y >= m_Height) return;
+        std::uint32_t EndX = (Width < m_Width - X) ? X + Width : m_Width;
+        std::uint32_t EndY = (Height < m_Height - Y) ? Y + Height : m_Height;
+        for (std::uint32_t Row = Y; Row < EndY; Row++) {
+            volatile std::uint32_t *Line = m_Pixels + static_cast<std::size_t>(Row) * m_Pitch;
+            for (std::uint32_t Column = X; Column < EndX; Column++) Line[Column] = Pixel;
+        }
+    }
+
+private:
+    volatile std::uint32_t *m_Pixels;
+    std::uint32_t m_Width;
+    std::uint32_t m_Height;
+    std::uint32_t m_Pitch;
+    PixelPacker<Format> m_Pack;
+};
+
+inline constexpr PixelFormat DetectPixelFormat(const PXS_FRAMEBUFFER_INFO &Info) {
+    bool Byte = Info.RedMaskSize == 8 && Info.GreenMaskSize == 8 && Info.BlueMaskSize == 8 && Info.GreenFieldPosition == 8;
+    if (Byte && Info.RedFieldPosition == 0 && Info.BlueFieldPosition == 16) return PixelFormat::Rgbx8;
+    if (Byte && Info.RedFieldPosition == 16 && Info.BlueFieldPosition == 0) return PixelFormat::Bgrx8;
+    return PixelFormat::Bitmask;
+}
+
+// Call Fn with the Framebuffer<Format> matching Info, so the drawing code is
+// instantiated once per format and the format is checked once, not per pixel.
+// Fn is not called when there is no framebuffer (headless boot).
+template <typename Function>
+void WithFramebuffer(const PXS_FRAMEBUFFER_INFO &Info, Function &&Fn) {
+    if (Info.BaseAddress == 0 || Info.Width == 0 || Info.Height == 0) return;
+    switch (DetectPixelFormat(Info)) {
+        case PixelFormat::Rgbx8:
+            Fn(Framebuffer<PixelFormat::Rgbx8>(Info));
+            break;
+        case PixelFormat::Bgrx8:
+            Fn(Framebuffer<PixelFormat::Bgrx8>(Info));
+            break;
+        case PixelFormat::Bitmask:
+            Fn(Framebuffer<PixelFormat::Bitmask>(Info));
+            break;
+    }
+}
+
+// --------------------------------------------------------------------------
+// LOADER LOG
+// --------------------------------------------------------------------------
+
+// The loader's message ring, indexed oldest record first
+class LoaderLog {
+public:
+    constexpr LoaderLog() = default;
+    constexpr explicit LoaderLog(const PXS_LOG *Log) : m_Log(Log && Log->Capacity != 0 ? Log : nullptr) {}
+
+    constexpr std::size_t size() const {
+        if (!m_Log) return 0;
+        return m_Log->Written < m_Log->Capacity ? static_cast<std::size_t>(m_Log->Written) : m_Log->Capacity;
+    }
+    constexpr bool empty() const { return size() == 0; }
+
+    // Records overwritten before the kernel started
+    constexpr std::uint64_t Dropped() const { return m_Log ? m_Log->Written - size() : 0; }
+
+    constexpr const PXS_LOG_RECORD &operator[](std::size_t Index) const {
+        return m_Log->Records[(m_Log->Written - size() + Index) % m_Log->Capacity];
+    }
+
+    static constexpr Chars Text(const PXS_LOG_RECORD &Record) {
+        return Chars(Record.Text, Record.Length < PXS_LOG_TEXT_SIZE ? Record.Length : PXS_LOG_TEXT_SIZE - 1);
+    }
+
+private:
+    const PXS_LOG *m_Log = nullptr;
+};
+
+// --------------------------------------------------------------------------
+// SMP
+// --------------------------------------------------------------------------
+
+// Wake a parked AP (see PXS_CPU_MAILBOX), through wherever the kernel maps
+// PXS_CPU.Mailbox. EntryPoint is stored last with release order, so the AP
+// sees the rest once it sees it.
+inline void StartParkedAp(PXS_CPU_MAILBOX *Mailbox, std::uint64_t EntryPoint, std::uint64_t StackPointer,
+                          std::uint64_t Argument, std::uint64_t PageTable) {
+    Mailbox->StackPointer = StackPointer;
+    Mailbox->Argument = Argument;
+    Mailbox->PageTable = PageTable;
+    __atomic_store_n(&Mailbox->EntryPoint, EntryPoint, __ATOMIC_RELEASE);
+}
+
+inline bool ParkedApRunning(const PXS_CPU_MAILBOX *Mailbox) {
+    return __atomic_load_n(&Mailbox->State, __ATOMIC_ACQUIRE) == PXS_AP_STATE_RUNNING;
+}
+
+// --------------------------------------------------------------------------
+// FIRMWARE TABLES
+// --------------------------------------------------------------------------
+
+// PXS_ACPI_TABLE.Signature of a table name, e.g. AcpiSignature("APIC")
+inline constexpr std::uint32_t AcpiSignature(const char (&Name)[5]) {
+    return PXS_ACPI_SIGNATURE(static_cast<unsigned char>(Name[0]), static_cast<unsigned char>(Name[1]),
+                              static_cast<unsigned char>(Name[2]), static_cast<unsigned char>(Name[3]));
+}
+
+// Lookups in the loader's ACPI and SMBIOS directory, by binary search over
+// its sorted entries
+class FirmwareTables {
+public:
+    constexpr FirmwareTables() = default;
+    constexpr explicit FirmwareTables(const PXS_FIRMWARE_TABLES *Tables) : m_Tables(Tables) {}
+
+    constexpr explicit operator bool() const { return m_Tables != nullptr; }
+    constexpr const PXS_FIRMWARE_TABLES *Raw() const { return m_Tables; }
+
+    Span<const PXS_ACPI_TABLE> Acpi() const {
+        if (!m_Tables) return {};
+        return {m_Tables->Acpi, m_Tables->AcpiCount};
+    }
+    Span<const PXS_SMBIOS_STRUCTURE> Smbios() const {
+        if (!m_Tables) return {};
+        return {m_Tables->Smbios, m_Tables->SmbiosCount};
+    }
+
+    // Every table with Signature, in root table order (several SSDTs, say)
+    Span<const PXS_ACPI_TABLE> AcpiTables(std::uint32_t Signature) const {
+        return Range(Acpi(), Signature, [](const PXS_ACPI_TABLE &Table) { return Table.Signature; });
+    }
+    const PXS_ACPI_TABLE *AcpiTable(std::uint32_t Signature, std::size_t Instance = 0) const {
+        auto Tables = AcpiTables(Signature);
+        return Instance < Tables.size() ? &Tables[Instance] : nullptr;
+    }
+
+    // Every structure of Type, in table order
+    Span<const PXS_SMBIOS_STRUCTURE> SmbiosStructures(std::uint8_t Type) const {
+        return Range(Smbios(), Type, [](const PXS_SMBIOS_STRUCTURE &Structure) -> std::uint32_t { return Structure.Type; });
+    }
+
+private:
+    template <typename T, typename KeyFn>
+    static Span<const T> Range(Span<const T> Entries, std::uint32_t Key, KeyFn KeyOf) {
+        std::size_t Low = 0, High = Entries.size();
+        while (Low < High) {
+            std::size_t Mid = Low + (High - Low) / 2;
+            if (KeyOf(Entries[Mid]) < Key) Low = Mid + 1;
+            else High = Mid;
+        }
+        std::size_t End = Low;
+        while (End < Entries.size() && KeyOf(Entries[End]) == Key) End++;
+        return Entries.Subspan(Low, End - Low);
+    }
+
+    const PXS_FIRMWARE_TABLES *m_Tables = nullptr;
+};
+
+// --------------------------------------------------------------------------
+// NUMA
+// --------------------------------------------------------------------------
+
+// The loader's node table: proximity domains, the memory the SRAT assigns to
+// each and the SLIT distances between them
+class Numa {
+public:
+    constexpr Numa() = default;
+    constexpr explicit Numa(const PXS_NUMA *Table) : m_Table(Table) {}
+
+    constexpr explicit operator bool() const { return m_Table != nullptr; }
+    constexpr const PXS_NUMA *Raw() const { return m_Table; }
+
+    Span<const PXS_NUMA_NODE> Nodes() const {
+        if (!m_Table) return {};
+        return {m_Table->Nodes, m_Table->NodeCount};
+    }
+    Span<const PXS_NUMA_RANGE> Ranges() const {
+        if (!m_Table) return {};
+        return {m_Table->Ranges, m_Table->RangeCount};
+    }
+
+    // Memory of one node, by base address
+    Span<const PXS_NUMA_RANGE> Ranges(std::uint32_t Node) const {
+        if (Node >= Nodes().size()) return {};
+        return Ranges().Subspan(Nodes()[Node].FirstRange, Nodes()[Node].RangeCount);
+    }
+
+    // Node of the boot CPU, PXS_NUMA_NO_NODE if the SRAT does not list it
+    constexpr std::uint32_t BspNode() const { return m_Table ? m_Table->BspNode : PXS_NUMA_NO_NODE; }
+
+    // Node with proximity domain Domain, PXS_NUMA_NO_NODE if none
+    std::uint32_t NodeOfDomain(std::uint32_t Domain) const {
+        auto All = Nodes();
+        std::size_t Low = 0, High = All.size();
+        while (Low < High) {
+            std::size_t Mid = Low + (High - Low) / 2;
+            if (All[Mid].Domain < Domain) Low = Mid + 1;
+            else High = Mid;
+        }
+        return Low < All.size() && All[Low].Domain == Domain ? static_cast<std::uint32_t>(Low) : PXS_NUMA_NO_NODE;
+    }
+
+    // Node whose memory holds Address, PXS_NUMA_NO_NODE if none
+    std::uint32_t NodeOfAddress(std::uint64_t Address) const {
+        for (const auto &Range : Ranges()) {
+            if (Address - Range.Base < Range.Length) return Range.Node;
+        }
+        return PXS_NUMA_NO_NODE;
+    }
+
+    // SLIT distance (10 is local), 0 when unknown
+    std::uint8_t Distance(std::uint32_t From, std::uint32_t To) const {
+        std::size_t Count = Nodes().size();
+        if (!m_Table || !m_Table->Distances || From >= Count || To >= Count) return 0;
+        return m_Table->Distances[From * Count + To];
+    }
+
+private:
+    const PXS_NUMA *m_Table = nullptr;
+};
+
+// --------------------------------------------------------------------------
+// BOOT INFO
+// --------------------------------------------------------------------------
+
+// Checked access to the structure the loader passes to the kernel entry point.
+// Pointers are used as the loader left them: identity mapped, or through the
+// direct map once the kernel has translated the handoff arena.
+class BootInfo {
+public:
+    // Oldest protocol version this header can read
+    static constexpr std::uint32_t MinimumVersion = 1;
+
+    constexpr BootInfo() = default;
+    constexpr explicit BootInfo(const PXS_BOOT_INFO *Info)
+        : m_Info(Info && Info->Magic == PXS_MAGIC && Info->Version >= MinimumVersion ? Info : nullptr) {}
+
+    constexpr explicit operator bool() const { return m_Info != nullptr; }
+    constexpr const PXS_BOOT_INFO *Raw() const { return m_Info; }
+    constexpr std::uint32_t Version() const { return m_Info->Version; }
+    constexpr bool HasFlag(std::uint32_t Flag) const { return (m_Info->Flags & Flag) != 0; }
+    constexpr bool AtLeast(std::uint32_t Version) const { return m_Info && m_Info->Version >= Version; }
+
+    MemoryMap FirmwareMemoryMap() const {
+        return MemoryMap(m_Info->MemoryMap, m_Info->MemoryMapSize, m_Info->DescriptorSize);
+    }
+
+    Span<const PXS_MEMORY_RANGE> NormalizedMemoryMap() const {
+        if (!AtLeast(6) || !m_Info->NormalizedMemoryMap) return {};
+        return {m_Info->NormalizedMemoryMap->Entries, m_Info->NormalizedMemoryMap->EntryCount};
+    }
+
+    constexpr CommandLine Arguments() const { return CommandLine(CString(m_Info->CommandLine)); }
+
+    Initrd InitrdImage() const {
+        Bytes Image(reinterpret_cast<const std::uint8_t *>(static_cast<std::uintptr_t>(m_Info->InitrdAddress)), m_Info->InitrdSize);
+        if (!AtLeast(3) || !m_Info->InitrdIndex) return Initrd(Image, {});
+        return Initrd(Image, {m_Info->InitrdIndex->Entries, m_Info->InitrdIndex->EntryCount});
+    }
+
+    Span<const PXS_MODULE> Modules() const {
+        if (!AtLeast(4) || !m_Info->ModuleTable) return {};
+        return {m_Info->ModuleTable->Modules, m_Info->ModuleTable->ModuleCount};
+    }
+
+    const PXS_BOOT_TIMING *Timing() const { return AtLeast(2) ? m_Info->Timing : nullptr; }
+
+    // Older loaders left this byte as padding
+    constexpr std::uint8_t FramebufferCacheType() const {
+        return AtLeast(9) ? m_Info->Framebuffer.CacheType : PXS_FRAMEBUFFER_CACHE_UNKNOWN;
+    }
+
+    Bytes KernelSha256() const {
+        return AtLeast(7) && HasFlag(PXS_FLAG_KERNEL_SHA256) ? Bytes(m_Info->KernelSha256, 32) : Bytes();
+    }
+    Bytes InitrdSha256() const {
+        return AtLeast(7) && HasFlag(PXS_FLAG_INITRD_SHA256) ? Bytes(m_Info->InitrdSha256, 32) : Bytes();
+    }
+
+    Span<const PXS_CPU> Cpus() const {
+        if (!AtLeast(11) || !m_Info->CpuTable) return {};
+        return {m_Info->CpuTable->Cpus, m_Info->CpuTable->CpuCount};
+    }
+
+    LoaderLog Log() const { return LoaderLog(AtLeast(10) ? m_Info->Log : nullptr); }
+
+    FirmwareTables Firmware() const { return FirmwareTables(AtLeast(12) ? m_Info->FirmwareTables : nullptr); }
+
+    Numa Topology() const { return Numa(AtLeast(13) ? m_Info->Numa : nullptr); }
+
+    const PXS_CLOCKS *Clocks() const { return AtLeast(14) ? m_Info->Clocks : nullptr; }
+
+    // The reclaimable block holding this structure and everything it points to
+    Bytes Handoff() const {
+        if (!AtLeast(8)) return {};
+        return Bytes(reinterpret_cast<const std::uint8_t *>(static_cast<std::uintptr_t>(m_Info->HandoffBase)), m_Info->HandoffSize);
+    }
+
+private:
+    const PXS_BOOT_INFO *m_Info = nullptr;
+};
+
+} // namespace pxs